@@ -11,6 +11,8 @@
 #include <stdbool.h>
 #endif
 
+#include "azure_c_util/memory_budget.h"
+
 #include "umock_c/umock_c_prod.h"
 
 #ifdef __cplusplus
@@ -39,6 +41,12 @@ MOCKABLE_FUNCTION(, unsigned char*, BUFFER_u_char, BUFFER_HANDLE, handle);
 MOCKABLE_FUNCTION(, size_t, BUFFER_length, BUFFER_HANDLE, handle);
 MOCKABLE_FUNCTION(, BUFFER_HANDLE, BUFFER_clone, BUFFER_HANDLE, handle);
 
+/*charges the content of the BUFFER_HANDLEs created afterwards to memory_budget (NULL means "no budget"). When the budget is exhausted, growing a BUFFER waits at most timeout_ms (0 means "fail right away") for bytes to be released*/
+MOCKABLE_FUNCTION(, void, BUFFER_set_memory_budget, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms);
+
+/*same as BUFFER_create, but the BUFFER_HANDLE charges its content to memory_budget (NULL means "no budget") with timeout_ms instead of the budget set by BUFFER_set_memory_budget*/
+MOCKABLE_FUNCTION(, BUFFER_HANDLE, BUFFER_create_with_memory_budget, const unsigned char*, source, size_t, size, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
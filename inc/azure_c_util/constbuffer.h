@@ -12,6 +12,7 @@
 #endif
 
 #include "azure_c_util/buffer_.h"
+#include "azure_c_util/memory_budget.h"
 
 #include "umock_c/umock_c_prod.h"
 
@@ -53,7 +54,13 @@ MOCKABLE_INTERFACE(constbuffer,
 
     FUNCTION(, const CONSTBUFFER*, CONSTBUFFER_GetContent, CONSTBUFFER_HANDLE, constbufferHandle),
 
-    FUNCTION(, bool, CONSTBUFFER_HANDLE_contain_same, CONSTBUFFER_HANDLE, left, CONSTBUFFER_HANDLE, right)
+    FUNCTION(, bool, CONSTBUFFER_HANDLE_contain_same, CONSTBUFFER_HANDLE, left, CONSTBUFFER_HANDLE, right),
+
+    /*charges the CONSTBUFFER_HANDLEs created afterwards to memory_budget (NULL means "no budget"). When the budget is exhausted, creation waits at most timeout_ms (0 means "fail right away") for bytes to be released*/
+    FUNCTION(, void, CONSTBUFFER_SetMemoryBudget, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms),
+
+    /*same as CONSTBUFFER_Create, but charges memory_budget (NULL means "no budget") with timeout_ms instead of the budget set by CONSTBUFFER_SetMemoryBudget*/
+    FUNCTION(, CONSTBUFFER_HANDLE, CONSTBUFFER_CreateWithMemoryBudget, const unsigned char*, source, size_t, size, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms)
 )
 
 #ifdef __cplusplus
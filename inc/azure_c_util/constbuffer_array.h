@@ -46,6 +46,12 @@ MOCKABLE_FUNCTION(, const CONSTBUFFER_HANDLE*, constbuffer_array_get_const_buffe
 /*compare*/
 MOCKABLE_FUNCTION(, bool, CONSTBUFFER_ARRAY_HANDLE_contain_same, CONSTBUFFER_ARRAY_HANDLE, left, CONSTBUFFER_ARRAY_HANDLE, right);
 
+/*charges the CONSTBUFFER_ARRAY_HANDLEs created afterwards to memory_budget (NULL means "no budget"). When the budget is exhausted, creation waits at most timeout_ms (0 means "fail right away") for bytes to be released*/
+MOCKABLE_FUNCTION(, void, constbuffer_array_set_memory_budget, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms);
+
+/*same as constbuffer_array_create, but charges memory_budget (NULL means "no budget") with timeout_ms instead of the budget set by constbuffer_array_set_memory_budget*/
+MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create_with_memory_budget, const CONSTBUFFER_HANDLE*, buffers, uint32_t, buffer_count, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
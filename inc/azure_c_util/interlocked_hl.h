@@ -28,12 +28,92 @@ MU_DEFINE_ENUM(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
 
 typedef bool (*INTERLOCKED_COMPARE_EXCHANGE_64_IF)(int64_t target, int64_t exchange);
 
+/*returns true when current_value is the value waited for. It can be called several times per wait (also with values that were never written if the value changes quickly), so it shall have no side effects*/
+typedef bool (*INTERLOCKED_HL_WAIT_PREDICATE)(int32_t current_value, void* context);
+
+/*before calling wait_on_address the waits spin for a while (the value is often about to change, for example in the drain of short sm_exec_begin/sm_exec_end).
+The number of spins adapts to how long the recent waits on the same address (or on an address with the same hash) were, up to a maximum that can be changed with InterlockedHL_SetWaitSpinCount*/
+#define INTERLOCKED_HL_DEFAULT_WAIT_SPIN_COUNT 1000
+#define INTERLOCKED_HL_MAX_WAIT_SPIN_COUNT 1000000
+
+/*wait_on_address only waits on 32 bit values, so the 64 bit waits sleep on one of INTERLOCKED_HL_WAIT_CELL_COUNT 32 bit cells chosen by hashing the address.
+The 64 bit updaters (InterlockedHL_SetAndWakeAll64, InterlockedHL_Add64WithCeiling, InterlockedHL_CompareExchange64If) change the value and then, only if the cell has waiters, bump and wake the cell.
+A value changed with a plain interlocked operation is signalled with InterlockedHL_WakeAll64, which only touches the cell (so it can be called after the memory holding the value was freed by a waiter).
+There is no InterlockedHL_SetAndWake64: a cell is shared by several addresses, so a single wake could go to a waiter of another address. The cells also keep the spin budgets of the waits*/
+#define INTERLOCKED_HL_WAIT_CELL_COUNT 256
+
+/*a latch is an int32_t initialized with interlocked_exchange to the number of count downs to wait for.
+A barrier is an int32_t initialized with interlocked_exchange to 0: the low 16 bits count the parties that arrived, the high 16 bits are the generation of the barrier*/
+#define INTERLOCKED_HL_BARRIER_MAX_PARTIES 0xFFFF
+
+/*a mutex is an int32_t initialized with interlocked_exchange to 0: bit 0 is set while the mutex is owned, the other bits count the threads sleeping in InterlockedHL_MutexLock.
+Both locks spin and then sleep with wait_on_address, and the release only calls wake_by_address_* when there are sleeping threads*/
+typedef struct INTERLOCKED_HL_RWLOCK_TAG
+{
+    volatile_atomic int32_t state;          /*number of readers, a bit for the writer and a bit for a writer waiting (that keeps new readers out)*/
+    volatile_atomic int32_t waiter_count;   /*low 16 bits: number of threads sleeping on state. Bits 16-30: number of writers that stopped spinning, the writer that owns the lock keeps the writer waiting bit while it is not 0*/
+}INTERLOCKED_HL_RWLOCK;
+
+/*a seqlock protects read-mostly data: readers do not write anything (they only read the sequence before and after reading the data and read again if a writer ran meanwhile), writers make the sequence odd while they write*/
+typedef struct INTERLOCKED_HL_SEQLOCK_TAG
+{
+    volatile_atomic int32_t sequence;       /*odd while a writer writes*/
+    volatile_atomic int32_t waiter_count;   /*number of threads sleeping on sequence*/
+}INTERLOCKED_HL_SEQLOCK;
+
+/*a compare exchange retry loop declares an INTERLOCKED_HL_BACKOFF initialized with INTERLOCKED_HL_BACKOFF_INITIALIZER and calls InterlockedHL_Backoff every time the compare exchange failed.
+The backoff executes a random number of pause instructions between half and all of the current limit, and the limit doubles with every retry up to INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT, so contending threads spread out instead of failing each other's compare exchange*/
+typedef struct INTERLOCKED_HL_BACKOFF_TAG
+{
+    uint32_t pause_count;   /*limit of the pauses of the next backoff, 0 before the first backoff*/
+    uint32_t seed;          /*state of the generator of the jitter*/
+}INTERLOCKED_HL_BACKOFF;
+
+#define INTERLOCKED_HL_BACKOFF_INITIALIZER { 0, 0 }
+#define INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT 4
+#define INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT 1024
+
+/*the contention counters are kept per processor (processors with an index of INTERLOCKED_HL_STATISTICS_SLOT_COUNT or more share the slots) and summed by InterlockedHL_GetStatistics*/
+#define INTERLOCKED_HL_STATISTICS_SLOT_COUNT 64
+
+/*process wide counters of the contention on the compare exchange loops*/
+typedef struct INTERLOCKED_HL_STATISTICS_TAG
+{
+    uint64_t cas_retries;       /*compare exchanges that failed because the value changed meanwhile*/
+    uint64_t backoff_pauses;    /*pause instructions executed by InterlockedHL_Backoff*/
+}INTERLOCKED_HL_STATISTICS;
+
 MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_Add64WithCeiling, int64_t volatile_atomic*, Addend, int64_t, Ceiling, int64_t, Value, int64_t*, originalAddend)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
 MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SetAndWake, int32_t volatile_atomic*, address, int32_t, value)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
 MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SetAndWakeAll, int32_t volatile_atomic*, address, int32_t, value)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
 MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForValue, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
 MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForNotValue, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForMask, int32_t volatile_atomic*, address, int32_t, mask, int32_t, expected, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForLessThan, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForPredicate, int32_t volatile_atomic*, address, INTERLOCKED_HL_WAIT_PREDICATE, predicate, void*, context, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_LatchCountDown, int32_t volatile_atomic*, latch)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_LatchWait, int32_t volatile_atomic*, latch, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_BarrierArriveAndWait, int32_t volatile_atomic*, barrier, int32_t, parties, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_MutexLock, int32_t volatile_atomic*, mutex)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_MutexUnlock, int32_t volatile_atomic*, mutex)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockInit, INTERLOCKED_HL_RWLOCK*, rwlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockAcquireShared, INTERLOCKED_HL_RWLOCK*, rwlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockReleaseShared, INTERLOCKED_HL_RWLOCK*, rwlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockAcquireExclusive, INTERLOCKED_HL_RWLOCK*, rwlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockReleaseExclusive, INTERLOCKED_HL_RWLOCK*, rwlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockInit, INTERLOCKED_HL_SEQLOCK*, seqlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockReadBegin, INTERLOCKED_HL_SEQLOCK*, seqlock, int32_t*, sequence)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockReadRetry, INTERLOCKED_HL_SEQLOCK*, seqlock, int32_t, sequence)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockWriteBegin, INTERLOCKED_HL_SEQLOCK*, seqlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockWriteEnd, INTERLOCKED_HL_SEQLOCK*, seqlock)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SetAndWakeAll64, int64_t volatile_atomic*, address, int64_t, value)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WakeAll64, int64_t volatile_atomic*, address)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForValue64, int64_t volatile_atomic*, address, int64_t, value, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForNotValue64, int64_t volatile_atomic*, address, int64_t, value, uint32_t, milliseconds)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_SetWaitSpinCount, uint32_t, max_spin_count)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
 MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_CompareExchange64If, int64_t volatile_atomic*, target, int64_t, exchange, INTERLOCKED_COMPARE_EXCHANGE_64_IF, compare, int64_t*, original_target)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_Backoff, INTERLOCKED_HL_BACKOFF*, backoff)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
+MOCKABLE_FUNCTION_WITH_RETURNS(, INTERLOCKED_HL_RESULT, InterlockedHL_GetStatistics, INTERLOCKED_HL_STATISTICS*, statistics)(INTERLOCKED_HL_OK, INTERLOCKED_HL_ERROR);
 
 #ifdef __cplusplus
 }
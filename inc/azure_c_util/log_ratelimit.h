@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef LOG_RATELIMIT_H
+#define LOG_RATELIMIT_H
+
+#ifdef __cplusplus
+#include <cinttypes>
+#else
+#include <inttypes.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/interlocked.h"
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*one call site of LogErrorRateLimited. Lives in a static variable, so it is zero-initialized and never freed*/
+typedef struct LOG_RATELIMIT_SITE_TAG
+{
+    const char* file;
+    const char* func;
+    int line;
+    volatile_atomic int64_t count; /*number of times the call site was hit since the last log_ratelimit_flush*/
+    volatile_atomic int64_t total_count; /*number of times the call site was hit before the last log_ratelimit_flush*/
+    volatile_atomic int32_t listed; /*1 once the call site was added to the list of call sites*/
+    struct LOG_RATELIMIT_SITE_TAG* volatile_atomic next; /*all the call sites that were hit at least once are in a list, so log_ratelimit_flush can find them*/
+}LOG_RATELIMIT_SITE;
+
+#define LOG_RATELIMIT_SITE_INITIALIZER { __FILE__, __func__, __LINE__, 0, 0, 0, NULL }
+
+/*counts one hit of site. Returns the number of hits since the last log_ratelimit_flush when this hit should be logged (the 1st, 2nd, 4th, 8th... hit), 0 otherwise*/
+MOCKABLE_FUNCTION(, int64_t, log_ratelimit_hit, LOG_RATELIMIT_SITE*, site);
+
+/*logs, for every call site, the number of hits since the previous log_ratelimit_flush and starts counting the hits again from 0, so the next hit of every call site is logged.
+Meant to be called periodically (for example from a timer of the application)*/
+MOCKABLE_FUNCTION(, void, log_ratelimit_flush);
+
+/*LogErrorRateLimited is a LogError for paths that can be hit by many threads at once (for example the refusals of sm_exec_begin during a close).
+A hit costs one interlocked increment. Only the hits whose count (since the last log_ratelimit_flush) is a power of 2 are formatted and logged, together with the count.*/
+#define LogErrorRateLimited(FORMAT, ...)                                                                    \
+    do                                                                                                      \
+    {                                                                                                       \
+        static LOG_RATELIMIT_SITE log_ratelimit_site = LOG_RATELIMIT_SITE_INITIALIZER;                      \
+        int64_t log_ratelimit_count = log_ratelimit_hit(&log_ratelimit_site);                               \
+        if (log_ratelimit_count != 0)                                                                       \
+        {                                                                                                   \
+            LogError("[rate limited, hit %" PRId64 "] " FORMAT, log_ratelimit_count, ##__VA_ARGS__);        \
+        }                                                                                                   \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*LOG_RATELIMIT_H*/
@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MEMORY_BUDGET_TAG* MEMORY_BUDGET_HANDLE;
+
+#define MEMORY_BUDGET_RESULT_VALUES     \
+    MEMORY_BUDGET_OK,                   \
+    MEMORY_BUDGET_EXHAUSTED,            \
+    MEMORY_BUDGET_ERROR                 \
+
+MU_DEFINE_ENUM(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+
+/*a named budget of limit bytes. Bytes charged to a budget are also charged to its parent (and to the parent of its parent...), so a component budget can be nested in a process wide budget. parent can be NULL and shall outlive the budget*/
+MOCKABLE_FUNCTION(, MEMORY_BUDGET_HANDLE, memory_budget_create, const char*, name, int64_t, limit, MEMORY_BUDGET_HANDLE, parent);
+MOCKABLE_FUNCTION(, void, memory_budget_destroy, MEMORY_BUDGET_HANDLE, memory_budget);
+
+/*charges size bytes to memory_budget and its parents. When a budget does not have size bytes left, waits at most timeout_ms (0 means "do not wait", UINT32_MAX means "forever") for bytes to be released*/
+MOCKABLE_FUNCTION(, MEMORY_BUDGET_RESULT, memory_budget_charge, MEMORY_BUDGET_HANDLE, memory_budget, int64_t, size, uint32_t, timeout_ms);
+
+/*gives back size bytes previously charged with memory_budget_charge*/
+MOCKABLE_FUNCTION(, void, memory_budget_release, MEMORY_BUDGET_HANDLE, memory_budget, int64_t, size);
+
+MOCKABLE_FUNCTION(, int, memory_budget_get_used, MEMORY_BUDGET_HANDLE, memory_budget, int64_t*, used);
+MOCKABLE_FUNCTION(, const char*, memory_budget_get_name, MEMORY_BUDGET_HANDLE, memory_budget);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*macro to be used in a .c file (that includes azure_c_pal/interlocked.h). MEMORY_BUDGET_SETTING_DEFINE(name) defines a static setting "name" that holds a budget and the timeout
+to charge it with, together with the static functions name_set(memory_budget, timeout_ms) and name_get(&memory_budget, &timeout_ms).
+name_get returns a budget and a timeout that were set by the same name_set: name_set makes the sequence odd while it writes, and name_get reads again when it saw the sequence odd or changed.
+name_get uses no interlocked operation because a setting is read by every create and set about once per process*/
+#define MEMORY_BUDGET_SETTING_DEFINE(name)                                                                                              \
+/*Codes_SRS_MEMORY_BUDGET_02_026: [ MEMORY_BUDGET_SETTING_DEFINE(name) shall define a static setting name without a budget (NULL) and with a timeout of 0. ]*/\
+static struct MU_C2(name, _TAG)                                                                                                         \
+{                                                                                                                                       \
+    volatile_atomic int32_t sequence;                                                                                                   \
+    void* volatile_atomic memory_budget;                                                                                                \
+    volatile_atomic int32_t timeout_ms;                                                                                                 \
+} name = { 0, NULL, 0 };                                                                                                                \
+                                                                                                                                        \
+static void MU_C2(name, _set)(MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms)                                                  \
+{                                                                                                                                       \
+    int32_t sequence;                                                                                                                   \
+    /*Codes_SRS_MEMORY_BUDGET_02_029: [ name_set shall make the sequence of name odd by incrementing it from an even value with interlocked_compare_exchange, write memory_budget and timeout_ms and then make the sequence even again. ]*/\
+    do                                                                                                                                  \
+    {                                                                                                                                   \
+        sequence = interlocked_add(&name.sequence, 0);                                                                                  \
+    } while (((sequence & 1) != 0) || (interlocked_compare_exchange(&name.sequence, sequence + 1, sequence) != sequence));              \
+                                                                                                                                        \
+    /*Codes_SRS_MEMORY_BUDGET_02_027: [ name_set shall store memory_budget and timeout_ms in name. ]*/                                  \
+    (void)interlocked_exchange_pointer(&name.memory_budget, memory_budget);                                                             \
+    (void)interlocked_exchange(&name.timeout_ms, (int32_t)timeout_ms);                                                                  \
+    (void)interlocked_exchange(&name.sequence, sequence + 2);                                                                           \
+}                                                                                                                                       \
+                                                                                                                                        \
+static void MU_C2(name, _get)(MEMORY_BUDGET_HANDLE* memory_budget, uint32_t* timeout_ms)                                                \
+{                                                                                                                                       \
+    int32_t sequence;                                                                                                                   \
+    /*Codes_SRS_MEMORY_BUDGET_02_028: [ name_get shall write in memory_budget and timeout_ms the budget and the timeout stored in name. ]*/\
+    /*Codes_SRS_MEMORY_BUDGET_02_030: [ If the sequence of name was odd or changed while name_get read then name_get shall read again. ]*/\
+    do                                                                                                                                  \
+    {                                                                                                                                   \
+        sequence = name.sequence;                                                                                                       \
+        *memory_budget = name.memory_budget;                                                                                            \
+        *timeout_ms = (uint32_t)name.timeout_ms;                                                                                        \
+    } while (((sequence & 1) != 0) || (sequence != name.sequence));                                                                     \
+}                                                                                                                                       \
+
+#endif /*MEMORY_BUDGET_H*/
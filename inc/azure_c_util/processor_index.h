@@ -0,0 +1,29 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PROCESSOR_INDEX_H
+#define PROCESSOR_INDEX_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*processor_index is used to spread per-processor data (counters, caches) so that threads running on different processors do not share cache lines*/
+/*the values returned by processor_index_get_current are only a hint: the calling thread can be migrated to another processor at any time*/
+
+MOCKABLE_FUNCTION(, uint32_t, processor_index_get_count);
+MOCKABLE_FUNCTION(, uint32_t, processor_index_get_current);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*PROCESSOR_INDEX_H*/
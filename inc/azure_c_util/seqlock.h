@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#ifdef __cplusplus
+#include <cstring>
+#include <cinttypes>
+#else
+#include <string.h>
+#include <inttypes.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+#include "umock_c/umock_c_prod.h"
+
+#include "azure_c_logging/xlogging.h"
+
+#include "azure_c_util/interlocked_hl.h"
+
+/*given a type T, SEQLOCK(T) is a struct that has an INTERLOCKED_HL_SEQLOCK and a T protected by it.
+T is copied with memcpy, so it shall not own memory that a writer frees (the copy of a reader can be torn until the reader finds out that a writer ran meanwhile)*/
+#define SEQLOCK(T) MU_C2(SEQLOCK_, T)
+
+/*given a previous type T, SEQLOCK_INIT introduces a new name for a function that initializes a SEQLOCK(T) with a T*/
+#define SEQLOCK_INIT(T) MU_C2(T, _SEQLOCK_INIT)
+
+/*given a previous type T, SEQLOCK_READ introduces a new name for a function that copies the T of a SEQLOCK(T) without writing to the SEQLOCK(T)*/
+#define SEQLOCK_READ(T) MU_C2(T, _SEQLOCK_READ)
+
+/*given a previous type T, SEQLOCK_WRITE introduces a new name for a function that replaces the T of a SEQLOCK(T)*/
+#define SEQLOCK_WRITE(T) MU_C2(T, _SEQLOCK_WRITE)
+
+#define SEQLOCK_INIT_MACRO(T)                                                                                                                                       \
+int SEQLOCK_INIT(T)(SEQLOCK(T)* seqlock, const T* value)                                                                                                            \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (                                                                                                                                                            \
+        /*Codes_SRS_SEQLOCK_02_001: [ If seqlock is NULL then SEQLOCK_INIT shall fail and return a non-zero value. ]*/                                              \
+        (seqlock == NULL) ||                                                                                                                                        \
+        /*Codes_SRS_SEQLOCK_02_002: [ If value is NULL then SEQLOCK_INIT shall fail and return a non-zero value. ]*/                                                \
+        (value == NULL)                                                                                                                                             \
+        )                                                                                                                                                           \
+    {                                                                                                                                                               \
+        LogError("invalid arguments SEQLOCK(" MU_TOSTRING(T) ")* seqlock=%p, const " MU_TOSTRING(T) "* value=%p", seqlock, value);                                  \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    /*Codes_SRS_SEQLOCK_02_003: [ SEQLOCK_INIT shall call InterlockedHL_SeqLockInit. ]*/                                                                            \
+    else if (InterlockedHL_SeqLockInit(&seqlock->seqlock) != INTERLOCKED_HL_OK)                                                                                     \
+    {                                                                                                                                                               \
+        /*Codes_SRS_SEQLOCK_02_004: [ If InterlockedHL_SeqLockInit fails then SEQLOCK_INIT shall fail and return a non-zero value. ]*/                              \
+        LogError("failure in InterlockedHL_SeqLockInit(&seqlock->seqlock=%p)", &seqlock->seqlock);                                                                  \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_SEQLOCK_02_005: [ SEQLOCK_INIT shall copy value in seqlock, succeed and return 0. ]*/                                                           \
+        (void)memcpy((void*)&seqlock->value, value, sizeof(T));                                                                                                     \
+        result = 0;                                                                                                                                                 \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+
+#define SEQLOCK_READ_MACRO(T)                                                                                                                                       \
+int SEQLOCK_READ(T)(SEQLOCK(T)* seqlock, T* value)                                                                                                                  \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (                                                                                                                                                            \
+        /*Codes_SRS_SEQLOCK_02_006: [ If seqlock is NULL then SEQLOCK_READ shall fail and return a non-zero value. ]*/                                              \
+        (seqlock == NULL) ||                                                                                                                                        \
+        /*Codes_SRS_SEQLOCK_02_007: [ If value is NULL then SEQLOCK_READ shall fail and return a non-zero value. ]*/                                                \
+        (value == NULL)                                                                                                                                             \
+        )                                                                                                                                                           \
+    {                                                                                                                                                               \
+        LogError("invalid arguments SEQLOCK(" MU_TOSTRING(T) ")* seqlock=%p, " MU_TOSTRING(T) "* value=%p", seqlock, value);                                        \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        do                                                                                                                                                          \
+        {                                                                                                                                                           \
+            int32_t sequence;                                                                                                                                       \
+            INTERLOCKED_HL_RESULT retry_result;                                                                                                                     \
+            /*Codes_SRS_SEQLOCK_02_008: [ SEQLOCK_READ shall call InterlockedHL_SeqLockReadBegin. ]*/                                                               \
+            if (InterlockedHL_SeqLockReadBegin(&seqlock->seqlock, &sequence) != INTERLOCKED_HL_OK)                                                                  \
+            {                                                                                                                                                       \
+                /*Codes_SRS_SEQLOCK_02_009: [ If InterlockedHL_SeqLockReadBegin fails then SEQLOCK_READ shall fail and return a non-zero value. ]*/                 \
+                LogError("failure in InterlockedHL_SeqLockReadBegin(&seqlock->seqlock=%p, &sequence=%p)", &seqlock->seqlock, &sequence);                            \
+                result = MU_FAILURE;                                                                                                                                \
+                break;                                                                                                                                              \
+            }                                                                                                                                                       \
+                                                                                                                                                                    \
+            /*Codes_SRS_SEQLOCK_02_010: [ SEQLOCK_READ shall copy the value of seqlock in value. ]*/                                                                \
+            (void)memcpy(value, (const void*)&seqlock->value, sizeof(T));                                                                                           \
+                                                                                                                                                                    \
+            /*Codes_SRS_SEQLOCK_02_011: [ SEQLOCK_READ shall call InterlockedHL_SeqLockReadRetry. ]*/                                                               \
+            retry_result = InterlockedHL_SeqLockReadRetry(&seqlock->seqlock, sequence);                                                                             \
+            if (retry_result == INTERLOCKED_HL_OK)                                                                                                                  \
+            {                                                                                                                                                       \
+                /*Codes_SRS_SEQLOCK_02_012: [ If InterlockedHL_SeqLockReadRetry returns INTERLOCKED_HL_OK then SEQLOCK_READ shall succeed and return 0. ]*/         \
+                result = 0;                                                                                                                                         \
+                break;                                                                                                                                              \
+            }                                                                                                                                                       \
+            else if (retry_result != INTERLOCKED_HL_CHANGED)                                                                                                        \
+            {                                                                                                                                                       \
+                /*Codes_SRS_SEQLOCK_02_014: [ If InterlockedHL_SeqLockReadRetry fails then SEQLOCK_READ shall fail and return a non-zero value. ]*/                 \
+                LogError("failure in InterlockedHL_SeqLockReadRetry(&seqlock->seqlock=%p, sequence=%" PRId32 ")", &seqlock->seqlock, sequence);                     \
+                result = MU_FAILURE;                                                                                                                                \
+                break;                                                                                                                                              \
+            }                                                                                                                                                       \
+            else                                                                                                                                                    \
+            {                                                                                                                                                       \
+                /*Codes_SRS_SEQLOCK_02_013: [ If InterlockedHL_SeqLockReadRetry returns INTERLOCKED_HL_CHANGED then SEQLOCK_READ shall read the value again. ]*/    \
+            }                                                                                                                                                       \
+        } while (1);                                                                                                                                                \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+
+#define SEQLOCK_WRITE_MACRO(T)                                                                                                                                      \
+int SEQLOCK_WRITE(T)(SEQLOCK(T)* seqlock, const T* value)                                                                                                           \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (                                                                                                                                                            \
+        /*Codes_SRS_SEQLOCK_02_015: [ If seqlock is NULL then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/                                             \
+        (seqlock == NULL) ||                                                                                                                                        \
+        /*Codes_SRS_SEQLOCK_02_016: [ If value is NULL then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/                                               \
+        (value == NULL)                                                                                                                                             \
+        )                                                                                                                                                           \
+    {                                                                                                                                                               \
+        LogError("invalid arguments SEQLOCK(" MU_TOSTRING(T) ")* seqlock=%p, const " MU_TOSTRING(T) "* value=%p", seqlock, value);                                  \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    /*Codes_SRS_SEQLOCK_02_017: [ SEQLOCK_WRITE shall call InterlockedHL_SeqLockWriteBegin. ]*/                                                                     \
+    else if (InterlockedHL_SeqLockWriteBegin(&seqlock->seqlock) != INTERLOCKED_HL_OK)                                                                               \
+    {                                                                                                                                                               \
+        /*Codes_SRS_SEQLOCK_02_018: [ If InterlockedHL_SeqLockWriteBegin fails then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/                       \
+        LogError("failure in InterlockedHL_SeqLockWriteBegin(&seqlock->seqlock=%p)", &seqlock->seqlock);                                                            \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_SEQLOCK_02_019: [ SEQLOCK_WRITE shall copy value in seqlock. ]*/                                                                                \
+        (void)memcpy((void*)&seqlock->value, value, sizeof(T));                                                                                                     \
+                                                                                                                                                                    \
+        /*Codes_SRS_SEQLOCK_02_020: [ SEQLOCK_WRITE shall call InterlockedHL_SeqLockWriteEnd. ]*/                                                                   \
+        if (InterlockedHL_SeqLockWriteEnd(&seqlock->seqlock) != INTERLOCKED_HL_OK)                                                                                  \
+        {                                                                                                                                                           \
+            /*Codes_SRS_SEQLOCK_02_021: [ If InterlockedHL_SeqLockWriteEnd fails then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/                     \
+            LogError("failure in InterlockedHL_SeqLockWriteEnd(&seqlock->seqlock=%p)", &seqlock->seqlock);                                                          \
+            result = MU_FAILURE;                                                                                                                                    \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_SEQLOCK_02_022: [ SEQLOCK_WRITE shall succeed and return 0. ]*/                                                                             \
+            result = 0;                                                                                                                                             \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+
+/*macro to be used in headers*/
+/*introduces SEQLOCK(T) and the functions that initialize, read and write it*/
+#define SEQLOCK_TYPE_DECLARE(T)                                                                                                                                     \
+    typedef struct MU_C3(SEQLOCK_, T, _TAG)                                                                                                                         \
+    {                                                                                                                                                               \
+        INTERLOCKED_HL_SEQLOCK seqlock;                                                                                                                             \
+        T value;                                                                                                                                                    \
+    } SEQLOCK(T);                                                                                                                                                   \
+    MOCKABLE_FUNCTION(, int, SEQLOCK_INIT(T), SEQLOCK(T)*, seqlock, const T*, value);                                                                               \
+    MOCKABLE_FUNCTION(, int, SEQLOCK_READ(T), SEQLOCK(T)*, seqlock, T*, value);                                                                                     \
+    MOCKABLE_FUNCTION(, int, SEQLOCK_WRITE(T), SEQLOCK(T)*, seqlock, const T*, value);                                                                              \
+
+/*macro to be used in a .c file*/
+#define SEQLOCK_TYPE_DEFINE(T)                                                                                                                                      \
+    SEQLOCK_INIT_MACRO(T)                                                                                                                                           \
+    SEQLOCK_READ_MACRO(T)                                                                                                                                           \
+    SEQLOCK_WRITE_MACRO(T)                                                                                                                                          \
+
+#endif /*SEQLOCK_H*/
@@ -6,8 +6,10 @@
 
 #ifdef __cplusplus
 /*C++ has native support for "bool"*/
+#include <cstdint>
 #else
 #include <stdbool.h>
+#include <stdint.h>
 #endif
 
 #include "azure_macro_utils/macro_utils.h"
@@ -24,11 +26,58 @@ typedef struct SM_HANDLE_DATA_TAG* SM_HANDLE;
 #define SM_RESULT_VALUES    \
     SM_EXEC_GRANTED,        \
     SM_EXEC_REFUSED,        \
-    SM_ERROR                \
+    SM_ERROR,               \
+    SM_EXEC_THROTTLED       \
 
 MU_DEFINE_ENUM(SM_RESULT, SM_RESULT_VALUES);
 
+/*a zero-initialized SM_OPTIONS produces the same SM_HANDLE as sm_create*/
+typedef struct SM_OPTIONS_TAG
+{
+    bool use_sharded_exec_count;    /*when true the count of executing non-barrier APIs is spread over per-processor shards. sm_exec_begin/sm_exec_end get cheaper, sm_barrier_begin/sm_close_begin get more expensive*/
+    uint32_t shard_count;           /*number of shards when use_sharded_exec_count is true. 0 means "as many as processors"*/
+    uint32_t max_exec_count;        /*maximum number of concurrently granted executions. 0 means "no maximum". Cannot be combined with use_sharded_exec_count*/
+    bool wait_when_throttled;       /*when true, sm_exec_begin waits for an execution to end instead of returning SM_EXEC_THROTTLED*/
+    bool collect_statistics;        /*when true, the calls are counted in per-processor counters that can be read with sm_get_statistics*/
+}SM_OPTIONS;
+
+#define SM_STATISTICS_DRAIN_WAIT_BUCKET_COUNT 32
+
+typedef struct SM_API_STATISTICS_TAG
+{
+    uint64_t granted;
+    uint64_t refused;
+}SM_API_STATISTICS;
+
+typedef struct SM_STATISTICS_TAG
+{
+    SM_API_STATISTICS open_begin;
+    SM_API_STATISTICS close_begin;      /*includes sm_close_begin_async*/
+    SM_API_STATISTICS exec_begin;       /*includes sm_exec_begin_n*/
+    SM_API_STATISTICS barrier_begin;    /*includes sm_barrier_begin_async*/
+    uint64_t exec_begin_throttled;
+    uint64_t state_changed_meanwhile;   /*number of times a state transition lost the race with another thread*/
+    uint64_t cas_retries;               /*number of times a compare exchange of the state word was retried because n changed meanwhile*/
+    uint64_t drain_wait_us[SM_STATISTICS_DRAIN_WAIT_BUCKET_COUNT]; /*drain_wait_us[0] counts drains shorter than 1 microsecond, drain_wait_us[i] counts drains that took [2^(i-1), 2^i) microseconds. The last bucket also counts everything longer*/
+}SM_STATISTICS;
+
+/*number of records kept by the transition trace of every SM_HANDLE when sm.c is compiled with SM_TRACE. A power of 2*/
+#define SM_TRACE_RECORD_COUNT 64
+
+/*one state transition (or one refused sm_exec_begin, in which case old_state and new_state are the same)*/
+typedef struct SM_TRACE_RECORD_TAG
+{
+    int64_t sequence;       /*position of the record in the history of the SM_HANDLE, starting at 0*/
+    double timestamp_ms;    /*timer_global_get_elapsed_ms at the time of the transition*/
+    int32_t old_state;      /*the state before the transition, as kept internally by sm (state, SM_CLOSE_BIT and transition counter)*/
+    int32_t new_state;      /*the state after the transition*/
+}SM_TRACE_RECORD;
+
+/*called when all the executions have drained after sm_close_begin_async/sm_barrier_begin_async. It runs on the thread that ended the last execution (or on the thread that called the _async function if nothing was executing)*/
+typedef void (*SM_ON_DRAINED_FUNC)(void* context);
+
 MOCKABLE_FUNCTION(, SM_HANDLE, sm_create, const char*, name);
+MOCKABLE_FUNCTION(, SM_HANDLE, sm_create_with_options, const char*, name, const SM_OPTIONS*, options);
 MOCKABLE_FUNCTION(, void, sm_destroy, SM_HANDLE, sm);
 
 MOCKABLE_FUNCTION(, SM_RESULT, sm_open_begin, SM_HANDLE, sm);
@@ -40,9 +89,25 @@ MOCKABLE_FUNCTION(, void, sm_close_end, SM_HANDLE, sm);
 MOCKABLE_FUNCTION(, SM_RESULT, sm_exec_begin, SM_HANDLE, sm);
 MOCKABLE_FUNCTION(, void, sm_exec_end, SM_HANDLE, sm);
 
+/*sm_exec_begin_n grants count executions at once (or none). They can be ended all together by sm_exec_end_n or piecemeal by sm_exec_end/sm_exec_end_n*/
+MOCKABLE_FUNCTION(, SM_RESULT, sm_exec_begin_n, SM_HANDLE, sm, uint32_t, count);
+MOCKABLE_FUNCTION(, void, sm_exec_end_n, SM_HANDLE, sm, uint32_t, count);
+
 MOCKABLE_FUNCTION(, SM_RESULT, sm_barrier_begin, SM_HANDLE, sm);
 MOCKABLE_FUNCTION(, void, sm_barrier_end, SM_HANDLE, sm);
 
+/*non-blocking variants of sm_close_begin/sm_barrier_begin. When they return SM_EXEC_GRANTED, on_drained is called once n reaches 0 and then sm_close_end/sm_barrier_end need to be called*/
+MOCKABLE_FUNCTION(, SM_RESULT, sm_close_begin_async, SM_HANDLE, sm, SM_ON_DRAINED_FUNC, on_drained, void*, context);
+MOCKABLE_FUNCTION(, SM_RESULT, sm_barrier_begin_async, SM_HANDLE, sm, SM_ON_DRAINED_FUNC, on_drained, void*, context);
+
+/*fills statistics with the sum of the per-processor counters. Only available for SM_HANDLEs created with collect_statistics*/
+MOCKABLE_FUNCTION(, int, sm_get_statistics, SM_HANDLE, sm, SM_STATISTICS*, statistics);
+
+/*copies the most recent (at most SM_TRACE_RECORD_COUNT) transitions of sm, oldest first. records needs to have space for SM_TRACE_RECORD_COUNT records. Only available when sm.c is compiled with SM_TRACE*/
+MOCKABLE_FUNCTION(, int, sm_trace_get, SM_HANDLE, sm, SM_TRACE_RECORD*, records, uint32_t*, record_count);
+/*logs the most recent transitions of sm, oldest first. Only available when sm.c is compiled with SM_TRACE*/
+MOCKABLE_FUNCTION(, void, sm_trace_dump, SM_HANDLE, sm);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef SM_GROUP_H
+#define SM_GROUP_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/sm.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "umock_c/umock_c_prod.h"
+
+/*a SM_GROUP_HANDLE closes (or barriers) several SM_HANDLEs at once: all the children stop granting sm_exec_begin at the same time and their drains overlap*/
+typedef struct SM_GROUP_TAG* SM_GROUP_HANDLE;
+
+MOCKABLE_FUNCTION(, SM_GROUP_HANDLE, sm_group_create, SM_HANDLE*, children, uint32_t, child_count);
+MOCKABLE_FUNCTION(, void, sm_group_destroy, SM_GROUP_HANDLE, group);
+
+MOCKABLE_FUNCTION(, SM_RESULT, sm_group_close_begin, SM_GROUP_HANDLE, group);
+MOCKABLE_FUNCTION(, void, sm_group_close_end, SM_GROUP_HANDLE, group);
+
+MOCKABLE_FUNCTION(, SM_RESULT, sm_group_barrier_begin, SM_GROUP_HANDLE, group);
+MOCKABLE_FUNCTION(, void, sm_group_barrier_end, SM_GROUP_HANDLE, group);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*SM_GROUP_H*/
@@ -31,16 +31,53 @@
     #endif
 #endif
 
+/*when THANDLE_TELEMETRY is defined every wrapper remembers its size and the types registered by THANDLE_TELEMETRY_INIT(T) count their live instances in thandle_telemetry*/
+#ifdef THANDLE_TELEMETRY
+#include "azure_c_util/thandle_telemetry.h"
+#define THANDLE_TELEMETRY_EXTRA_FIELDS \
+    size_t, telemetrySize, \
+
+#else
+#define THANDLE_TELEMETRY_EXTRA_FIELDS
+#endif
+
 /*the incomplete unassignable type*/
 #define THANDLE(T) MU_C2(CONST_P2_CONST_,T)
 
 #define THANDLE_MACRO(T)                                \
     typedef const T* const volatile THANDLE(T);
 
+/*the incomplete unassignable type of a weak reference to a THANDLE(T). A weak reference does not keep T alive, it keeps alive only the wrapper, so it can be upgraded to a THANDLE(T) for as long as T is alive*/
+#define THANDLE_WEAK(T) MU_C2(CONST_P2_CONST_WEAK_,T)
+
+/*THANDLE_WEAK(T) points to this incomplete struct so that a THANDLE_WEAK(T) cannot be used where a THANDLE(T) is expected*/
+#define THANDLE_WEAK_STRUCT(T) MU_C2(T,_WEAK_TAG)
+
+#define THANDLE_WEAK_MACRO(T)                           \
+    typedef const struct THANDLE_WEAK_STRUCT(T)* const volatile THANDLE_WEAK(T);
+
+/*the incomplete unassignable type of a thread confined handle to T. All the THANDLE_LOCAL(T) of an object live in one thread and count themselves with plain (not interlocked) operations,
+together they hold one reference of the object. THANDLE_LOCAL_SHARE makes a THANDLE(T) that can go to other threads*/
+#define THANDLE_LOCAL(T) MU_C2(CONST_P2_LOCAL_,T)
+
+/*THANDLE_LOCAL(T) points to this incomplete struct so that a THANDLE_LOCAL(T) cannot be used where a THANDLE(T) is expected*/
+#define THANDLE_LOCAL_STRUCT(T) MU_C2(T,_LOCAL_TAG)
+
+#define THANDLE_LOCAL_MACRO(T)                          \
+    typedef const struct THANDLE_LOCAL_STRUCT(T)* const THANDLE_LOCAL(T);
+
+/*weakCount is the number of THANDLE_WEAK(T) plus 1 for as long as refCount is not 0. The wrapper is freed when weakCount reaches 0*/
 #define THANDLE_EXTRA_FIELDS(type) \
+    THANDLE_TELEMETRY_EXTRA_FIELDS \
     volatile_atomic int32_t, refCount, \
+    volatile_atomic int32_t, weakCount, \
     void(*dispose)(type*) , \
 
+/*the wrapper of a type defined with THANDLE_LOCAL_TYPE_DEFINE also has the number of THANDLE_LOCAL(T), which is only touched by the thread that owns them*/
+#define THANDLE_LOCAL_EXTRA_FIELDS(type) \
+    int32_t, localRefCount, \
+    THANDLE_EXTRA_FIELDS(type) \
+
 /*given a previous type T, this is the name of the type that has T wrapped*/
 #define THANDLE_WRAPPER_TYPE_NAME(T) MU_C2(T, _WRAPPER)
 
@@ -93,6 +130,131 @@ INITIALIZE_MOVE does not increment the ref count, and NULLs the source.
 INITIALIZE_MOVE assumes that destination is not initialized and thus it does not decrement the destination ref count */
 #define THANDLE_INITIALIZE_MOVE(T) MU_C2(T,_INITIALIZE_MOVE)
 
+/*given a previous type T, THANDLE_WEAK_INITIALIZE introduces a new name for a function that makes a THANDLE_WEAK(T) from a THANDLE(T) (and considers the THANDLE_WEAK(T) as uninitialized memory)*/
+#define THANDLE_WEAK_INITIALIZE(T) MU_C2(T,_WEAK_INITIALIZE)
+
+/*given a previous type T, THANDLE_WEAK_ASSIGN introduces a new name for a function that does WEAK1=T2 (with inc/dec of the weak refs)*/
+#define THANDLE_WEAK_ASSIGN(T) MU_C2(T,_WEAK_ASSIGN)
+
+/*given a previous type T, THANDLE_WEAK_UPGRADE introduces a new name for a function that makes a THANDLE(T) from a THANDLE_WEAK(T) if T is still alive*/
+#define THANDLE_WEAK_UPGRADE(T) MU_C2(T,_WEAK_UPGRADE)
+
+/*given a previous type T, THANDLE_LOCAL_INC_REF introduces a new name for a function that increments the count of THANDLE_LOCAL(T) without interlocked operations*/
+#define THANDLE_LOCAL_INC_REF(T) MU_C2(T,_LOCAL_INC_REF)
+
+/*given a previous type T, THANDLE_LOCAL_DEC_REF introduces a new name for a function that decrements the count of THANDLE_LOCAL(T) without interlocked operations (and gives back the reference of the object when it reaches 0)*/
+#define THANDLE_LOCAL_DEC_REF(T) MU_C2(T,_LOCAL_DEC_REF)
+
+/*given a previous type T, THANDLE_LOCAL_ASSIGN introduces a new name for a function that does LOCAL1=LOCAL2 (with local inc/dec refs)*/
+#define THANDLE_LOCAL_ASSIGN(T) MU_C2(T,_LOCAL_ASSIGN)
+
+/*given a previous type T, THANDLE_LOCAL_INITIALIZE introduces a new name for a function that does LOCAL1=LOCAL2 (with local inc ref, and considers LOCAL1 as uninitialized memory)*/
+#define THANDLE_LOCAL_INITIALIZE(T) MU_C2(T,_LOCAL_INITIALIZE)
+
+/*given a previous type T, THANDLE_LOCAL_INITIALIZE_MOVE introduces a new name for a function that moves a THANDLE(T) into a THANDLE_LOCAL(T) (and considers the THANDLE_LOCAL(T) as uninitialized memory)*/
+#define THANDLE_LOCAL_INITIALIZE_MOVE(T) MU_C2(T,_LOCAL_INITIALIZE_MOVE)
+
+/*given a previous type T, THANDLE_LOCAL_SHARE introduces a new name for a function that makes a THANDLE(T) from a THANDLE_LOCAL(T) (and considers the THANDLE(T) as uninitialized memory)*/
+#define THANDLE_LOCAL_SHARE(T) MU_C2(T,_LOCAL_SHARE)
+
+/*given a previous type T (and its THANDLE_LOCAL(T)), THANDLE_LOCAL_GET_T introduces a new name for a function that returns the T* from under the THANDLE_LOCAL(T)*/
+#define THANDLE_LOCAL_GET_T(T) MU_C2(T,_LOCAL_GET_T)
+
+/*given a previous type T, THANDLE_WEAK_DEC_REF introduces a new name for the static function that decrements the weak ref count and frees the wrapper when it reaches 0*/
+#define THANDLE_WEAK_DEC_REF(T) MU_C2(T,_WEAK_DEC_REF)
+
+/*given a previous type T, THANDLE_TELEMETRY_VARIABLE is the name of the static variable that holds the telemetry of T*/
+#define THANDLE_TELEMETRY_VARIABLE(T) MU_C2(T,_THANDLE_TELEMETRY)
+
+/*given a previous type T, THANDLE_TELEMETRY_INIT introduces a new name for the function that registers T in thandle_telemetry*/
+#define THANDLE_TELEMETRY_INIT(T) MU_C2(T,_TELEMETRY_INIT)
+
+/*given a previous type T, THANDLE_TELEMETRY_DEINIT introduces a new name for the function that unregisters T from thandle_telemetry*/
+#define THANDLE_TELEMETRY_DEINIT(T) MU_C2(T,_TELEMETRY_DEINIT)
+
+/*given a previous type T, THANDLE_TELEMETRY_ON_CREATE introduces a new name for the function that counts a new wrapper of T*/
+#define THANDLE_TELEMETRY_ON_CREATE(T) MU_C2(T,_TELEMETRY_ON_CREATE)
+
+/*given a previous type T, THANDLE_TELEMETRY_ON_FREE introduces a new name for the function that counts a freed wrapper of T*/
+#define THANDLE_TELEMETRY_ON_FREE(T) MU_C2(T,_TELEMETRY_ON_FREE)
+
+/*given a previous type T, this introduces the telemetry of T and the functions that register it (only when THANDLE_TELEMETRY is defined).
+THANDLE_TELEMETRY_DEINIT(T) is to be called when there are no more THANDLE(T) that were created while T was registered*/
+#ifdef THANDLE_TELEMETRY
+#define THANDLE_TELEMETRY_MACRO(T)                                                                                                                                  \
+static THANDLE_TELEMETRY_HANDLE THANDLE_TELEMETRY_VARIABLE(T) = NULL;                                                                                               \
+static int THANDLE_TELEMETRY_INIT(T)(void)                                                                                                                          \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (THANDLE_TELEMETRY_VARIABLE(T) != NULL)                                                                                                                      \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_067: [ If T is already registered then THANDLE_TELEMETRY_INIT shall fail and return a non-zero value. ]*/                            \
+        LogError("the telemetry of " MU_TOSTRING(T) " already exists");                                                                                             \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_068: [ THANDLE_TELEMETRY_INIT shall call thandle_telemetry_register with the name of T. ]*/                                          \
+        THANDLE_TELEMETRY_VARIABLE(T) = thandle_telemetry_register(MU_TOSTRING(T));                                                                                 \
+        if (THANDLE_TELEMETRY_VARIABLE(T) == NULL)                                                                                                                  \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_069: [ If thandle_telemetry_register fails then THANDLE_TELEMETRY_INIT shall fail and return a non-zero value. ]*/               \
+            LogError("failure in thandle_telemetry_register(\"" MU_TOSTRING(T) "\")");                                                                              \
+            result = MU_FAILURE;                                                                                                                                    \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_070: [ THANDLE_TELEMETRY_INIT shall succeed and return 0. ]*/                                                                    \
+            result = 0;                                                                                                                                             \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+static void THANDLE_TELEMETRY_DEINIT(T)(void)                                                                                                                       \
+{                                                                                                                                                                   \
+    if (THANDLE_TELEMETRY_VARIABLE(T) == NULL)                                                                                                                      \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_071: [ If T is not registered then THANDLE_TELEMETRY_DEINIT shall return. ]*/                                                        \
+        LogError("the telemetry of " MU_TOSTRING(T) " does not exist");                                                                                             \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_072: [ THANDLE_TELEMETRY_DEINIT shall call thandle_telemetry_unregister and forget the telemetry of T. ]*/                           \
+        thandle_telemetry_unregister(THANDLE_TELEMETRY_VARIABLE(T));                                                                                                \
+        THANDLE_TELEMETRY_VARIABLE(T) = NULL;                                                                                                                       \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+static void THANDLE_TELEMETRY_ON_CREATE(T)(THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl, size_t size)                                                                  \
+{                                                                                                                                                                   \
+    if (THANDLE_TELEMETRY_VARIABLE(T) == NULL)                                                                                                                      \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_073: [ If T is not registered then the functions that create a THANDLE(T) shall remember that the wrapper is not counted. ]*/        \
+        handle_impl->telemetrySize = 0;                                                                                                                             \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_074: [ If T is registered then the functions that create a THANDLE(T) shall remember the size of the wrapper and call thandle_telemetry_on_create with it. ]*/\
+        handle_impl->telemetrySize = size;                                                                                                                          \
+        thandle_telemetry_on_create(THANDLE_TELEMETRY_VARIABLE(T), size);                                                                                           \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+static void THANDLE_TELEMETRY_ON_FREE(T)(THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl)                                                                                 \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_075: [ If T is registered and the wrapper was counted then THANDLE_FREE shall call thandle_telemetry_on_free with the size of the wrapper. ]*/\
+    if ((THANDLE_TELEMETRY_VARIABLE(T) != NULL) && (handle_impl->telemetrySize != 0))                                                                               \
+    {                                                                                                                                                               \
+        thandle_telemetry_on_free(THANDLE_TELEMETRY_VARIABLE(T), handle_impl->telemetrySize);                                                                       \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+#define THANDLE_TELEMETRY_CREATED(T, handle_impl, size) THANDLE_TELEMETRY_ON_CREATE(T)((handle_impl), (size))
+#define THANDLE_TELEMETRY_FREED(T, handle_impl) THANDLE_TELEMETRY_ON_FREE(T)(handle_impl)
+#else
+#define THANDLE_TELEMETRY_MACRO(T)
+#define THANDLE_TELEMETRY_CREATED(T, handle_impl, size)
+#define THANDLE_TELEMETRY_FREED(T, handle_impl)
+#endif
+
 /*given a previous type T, this introduces THANDLE_MALLOC macro to create its wrapper, initialize refCount to 1, and remember the dispose function*/
 
 #define THANDLE_MALLOC_MACRO(T) \
@@ -113,6 +275,8 @@ static T* THANDLE_MALLOC(T)(void(*dispose)(T*))
         /*Codes_SRS_THANDLE_02_014: [ THANDLE_MALLOC shall initialize the reference count to 1, store dispose and return a T* . ]*/                                 \
         handle_impl->dispose = dispose;                                                                                                                             \
         (void)interlocked_exchange(&handle_impl->refCount,1);                                                                                                       \
+        (void)interlocked_exchange(&handle_impl->weakCount,1);                                                                                                      \
+        THANDLE_TELEMETRY_CREATED(T, handle_impl, sizeof(THANDLE_WRAPPER_TYPE_NAME(T)));                                                                            \
         result = &(handle_impl->data);                                                                                                                              \
     }                                                                                                                                                               \
     return result;                                                                                                                                                  \
@@ -152,6 +316,8 @@ static T* THANDLE_MALLOC_WITH_EXTRA_SIZE(T)(void(*dispose)(T*), size_t extra_siz
             /*Codes_SRS_THANDLE_02_021: [ THANDLE_MALLOC_WITH_EXTRA_SIZE shall initialize the reference count to 1, store dispose and return a T*. ]*/              \
             handle_impl->dispose = dispose;                                                                                                                         \
             (void)interlocked_exchange(&handle_impl->refCount,1);                                                                                                   \
+            (void)interlocked_exchange(&handle_impl->weakCount,1);                                                                                                  \
+            THANDLE_TELEMETRY_CREATED(T, handle_impl, extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)));                                                           \
             result = &(handle_impl->data);                                                                                                                          \
         }                                                                                                                                                           \
     }                                                                                                                                                               \
@@ -192,6 +358,8 @@ static THANDLE(T) THANDLE_CREATE_FROM_CONTENT_FLEX(T)(const T* source, void(*dis
                 handle_impl->dispose = dispose;                                                                                                                     \
                 /*Codes_SRS_THANDLE_02_029: [ THANDLE_CREATE_FROM_CONTENT_FLEX shall initialize the ref count to 1, succeed and return a non-NULL value. ]*/        \
                 (void)interlocked_exchange(&handle_impl->refCount,1);                                                                                               \
+                (void)interlocked_exchange(&handle_impl->weakCount,1);                                                                                              \
+                THANDLE_TELEMETRY_CREATED(T, handle_impl, sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) - sizeof(T) + sizeof_source);                                        \
                 result = &(handle_impl->data);                                                                                                                      \
             }                                                                                                                                                       \
             else                                                                                                                                                    \
@@ -209,6 +377,8 @@ static THANDLE(T) THANDLE_CREATE_FROM_CONTENT_FLEX(T)(const T* source, void(*dis
                     handle_impl->dispose = dispose;                                                                                                                 \
                     /*Codes_SRS_THANDLE_02_029: [ THANDLE_CREATE_FROM_CONTENT_FLEX shall initialize the ref count to 1, succeed and return a non-NULL value. ]*/    \
                     (void)interlocked_exchange(&handle_impl->refCount,1);                                                                                           \
+                    (void)interlocked_exchange(&handle_impl->weakCount,1);                                                                                          \
+                    THANDLE_TELEMETRY_CREATED(T, handle_impl, sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) - sizeof(T) + sizeof_source);                                    \
                     result = &(handle_impl->data);                                                                                                                  \
                 }                                                                                                                                                   \
             }                                                                                                                                                       \
@@ -243,6 +413,7 @@ static void THANDLE_FREE(T)(T* t)
     {                                                                                                                                                               \
         /*Codes_SRS_THANDLE_02_017: [ THANDLE_FREE shall free the allocated memory by THANDLE_MALLOC. ]*/                                                           \
         THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD(t, THANDLE_WRAPPER_TYPE_NAME(T), data);                                                       \
+        THANDLE_TELEMETRY_FREED(T, handle_impl);                                                                                                                    \
         THANDLE_FREE_FUNCTION(handle_impl);                                                                                                                         \
     }                                                                                                                                                               \
 }                                                                                                                                                                   \
@@ -267,7 +438,15 @@ void THANDLE_DEC_REF(T)(THANDLE(T) t)
             {                                                                                                                                                       \
                 handle_impl->dispose(&handle_impl->data);                                                                                                           \
             }                                                                                                                                                       \
-            THANDLE_FREE(T)(&handle_impl->data);                                                                                                                    \
+            /*Codes_SRS_THANDLE_02_039: [ If the ref count of t reaches 0 then THANDLE_DEC_REF shall decrement the weak ref count of t and free the used memory only when the weak ref count reaches 0. ]*/ \
+            /*when there are no THANDLE_WEAK(T) nobody can make one anymore (there are no THANDLE(T) left), so the decrement is not needed*/                        \
+            if (                                                                                                                                                    \
+                (interlocked_add(&handle_impl->weakCount, 0) == 1) ||                                                                                               \
+                (interlocked_decrement(&handle_impl->weakCount) == 0)                                                                                               \
+                )                                                                                                                                                   \
+            {                                                                                                                                                       \
+                THANDLE_FREE(T)(&handle_impl->data);                                                                                                                \
+            }                                                                                                                                                       \
         }                                                                                                                                                           \
                                                                                                                                                                     \
     }                                                                                                                                                               \
@@ -445,14 +624,260 @@ void THANDLE_INITIALIZE_MOVE(T)(THANDLE(T) * t1, THANDLE(T) * t2 )
     }                                                                                                                                                               \
 }                                                                                                                                                                   \
 
-/*given a previous type T, this introduces a wrapper type that contains T (and other fields) and defines the functions of that type T*/
-#define THANDLE_TYPE_DEFINE(T) \
+/*given a previous type T, this introduces THANDLE_WEAK_DEC_REF macro to decrement the weak reference count*/
+#define THANDLE_WEAK_DEC_REF_MACRO(T)                                                                                                                               \
+static void THANDLE_WEAK_DEC_REF(T)(THANDLE_WEAK(T) weak)                                                                                                           \
+{                                                                                                                                                                   \
+    THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD((const T*)weak, THANDLE_WRAPPER_TYPE_NAME(T), data);                                              \
+    if (interlocked_decrement(&handle_impl->weakCount) == 0)                                                                                                        \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_045: [ If the weak ref count reaches 0 then the memory used by the wrapper shall be freed. ]*/                                       \
+        THANDLE_FREE(T)(&handle_impl->data);                                                                                                                        \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T, this introduces THANDLE_WEAK_INITIALIZE macro to initialize a weak reference*/
+#define THANDLE_WEAK_INITIALIZE_MACRO(T)                                                                                                                            \
+void THANDLE_WEAK_INITIALIZE(T)(THANDLE_WEAK(T) * lvalue, THANDLE(T) rvalue )                                                                                       \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_040: [ If lvalue is NULL then THANDLE_WEAK_INITIALIZE shall return. ]*/                                                                  \
+    if(lvalue == NULL)                                                                                                                                              \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_WEAK(" MU_TOSTRING(T) ") * lvalue=%p, THANDLE(" MU_TOSTRING(T) ") rvalue=%p", lvalue, rvalue );                          \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        if(rvalue == NULL)                                                                                                                                          \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_041: [ If rvalue is NULL then THANDLE_WEAK_INITIALIZE shall store NULL in *lvalue. ]*/                                           \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_042: [ THANDLE_WEAK_INITIALIZE shall increment the weak ref count of rvalue and store it in *lvalue. ]*/                         \
+            THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD(rvalue, THANDLE_WRAPPER_TYPE_NAME(T), data);                                              \
+            (void)interlocked_increment(&handle_impl->weakCount);                                                                                                   \
+        }                                                                                                                                                           \
+        * (const struct THANDLE_WEAK_STRUCT(T)**)lvalue = (const struct THANDLE_WEAK_STRUCT(T)*)rvalue;                                                             \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T, this introduces THANDLE_WEAK_ASSIGN macro to assign a weak reference to a handle (or NULL, which releases the weak reference)*/
+#define THANDLE_WEAK_ASSIGN_MACRO(T)                                                                                                                                \
+void THANDLE_WEAK_ASSIGN(T)(THANDLE_WEAK(T) * t1, THANDLE(T) t2 )                                                                                                   \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_043: [ If t1 is NULL then THANDLE_WEAK_ASSIGN shall return. ]*/                                                                          \
+    if(t1 == NULL)                                                                                                                                                  \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_WEAK(" MU_TOSTRING(T) ") * t1=%p, THANDLE(" MU_TOSTRING(T) ") t2=%p", t1, t2 );                                          \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_044: [ THANDLE_WEAK_ASSIGN shall increment the weak ref count of t2 (if not NULL), decrement the weak ref count of *t1 (if not NULL) and store t2 in *t1. ]*/ \
+        if (t2 != NULL)                                                                                                                                             \
+        {                                                                                                                                                           \
+            THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD(t2, THANDLE_WRAPPER_TYPE_NAME(T), data);                                                  \
+            (void)interlocked_increment(&handle_impl->weakCount);                                                                                                   \
+        }                                                                                                                                                           \
+        if (*t1 != NULL)                                                                                                                                            \
+        {                                                                                                                                                           \
+            THANDLE_WEAK_DEC_REF(T)(*t1);                                                                                                                           \
+        }                                                                                                                                                           \
+        * (const struct THANDLE_WEAK_STRUCT(T)**)t1 = (const struct THANDLE_WEAK_STRUCT(T)*)t2;                                                                     \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T, this introduces THANDLE_WEAK_UPGRADE macro to get a handle from a weak reference. The upgrade fails (and produces NULL) once the ref count reached 0*/
+#define THANDLE_WEAK_UPGRADE_MACRO(T)                                                                                                                               \
+void THANDLE_WEAK_UPGRADE(T)(THANDLE(T) * lvalue, THANDLE_WEAK(T) weak )                                                                                            \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_046: [ If lvalue is NULL then THANDLE_WEAK_UPGRADE shall return. ]*/                                                                     \
+    if(lvalue == NULL)                                                                                                                                              \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE(" MU_TOSTRING(T) ") * lvalue=%p, THANDLE_WEAK(" MU_TOSTRING(T) ") weak=%p", lvalue, weak );                              \
+    }                                                                                                                                                               \
+    else if(weak == NULL)                                                                                                                                           \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_047: [ If weak is NULL then THANDLE_WEAK_UPGRADE shall store NULL in *lvalue. ]*/                                                    \
+        * (T const**)lvalue = NULL;                                                                                                                                 \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD((const T*)weak, THANDLE_WRAPPER_TYPE_NAME(T), data);                                          \
+        int32_t refCount = interlocked_add(&handle_impl->refCount, 0);                                                                                              \
+        /*Codes_SRS_THANDLE_02_048: [ THANDLE_WEAK_UPGRADE shall increment the ref count of weak with interlocked_compare_exchange only if the ref count is not 0, and try again if the ref count changed meanwhile. ]*/ \
+        while (refCount != 0)                                                                                                                                       \
+        {                                                                                                                                                           \
+            int32_t previous = interlocked_compare_exchange(&handle_impl->refCount, refCount + 1, refCount);                                                        \
+            if (previous == refCount)                                                                                                                               \
+            {                                                                                                                                                       \
+                break;                                                                                                                                              \
+            }                                                                                                                                                       \
+            refCount = previous;                                                                                                                                    \
+        }                                                                                                                                                           \
+        if (refCount == 0)                                                                                                                                          \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_049: [ If the ref count of weak is 0 then THANDLE_WEAK_UPGRADE shall store NULL in *lvalue. ]*/                                  \
+            * (T const**)lvalue = NULL;                                                                                                                             \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_050: [ THANDLE_WEAK_UPGRADE shall store weak as a THANDLE(T) in *lvalue. ]*/                                                     \
+            * (T const**)lvalue = &handle_impl->data;                                                                                                               \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T defined with THANDLE_LOCAL_TYPE_DEFINE, this introduces THANDLE_LOCAL_INC_REF macro to increment the count of THANDLE_LOCAL(T)*/
+#define THANDLE_LOCAL_INC_REF_MACRO(T)                                                                                                                              \
+void THANDLE_LOCAL_INC_REF(T)(THANDLE_LOCAL(T) t)                                                                                                                   \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_051: [ If t is NULL then THANDLE_LOCAL_INC_REF shall return. ]*/                                                                         \
+    if(t == NULL)                                                                                                                                                   \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_LOCAL(" MU_TOSTRING(T) ") t=%p", t);                                                                                     \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_052: [ THANDLE_LOCAL_INC_REF shall increment the local ref count of t without interlocked operations. ]*/                            \
+        THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD((const T*)t, THANDLE_WRAPPER_TYPE_NAME(T), data);                                             \
+        handle_impl->localRefCount++;                                                                                                                               \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T defined with THANDLE_LOCAL_TYPE_DEFINE, this introduces THANDLE_LOCAL_DEC_REF macro to decrement the count of THANDLE_LOCAL(T)*/
+#define THANDLE_LOCAL_DEC_REF_MACRO(T)                                                                                                                              \
+void THANDLE_LOCAL_DEC_REF(T)(THANDLE_LOCAL(T) t)                                                                                                                   \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_053: [ If t is NULL then THANDLE_LOCAL_DEC_REF shall return. ]*/                                                                         \
+    if(t == NULL)                                                                                                                                                   \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_LOCAL(" MU_TOSTRING(T) ") t=%p", t);                                                                                     \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_054: [ THANDLE_LOCAL_DEC_REF shall decrement the local ref count of t without interlocked operations. ]*/                            \
+        THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD((const T*)t, THANDLE_WRAPPER_TYPE_NAME(T), data);                                             \
+        if (--handle_impl->localRefCount == 0)                                                                                                                      \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_055: [ If the local ref count of t reaches 0 then THANDLE_LOCAL_DEC_REF shall call THANDLE_DEC_REF. ]*/                          \
+            THANDLE_DEC_REF(T)(&handle_impl->data);                                                                                                                 \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T defined with THANDLE_LOCAL_TYPE_DEFINE, this introduces THANDLE_LOCAL_ASSIGN macro to assign a THANDLE_LOCAL(T) to another THANDLE_LOCAL(T)*/
+#define THANDLE_LOCAL_ASSIGN_MACRO(T)                                                                                                                               \
+void THANDLE_LOCAL_ASSIGN(T)(THANDLE_LOCAL(T) * t1, THANDLE_LOCAL(T) t2 )                                                                                           \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_056: [ If t1 is NULL then THANDLE_LOCAL_ASSIGN shall return. ]*/                                                                         \
+    if(t1 == NULL)                                                                                                                                                  \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_LOCAL(" MU_TOSTRING(T) ") * t1=%p, THANDLE_LOCAL(" MU_TOSTRING(T) ") t2=%p", t1, t2 );                                   \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_057: [ THANDLE_LOCAL_ASSIGN shall call THANDLE_LOCAL_INC_REF on t2 (if not NULL), THANDLE_LOCAL_DEC_REF on *t1 (if not NULL) and store t2 in *t1. ]*/ \
+        if (t2 != NULL)                                                                                                                                             \
+        {                                                                                                                                                           \
+            THANDLE_LOCAL_INC_REF(T)(t2);                                                                                                                           \
+        }                                                                                                                                                           \
+        if (*t1 != NULL)                                                                                                                                            \
+        {                                                                                                                                                           \
+            THANDLE_LOCAL_DEC_REF(T)(*t1);                                                                                                                          \
+        }                                                                                                                                                           \
+        * (const struct THANDLE_LOCAL_STRUCT(T)**)t1 = t2;                                                                                                          \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T defined with THANDLE_LOCAL_TYPE_DEFINE, this introduces THANDLE_LOCAL_INITIALIZE macro to initialize a THANDLE_LOCAL(T)*/
+#define THANDLE_LOCAL_INITIALIZE_MACRO(T)                                                                                                                           \
+void THANDLE_LOCAL_INITIALIZE(T)(THANDLE_LOCAL(T) * lvalue, THANDLE_LOCAL(T) rvalue )                                                                               \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_058: [ If lvalue is NULL then THANDLE_LOCAL_INITIALIZE shall return. ]*/                                                                 \
+    if(lvalue == NULL)                                                                                                                                              \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_LOCAL(" MU_TOSTRING(T) ") * lvalue=%p, THANDLE_LOCAL(" MU_TOSTRING(T) ") rvalue=%p", lvalue, rvalue );                   \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_059: [ THANDLE_LOCAL_INITIALIZE shall call THANDLE_LOCAL_INC_REF on rvalue (if not NULL) and store rvalue in *lvalue. ]*/            \
+        if(rvalue != NULL)                                                                                                                                          \
+        {                                                                                                                                                           \
+            THANDLE_LOCAL_INC_REF(T)(rvalue);                                                                                                                       \
+        }                                                                                                                                                           \
+        * (const struct THANDLE_LOCAL_STRUCT(T)**)lvalue = rvalue;                                                                                                  \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T defined with THANDLE_LOCAL_TYPE_DEFINE, this introduces THANDLE_LOCAL_INITIALIZE_MOVE macro to move a THANDLE(T) into a THANDLE_LOCAL(T)*/
+#define THANDLE_LOCAL_INITIALIZE_MOVE_MACRO(T)                                                                                                                      \
+void THANDLE_LOCAL_INITIALIZE_MOVE(T)(THANDLE_LOCAL(T) * lvalue, THANDLE(T) * t )                                                                                   \
+{                                                                                                                                                                   \
+    if(                                                                                                                                                             \
+        /*Codes_SRS_THANDLE_02_060: [ If lvalue is NULL then THANDLE_LOCAL_INITIALIZE_MOVE shall return. ]*/                                                        \
+        (lvalue == NULL) ||                                                                                                                                         \
+        /*Codes_SRS_THANDLE_02_061: [ If t is NULL then THANDLE_LOCAL_INITIALIZE_MOVE shall return. ]*/                                                             \
+        (t == NULL)                                                                                                                                                 \
+    )                                                                                                                                                               \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_LOCAL(" MU_TOSTRING(T) ") * lvalue=%p, THANDLE(" MU_TOSTRING(T) ") * t=%p", lvalue, t );                                 \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        if (*t == NULL)                                                                                                                                             \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_062: [ If *t is NULL then THANDLE_LOCAL_INITIALIZE_MOVE shall store NULL in *lvalue. ]*/                                         \
+            * (const struct THANDLE_LOCAL_STRUCT(T)**)lvalue = NULL;                                                                                                \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_02_063: [ THANDLE_LOCAL_INITIALIZE_MOVE shall set the local ref count of *t to 1, move the reference of *t under *lvalue and set *t to NULL. ]*/ \
+            THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD(*t, THANDLE_WRAPPER_TYPE_NAME(T), data);                                                  \
+            handle_impl->localRefCount = 1;                                                                                                                         \
+            * (const struct THANDLE_LOCAL_STRUCT(T)**)lvalue = (const struct THANDLE_LOCAL_STRUCT(T)*)*t;                                                           \
+            * (T const**)t = NULL;                                                                                                                                  \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T defined with THANDLE_LOCAL_TYPE_DEFINE, this introduces THANDLE_LOCAL_SHARE macro to make a THANDLE(T) that can go to other threads from a THANDLE_LOCAL(T)*/
+#define THANDLE_LOCAL_SHARE_MACRO(T)                                                                                                                                \
+void THANDLE_LOCAL_SHARE(T)(THANDLE(T) * lvalue, THANDLE_LOCAL(T) local )                                                                                           \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_064: [ If lvalue is NULL then THANDLE_LOCAL_SHARE shall return. ]*/                                                                      \
+    if(lvalue == NULL)                                                                                                                                              \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE(" MU_TOSTRING(T) ") * lvalue=%p, THANDLE_LOCAL(" MU_TOSTRING(T) ") local=%p", lvalue, local );                           \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_02_065: [ THANDLE_LOCAL_SHARE shall call THANDLE_INITIALIZE with lvalue and local as a THANDLE(T). ]*/                                  \
+        THANDLE_INITIALIZE(T)(lvalue, (const T*)local);                                                                                                             \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*if THANDLE_LOCAL(T) is previously defined, then this macro returns the T* from under the THANDLE_LOCAL(T) */
+#define THANDLE_LOCAL_GET_T_MACRO(T)                                                                                                                                \
+static T* THANDLE_LOCAL_GET_T(T)(THANDLE_LOCAL(T) t)                                                                                                                \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_02_066: [ THANDLE_LOCAL_GET_T(T) shall return the T* under t (NULL if t is NULL). ]*/                                                       \
+    return (T*)t;                                                                                                                                                   \
+}                                                                                                                                                                   \
+
+/*given a previous type T, this introduces a wrapper type that contains T (and other fields) and defines the functions of that type T.
+malloc_macro, malloc_with_extra_size_macro and free_macro generate THANDLE_MALLOC, THANDLE_MALLOC_WITH_EXTRA_SIZE and THANDLE_FREE, so that a variant of THANDLE (for example THANDLE_TYPE_DEFINE_WITH_POOL) can allocate the wrappers differently*/
+#define THANDLE_TYPE_DEFINE_WITH_MALLOC_MACROS(T, malloc_macro, malloc_with_extra_size_macro, free_macro) \
     MU_DEFINE_STRUCT(THANDLE_WRAPPER_TYPE_NAME(T), THANDLE_EXTRA_FIELDS(T), T, data);                                                                               \
-    THANDLE_MALLOC_MACRO(T)                                                                                                                                         \
-    THANDLE_MALLOC_WITH_EXTRA_SIZE_MACRO(T)                                                                                                                         \
+    THANDLE_TYPE_DEFINE_FUNCTIONS(T, malloc_macro, malloc_with_extra_size_macro, free_macro)                                                                        \
+
+/*given a previous type T and its wrapper type, this defines the functions of that type T*/
+#define THANDLE_TYPE_DEFINE_FUNCTIONS(T, malloc_macro, malloc_with_extra_size_macro, free_macro)                                                                    \
+    THANDLE_TELEMETRY_MACRO(T)                                                                                                                                      \
+    malloc_macro(T)                                                                                                                                                 \
+    malloc_with_extra_size_macro(T)                                                                                                                                 \
     THANDLE_CREATE_FROM_CONTENT_FLEX_MACRO(T)                                                                                                                       \
     THANDLE_CREATE_FROM_CONTENT_MACRO(T)                                                                                                                            \
-    THANDLE_FREE_MACRO(T)                                                                                                                                           \
+    free_macro(T)                                                                                                                                                   \
     THANDLE_DEC_REF_MACRO(T)                                                                                                                                        \
     THANDLE_INC_REF_MACRO(T)                                                                                                                                        \
     THANDLE_ASSIGN_MACRO(T)                                                                                                                                         \
@@ -461,17 +886,52 @@ void THANDLE_INITIALIZE_MOVE(T)(THANDLE(T) * t1, THANDLE(T) * t2 )
     THANDLE_INSPECT_MACRO(T)                                                                                                                                        \
     THANDLE_MOVE_MACRO(T)                                                                                                                                           \
     THANDLE_INITIALIZE_MOVE_MACRO(T)                                                                                                                                \
+    THANDLE_WEAK_DEC_REF_MACRO(T)                                                                                                                                   \
+    THANDLE_WEAK_INITIALIZE_MACRO(T)                                                                                                                                \
+    THANDLE_WEAK_ASSIGN_MACRO(T)                                                                                                                                    \
+    THANDLE_WEAK_UPGRADE_MACRO(T)                                                                                                                                   \
+
+/*given a previous type T, this introduces a wrapper type that contains T (and other fields) and defines the functions of that type T*/
+#define THANDLE_TYPE_DEFINE(T) \
+    THANDLE_TYPE_DEFINE_WITH_MALLOC_MACROS(T, THANDLE_MALLOC_MACRO, THANDLE_MALLOC_WITH_EXTRA_SIZE_MACRO, THANDLE_FREE_MACRO)                                       \
+
+/*given a previous type T, this defines the functions of THANDLE_TYPE_DEFINE(T) and the functions of THANDLE_LOCAL(T). The wrapper of T also has the local ref count*/
+#define THANDLE_LOCAL_TYPE_DEFINE(T) \
+    MU_DEFINE_STRUCT(THANDLE_WRAPPER_TYPE_NAME(T), THANDLE_LOCAL_EXTRA_FIELDS(T), T, data);                                                                         \
+    THANDLE_TYPE_DEFINE_FUNCTIONS(T, THANDLE_MALLOC_MACRO, THANDLE_MALLOC_WITH_EXTRA_SIZE_MACRO, THANDLE_FREE_MACRO)                                                \
+    THANDLE_LOCAL_INC_REF_MACRO(T)                                                                                                                                  \
+    THANDLE_LOCAL_DEC_REF_MACRO(T)                                                                                                                                  \
+    THANDLE_LOCAL_ASSIGN_MACRO(T)                                                                                                                                   \
+    THANDLE_LOCAL_INITIALIZE_MACRO(T)                                                                                                                               \
+    THANDLE_LOCAL_INITIALIZE_MOVE_MACRO(T)                                                                                                                          \
+    THANDLE_LOCAL_SHARE_MACRO(T)                                                                                                                                    \
+    THANDLE_LOCAL_GET_T_MACRO(T)                                                                                                                                    \
 
 /*macro to be used in headers*/                                                                                       \
 /*introduces an incomplete type based on a MU_DEFINE_STRUCT(T...) previously defined;*/                               \
 #define THANDLE_TYPE_DECLARE(T)                                                                                       \
     THANDLE_MACRO(T);                                                                                                 \
+    THANDLE_WEAK_MACRO(T);                                                                                            \
     MOCKABLE_FUNCTION(, void, THANDLE_DEC_REF(T), THANDLE(T), t);                                                     \
     MOCKABLE_FUNCTION(, void, THANDLE_INC_REF(T), THANDLE(T), t);                                                     \
     MOCKABLE_FUNCTION(, void, THANDLE_ASSIGN(T), THANDLE(T) *, t1, THANDLE(T), t2 );                                  \
     MOCKABLE_FUNCTION(, void, THANDLE_INITIALIZE(T), THANDLE(T) *, t1, THANDLE(T), t2 );                              \
     MOCKABLE_FUNCTION(, void, THANDLE_MOVE(T), THANDLE(T) *, t1, THANDLE(T)*, t2 );                                   \
     MOCKABLE_FUNCTION(, void, THANDLE_INITIALIZE_MOVE(T), THANDLE(T) *, t1, THANDLE(T)*, t2 );                        \
+    MOCKABLE_FUNCTION(, void, THANDLE_WEAK_INITIALIZE(T), THANDLE_WEAK(T) *, lvalue, THANDLE(T), rvalue );            \
+    MOCKABLE_FUNCTION(, void, THANDLE_WEAK_ASSIGN(T), THANDLE_WEAK(T) *, t1, THANDLE(T), t2 );                        \
+    MOCKABLE_FUNCTION(, void, THANDLE_WEAK_UPGRADE(T), THANDLE(T) *, lvalue, THANDLE_WEAK(T), weak );                 \
+
+/*macro to be used in headers instead of THANDLE_TYPE_DECLARE for types defined with THANDLE_LOCAL_TYPE_DEFINE*/     \
+#define THANDLE_LOCAL_TYPE_DECLARE(T)                                                                                 \
+    THANDLE_TYPE_DECLARE(T)                                                                                           \
+    THANDLE_LOCAL_MACRO(T);                                                                                           \
+    MOCKABLE_FUNCTION(, void, THANDLE_LOCAL_INC_REF(T), THANDLE_LOCAL(T), t);                                         \
+    MOCKABLE_FUNCTION(, void, THANDLE_LOCAL_DEC_REF(T), THANDLE_LOCAL(T), t);                                         \
+    MOCKABLE_FUNCTION(, void, THANDLE_LOCAL_ASSIGN(T), THANDLE_LOCAL(T) *, t1, THANDLE_LOCAL(T), t2 );                \
+    MOCKABLE_FUNCTION(, void, THANDLE_LOCAL_INITIALIZE(T), THANDLE_LOCAL(T) *, lvalue, THANDLE_LOCAL(T), rvalue );    \
+    MOCKABLE_FUNCTION(, void, THANDLE_LOCAL_INITIALIZE_MOVE(T), THANDLE_LOCAL(T) *, lvalue, THANDLE(T) *, t );        \
+    MOCKABLE_FUNCTION(, void, THANDLE_LOCAL_SHARE(T), THANDLE(T) *, lvalue, THANDLE_LOCAL(T), local );                \
 
 #endif /*THANDLE_H*/
 
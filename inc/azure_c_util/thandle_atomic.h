@@ -0,0 +1,227 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef THANDLE_ATOMIC_H
+#define THANDLE_ATOMIC_H
+
+#ifdef __cplusplus
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#include "azure_c_util/thandle.h"
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*a THANDLE_ATOMIC_SLOT holds a pointer that readers load (and take a reference of) without any lock while writers replace it.
+A reader announces itself in one of the 2 reader counts before loading the pointer and leaves after it took its reference.
+A writer exchanges the pointer and then waits for the readers that could have loaded the previous pointer (deferred reclamation):
+it switches the readers to the other count, waits for the first count to reach 0 and does the same with the other count.
+Writers are serialized by a mutex, readers never wait*/
+typedef struct THANDLE_ATOMIC_SLOT_TAG
+{
+    void* volatile_atomic value;
+    volatile_atomic int32_t readers[2];
+    volatile_atomic int32_t reader_index; /*the count that new readers use, 0 when no writer is waiting for readers*/
+    volatile_atomic int32_t writer_mutex; /*an InterlockedHL_MutexLock mutex*/
+}THANDLE_ATOMIC_SLOT;
+
+MOCKABLE_FUNCTION(, int, thandle_atomic_slot_init, THANDLE_ATOMIC_SLOT*, slot, void*, value);
+
+/*returns the pointer in the slot, the pointer is safe to use until thandle_atomic_slot_read_end is called with the same reader_index*/
+MOCKABLE_FUNCTION(, void*, thandle_atomic_slot_read_begin, THANDLE_ATOMIC_SLOT*, slot, int32_t*, reader_index);
+MOCKABLE_FUNCTION(, void, thandle_atomic_slot_read_end, THANDLE_ATOMIC_SLOT*, slot, int32_t, reader_index);
+
+/*stores value in the slot and returns the previous pointer in *previous_value only after no reader can be using it*/
+MOCKABLE_FUNCTION(, int, thandle_atomic_slot_exchange, THANDLE_ATOMIC_SLOT*, slot, void*, value, void**, previous_value);
+
+/*given a previous type T, THANDLE_ATOMIC(T) is the type of a slot that holds a THANDLE(T) that can be loaded and stored concurrently*/
+#define THANDLE_ATOMIC(T) MU_C2(THANDLE_ATOMIC_,T)
+
+/*given a previous type T, THANDLE_ATOMIC_INIT introduces a new name for a function that initializes a THANDLE_ATOMIC(T) with a THANDLE(T)*/
+#define THANDLE_ATOMIC_INIT(T) MU_C2(T,_ATOMIC_INIT)
+
+/*given a previous type T, THANDLE_ATOMIC_DEINIT introduces a new name for a function that releases the THANDLE(T) of a THANDLE_ATOMIC(T)*/
+#define THANDLE_ATOMIC_DEINIT(T) MU_C2(T,_ATOMIC_DEINIT)
+
+/*given a previous type T, THANDLE_ATOMIC_LOAD introduces a new name for a function that takes a reference of the THANDLE(T) in a THANDLE_ATOMIC(T)*/
+#define THANDLE_ATOMIC_LOAD(T) MU_C2(T,_ATOMIC_LOAD)
+
+/*given a previous type T, THANDLE_ATOMIC_STORE introduces a new name for a function that replaces the THANDLE(T) in a THANDLE_ATOMIC(T)*/
+#define THANDLE_ATOMIC_STORE(T) MU_C2(T,_ATOMIC_STORE)
+
+/*given a previous type T, THANDLE_ATOMIC_EXCHANGE introduces a new name for a function that replaces the THANDLE(T) in a THANDLE_ATOMIC(T) and returns the previous one*/
+#define THANDLE_ATOMIC_EXCHANGE(T) MU_C2(T,_ATOMIC_EXCHANGE)
+
+/*macro to be used in headers after THANDLE_TYPE_DECLARE(T)*/
+#define THANDLE_ATOMIC_TYPE_DECLARE(T)                                                                                \
+    typedef struct MU_C2(T,_ATOMIC_TAG)                                                                               \
+    {                                                                                                                 \
+        THANDLE_ATOMIC_SLOT slot;                                                                                     \
+    }THANDLE_ATOMIC(T);                                                                                               \
+    MOCKABLE_FUNCTION(, int, THANDLE_ATOMIC_INIT(T), THANDLE_ATOMIC(T)*, atomic, THANDLE(T), value);                  \
+    MOCKABLE_FUNCTION(, void, THANDLE_ATOMIC_DEINIT(T), THANDLE_ATOMIC(T)*, atomic);                                  \
+    MOCKABLE_FUNCTION(, void, THANDLE_ATOMIC_LOAD(T), THANDLE_ATOMIC(T)*, atomic, THANDLE(T)*, lvalue);               \
+    MOCKABLE_FUNCTION(, int, THANDLE_ATOMIC_STORE(T), THANDLE_ATOMIC(T)*, atomic, THANDLE(T), value);                 \
+    MOCKABLE_FUNCTION(, int, THANDLE_ATOMIC_EXCHANGE(T), THANDLE_ATOMIC(T)*, atomic, THANDLE(T), value, THANDLE(T)*, previous); \
+
+/*given a previous type T, this introduces the functions of THANDLE_ATOMIC(T). To be used in a .c file after THANDLE_TYPE_DEFINE(T)*/
+#define THANDLE_ATOMIC_TYPE_DEFINE(T)                                                                                                                               \
+int THANDLE_ATOMIC_INIT(T)(THANDLE_ATOMIC(T)* atomic, THANDLE(T) value)                                                                                             \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (atomic == NULL)                                                                                                                                             \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_ATOMIC_02_021: [ If atomic is NULL then THANDLE_ATOMIC_INIT shall fail and return a non-zero value. ]*/                                 \
+        LogError("invalid argument THANDLE_ATOMIC(" MU_TOSTRING(T) ")* atomic=%p, THANDLE(" MU_TOSTRING(T) ") value=%p", atomic, value);                            \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_ATOMIC_02_022: [ THANDLE_ATOMIC_INIT shall call THANDLE_INC_REF on value (if not NULL). ]*/                                             \
+        if (value != NULL)                                                                                                                                          \
+        {                                                                                                                                                           \
+            THANDLE_INC_REF(T)(value);                                                                                                                              \
+        }                                                                                                                                                           \
+        /*Codes_SRS_THANDLE_ATOMIC_02_023: [ THANDLE_ATOMIC_INIT shall call thandle_atomic_slot_init with value. ]*/                                                \
+        if (thandle_atomic_slot_init(&atomic->slot, (void*)value) != 0)                                                                                             \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_ATOMIC_02_024: [ If thandle_atomic_slot_init fails then THANDLE_ATOMIC_INIT shall call THANDLE_DEC_REF on value (if not NULL), fail and return a non-zero value. ]*/ \
+            LogError("failure in thandle_atomic_slot_init(&atomic->slot=%p, value=%p)", &atomic->slot, value);                                                      \
+            if (value != NULL)                                                                                                                                      \
+            {                                                                                                                                                       \
+                THANDLE_DEC_REF(T)(value);                                                                                                                          \
+            }                                                                                                                                                       \
+            result = MU_FAILURE;                                                                                                                                    \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_ATOMIC_02_025: [ THANDLE_ATOMIC_INIT shall succeed and return 0. ]*/                                                                \
+            result = 0;                                                                                                                                             \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+void THANDLE_ATOMIC_DEINIT(T)(THANDLE_ATOMIC(T)* atomic)                                                                                                            \
+{                                                                                                                                                                   \
+    if (atomic == NULL)                                                                                                                                             \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_ATOMIC_02_026: [ If atomic is NULL then THANDLE_ATOMIC_DEINIT shall return. ]*/                                                         \
+        LogError("invalid argument THANDLE_ATOMIC(" MU_TOSTRING(T) ")* atomic=%p", atomic);                                                                         \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_ATOMIC_02_027: [ THANDLE_ATOMIC_DEINIT shall call THANDLE_ATOMIC_STORE with NULL. ]*/                                                   \
+        if (THANDLE_ATOMIC_STORE(T)(atomic, NULL) != 0)                                                                                                             \
+        {                                                                                                                                                           \
+            LogError("failure in THANDLE_ATOMIC_STORE(" MU_TOSTRING(T) ")(atomic=%p, NULL)", atomic);                                                               \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+void THANDLE_ATOMIC_LOAD(T)(THANDLE_ATOMIC(T)* atomic, THANDLE(T)* lvalue)                                                                                          \
+{                                                                                                                                                                   \
+    if (                                                                                                                                                            \
+        /*Codes_SRS_THANDLE_ATOMIC_02_028: [ If atomic is NULL then THANDLE_ATOMIC_LOAD shall return. ]*/                                                           \
+        (atomic == NULL) ||                                                                                                                                         \
+        /*Codes_SRS_THANDLE_ATOMIC_02_029: [ If lvalue is NULL then THANDLE_ATOMIC_LOAD shall return. ]*/                                                           \
+        (lvalue == NULL)                                                                                                                                            \
+    )                                                                                                                                                               \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_ATOMIC(" MU_TOSTRING(T) ")* atomic=%p, THANDLE(" MU_TOSTRING(T) ")* lvalue=%p", atomic, lvalue);                         \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        int32_t reader_index;                                                                                                                                       \
+        /*Codes_SRS_THANDLE_ATOMIC_02_030: [ THANDLE_ATOMIC_LOAD shall call thandle_atomic_slot_read_begin. ]*/                                                     \
+        T* value = (T*)thandle_atomic_slot_read_begin(&atomic->slot, &reader_index);                                                                                \
+        if (value != NULL)                                                                                                                                          \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_ATOMIC_02_031: [ THANDLE_ATOMIC_LOAD shall call THANDLE_INC_REF on the value returned by thandle_atomic_slot_read_begin (if not NULL). ]*/ \
+            THANDLE_INC_REF(T)(value);                                                                                                                              \
+        }                                                                                                                                                           \
+        /*Codes_SRS_THANDLE_ATOMIC_02_032: [ THANDLE_ATOMIC_LOAD shall call thandle_atomic_slot_read_end. ]*/                                                       \
+        thandle_atomic_slot_read_end(&atomic->slot, reader_index);                                                                                                  \
+        /*Codes_SRS_THANDLE_ATOMIC_02_033: [ THANDLE_ATOMIC_LOAD shall store the value in *lvalue. ]*/                                                              \
+        * (T const**)lvalue = value;                                                                                                                                \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+int THANDLE_ATOMIC_EXCHANGE(T)(THANDLE_ATOMIC(T)* atomic, THANDLE(T) value, THANDLE(T)* previous)                                                                   \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (                                                                                                                                                            \
+        /*Codes_SRS_THANDLE_ATOMIC_02_034: [ If atomic is NULL then THANDLE_ATOMIC_EXCHANGE shall fail and return a non-zero value. ]*/                             \
+        (atomic == NULL) ||                                                                                                                                         \
+        /*Codes_SRS_THANDLE_ATOMIC_02_035: [ If previous is NULL then THANDLE_ATOMIC_EXCHANGE shall fail and return a non-zero value. ]*/                           \
+        (previous == NULL)                                                                                                                                          \
+    )                                                                                                                                                               \
+    {                                                                                                                                                               \
+        LogError("invalid argument THANDLE_ATOMIC(" MU_TOSTRING(T) ")* atomic=%p, THANDLE(" MU_TOSTRING(T) ") value=%p, THANDLE(" MU_TOSTRING(T) ")* previous=%p",  \
+            atomic, value, previous);                                                                                                                               \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        void* previous_value;                                                                                                                                       \
+        /*Codes_SRS_THANDLE_ATOMIC_02_036: [ THANDLE_ATOMIC_EXCHANGE shall call THANDLE_INC_REF on value (if not NULL). ]*/                                         \
+        if (value != NULL)                                                                                                                                          \
+        {                                                                                                                                                           \
+            THANDLE_INC_REF(T)(value);                                                                                                                              \
+        }                                                                                                                                                           \
+        /*Codes_SRS_THANDLE_ATOMIC_02_037: [ THANDLE_ATOMIC_EXCHANGE shall call thandle_atomic_slot_exchange with value. ]*/                                        \
+        if (thandle_atomic_slot_exchange(&atomic->slot, (void*)value, &previous_value) != 0)                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_ATOMIC_02_038: [ If thandle_atomic_slot_exchange fails then THANDLE_ATOMIC_EXCHANGE shall call THANDLE_DEC_REF on value (if not NULL), fail and return a non-zero value. ]*/ \
+            LogError("failure in thandle_atomic_slot_exchange(&atomic->slot=%p, value=%p, &previous_value=%p)", &atomic->slot, value, &previous_value);             \
+            if (value != NULL)                                                                                                                                      \
+            {                                                                                                                                                       \
+                THANDLE_DEC_REF(T)(value);                                                                                                                          \
+            }                                                                                                                                                       \
+            result = MU_FAILURE;                                                                                                                                    \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_ATOMIC_02_039: [ THANDLE_ATOMIC_EXCHANGE shall move the reference of the previous value under *previous, succeed and return 0. ]*/  \
+            * (T const**)previous = (T*)previous_value;                                                                                                             \
+            result = 0;                                                                                                                                             \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+int THANDLE_ATOMIC_STORE(T)(THANDLE_ATOMIC(T)* atomic, THANDLE(T) value)                                                                                            \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    THANDLE(T) previous = NULL;                                                                                                                                     \
+    /*Codes_SRS_THANDLE_ATOMIC_02_040: [ THANDLE_ATOMIC_STORE shall call THANDLE_ATOMIC_EXCHANGE. ]*/                                                               \
+    if (THANDLE_ATOMIC_EXCHANGE(T)(atomic, value, &previous) != 0)                                                                                                  \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_ATOMIC_02_041: [ If THANDLE_ATOMIC_EXCHANGE fails then THANDLE_ATOMIC_STORE shall fail and return a non-zero value. ]*/                 \
+        LogError("failure in THANDLE_ATOMIC_EXCHANGE(" MU_TOSTRING(T) ")(atomic=%p, value=%p, &previous=%p)", atomic, value, &previous);                            \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_ATOMIC_02_042: [ THANDLE_ATOMIC_STORE shall release the previous value with THANDLE_ASSIGN, succeed and return 0. ]*/                   \
+        THANDLE_ASSIGN(T)(&previous, NULL);                                                                                                                         \
+        result = 0;                                                                                                                                                 \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*THANDLE_ATOMIC_H*/
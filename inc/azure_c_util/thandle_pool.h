@@ -0,0 +1,238 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef THANDLE_POOL_H
+#define THANDLE_POOL_H
+
+#ifdef __cplusplus
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/thandle.h"
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*a thandle_pool keeps a slab of fixed size items that are recycled instead of being freed.
+The slab is split in one partition per processor, a thread takes items from the partition of its processor (and from the other partitions when that one is empty).
+The slab is allocated once, so the memory kept by the pool never grows. When the pool is empty the callers allocate with malloc*/
+typedef struct THANDLE_POOL_TAG* THANDLE_POOL_HANDLE;
+
+#define THANDLE_POOL_DEFAULT_ITEMS_PER_PROCESSOR 16
+#define THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR 64
+
+typedef struct THANDLE_POOL_STATISTICS_TAG
+{
+    uint64_t hits;              /*thandle_pool_malloc calls that returned an item of the pool*/
+    uint64_t misses;            /*thandle_pool_malloc calls that returned NULL because the pool was empty or the size was too big*/
+    uint64_t returns;           /*thandle_pool_free calls that put an item back in the pool*/
+    uint64_t foreign_frees;     /*thandle_pool_free calls for memory that was not an item of the pool*/
+    uint32_t item_count;        /*number of items of the slab*/
+    uint32_t free_item_count;   /*number of items in the pool when the statistics were read*/
+}THANDLE_POOL_STATISTICS;
+
+MOCKABLE_FUNCTION(, THANDLE_POOL_HANDLE, thandle_pool_create, size_t, item_size, uint32_t, items_per_processor);
+MOCKABLE_FUNCTION(, void, thandle_pool_destroy, THANDLE_POOL_HANDLE, thandle_pool);
+
+/*returns NULL when size is greater than the size of the items or when the pool is empty*/
+MOCKABLE_FUNCTION(, void*, thandle_pool_malloc, THANDLE_POOL_HANDLE, thandle_pool, size_t, size);
+/*returns false when ptr is not an item of the pool, then the caller frees it*/
+MOCKABLE_FUNCTION(, bool, thandle_pool_free, THANDLE_POOL_HANDLE, thandle_pool, void*, ptr);
+
+MOCKABLE_FUNCTION(, int, thandle_pool_get_statistics, THANDLE_POOL_HANDLE, thandle_pool, THANDLE_POOL_STATISTICS*, statistics);
+
+/*given a previous type T, THANDLE_POOL_VARIABLE is the name of the static variable that holds the pool of the wrappers of T*/
+#define THANDLE_POOL_VARIABLE(T) MU_C2(T,_THANDLE_POOL)
+
+/*given a previous type T, THANDLE_POOL_INIT introduces a new name for the function that creates the pool of the wrappers of T*/
+#define THANDLE_POOL_INIT(T) MU_C2(T,_POOL_INIT)
+
+/*given a previous type T, THANDLE_POOL_DEINIT introduces a new name for the function that destroys the pool of the wrappers of T*/
+#define THANDLE_POOL_DEINIT(T) MU_C2(T,_POOL_DEINIT)
+
+/*given a previous type T, THANDLE_POOL_GET_STATISTICS introduces a new name for the function that returns the statistics of the pool of the wrappers of T*/
+#define THANDLE_POOL_GET_STATISTICS(T) MU_C2(T,_POOL_GET_STATISTICS)
+
+/*given a previous type T, this introduces the pool of the wrappers of T, the functions that manage it and a THANDLE_MALLOC that takes the wrappers from the pool*/
+#define THANDLE_POOL_MALLOC_MACRO(T)                                                                                                                                \
+static THANDLE_POOL_HANDLE THANDLE_POOL_VARIABLE(T) = NULL;                                                                                                         \
+static int THANDLE_POOL_INIT(T)(size_t extra_size, uint32_t items_per_processor)                                                                                    \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (THANDLE_POOL_VARIABLE(T) != NULL)                                                                                                                           \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_025: [ If the pool of T already exists then THANDLE_POOL_INIT shall fail and return a non-zero value. ]*/                       \
+        LogError("the pool of " MU_TOSTRING(T) " already exists");                                                                                                  \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else if (SIZE_MAX - sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) < extra_size)                                                                                          \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_026: [ If extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) would exceed SIZE_MAX then THANDLE_POOL_INIT shall fail and return a non-zero value. ]*/ \
+        LogError("extra_size=%zu produces arithmetic overflows", extra_size);                                                                                       \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_027: [ THANDLE_POOL_INIT shall call thandle_pool_create with sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) + extra_size as item size and items_per_processor. ]*/ \
+        THANDLE_POOL_VARIABLE(T) = thandle_pool_create(sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) + extra_size, items_per_processor);                                     \
+        if (THANDLE_POOL_VARIABLE(T) == NULL)                                                                                                                       \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_POOL_02_028: [ If thandle_pool_create fails then THANDLE_POOL_INIT shall fail and return a non-zero value. ]*/                      \
+            LogError("failure in thandle_pool_create(sizeof(THANDLE_WRAPPER_TYPE_NAME(" MU_TOSTRING(T) "))=%zu + extra_size=%zu, items_per_processor=%" PRIu32 ")", \
+                sizeof(THANDLE_WRAPPER_TYPE_NAME(T)), extra_size, items_per_processor);                                                                             \
+            result = MU_FAILURE;                                                                                                                                    \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_POOL_02_029: [ THANDLE_POOL_INIT shall succeed and return 0. ]*/                                                                    \
+            result = 0;                                                                                                                                             \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+static void THANDLE_POOL_DEINIT(T)(void)                                                                                                                            \
+{                                                                                                                                                                   \
+    if (THANDLE_POOL_VARIABLE(T) == NULL)                                                                                                                           \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_030: [ If the pool of T does not exist then THANDLE_POOL_DEINIT shall return. ]*/                                               \
+        LogError("the pool of " MU_TOSTRING(T) " does not exist");                                                                                                  \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_031: [ THANDLE_POOL_DEINIT shall call thandle_pool_destroy and forget the pool of T. ]*/                                        \
+        thandle_pool_destroy(THANDLE_POOL_VARIABLE(T));                                                                                                             \
+        THANDLE_POOL_VARIABLE(T) = NULL;                                                                                                                            \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+static int THANDLE_POOL_GET_STATISTICS(T)(THANDLE_POOL_STATISTICS* statistics)                                                                                      \
+{                                                                                                                                                                   \
+    int result;                                                                                                                                                     \
+    if (THANDLE_POOL_VARIABLE(T) == NULL)                                                                                                                           \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_032: [ If the pool of T does not exist then THANDLE_POOL_GET_STATISTICS shall fail and return a non-zero value. ]*/             \
+        LogError("the pool of " MU_TOSTRING(T) " does not exist");                                                                                                  \
+        result = MU_FAILURE;                                                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_033: [ THANDLE_POOL_GET_STATISTICS shall return what thandle_pool_get_statistics returns. ]*/                                   \
+        result = thandle_pool_get_statistics(THANDLE_POOL_VARIABLE(T), statistics);                                                                                 \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+static T* THANDLE_MALLOC(T)(void(*dispose)(T*))                                                                                                                     \
+{                                                                                                                                                                   \
+    T* result;                                                                                                                                                      \
+    /*Codes_SRS_THANDLE_POOL_02_034: [ If the pool of T exists then THANDLE_MALLOC shall take a wrapper from the pool by calling thandle_pool_malloc. ]*/           \
+    THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = (THANDLE_POOL_VARIABLE(T) == NULL) ? NULL : (THANDLE_WRAPPER_TYPE_NAME(T)*)thandle_pool_malloc(THANDLE_POOL_VARIABLE(T), sizeof(THANDLE_WRAPPER_TYPE_NAME(T))); \
+    if (handle_impl == NULL)                                                                                                                                        \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_035: [ If the pool of T does not exist or it is empty then THANDLE_MALLOC shall allocate memory. ]*/                            \
+        handle_impl = (THANDLE_WRAPPER_TYPE_NAME(T)*)THANDLE_MALLOC_FUNCTION(sizeof(THANDLE_WRAPPER_TYPE_NAME(T)));                                                 \
+    }                                                                                                                                                               \
+    if (handle_impl == NULL)                                                                                                                                        \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_036: [ If allocating memory fails then THANDLE_MALLOC shall fail and return NULL. ]*/                                           \
+        LogError("error in malloc(sizeof(THANDLE_WRAPPER_TYPE_NAME(" MU_TOSTRING(T) "))=%zu)",                                                                      \
+            sizeof(THANDLE_WRAPPER_TYPE_NAME(T)));                                                                                                                  \
+        result = NULL;                                                                                                                                              \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_037: [ THANDLE_MALLOC shall initialize the reference count to 1, store dispose and return a T*. ]*/                             \
+        handle_impl->dispose = dispose;                                                                                                                             \
+        (void)interlocked_exchange(&handle_impl->refCount,1);                                                                                                       \
+        (void)interlocked_exchange(&handle_impl->weakCount,1);                                                                                                      \
+        THANDLE_TELEMETRY_CREATED(T, handle_impl, sizeof(THANDLE_WRAPPER_TYPE_NAME(T)));                                                                            \
+        result = &(handle_impl->data);                                                                                                                              \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+
+/*given a previous type T, this introduces a THANDLE_MALLOC_WITH_EXTRA_SIZE that takes the wrappers from the pool when they fit in its items*/
+#define THANDLE_POOL_MALLOC_WITH_EXTRA_SIZE_MACRO(T)                                                                                                                \
+static T* THANDLE_MALLOC_WITH_EXTRA_SIZE(T)(void(*dispose)(T*), size_t extra_size)                                                                                  \
+{                                                                                                                                                                   \
+    T* result;                                                                                                                                                      \
+    /*Codes_SRS_THANDLE_POOL_02_038: [ If extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) would exceed SIZE_MAX then THANDLE_MALLOC_WITH_EXTRA_SIZE shall fail and return NULL. ]*/ \
+    if (SIZE_MAX - sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) < extra_size)                                                                                               \
+    {                                                                                                                                                               \
+        LogError("extra_size=%zu produces arithmetic overflows", extra_size);                                                                                       \
+        result = NULL;                                                                                                                                              \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        /*Codes_SRS_THANDLE_POOL_02_039: [ If the pool of T exists then THANDLE_MALLOC_WITH_EXTRA_SIZE shall take a wrapper from the pool by calling thandle_pool_malloc with extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)). ]*/ \
+        THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = (THANDLE_POOL_VARIABLE(T) == NULL) ? NULL : (THANDLE_WRAPPER_TYPE_NAME(T)*)thandle_pool_malloc(THANDLE_POOL_VARIABLE(T), extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T))); \
+        if (handle_impl == NULL)                                                                                                                                    \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_POOL_02_040: [ If the pool of T does not exist, it is empty or its items are too small then THANDLE_MALLOC_WITH_EXTRA_SIZE shall allocate memory enough to hold T and extra_size. ]*/ \
+            handle_impl = (THANDLE_WRAPPER_TYPE_NAME(T)*)THANDLE_MALLOC_FUNCTION(extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)));                                \
+        }                                                                                                                                                           \
+        if (handle_impl == NULL)                                                                                                                                    \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_POOL_02_041: [ If allocating memory fails then THANDLE_MALLOC_WITH_EXTRA_SIZE shall fail and return NULL. ]*/                       \
+            LogError("error in malloc(sizeof(THANDLE_WRAPPER_TYPE_NAME(" MU_TOSTRING(T) "))=%zu + extra_size=%zu)",                                                 \
+                sizeof(THANDLE_WRAPPER_TYPE_NAME(T)), extra_size);                                                                                                  \
+            result = NULL;                                                                                                                                          \
+        }                                                                                                                                                           \
+        else                                                                                                                                                        \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_POOL_02_042: [ THANDLE_MALLOC_WITH_EXTRA_SIZE shall initialize the reference count to 1, store dispose and return a T*. ]*/          \
+            handle_impl->dispose = dispose;                                                                                                                         \
+            (void)interlocked_exchange(&handle_impl->refCount,1);                                                                                                   \
+            (void)interlocked_exchange(&handle_impl->weakCount,1);                                                                                                  \
+            THANDLE_TELEMETRY_CREATED(T, handle_impl, extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)));                                                           \
+            result = &(handle_impl->data);                                                                                                                          \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+    return result;                                                                                                                                                  \
+}                                                                                                                                                                   \
+
+/*given a previous type T, this introduces a THANDLE_FREE that gives the wrappers back to the pool (the final THANDLE_DEC_REF calls THANDLE_FREE)*/
+#define THANDLE_POOL_FREE_MACRO(T)                                                                                                                                  \
+static void THANDLE_FREE(T)(T* t)                                                                                                                                   \
+{                                                                                                                                                                   \
+    /*Codes_SRS_THANDLE_POOL_02_043: [ If t is NULL then THANDLE_FREE shall return. ]*/                                                                             \
+    if (t == NULL)                                                                                                                                                  \
+    {                                                                                                                                                               \
+        LogError("invalid arg " MU_TOSTRING(T) "* t=%p", t);                                                                                                        \
+    }                                                                                                                                                               \
+    else                                                                                                                                                            \
+    {                                                                                                                                                               \
+        THANDLE_WRAPPER_TYPE_NAME(T)* handle_impl = CONTAINING_RECORD(t, THANDLE_WRAPPER_TYPE_NAME(T), data);                                                       \
+        THANDLE_TELEMETRY_FREED(T, handle_impl);                                                                                                                    \
+        if (                                                                                                                                                        \
+            /*Codes_SRS_THANDLE_POOL_02_044: [ If the pool of T exists then THANDLE_FREE shall give the wrapper back to the pool by calling thandle_pool_free. ]*/  \
+            (THANDLE_POOL_VARIABLE(T) == NULL) ||                                                                                                                   \
+            (!thandle_pool_free(THANDLE_POOL_VARIABLE(T), handle_impl))                                                                                             \
+            )                                                                                                                                                       \
+        {                                                                                                                                                           \
+            /*Codes_SRS_THANDLE_POOL_02_045: [ If the pool of T does not exist or the wrapper is not an item of the pool then THANDLE_FREE shall free the memory. ]*/ \
+            THANDLE_FREE_FUNCTION(handle_impl);                                                                                                                     \
+        }                                                                                                                                                           \
+    }                                                                                                                                                               \
+}                                                                                                                                                                   \
+
+/*given a previous type T, this introduces a wrapper type that contains T (and other fields), defines the functions of that type T and a pool of wrappers.
+The pool is created by THANDLE_POOL_INIT(T) and destroyed by THANDLE_POOL_DEINIT(T) when there are no more THANDLE(T). Without a pool THANDLE(T) behaves as THANDLE_TYPE_DEFINE(T)*/
+#define THANDLE_TYPE_DEFINE_WITH_POOL(T)                                                                                                                            \
+    THANDLE_TYPE_DEFINE_WITH_MALLOC_MACROS(T, THANDLE_POOL_MALLOC_MACRO, THANDLE_POOL_MALLOC_WITH_EXTRA_SIZE_MACRO, THANDLE_POOL_FREE_MACRO)                        \
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*THANDLE_POOL_H*/
@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef THANDLE_TELEMETRY_H
+#define THANDLE_TELEMETRY_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*thandle_telemetry counts the live instances of a THANDLE'd type and the bytes they use. When thandle.h is compiled with THANDLE_TELEMETRY every
+type T registered by THANDLE_TELEMETRY_INIT(T) reports the creation and the freeing of its wrappers here.
+The counters are kept per processor, the live count is folded in a global count (that tracks the peak) every THANDLE_TELEMETRY_BATCH instances*/
+typedef struct THANDLE_TELEMETRY_TAG* THANDLE_TELEMETRY_HANDLE;
+
+#define THANDLE_TELEMETRY_BATCH 32
+
+typedef struct THANDLE_TELEMETRY_STATISTICS_TAG
+{
+    const char* type_name;
+    uint64_t created_count; /*instances created since the type was registered*/
+    int64_t live_count;     /*instances created and not freed yet (a wrapper is freed when the last THANDLE(T) and THANDLE_WEAK(T) go away)*/
+    int64_t live_bytes;     /*bytes of the wrappers of the live instances, extra_size included*/
+    int64_t peak_count;     /*the highest live_count seen, give or take THANDLE_TELEMETRY_BATCH instances per processor*/
+}THANDLE_TELEMETRY_STATISTICS;
+
+/*called by thandle_telemetry_enumerate for every registered type*/
+typedef void(*THANDLE_TELEMETRY_ON_TYPE)(void* context, const THANDLE_TELEMETRY_STATISTICS* statistics);
+
+/*type_name is not copied, it has to outlive the registration*/
+MOCKABLE_FUNCTION(, THANDLE_TELEMETRY_HANDLE, thandle_telemetry_register, const char*, type_name);
+MOCKABLE_FUNCTION(, void, thandle_telemetry_unregister, THANDLE_TELEMETRY_HANDLE, thandle_telemetry);
+
+MOCKABLE_FUNCTION(, void, thandle_telemetry_on_create, THANDLE_TELEMETRY_HANDLE, thandle_telemetry, size_t, size);
+MOCKABLE_FUNCTION(, void, thandle_telemetry_on_free, THANDLE_TELEMETRY_HANDLE, thandle_telemetry, size_t, size);
+
+MOCKABLE_FUNCTION(, int, thandle_telemetry_get_statistics, THANDLE_TELEMETRY_HANDLE, thandle_telemetry, THANDLE_TELEMETRY_STATISTICS*, statistics);
+
+/*on_type is called with the registry locked, it cannot register or unregister types*/
+MOCKABLE_FUNCTION(, int, thandle_telemetry_enumerate, THANDLE_TELEMETRY_ON_TYPE, on_type, void*, context);
+/*logs the statistics of every registered type*/
+MOCKABLE_FUNCTION(, int, thandle_telemetry_log_all);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*THANDLE_TELEMETRY_H*/
@@ -0,0 +1,45 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TOKEN_BUCKET_TAG* TOKEN_BUCKET_HANDLE;
+
+#define TOKEN_BUCKET_RESULT_VALUES      \
+    TOKEN_BUCKET_OK,                    \
+    TOKEN_BUCKET_NOT_ENOUGH_TOKENS,     \
+    TOKEN_BUCKET_TIMEOUT,               \
+    TOKEN_BUCKET_ERROR                  \
+
+MU_DEFINE_ENUM(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_RESULT_VALUES);
+
+/*a bucket that holds at most capacity tokens and is refilled with tokens_per_second tokens every second. The bucket starts full*/
+MOCKABLE_FUNCTION(, TOKEN_BUCKET_HANDLE, token_bucket_create, int64_t, capacity, int64_t, tokens_per_second);
+MOCKABLE_FUNCTION(, void, token_bucket_destroy, TOKEN_BUCKET_HANDLE, token_bucket);
+
+/*takes count tokens if the bucket has them, never waits*/
+MOCKABLE_FUNCTION(, TOKEN_BUCKET_RESULT, token_bucket_try_acquire, TOKEN_BUCKET_HANDLE, token_bucket, int64_t, count);
+
+/*takes count tokens, waiting at most timeout_ms milliseconds (UINT32_MAX means "forever") for the bucket to be refilled*/
+MOCKABLE_FUNCTION(, TOKEN_BUCKET_RESULT, token_bucket_acquire, TOKEN_BUCKET_HANDLE, token_bucket, int64_t, count, uint32_t, timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*TOKEN_BUCKET_H*/
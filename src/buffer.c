@@ -4,12 +4,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "azure_c_pal/gballoc_hl.h"
 #include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
 
 #include "azure_c_logging/xlogging.h"
 
+#include "azure_c_util/memory_budget.h"
+
 #include "azure_c_util/buffer_.h"
 
 
@@ -17,8 +21,71 @@ typedef struct BUFFER_TAG
 {
     unsigned char* buffer;
     size_t size;
+    MEMORY_BUDGET_HANDLE memory_budget; /*the budget given to BUFFER_create_with_memory_budget or set by BUFFER_set_memory_budget when the BUFFER was created, NULL if none*/
+    uint32_t memory_budget_timeout_ms; /*the timeout of every growth charged to memory_budget, chosen together with memory_budget*/
+    size_t memory_budget_charge; /*bytes charged to memory_budget. This is the largest size the content ever had, it is given back by BUFFER_delete*/
 } BUFFER;
 
+/*the budget of the BUFFERs created without one, set by BUFFER_set_memory_budget*/
+MEMORY_BUDGET_SETTING_DEFINE(buffer_memory_budget)
+
+static void BUFFER_init_memory_budget(BUFFER* b, MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms)
+{
+    b->memory_budget = memory_budget;
+    b->memory_budget_timeout_ms = timeout_ms;
+    b->memory_budget_charge = 0;
+}
+
+static void BUFFER_init_default_memory_budget(BUFFER* b)
+{
+    MEMORY_BUDGET_HANDLE memory_budget;
+    uint32_t timeout_ms;
+    buffer_memory_budget_get(&memory_budget, &timeout_ms);
+    BUFFER_init_memory_budget(b, memory_budget, timeout_ms);
+}
+
+/*makes sure that size bytes of content are charged to the memory budget of b. Only the growth above the bytes already charged is charged,
+so a BUFFER that shrinks and grows back does not call memory_budget_charge again*/
+static int BUFFER_charge_memory_budget(BUFFER* b, size_t size)
+{
+    int result;
+    if (
+        (b->memory_budget == NULL) ||
+        (size <= b->memory_budget_charge)
+        )
+    {
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_BUFFER_02_006: [ If the BUFFER_HANDLE was created after a memory budget was set by BUFFER_set_memory_budget then before growing its content above the size that was already charged, BUFFER_create, BUFFER_create_with_size, BUFFER_build, BUFFER_append_build, BUFFER_pre_build, BUFFER_enlarge, BUFFER_append, BUFFER_prepend and BUFFER_clone shall charge the growth by calling memory_budget_charge with the timeout set by BUFFER_set_memory_budget. ]*/
+        /*Codes_SRS_BUFFER_02_012: [ If memory_budget is not NULL then BUFFER_create_with_memory_budget shall charge the content to memory_budget (and not to the budget set by BUFFER_set_memory_budget) by calling memory_budget_charge with timeout_ms, and so shall every later growth of the BUFFER_HANDLE. ]*/
+        size_t growth = size - b->memory_budget_charge;
+        if (memory_budget_charge(b->memory_budget, (int64_t)growth, b->memory_budget_timeout_ms) != MEMORY_BUDGET_OK)
+        {
+            /*Codes_SRS_BUFFER_02_007: [ If memory_budget_charge fails then the function shall fail without changing the content of the BUFFER_HANDLE. ]*/
+            LogError("memory budget %s refused %zu bytes", memory_budget_get_name(b->memory_budget), growth);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            b->memory_budget_charge = size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static void BUFFER_release_memory_budget(BUFFER* b)
+{
+    if (b->memory_budget_charge != 0)
+    {
+        /*Codes_SRS_BUFFER_02_008: [ If the BUFFER_HANDLE was charged to a memory budget, BUFFER_delete shall give back all the charged bytes by calling memory_budget_release. ]*/
+        memory_budget_release(b->memory_budget, (int64_t)b->memory_budget_charge);
+        b->memory_budget_charge = 0;
+    }
+}
+
 /* Codes_SRS_BUFFER_07_001: [BUFFER_new shall allocate a BUFFER_HANDLE that will contain a NULL unsigned char*.] */
 BUFFER_HANDLE BUFFER_new(void)
 {
@@ -28,6 +95,7 @@ BUFFER_HANDLE BUFFER_new(void)
     {
         temp->buffer = NULL;
         temp->size = 0;
+        BUFFER_init_default_memory_budget(temp);
     }
     return (BUFFER_HANDLE)temp;
 }
@@ -40,8 +108,13 @@ static int BUFFER_safemalloc(BUFFER* handleptr, size_t size)
     {
         sizetomalloc = 1;
     }
-    handleptr->buffer = (unsigned char*)malloc(sizetomalloc);
-    if (handleptr->buffer == NULL)
+    if (BUFFER_charge_memory_budget(handleptr, size) != 0)
+    {
+        LogError("failure in BUFFER_charge_memory_budget(handleptr=%p, size=%zu)", handleptr, size);
+        handleptr->buffer = NULL;
+        result = MU_FAILURE;
+    }
+    else if ((handleptr->buffer = (unsigned char*)malloc(sizetomalloc)) == NULL)
     {
         /*Codes_SRS_BUFFER_02_003: [If allocating memory fails, then BUFFER_create shall return NULL.]*/
         LogError("Failure allocating data");
@@ -56,10 +129,11 @@ static int BUFFER_safemalloc(BUFFER* handleptr, size_t size)
     return result;
 }
 
-BUFFER_HANDLE BUFFER_create(const unsigned char* source, size_t size)
+static BUFFER_HANDLE BUFFER_create_internal(const unsigned char* source, size_t size, MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms)
 {
     BUFFER* result;
     /*Codes_SRS_BUFFER_02_001: [If source is NULL then BUFFER_create shall return NULL.]*/
+    /*Codes_SRS_BUFFER_02_011: [ If source is NULL then BUFFER_create_with_memory_budget shall fail and return NULL. ]*/
     if (source == NULL)
     {
         LogError("invalid parameter source: %p", source);
@@ -72,21 +146,25 @@ BUFFER_HANDLE BUFFER_create(const unsigned char* source, size_t size)
         if (result == NULL)
         {
             /*Codes_SRS_BUFFER_02_003: [If allocating memory fails, then BUFFER_create shall return NULL.] */
+            /*Codes_SRS_BUFFER_02_015: [ If there are any failures then BUFFER_create_with_memory_budget shall fail and return NULL. ]*/
             /*fallthrough*/
             LogError("Failure allocating BUFFER structure");
         }
         else
         {
+            BUFFER_init_memory_budget(result, memory_budget, timeout_ms);
             /* Codes_SRS_BUFFER_02_005: [If size parameter is 0 then 1 byte of memory shall be allocated yet size of the buffer shall be set to 0.]*/
             if (BUFFER_safemalloc(result, size) != 0)
             {
                 LogError("unable to BUFFER_safemalloc ");
+                BUFFER_release_memory_budget(result);
                 free(result);
                 result = NULL;
             }
             else
             {
                 /*Codes_SRS_BUFFER_02_004: [Otherwise, BUFFER_create shall return a non-NULL handle.] */
+                /*Codes_SRS_BUFFER_02_014: [ Otherwise BUFFER_create_with_memory_budget shall copy size bytes from source in a new BUFFER_HANDLE and return it. ]*/
                 (void)memcpy(result->buffer, source, size);
             }
         }
@@ -94,6 +172,20 @@ BUFFER_HANDLE BUFFER_create(const unsigned char* source, size_t size)
     return (BUFFER_HANDLE)result;
 }
 
+BUFFER_HANDLE BUFFER_create(const unsigned char* source, size_t size)
+{
+    MEMORY_BUDGET_HANDLE memory_budget;
+    uint32_t timeout_ms;
+    buffer_memory_budget_get(&memory_budget, &timeout_ms);
+    return BUFFER_create_internal(source, size, memory_budget, timeout_ms);
+}
+
+BUFFER_HANDLE BUFFER_create_with_memory_budget(const unsigned char* source, size_t size, MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms)
+{
+    /*Codes_SRS_BUFFER_02_013: [ If memory_budget is NULL then the BUFFER_HANDLE created by BUFFER_create_with_memory_budget shall not be charged to any memory budget. ]*/
+    return BUFFER_create_internal(source, size, memory_budget, timeout_ms);
+}
+
 // Codes_SRS_BUFFER_07_029: [ BUFFER_create_with_size shall create a BUFFER_HANDLE with a pre allocated underlying buffer size.]
 BUFFER_HANDLE BUFFER_create_with_size(size_t buff_size)
 {
@@ -101,6 +193,7 @@ BUFFER_HANDLE BUFFER_create_with_size(size_t buff_size)
     result = (BUFFER*)malloc(sizeof(BUFFER));
     if (result != NULL)
     {
+        BUFFER_init_default_memory_budget(result);
         if (buff_size == 0)
         {
             // Codes_SRS_BUFFER_07_030: [ If buff_size is 0 BUFFER_create_with_size shall create a valid non-NULL handle of zero size. ]
@@ -111,10 +204,18 @@ BUFFER_HANDLE BUFFER_create_with_size(size_t buff_size)
         {
             // Codes_SRS_BUFFER_07_031: [ BUFFER_create_with_size shall allocate a buffer of buff_size. ]
             result->size = buff_size;
-            if ((result->buffer = (unsigned char*)malloc(result->size)) == NULL)
+            if (BUFFER_charge_memory_budget(result, buff_size) != 0)
+            {
+                // Codes_SRS_BUFFER_07_032: [ If allocating memory fails, then BUFFER_create_with_size shall return NULL. ]
+                LogError("failure in BUFFER_charge_memory_budget(result=%p, buff_size=%zu)", result, buff_size);
+                free(result);
+                result = NULL;
+            }
+            else if ((result->buffer = (unsigned char*)malloc(result->size)) == NULL)
             {
                 // Codes_SRS_BUFFER_07_032: [ If allocating memory fails, then BUFFER_create_with_size shall return NULL. ]
                 LogError("unable to allocate buffer");
+                BUFFER_release_memory_budget(result);
                 free(result);
                 result = NULL;
             }
@@ -141,6 +242,7 @@ void BUFFER_delete(BUFFER_HANDLE handle)
             /* Codes_SRS_BUFFER_07_003: [BUFFER_delete shall delete the data associated with the BUFFER_HANDLE along with the Buffer.] */
             free(b->buffer);
         }
+        BUFFER_release_memory_budget(b);
         free(b);
     }
 }
@@ -177,9 +279,15 @@ int BUFFER_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size)
         else
         {
             BUFFER* b = (BUFFER*)handle;
+            unsigned char* newBuffer;
+            if (BUFFER_charge_memory_budget(b, size) != 0)
+            {
+                /* Codes_SRS_BUFFER_07_010: [BUFFER_build shall return nonzero if any error is encountered.] */
+                LogError("failure in BUFFER_charge_memory_budget(b=%p, size=%zu)", b, size);
+                result = MU_FAILURE;
+            }
             /* Codes_SRS_BUFFER_07_011: [BUFFER_build shall overwrite previous contents if the buffer has been previously allocated.] */
-            unsigned char* newBuffer = (unsigned char*)realloc(b->buffer, size);
-            if (newBuffer == NULL)
+            else if ((newBuffer = (unsigned char*)realloc(b->buffer, size)) == NULL)
             {
                 /* Codes_SRS_BUFFER_07_010: [BUFFER_build shall return nonzero if any error is encountered.] */
                 LogError("Failure reallocating buffer");
@@ -230,9 +338,15 @@ int BUFFER_append_build(BUFFER_HANDLE handle, const unsigned char* source, size_
         }
         else
         {
+            unsigned char* temp;
+            if (BUFFER_charge_memory_budget(handle, handle->size + size) != 0)
+            {
+                /* Codes_SRS_BUFFER_07_035: [ If any error is encountered BUFFER_append_build shall return a non-null value. ] */
+                LogError("failure in BUFFER_charge_memory_budget(handle=%p, handle->size=%zu + size=%zu)", handle, handle->size, size);
+                result = MU_FAILURE;
+            }
             /* Codes_SRS_BUFFER_01_009: [ if handle->buffer is not NULL BUFFER_append_build shall realloc the buffer to be the handle->size + size ] */
-            unsigned char* temp = (unsigned char*)realloc(handle->buffer, handle->size + size);
-            if (temp == NULL)
+            else if ((temp = (unsigned char*)realloc(handle->buffer, handle->size + size)) == NULL)
             {
                 /* Codes_SRS_BUFFER_07_035: [ If any error is encountered BUFFER_append_build shall return a non-null value. ] */
                 LogError("Failure reallocating temporary buffer");
@@ -278,6 +392,12 @@ int BUFFER_pre_build(BUFFER_HANDLE handle, size_t size)
             LogError("Failure buffer data is NULL");
             result = MU_FAILURE;
         }
+        else if (BUFFER_charge_memory_budget(b, size) != 0)
+        {
+            /* Codes_SRS_BUFFER_07_013: [BUFFER_pre_build shall return nonzero if any error is encountered.] */
+            LogError("failure in BUFFER_charge_memory_budget(b=%p, size=%zu)", b, size);
+            result = MU_FAILURE;
+        }
         else
         {
             if ((b->buffer = (unsigned char*)malloc(size)) == NULL)
@@ -361,8 +481,14 @@ int BUFFER_enlarge(BUFFER_HANDLE handle, size_t enlargeSize)
     else
     {
         BUFFER* b = (BUFFER*)handle;
-        unsigned char* temp = (unsigned char*)realloc(b->buffer, b->size + enlargeSize);
-        if (temp == NULL)
+        unsigned char* temp;
+        if (BUFFER_charge_memory_budget(b, b->size + enlargeSize) != 0)
+        {
+            /* Codes_SRS_BUFFER_07_018: [BUFFER_enlarge shall return a nonzero result if any error is encountered.] */
+            LogError("failure in BUFFER_charge_memory_budget(b=%p, b->size=%zu + enlargeSize=%zu)", b, b->size, enlargeSize);
+            result = MU_FAILURE;
+        }
+        else if ((temp = (unsigned char*)realloc(b->buffer, b->size + enlargeSize)) == NULL)
         {
             /* Codes_SRS_BUFFER_07_018: [BUFFER_enlarge shall return a nonzero result if any error is encountered.] */
             LogError("Failure: allocating temp buffer.");
@@ -497,8 +623,14 @@ int BUFFER_append(BUFFER_HANDLE handle1, BUFFER_HANDLE handle2)
             else
             {
                 // b2->size != 0, whatever b1->size is
-                unsigned char* temp = (unsigned char*)realloc(b1->buffer, b1->size + b2->size);
-                if (temp == NULL)
+                unsigned char* temp;
+                if (BUFFER_charge_memory_budget(b1, b1->size + b2->size) != 0)
+                {
+                    /* Codes_SRS_BUFFER_07_023: [BUFFER_append shall return a nonzero upon any error that is encountered.] */
+                    LogError("failure in BUFFER_charge_memory_budget(b1=%p, b1->size=%zu + b2->size=%zu)", b1, b1->size, b2->size);
+                    result = MU_FAILURE;
+                }
+                else if ((temp = (unsigned char*)realloc(b1->buffer, b1->size + b2->size)) == NULL)
                 {
                     /* Codes_SRS_BUFFER_07_023: [BUFFER_append shall return a nonzero upon any error that is encountered.] */
                     LogError("Failure: allocating temp buffer.");
@@ -552,8 +684,14 @@ int BUFFER_prepend(BUFFER_HANDLE handle1, BUFFER_HANDLE handle2)
             else
             {
                 // b2->size != 0
-                unsigned char* temp = (unsigned char*)malloc(b1->size + b2->size);
-                if (temp == NULL)
+                unsigned char* temp;
+                if (BUFFER_charge_memory_budget(b1, b1->size + b2->size) != 0)
+                {
+                    /* Codes_SRS_BUFFER_01_005: [ BUFFER_prepend shall return a non-zero upon value any error that is encountered. ]*/
+                    LogError("failure in BUFFER_charge_memory_budget(b1=%p, b1->size=%zu + b2->size=%zu)", b1, b1->size, b2->size);
+                    result = MU_FAILURE;
+                }
+                else if ((temp = (unsigned char*)malloc(b1->size + b2->size)) == NULL)
                 {
                     /* Codes_SRS_BUFFER_01_005: [ BUFFER_prepend shall return a non-zero upon value any error that is encountered. ]*/
                     LogError("Failure: allocating temp buffer.");
@@ -648,8 +786,11 @@ BUFFER_HANDLE BUFFER_clone(BUFFER_HANDLE handle)
         BUFFER* b = (BUFFER*)malloc(sizeof(BUFFER));
         if (b != NULL)
         {
+            /*Codes_SRS_BUFFER_02_016: [ BUFFER_clone shall charge the clone to the memory budget of handle, with the timeout of handle. ]*/
+            BUFFER_init_memory_budget(b, suppliedBuff->memory_budget, suppliedBuff->memory_budget_timeout_ms);
             if (BUFFER_safemalloc(b, suppliedBuff->size) != 0)
             {
+                BUFFER_release_memory_budget(b);
                 free(b);
                 LogError("Failure: allocating temp buffer.");
                 result = NULL;
@@ -668,3 +809,10 @@ BUFFER_HANDLE BUFFER_clone(BUFFER_HANDLE handle)
     }
     return result;
 }
+
+void BUFFER_set_memory_budget(MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms)
+{
+    /*Codes_SRS_BUFFER_02_009: [ BUFFER_set_memory_budget shall store memory_budget and timeout_ms to be used by all the BUFFER_HANDLEs created afterwards. ]*/
+    /*Codes_SRS_BUFFER_02_010: [ If memory_budget is NULL then the BUFFER_HANDLEs created afterwards shall not be charged to any memory budget. ]*/
+    buffer_memory_budget_set(memory_budget, timeout_ms);
+}
@@ -3,6 +3,8 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
 
 #include "azure_macro_utils/macro_utils.h"
 
@@ -13,6 +15,8 @@
 #include "azure_c_pal/interlocked.h"
 
 #include "azure_c_util/constbuffer.h"
+#include "azure_c_util/log_ratelimit.h"
+#include "azure_c_util/memory_budget.h"
 
 #define CONSTBUFFER_TYPE_VALUES \
     CONSTBUFFER_TYPE_COPIED, \
@@ -30,23 +34,76 @@ typedef struct CONSTBUFFER_HANDLE_DATA_TAG
     CONSTBUFFER_CUSTOM_FREE_FUNC custom_free_func;
     void* custom_free_func_context;
     CONSTBUFFER_HANDLE originalHandle; /*where the CONSTBUFFER_TYPE_FROM_OFFSET_AND_SIZE was build from*/
+    MEMORY_BUDGET_HANDLE memory_budget; /*the budget charged at creation, NULL if none*/
+    size_t memory_budget_charge; /*bytes charged to memory_budget, released when the ref count reaches 0*/
     unsigned char storage[]; /*if the memory was copied, this is where the copied memory is. For example in the case of CONSTBUFFER_CreateFromOffsetAndSizeWithCopy. Can have 0 as size.*/
 } CONSTBUFFER_HANDLE_DATA;
 
-static CONSTBUFFER_HANDLE CONSTBUFFER_Create_Internal(const unsigned char* source, size_t size)
+/*the budget charged by the CONSTBUFFER_Create* functions that do not take one, set by CONSTBUFFER_SetMemoryBudget*/
+MEMORY_BUDGET_SETTING_DEFINE(constbuffer_memory_budget)
+
+/*allocates a CONSTBUFFER_HANDLE_DATA with storage_size bytes of storage. Before that memory_budget (if not NULL) is charged with the allocation
+and with owned_size, the bytes of content that the new handle keeps alive outside of its allocation (for example the moved memory)*/
+static CONSTBUFFER_HANDLE CONSTBUFFER_AllocateWithMemoryBudget(MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms, size_t storage_size, size_t owned_size)
+{
+    CONSTBUFFER_HANDLE result;
+    size_t charge = sizeof(CONSTBUFFER_HANDLE_DATA) + storage_size + owned_size;
+
+    if (
+        (memory_budget != NULL) &&
+        /*Codes_SRS_CONSTBUFFER_02_041: [ If a memory budget was set by CONSTBUFFER_SetMemoryBudget then the CONSTBUFFER_Create* functions shall charge the memory budget with the bytes of the new CONSTBUFFER_HANDLE by calling memory_budget_charge with the timeout set by CONSTBUFFER_SetMemoryBudget. ]*/
+        /*Codes_SRS_CONSTBUFFER_02_047: [ If memory_budget is not NULL then CONSTBUFFER_CreateWithMemoryBudget shall charge memory_budget (and not the budget set by CONSTBUFFER_SetMemoryBudget) with the bytes of the new CONSTBUFFER_HANDLE by calling memory_budget_charge with timeout_ms. ]*/
+        (memory_budget_charge(memory_budget, (int64_t)charge, timeout_ms) != MEMORY_BUDGET_OK)
+        )
+    {
+        /*Codes_SRS_CONSTBUFFER_02_042: [ If memory_budget_charge fails then the CONSTBUFFER_Create* functions shall fail and return NULL. ]*/
+        LogError("memory budget %s refused %zu bytes", memory_budget_get_name(memory_budget), charge);
+        result = NULL;
+    }
+    else
+    {
+        result = (CONSTBUFFER_HANDLE)malloc(sizeof(CONSTBUFFER_HANDLE_DATA) + storage_size);
+        if (result == NULL)
+        {
+            LogError("failure in malloc(sizeof(CONSTBUFFER_HANDLE_DATA)=%zu + storage_size=%zu)", sizeof(CONSTBUFFER_HANDLE_DATA), storage_size);
+            if (memory_budget != NULL)
+            {
+                memory_budget_release(memory_budget, (int64_t)charge);
+            }
+        }
+        else
+        {
+            result->memory_budget = memory_budget;
+            result->memory_budget_charge = charge;
+        }
+    }
+    return result;
+}
+
+/*same as CONSTBUFFER_AllocateWithMemoryBudget, with the budget set by CONSTBUFFER_SetMemoryBudget*/
+static CONSTBUFFER_HANDLE CONSTBUFFER_Allocate(size_t storage_size, size_t owned_size)
+{
+    MEMORY_BUDGET_HANDLE memory_budget;
+    uint32_t timeout_ms;
+    constbuffer_memory_budget_get(&memory_budget, &timeout_ms);
+    return CONSTBUFFER_AllocateWithMemoryBudget(memory_budget, timeout_ms, storage_size, owned_size);
+}
+
+static CONSTBUFFER_HANDLE CONSTBUFFER_Copy_Internal(const unsigned char* source, size_t size, MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms)
 {
     CONSTBUFFER_HANDLE result;
     /*Codes_SRS_CONSTBUFFER_02_005: [The non-NULL handle returned by CONSTBUFFER_Create shall have its ref count set to "1".]*/
     /*Codes_SRS_CONSTBUFFER_02_010: [The non-NULL handle returned by CONSTBUFFER_CreateFromBuffer shall have its ref count set to "1".]*/
     /*Codes_SRS_CONSTBUFFER_02_037: [ CONSTBUFFER_CreateFromOffsetAndSizeWithCopy shall allocate enough memory to hold CONSTBUFFER_HANDLE and size bytes. ]*/
-    result = (CONSTBUFFER_HANDLE)malloc(sizeof(CONSTBUFFER_HANDLE_DATA) + size * sizeof(unsigned char));
+    /*Codes_SRS_CONSTBUFFER_02_049: [ CONSTBUFFER_CreateWithMemoryBudget shall create a copy of the memory area pointed to by source having size bytes, with its ref count set to 1, and return a non-NULL handle. ]*/
+    result = CONSTBUFFER_AllocateWithMemoryBudget(memory_budget, timeout_ms, size * sizeof(unsigned char), 0);
     if (result == NULL)
     {
         /*Codes_SRS_CONSTBUFFER_02_003: [If creating the copy fails then CONSTBUFFER_Create shall return NULL.]*/
         /*Codes_SRS_CONSTBUFFER_02_008: [If copying the content fails, then CONSTBUFFER_CreateFromBuffer shall fail and return NULL.] */
         /*Codes_SRS_CONSTBUFFER_02_040: [ If there are any failures then CONSTBUFFER_CreateFromOffsetAndSizeWithCopy shall fail and return NULL. ]*/
-        LogError("failure in malloc(sizeof(CONSTBUFFER_HANDLE_DATA)=%zu + size=%zu * sizeof(unsigned char)=%zu)",
-            sizeof(CONSTBUFFER_HANDLE_DATA) , size , sizeof(unsigned char));
+        /*Codes_SRS_CONSTBUFFER_02_050: [ If there are any failures then CONSTBUFFER_CreateWithMemoryBudget shall fail and return NULL. ]*/
+        LogError("failure in CONSTBUFFER_AllocateWithMemoryBudget(memory_budget=%p, timeout_ms=%" PRIu32 ", size=%zu * sizeof(unsigned char)=%zu, 0)", memory_budget, timeout_ms, size, sizeof(unsigned char));
         /*return as is*/
     }
     else
@@ -75,6 +132,15 @@ static CONSTBUFFER_HANDLE CONSTBUFFER_Create_Internal(const unsigned char* sourc
     return result;
 }
 
+/*same as CONSTBUFFER_Copy_Internal, with the budget set by CONSTBUFFER_SetMemoryBudget*/
+static CONSTBUFFER_HANDLE CONSTBUFFER_Create_Internal(const unsigned char* source, size_t size)
+{
+    MEMORY_BUDGET_HANDLE memory_budget;
+    uint32_t timeout_ms;
+    constbuffer_memory_budget_get(&memory_budget, &timeout_ms);
+    return CONSTBUFFER_Copy_Internal(source, size, memory_budget, timeout_ms);
+}
+
 IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, CONSTBUFFER_Create, const unsigned char*, source, size_t, size)
 {
     CONSTBUFFER_HANDLE result;
@@ -125,11 +191,11 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, CONSTBUFFER_CreateWithMoveMemo
     }
     else
     {
-        result = (CONSTBUFFER_HANDLE)malloc(sizeof(CONSTBUFFER_HANDLE_DATA));
+        result = (CONSTBUFFER_HANDLE)CONSTBUFFER_Allocate(0, size);
         if (result == NULL)
         {
             /* Codes_SRS_CONSTBUFFER_01_005: [ If any error occurs, CONSTBUFFER_CreateWithMoveMemory shall fail and return NULL. ]*/
-            LogError("malloc failed");
+            LogError("failure in CONSTBUFFER_Allocate(0, size=%zu)", size);
         }
         else
         {
@@ -166,11 +232,11 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, CONSTBUFFER_CreateWithCustomFr
     }
     else
     {
-        result = (CONSTBUFFER_HANDLE)malloc(sizeof(CONSTBUFFER_HANDLE_DATA));
+        result = (CONSTBUFFER_HANDLE)CONSTBUFFER_Allocate(0, size);
         if (result == NULL)
         {
             /* Codes_SRS_CONSTBUFFER_01_011: [ If any error occurs, CONSTBUFFER_CreateWithMoveMemory shall fail and return NULL. ]*/
-            LogError("malloc failed");
+            LogError("failure in CONSTBUFFER_Allocate(0, size=%zu)", size);
         }
         else
         {
@@ -214,11 +280,12 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, CONSTBUFFER_CreateFromOffsetAn
     else
     {
         /*Codes_SRS_CONSTBUFFER_02_028: [ CONSTBUFFER_CreateFromOffsetAndSize shall allocate memory for a new CONSTBUFFER_HANDLE's content. ]*/
-        result = (CONSTBUFFER_HANDLE)malloc(sizeof(CONSTBUFFER_HANDLE_DATA));
+        /*the content belongs to handle (and is charged to the budget of handle), only the new CONSTBUFFER_HANDLE_DATA is charged*/
+        result = CONSTBUFFER_Allocate(0, 0);
         if (result == NULL)
         {
             /*Codes_SRS_CONSTBUFFER_02_032: [ If there are any failures then CONSTBUFFER_CreateFromOffsetAndSize shall fail and return NULL. ]*/
-            LogError("failure in malloc(sizeof(CONSTBUFFER_HANDLE_DATA)=%zu)", sizeof(CONSTBUFFER_HANDLE_DATA));
+            LogError("failure in CONSTBUFFER_Allocate(0, 0)");
             /*return as is*/
         }
         else
@@ -282,7 +349,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, void, CONSTBUFFER_IncRef, CONSTBUFFER_HANDLE, cons
     if (constbufferHandle == NULL)
     {
         /*Codes_SRS_CONSTBUFFER_02_013: [If constbufferHandle is NULL then CONSTBUFFER_IncRef shall return.]*/
-        LogError("Invalid arguments: CONSTBUFFER_HANDLE constbufferHandle=%p", constbufferHandle);
+        LogErrorRateLimited("Invalid arguments: CONSTBUFFER_HANDLE constbufferHandle=%p", constbufferHandle);
     }
     else
     {
@@ -298,7 +365,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, const CONSTBUFFER*, CONSTBUFFER_GetContent, CONSTB
     {
         /*Codes_SRS_CONSTBUFFER_02_011: [If constbufferHandle is NULL then CONSTBUFFER_GetContent shall return NULL.]*/
         result = NULL;
-        LogError("invalid arg");
+        LogErrorRateLimited("invalid arg");
     }
     else
     {
@@ -328,6 +395,12 @@ static void CONSTBUFFER_DecRef_internal(CONSTBUFFER_HANDLE constbufferHandle)
             CONSTBUFFER_DecRef_internal(constbufferHandle->originalHandle);
         }
 
+        /*Codes_SRS_CONSTBUFFER_02_043: [ If the refcount reaches zero and the CONSTBUFFER_HANDLE was charged to a memory budget, CONSTBUFFER_DecRef shall give back the charged bytes by calling memory_budget_release. ]*/
+        if (constbufferHandle->memory_budget != NULL)
+        {
+            memory_budget_release(constbufferHandle->memory_budget, (int64_t)constbufferHandle->memory_budget_charge);
+        }
+
         /*Codes_SRS_CONSTBUFFER_02_017: [If the refcount reaches zero, then CONSTBUFFER_DecRef shall deallocate all resources used by the CONSTBUFFER_HANDLE.]*/
         free(constbufferHandle);
     }
@@ -338,7 +411,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, void, CONSTBUFFER_DecRef, CONSTBUFFER_HANDLE, cons
     if (constbufferHandle == NULL)
     {
         /*Codes_SRS_CONSTBUFFER_02_015: [If constbufferHandle is NULL then CONSTBUFFER_DecRef shall do nothing.]*/
-        LogError("Invalid arguments: CONSTBUFFER_HANDLE constbufferHandle=%p", constbufferHandle);
+        LogErrorRateLimited("Invalid arguments: CONSTBUFFER_HANDLE constbufferHandle=%p", constbufferHandle);
     }
     else
     {
@@ -394,3 +467,30 @@ IMPLEMENT_MOCKABLE_FUNCTION(, bool, CONSTBUFFER_HANDLE_contain_same, CONSTBUFFER
     }
     return result;
 }
+
+IMPLEMENT_MOCKABLE_FUNCTION(, void, CONSTBUFFER_SetMemoryBudget, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms)
+{
+    /*Codes_SRS_CONSTBUFFER_02_044: [ CONSTBUFFER_SetMemoryBudget shall store memory_budget and timeout_ms to be used by all the CONSTBUFFER_HANDLEs created afterwards. ]*/
+    /*Codes_SRS_CONSTBUFFER_02_045: [ If memory_budget is NULL then the CONSTBUFFER_HANDLEs created afterwards shall not be charged to any memory budget. ]*/
+    constbuffer_memory_budget_set(memory_budget, timeout_ms);
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, CONSTBUFFER_CreateWithMemoryBudget, const unsigned char*, source, size_t, size, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms)
+{
+    CONSTBUFFER_HANDLE result;
+    /*Codes_SRS_CONSTBUFFER_02_046: [ If source is NULL and size is different than 0 then CONSTBUFFER_CreateWithMemoryBudget shall fail and return NULL. ]*/
+    if (
+        (source == NULL) &&
+        (size != 0)
+        )
+    {
+        LogError("invalid arguments const unsigned char* source=%p, size_t size=%zu, MEMORY_BUDGET_HANDLE memory_budget=%p, uint32_t timeout_ms=%" PRIu32 "", source, size, memory_budget, timeout_ms);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_CONSTBUFFER_02_048: [ If memory_budget is NULL then CONSTBUFFER_CreateWithMemoryBudget shall not charge any memory budget. ]*/
+        result = CONSTBUFFER_Copy_Internal(source, size, memory_budget, timeout_ms);
+    }
+    return result;
+}
@@ -10,9 +10,12 @@
 
 #include "azure_c_pal/gballoc_hl.h"
 #include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
 #include "azure_c_pal/refcount.h"
 
 #include "azure_c_util/constbuffer.h"
+#include "azure_c_util/log_ratelimit.h"
+#include "azure_c_util/memory_budget.h"
 
 #include "azure_c_util/constbuffer_array.h"
 
@@ -24,17 +27,70 @@ typedef struct CONSTBUFFER_ARRAY_HANDLE_DATA_TAG
     CONSTBUFFER_ARRAY_CUSTOM_FREE_FUNC custom_free;
     void* custom_free_context;
     CONSTBUFFER_HANDLE* buffers;
+    MEMORY_BUDGET_HANDLE memory_budget; /*the budget charged at creation, NULL if none*/
+    size_t memory_budget_charge; /*bytes charged to memory_budget, released when the ref count reaches 0*/
     CONSTBUFFER_HANDLE buffers_memory[];
 } CONSTBUFFER_ARRAY_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(CONSTBUFFER_ARRAY_HANDLE_DATA);
 
-IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create, const CONSTBUFFER_HANDLE*, buffers, uint32_t, buffer_count)
+/*the budget charged by the functions creating a CONSTBUFFER_ARRAY_HANDLE that do not take one, set by constbuffer_array_set_memory_budget*/
+MEMORY_BUDGET_SETTING_DEFINE(constbuffer_array_memory_budget)
+
+/*allocates a CONSTBUFFER_ARRAY_HANDLE_DATA that can hold buffer_count buffers. Before that memory_budget (if not NULL) is charged with the allocation
+and with owned_size, the bytes that the new array keeps alive outside of its allocation (for example the moved array of buffers). The buffers themselves are charged by constbuffer*/
+static CONSTBUFFER_ARRAY_HANDLE constbuffer_array_allocate_with_memory_budget(MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms, uint32_t buffer_count, size_t owned_size)
+{
+    CONSTBUFFER_ARRAY_HANDLE result;
+    size_t charge = sizeof(CONSTBUFFER_ARRAY_HANDLE_DATA) + buffer_count * sizeof(CONSTBUFFER_HANDLE) + owned_size;
+
+    if (
+        (memory_budget != NULL) &&
+        /*Codes_SRS_CONSTBUFFER_ARRAY_02_056: [ If a memory budget was set by constbuffer_array_set_memory_budget then the functions creating a CONSTBUFFER_ARRAY_HANDLE shall charge the memory budget with the bytes of the new CONSTBUFFER_ARRAY_HANDLE by calling memory_budget_charge with the timeout set by constbuffer_array_set_memory_budget. ]*/
+        /*Codes_SRS_CONSTBUFFER_ARRAY_02_062: [ If memory_budget is not NULL then constbuffer_array_create_with_memory_budget shall charge memory_budget (and not the budget set by constbuffer_array_set_memory_budget) with the bytes of the new CONSTBUFFER_ARRAY_HANDLE by calling memory_budget_charge with timeout_ms. ]*/
+        (memory_budget_charge(memory_budget, (int64_t)charge, timeout_ms) != MEMORY_BUDGET_OK)
+        )
+    {
+        /*Codes_SRS_CONSTBUFFER_ARRAY_02_057: [ If memory_budget_charge fails then the functions creating a CONSTBUFFER_ARRAY_HANDLE shall fail and return NULL. ]*/
+        LogError("memory budget %s refused %zu bytes", memory_budget_get_name(memory_budget), charge);
+        result = NULL;
+    }
+    else
+    {
+        result = REFCOUNT_TYPE_CREATE_WITH_EXTRA_SIZE(CONSTBUFFER_ARRAY_HANDLE_DATA, buffer_count * sizeof(CONSTBUFFER_HANDLE));
+        if (result == NULL)
+        {
+            LogError("failure in REFCOUNT_TYPE_CREATE_WITH_EXTRA_SIZE(CONSTBUFFER_ARRAY_HANDLE_DATA, buffer_count=%" PRIu32 " * sizeof(CONSTBUFFER_HANDLE)=%zu)", buffer_count, sizeof(CONSTBUFFER_HANDLE));
+            if (memory_budget != NULL)
+            {
+                memory_budget_release(memory_budget, (int64_t)charge);
+            }
+        }
+        else
+        {
+            result->memory_budget = memory_budget;
+            result->memory_budget_charge = charge;
+        }
+    }
+    return result;
+}
+
+/*same as constbuffer_array_allocate_with_memory_budget, with the budget set by constbuffer_array_set_memory_budget*/
+static CONSTBUFFER_ARRAY_HANDLE constbuffer_array_allocate(uint32_t buffer_count, size_t owned_size)
+{
+    MEMORY_BUDGET_HANDLE memory_budget;
+    uint32_t timeout_ms;
+    constbuffer_array_memory_budget_get(&memory_budget, &timeout_ms);
+    return constbuffer_array_allocate_with_memory_budget(memory_budget, timeout_ms, buffer_count, owned_size);
+}
+
+static CONSTBUFFER_ARRAY_HANDLE constbuffer_array_create_internal(const CONSTBUFFER_HANDLE* buffers, uint32_t buffer_count, MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms)
 {
     CONSTBUFFER_ARRAY_HANDLE result;
 
     if (
         /* Codes_SRS_CONSTBUFFER_ARRAY_01_012: [ If buffers is NULL and buffer_count is not 0, constbuffer_array_create shall fail and return NULL. ]*/
+        /*Codes_SRS_CONSTBUFFER_ARRAY_02_061: [ If buffers is NULL and buffer_count is not 0, constbuffer_array_create_with_memory_budget shall fail and return NULL. ]*/
         (buffers == NULL) && (buffer_count != 0)
         )
     {
@@ -44,10 +100,11 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create
     else
     {
         /* Codes_SRS_CONSTBUFFER_ARRAY_01_009: [ constbuffer_array_create shall allocate memory for a new CONSTBUFFER_ARRAY_HANDLE that can hold buffer_count buffers. ]*/
-        result = REFCOUNT_TYPE_CREATE_WITH_EXTRA_SIZE(CONSTBUFFER_ARRAY_HANDLE_DATA, buffer_count * sizeof(CONSTBUFFER_HANDLE));
+        result = constbuffer_array_allocate_with_memory_budget(memory_budget, timeout_ms, buffer_count, 0);
         if (result == NULL)
         {
             /* Codes_SRS_CONSTBUFFER_ARRAY_01_014: [ If any error occurs, constbuffer_array_create shall fail and return NULL. ]*/
+            /*Codes_SRS_CONSTBUFFER_ARRAY_02_065: [ If any error occurs, constbuffer_array_create_with_memory_budget shall fail and return NULL. ]*/
             LogError("failure in allocating const buffer array");
         }
         else
@@ -61,6 +118,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create
             for (i = 0; i < buffer_count; i++)
             {
                 /* Codes_SRS_CONSTBUFFER_ARRAY_01_010: [ constbuffer_array_create shall clone the buffers in buffers and store them. ]*/
+                /*Codes_SRS_CONSTBUFFER_ARRAY_02_064: [ constbuffer_array_create_with_memory_budget shall clone the buffers in buffers, store them and return a non-NULL handle. ]*/
                 CONSTBUFFER_IncRef(buffers[i]);
                 result->buffers[i] = buffers[i];
             }
@@ -76,12 +134,20 @@ all_ok:
     return result;
 }
 
+IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create, const CONSTBUFFER_HANDLE*, buffers, uint32_t, buffer_count)
+{
+    MEMORY_BUDGET_HANDLE memory_budget;
+    uint32_t timeout_ms;
+    constbuffer_array_memory_budget_get(&memory_budget, &timeout_ms);
+    return constbuffer_array_create_internal(buffers, buffer_count, memory_budget, timeout_ms);
+}
+
 IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create_empty)
 {
     CONSTBUFFER_ARRAY_HANDLE result;
 
     /*Codes_SRS_CONSTBUFFER_ARRAY_02_004: [ constbuffer_array_create_empty shall allocate memory for a new CONSTBUFFER_ARRAY_HANDLE. ]*/
-    result = REFCOUNT_TYPE_CREATE(CONSTBUFFER_ARRAY_HANDLE_DATA); /*implicit 0*/
+    result = constbuffer_array_allocate(0, 0);
     if (result == NULL)
     {
         /*Codes_SRS_CONSTBUFFER_ARRAY_02_001: [ If are any failure is encountered, constbuffer_array_create_empty shall fail and return NULL. ]*/
@@ -122,7 +188,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create
     else
     {
         /* Codes_SRS_CONSTBUFFER_ARRAY_01_029: [ Otherwise, constbuffer_array_create_with_move_buffers shall allocate memory for a new CONSTBUFFER_ARRAY_HANDLE that holds the const buffers in buffers. ]*/
-        result = REFCOUNT_TYPE_CREATE(CONSTBUFFER_ARRAY_HANDLE_DATA); /*implicit 0*/
+        result = constbuffer_array_allocate(0, buffer_count * sizeof(CONSTBUFFER_HANDLE));
         if (result == NULL)
         {
             /* Codes_SRS_CONSTBUFFER_ARRAY_01_030: [ If any error occurs, constbuffer_array_create_with_move_buffers shall fail and return NULL. ]*/
@@ -174,7 +240,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create
     else
     {
         /* Codes_SRS_CONSTBUFFER_ARRAY_42_013: [ constbuffer_array_create_from_buffer_index_and_count shall allocate memory for a new CONSTBUFFER_ARRAY_HANDLE. ]*/
-        result = REFCOUNT_TYPE_CREATE(CONSTBUFFER_ARRAY_HANDLE_DATA); /*implicit 0*/
+        result = constbuffer_array_allocate(0, 0);
         if (result == NULL)
         {
             /* Codes_SRS_CONSTBUFFER_ARRAY_42_016: [ If any error occurs then constbuffer_array_create_from_buffer_index_and_count shall fail and return NULL. ]*/
@@ -255,7 +321,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create
             else
             {
                 /*Codes_SRS_CONSTBUFFER_ARRAY_42_003: [ constbuffer_array_create_from_array_array shall allocate memory to hold all of the CONSTBUFFER_HANDLES from buffer_arrays. ]*/
-                result = REFCOUNT_TYPE_CREATE_WITH_EXTRA_SIZE(CONSTBUFFER_ARRAY_HANDLE_DATA, (total_buffer_count) * sizeof(CONSTBUFFER_HANDLE));
+                result = constbuffer_array_allocate(total_buffer_count, 0);
                 if (result == NULL)
                 {
                     /*Codes_SRS_CONSTBUFFER_ARRAY_42_008: [ If there are any failures then constbuffer_array_create_from_array_array shall fail and return NULL. ]*/
@@ -307,7 +373,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_add_fr
     else
     {
         /*Codes_SRS_CONSTBUFFER_ARRAY_02_042: [ constbuffer_array_add_front shall allocate enough memory to hold all of constbuffer_array_handle existing CONSTBUFFER_HANDLE and constbuffer_handle. ]*/
-        result = REFCOUNT_TYPE_CREATE_WITH_EXTRA_SIZE(CONSTBUFFER_ARRAY_HANDLE_DATA, (constbuffer_array_handle->nBuffers + 1) * sizeof(CONSTBUFFER_HANDLE));
+        result = constbuffer_array_allocate(constbuffer_array_handle->nBuffers + 1, 0);
         if (result == NULL)
         {
             /*Codes_SRS_CONSTBUFFER_ARRAY_02_011: [ If there any failures constbuffer_array_add_front shall fail and return NULL. ]*/
@@ -366,7 +432,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_remove
         else
         {
             /*Codes_SRS_CONSTBUFFER_ARRAY_02_046: [ constbuffer_array_remove_front shall allocate memory to hold all of constbuffer_array_handle CONSTBUFFER_HANDLEs except the front one. ]*/
-            result = REFCOUNT_TYPE_CREATE_WITH_EXTRA_SIZE(CONSTBUFFER_ARRAY_HANDLE_DATA, (constbuffer_array_handle->nBuffers - 1) * sizeof(CONSTBUFFER_HANDLE));
+            result = constbuffer_array_allocate(constbuffer_array_handle->nBuffers - 1, 0);
             if (result == NULL)
             {
                 /*Codes_SRS_CONSTBUFFER_ARRAY_02_036: [ If there are any failures then constbuffer_array_remove_front shall fail and return NULL. ]*/
@@ -414,7 +480,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, int, constbuffer_array_get_buffer_count, CONSTBUFF
         (buffer_count == NULL)
         )
     {
-        LogError("Invalid arguments: CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p, uint32_t* buffer_count=%p",
+        LogErrorRateLimited("Invalid arguments: CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p, uint32_t* buffer_count=%p",
             constbuffer_array_handle, buffer_count);
         result = MU_FAILURE;
     }
@@ -440,7 +506,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, constbuffer_array_get_buffer,
         (buffer_index >= constbuffer_array_handle->nBuffers)
         )
     {
-        LogError("Invalid arguments: CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p, uint32_t buffer_index=%" PRIu32,
+        LogErrorRateLimited("Invalid arguments: CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p, uint32_t buffer_index=%" PRIu32,
             constbuffer_array_handle, buffer_index);
     }
     else
@@ -469,7 +535,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, const CONSTBUFFER*, constbuffer_array_get_buffer_c
         (buffer_index >= constbuffer_array_handle->nBuffers)
         )
     {
-        LogError("Invalid arguments: CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p, uint32_t buffer_index=%" PRIu32,
+        LogErrorRateLimited("Invalid arguments: CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p, uint32_t buffer_index=%" PRIu32,
             constbuffer_array_handle, buffer_index);
         result = NULL;
     }
@@ -487,7 +553,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, void, constbuffer_array_inc_ref, CONSTBUFFER_ARRAY
     if (constbuffer_array_handle == NULL)
     {
         /* Codes_SRS_CONSTBUFFER_ARRAY_01_017: [ If constbuffer_array_handle is NULL then constbuffer_array_inc_ref shall return. ]*/
-        LogError("invalid argument CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p", constbuffer_array_handle);
+        LogErrorRateLimited("invalid argument CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p", constbuffer_array_handle);
     }
     else
     {
@@ -501,7 +567,7 @@ IMPLEMENT_MOCKABLE_FUNCTION(, void, constbuffer_array_dec_ref, CONSTBUFFER_ARRAY
     if (constbuffer_array_handle == NULL)
     {
         /*Codes_SRS_CONSTBUFFER_ARRAY_02_039: [ If constbuffer_array_handle is NULL then constbuffer_array_dec_ref shall return. ]*/
-        LogError("invalid argument CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p", constbuffer_array_handle);
+        LogErrorRateLimited("invalid argument CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle=%p", constbuffer_array_handle);
     }
     else
     {
@@ -523,6 +589,12 @@ IMPLEMENT_MOCKABLE_FUNCTION(, void, constbuffer_array_dec_ref, CONSTBUFFER_ARRAY
                 constbuffer_array_handle->custom_free(constbuffer_array_handle->custom_free_context);
             }
 
+            /*Codes_SRS_CONSTBUFFER_ARRAY_02_058: [ If the reference count reaches 0 and the CONSTBUFFER_ARRAY_HANDLE was charged to a memory budget, constbuffer_array_dec_ref shall give back the charged bytes by calling memory_budget_release. ]*/
+            if (constbuffer_array_handle->memory_budget != NULL)
+            {
+                memory_budget_release(constbuffer_array_handle->memory_budget, (int64_t)constbuffer_array_handle->memory_budget_charge);
+            }
+
             REFCOUNT_TYPE_DESTROY(CONSTBUFFER_ARRAY_HANDLE_DATA, constbuffer_array_handle);
         }
     }
@@ -659,3 +731,16 @@ IMPLEMENT_MOCKABLE_FUNCTION(, bool, CONSTBUFFER_ARRAY_HANDLE_contain_same, CONST
     }
     return result;
 }
+
+IMPLEMENT_MOCKABLE_FUNCTION(, void, constbuffer_array_set_memory_budget, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms)
+{
+    /*Codes_SRS_CONSTBUFFER_ARRAY_02_059: [ constbuffer_array_set_memory_budget shall store memory_budget and timeout_ms to be used by all the CONSTBUFFER_ARRAY_HANDLEs created afterwards. ]*/
+    /*Codes_SRS_CONSTBUFFER_ARRAY_02_060: [ If memory_budget is NULL then the CONSTBUFFER_ARRAY_HANDLEs created afterwards shall not be charged to any memory budget. ]*/
+    constbuffer_array_memory_budget_set(memory_budget, timeout_ms);
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, CONSTBUFFER_ARRAY_HANDLE, constbuffer_array_create_with_memory_budget, const CONSTBUFFER_HANDLE*, buffers, uint32_t, buffer_count, MEMORY_BUDGET_HANDLE, memory_budget, uint32_t, timeout_ms)
+{
+    /*Codes_SRS_CONSTBUFFER_ARRAY_02_063: [ If memory_budget is NULL then constbuffer_array_create_with_memory_budget shall not charge any memory budget. ]*/
+    return constbuffer_array_create_internal(buffers, buffer_count, memory_budget, timeout_ms);
+}
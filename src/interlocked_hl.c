@@ -8,156 +8,1128 @@
 
 #include "azure_c_pal/interlocked.h"
 #include "azure_c_pal/sync.h"
+#include "azure_c_util/processor_index.h"
 #include "azure_c_util/interlocked_hl.h"
 
+#ifdef _MSC_VER
+#include "windows.h"
+#endif
+
 MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES)
 
-IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_Add64WithCeiling, int64_t volatile_atomic*, Addend, int64_t, Ceiling, int64_t, Value, int64_t*, originalAddend)
+static volatile_atomic int32_t interlocked_hl_max_wait_spin_count = INTERLOCKED_HL_DEFAULT_WAIT_SPIN_COUNT;
+
+#define INTERLOCKED_HL_CACHE_LINE_SIZE 64
+
+#ifdef _MSC_VER
+#define INTERLOCKED_HL_CACHE_ALIGNED __declspec(align(64))
+#else
+#define INTERLOCKED_HL_CACHE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+/*contention counters of one processor, see InterlockedHL_GetStatistics. They are only written by threads whose compare exchange already failed, and the threads
+that fail at the same time on different processors do not share the cache line of the counters they increment*/
+typedef struct INTERLOCKED_HL_STATISTICS_SLOT_TAG
+{
+    volatile_atomic int64_t cas_retries;
+    volatile_atomic int64_t backoff_pauses;
+    uint8_t padding[INTERLOCKED_HL_CACHE_LINE_SIZE - 2 * sizeof(int64_t)]; /*every slot has its own cache line*/
+}INTERLOCKED_HL_STATISTICS_SLOT;
+
+static INTERLOCKED_HL_CACHE_ALIGNED INTERLOCKED_HL_STATISTICS_SLOT interlocked_hl_statistics_slots[INTERLOCKED_HL_STATISTICS_SLOT_COUNT];
+
+/*returns the statistics slot of the processor executing the calling thread. The thread can migrate meanwhile, then it only shares the slot for one increment*/
+static INTERLOCKED_HL_STATISTICS_SLOT* interlocked_hl_get_statistics_slot(void)
+{
+    return &interlocked_hl_statistics_slots[processor_index_get_current() % INTERLOCKED_HL_STATISTICS_SLOT_COUNT];
+}
+
+/*a cell is a generation counter that the 64 bit updaters increment after changing the value when the cell has sleeping waiters. The waiters of all the 64 bit values that hash to the cell sleep on it.
+The cell also has the spin budget of the waits on all the (32 and 64 bit) values that hash to it, so a long wait on one address does not shorten the spin of the waits on unrelated addresses*/
+typedef struct INTERLOCKED_HL_WAIT_CELL_TAG
+{
+    volatile_atomic int32_t generation;
+    volatile_atomic int32_t waiter_count; /*number of threads about to sleep or sleeping on generation*/
+    volatile_atomic int32_t spin_budget_deficit; /*the spin budget is the maximum spin count minus this, so the zero initialized cells start at the maximum*/
+    uint8_t padding[INTERLOCKED_HL_CACHE_LINE_SIZE - 3 * sizeof(int32_t)]; /*every cell has its own cache line*/
+}INTERLOCKED_HL_WAIT_CELL;
+
+static INTERLOCKED_HL_CACHE_ALIGNED INTERLOCKED_HL_WAIT_CELL interlocked_hl_wait_cells[INTERLOCKED_HL_WAIT_CELL_COUNT];
+
+/*plain loads with acquire semantics. The readers of a seqlock use them instead of interlocked_add(address, 0) because they shall not write the cache line of the sequence*/
+static int32_t interlocked_hl_load_acquire(int32_t volatile_atomic* address)
+{
+#if defined(_MSC_VER)
+    return ReadAcquire((LONG const volatile*)address);
+#else
+    return __atomic_load_n(address, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/*a sequentially consistent load that does not write the cache line. Used right after an interlocked update of another variable (a full barrier), so the load is not moved before the update*/
+static int32_t interlocked_hl_load_seq_cst(int32_t volatile_atomic* address)
+{
+#if defined(_MSC_VER)
+    return ReadAcquire((LONG const volatile*)address);
+#else
+    return __atomic_load_n(address, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*the spin budget is only a hint, so it is read and written with relaxed atomic accesses: they are as cheap as plain accesses (no interlocked operation on the cache line of the cell) and a lost update only makes the next wait spin a bit more or a bit less*/
+static int32_t interlocked_hl_load_relaxed(int32_t volatile_atomic* address)
+{
+#if defined(_MSC_VER)
+    return ReadNoFence((LONG const volatile*)address);
+#else
+    return __atomic_load_n(address, __ATOMIC_RELAXED);
+#endif
+}
+
+static void interlocked_hl_store_relaxed(int32_t volatile_atomic* address, int32_t value)
+{
+#if defined(_MSC_VER)
+    WriteNoFence((LONG volatile*)address, value);
+#else
+    __atomic_store_n(address, value, __ATOMIC_RELAXED);
+#endif
+}
+
+static void interlocked_hl_fence_acquire(void)
+{
+#if defined(_MSC_VER)
+    MemoryBarrier();
+#else
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+static void interlocked_hl_cpu_pause(void)
+{
+#if defined(_MSC_VER)
+    YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#else
+    /*no pause instruction, just spin*/
+#endif
+}
+
+static INTERLOCKED_HL_WAIT_CELL* interlocked_hl_get_wait_cell(const volatile void* address)
+{
+    /*the low 3 bits are always 0 for an aligned int64_t (and neighbouring int32_t values are usually waited on in the same way), the xor brings the bits above the cell index into the hash*/
+    uintptr_t hash = (uintptr_t)address >> 3;
+    hash ^= hash >> 8;
+    hash ^= hash >> 16;
+    return &interlocked_hl_wait_cells[hash % INTERLOCKED_HL_WAIT_CELL_COUNT];
+}
+
+/*called after the 64 bit value at address was changed by an interlocked operation. The waiters increment the waiter count of the cell before reading the generation and the value for the last time and the updaters change the value before reading the waiter count,
+so either the updater sees the waiter (and wakes it) or the waiter sees the new value (and does not sleep). When nobody waits the updater does not write the cell*/
+static void interlocked_hl_wake_cell(int64_t volatile_atomic* address)
+{
+    INTERLOCKED_HL_WAIT_CELL* cell = interlocked_hl_get_wait_cell(address);
+    if (interlocked_hl_load_seq_cst(&cell->waiter_count) != 0)
+    {
+        /*the cell is shared with other addresses, so all its waiters are woken up (a single wake could go to a waiter of another address). The waiters of other addresses go back to sleep*/
+        (void)interlocked_increment(&cell->generation);
+        wake_by_address_all(&cell->generation);
+    }
+}
+
+/*returns how many times a wait on an address of cell spins*/
+static int32_t interlocked_hl_get_spin_budget(INTERLOCKED_HL_WAIT_CELL* cell, int32_t max_spin_count)
+{
+    int32_t budget = max_spin_count - interlocked_hl_load_relaxed(&cell->spin_budget_deficit);
+    if (budget < 0)
+    {
+        /*the maximum was lowered by InterlockedHL_SetWaitSpinCount while this wait started*/
+        budget = 0;
+    }
+    return budget;
+}
+
+/*A wait that ends after k spins moves the budget towards 2*k, a wait that exhausts the budget (and goes to wait_on_address) shrinks the budget by 1/8.
+The budget never goes under 1/8 of the maximum, so waits that became short again are eventually noticed*/
+static void interlocked_hl_update_spin_budget(INTERLOCKED_HL_WAIT_CELL* cell, int32_t max_spin_count, int32_t budget, int32_t spins, bool succeeded)
+{
+    int32_t new_budget = succeeded ? (budget + (2 * spins - budget) / 8) : (budget - budget / 8);
+    if (new_budget < max_spin_count / 8)
+    {
+        new_budget = max_spin_count / 8;
+    }
+    if (new_budget > max_spin_count)
+    {
+        new_budget = max_spin_count;
+    }
+    interlocked_hl_store_relaxed(&cell->spin_budget_deficit, max_spin_count - new_budget);
+}
+
+/*spins until condition is true for the value at address or until the spin budget of the wait cell of address is exhausted. On success current_value is the value that satisfied the condition*/
+static bool interlocked_hl_spin(int32_t volatile_atomic* address, INTERLOCKED_HL_WAIT_PREDICATE condition, void* context, int32_t* current_value)
+{
+    bool result = false;
+    INTERLOCKED_HL_WAIT_CELL* cell = interlocked_hl_get_wait_cell(address);
+    int32_t max_spin_count = interlocked_hl_load_relaxed(&interlocked_hl_max_wait_spin_count);
+    int32_t budget = interlocked_hl_get_spin_budget(cell, max_spin_count);
+    int32_t spins;
+
+    for (spins = 1; spins <= budget; spins++)
+    {
+        interlocked_hl_cpu_pause();
+
+        /*plain read: spinning on an interlocked operation would take the cache line away from the thread that is about to write it*/
+        if (condition(*address, context))
+        {
+            *current_value = interlocked_add(address, 0);
+            if (condition(*current_value, context))
+            {
+                result = true;
+                break;
+            }
+        }
+    }
+
+    interlocked_hl_update_spin_budget(cell, max_spin_count, budget, spins, result);
+
+    return result;
+}
+
+/*the same as interlocked_hl_spin, for the 64 bit waits: spins until (value at address == value) == wait_for_equal*/
+static bool interlocked_hl_spin_64(int64_t volatile_atomic* address, int64_t value, bool wait_for_equal)
+{
+    bool result = false;
+    INTERLOCKED_HL_WAIT_CELL* cell = interlocked_hl_get_wait_cell(address);
+    int32_t max_spin_count = interlocked_hl_load_relaxed(&interlocked_hl_max_wait_spin_count);
+    int32_t budget = interlocked_hl_get_spin_budget(cell, max_spin_count);
+    int32_t spins;
+
+    for (spins = 1; spins <= budget; spins++)
+    {
+        interlocked_hl_cpu_pause();
+
+        /*plain read (that might tear on 32 bit platforms), the value is read again with interlocked_add_64 before it is trusted*/
+        if ((*address == value) == wait_for_equal)
+        {
+            if ((interlocked_add_64(address, 0) == value) == wait_for_equal)
+            {
+                result = true;
+                break;
+            }
+        }
+    }
+
+    interlocked_hl_update_spin_budget(cell, max_spin_count, budget, spins, result);
+
+    return result;
+}
+
+static bool interlocked_hl_is_equal(int32_t current_value, void* context)
+{
+    return current_value == *(int32_t*)context;
+}
+
+static bool interlocked_hl_is_not_equal(int32_t current_value, void* context)
+{
+    return current_value != *(int32_t*)context;
+}
+
+static bool interlocked_hl_is_less_than(int32_t current_value, void* context)
+{
+    return current_value < *(int32_t*)context;
+}
+
+typedef struct INTERLOCKED_HL_MASK_TAG
+{
+    int32_t mask;
+    int32_t expected;
+}INTERLOCKED_HL_MASK;
+
+static bool interlocked_hl_matches_mask(int32_t current_value, void* context)
+{
+    INTERLOCKED_HL_MASK* mask = (INTERLOCKED_HL_MASK*)context;
+    return (current_value & mask->mask) == mask->expected;
+}
+
+/*waits until condition is true for the value at address: checks, spins, and then calls wait_on_address with the last value that did not satisfy the condition until it does.
+wait_on_address returns when the value is not the one passed (also spuriously), so the condition is always checked again*/
+static INTERLOCKED_HL_RESULT interlocked_hl_wait_for_condition(int32_t volatile_atomic* address, INTERLOCKED_HL_WAIT_PREDICATE condition, void* context, uint32_t milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    int32_t current_value = interlocked_add(address, 0);
+    if (condition(current_value, context))
+    {
+        result = INTERLOCKED_HL_OK;
+    }
+    else if (interlocked_hl_spin(address, condition, context, &current_value))
+    {
+        result = INTERLOCKED_HL_OK;
+    }
+    else
+    {
+        do
+        {
+            if (!wait_on_address(address, current_value, milliseconds))
+            {
+                LogError("failure in wait_on_address(address=%p, current_value=%" PRId32 ", milliseconds=%" PRIu32 ")",
+                    address, current_value, milliseconds);
+                result = INTERLOCKED_HL_ERROR;
+                break;
+            }
+
+            current_value = interlocked_add(address, 0);
+            if (condition(current_value, context))
+            {
+                result = INTERLOCKED_HL_OK;
+                break;
+            }
+        } while (1);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_Add64WithCeiling, int64_t volatile_atomic*, Addend, int64_t, Ceiling, int64_t, Value, int64_t*, originalAddend)
+{
+    INTERLOCKED_HL_RESULT result;
+    /*Codes_SRS_INTERLOCKED_HL_02_001: [ If Addend is NULL then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    /*Codes_SRS_INTERLOCKED_HL_02_006: [ If originalAddend is NULL then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    if (
+        (Addend == NULL) ||
+        (originalAddend == NULL)
+        )
+    {
+        LogError("invalid arguments int64_t volatile_atomic* Addend=%p, int64_t Ceiling=%" PRId64 ", int64_t Value=%" PRId64 ", int64_t* originalAddend=%p",
+            Addend, Ceiling, Value, originalAddend);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+        while(1)
+        {
+            /*checking if Addend + Value is representable*/
+            int64_t addend_copy;
+            int64_t expected_operation_result;
+
+            addend_copy = interlocked_add_64(Addend, 0);
+
+            /*Codes_SRS_INTERLOCKED_HL_02_003: [ If Addend + Value would overflow then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
+            if (
+                ((addend_copy >= 0) && (Value > INT64_MAX - addend_copy)) ||
+                ((addend_copy < 0) && (Value < INT64_MIN - addend_copy))
+                )
+            {
+                /*Codes_SRS_INTERLOCKED_HL_02_002: [ If Addend + Value would underflow then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
+                /*would overflow*/
+                result = INTERLOCKED_HL_ERROR;
+                break;
+            }
+            else
+            {
+                expected_operation_result = addend_copy + Value;
+                /*Codes_SRS_INTERLOCKED_HL_02_004: [ If Addend + Value would be greater than Ceiling then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
+                if (expected_operation_result > Ceiling)
+                {
+                    result = INTERLOCKED_HL_ERROR;
+                    break;
+                }
+                else
+                {
+                    /*Codes_SRS_INTERLOCKED_HL_02_005: [ Otherwise, InterlockedHL_Add64WithCeiling shall atomically write in Addend the sum of Addend and Value, succeed and return INTERLOCKED_HL_OK. ]*/
+                    if (interlocked_compare_exchange_64(Addend, expected_operation_result, addend_copy) == addend_copy)
+                    {
+                        /*Codes_SRS_INTERLOCKED_HL_02_152: [ If there are threads waiting on the wait cell of Addend then InterlockedHL_Add64WithCeiling shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+                        interlocked_hl_wake_cell(Addend);
+
+                        /*Codes_SRS_INTERLOCKED_HL_02_007: [ In all failure cases InterlockedHL_Add64WithCeiling shall not modify Addend or originalAddend*/
+                        *originalAddend = addend_copy;
+                        result = INTERLOCKED_HL_OK;
+                        break;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_INTERLOCKED_HL_02_150: [ If Addend changed meanwhile then InterlockedHL_Add64WithCeiling shall call InterlockedHL_Backoff and try again. ]*/
+                        (void)InterlockedHL_Backoff(&backoff);
+                        /*go back to while(1)*/
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForValue, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+
+    /* Codes_SRS_INTERLOCKED_HL_01_002: [ If address is NULL, InterlockedHL_WaitForValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    if (address == NULL)
+    {
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /* Codes_SRS_INTERLOCKED_HL_01_003: [ If the value at address is equal to value, InterlockedHL_WaitForValue shall return INTERLOCKED_HL_OK. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_02_032: [ If the value at address is not equal to value, InterlockedHL_WaitForValue shall first spin (executing a pause instruction between reads) for at most the current spin budget waiting for the value at address to be equal to value. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_02_033: [ If the value at address becomes equal to value while spinning then InterlockedHL_WaitForValue shall return INTERLOCKED_HL_OK without calling wait_on_address. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_01_004: [ If the value at address is not equal to value, InterlockedHL_WaitForValue shall wait until the value at address changes in order to compare it again to value by using wait_on_address. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_01_005: [ When waiting for the value at address to change, the milliseconds argument value shall be used as timeout. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_01_007: [ When wait_on_address succeeds, the value at address shall be compared to the target value passed in value by using interlocked_add. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_01_008: [ If the value at address does not match, InterlockedHL_WaitForValue shall issue another call to wait_on_address. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_01_006: [ If wait_on_address fails, InterlockedHL_WaitForValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_condition(address, interlocked_hl_is_equal, &value, milliseconds);
+    }
+
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForNotValue, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+
+    /* Codes_SRS_INTERLOCKED_HL_42_001: [ If address is NULL, InterlockedHL_WaitForNotValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    if (address == NULL)
+    {
+        LogError("invalid arguments int32_t volatile_atomic* address=%p, int32_t value=%" PRId32 ", uint32_t milliseconds=%" PRIu32 "",
+            address, value, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /* Codes_SRS_INTERLOCKED_HL_42_002: [ If the value at address is not equal to value, InterlockedHL_WaitForNotValue shall return INTERLOCKED_HL_OK. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_02_034: [ If the value at address is equal to value, InterlockedHL_WaitForNotValue shall first spin (executing a pause instruction between reads) for at most the current spin budget waiting for the value at address to be different than value. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_02_035: [ If the value at address becomes different than value while spinning then InterlockedHL_WaitForNotValue shall return INTERLOCKED_HL_OK without calling wait_on_address. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_42_003: [ If the value at address is equal to value, InterlockedHL_WaitForNotValue shall wait until the value at address changes in order to compare it again to value by using wait_on_address. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_42_004: [ When waiting for the value at address to change, the milliseconds argument value shall be used as timeout. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_42_005: [ When wait_on_address succeeds, the value at address shall be compared to the target value passed in value by using interlocked_add. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_42_006: [ If the value at address matches, InterlockedHL_WaitForNotValue shall issue another call to wait_on_address. ]*/
+        /* Codes_SRS_INTERLOCKED_HL_42_007: [ If wait_on_address fails, InterlockedHL_WaitForNotValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_condition(address, interlocked_hl_is_not_equal, &value, milliseconds);
+    }
+
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForMask, int32_t volatile_atomic*, address, int32_t, mask, int32_t, expected, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (
+        /*Codes_SRS_INTERLOCKED_HL_02_057: [ If address is NULL then InterlockedHL_WaitForMask shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        (address == NULL) ||
+        /*Codes_SRS_INTERLOCKED_HL_02_058: [ If expected has bits set outside of mask then InterlockedHL_WaitForMask shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        ((expected & ~mask) != 0)
+        )
+    {
+        LogError("invalid arguments int32_t volatile_atomic* address=%p, int32_t mask=%" PRIx32 ", int32_t expected=%" PRIx32 ", uint32_t milliseconds=%" PRIu32 "",
+            address, (uint32_t)mask, (uint32_t)expected, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        INTERLOCKED_HL_MASK mask_and_expected = { mask, expected };
+
+        /*Codes_SRS_INTERLOCKED_HL_02_059: [ If the value at address bitwise and mask is equal to expected then InterlockedHL_WaitForMask shall return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_060: [ Otherwise InterlockedHL_WaitForMask shall spin and then wait with wait_on_address (with milliseconds as timeout) until the value at address bitwise and mask is equal to expected. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_061: [ If wait_on_address fails then InterlockedHL_WaitForMask shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_condition(address, interlocked_hl_matches_mask, &mask_and_expected, milliseconds);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForLessThan, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (address == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_062: [ If address is NULL then InterlockedHL_WaitForLessThan shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments int32_t volatile_atomic* address=%p, int32_t value=%" PRId32 ", uint32_t milliseconds=%" PRIu32 "",
+            address, value, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_063: [ If the value at address is less than value then InterlockedHL_WaitForLessThan shall return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_064: [ Otherwise InterlockedHL_WaitForLessThan shall spin and then wait with wait_on_address (with milliseconds as timeout) until the value at address is less than value. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_065: [ If wait_on_address fails then InterlockedHL_WaitForLessThan shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_condition(address, interlocked_hl_is_less_than, &value, milliseconds);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForPredicate, int32_t volatile_atomic*, address, INTERLOCKED_HL_WAIT_PREDICATE, predicate, void*, context, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (
+        /*Codes_SRS_INTERLOCKED_HL_02_066: [ If address is NULL then InterlockedHL_WaitForPredicate shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        (address == NULL) ||
+        /*Codes_SRS_INTERLOCKED_HL_02_067: [ If predicate is NULL then InterlockedHL_WaitForPredicate shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        (predicate == NULL)
+        )
+    {
+        LogError("invalid arguments int32_t volatile_atomic* address=%p, INTERLOCKED_HL_WAIT_PREDICATE predicate=%p, void* context=%p, uint32_t milliseconds=%" PRIu32 "",
+            address, predicate, context, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_068: [ If predicate(value at address, context) returns true then InterlockedHL_WaitForPredicate shall return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_069: [ Otherwise InterlockedHL_WaitForPredicate shall spin and then wait with wait_on_address (with milliseconds as timeout) until predicate returns true. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_070: [ If wait_on_address fails then InterlockedHL_WaitForPredicate shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_condition(address, predicate, context, milliseconds);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_LatchCountDown, int32_t volatile_atomic*, latch)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (latch == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_071: [ If latch is NULL then InterlockedHL_LatchCountDown shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument int32_t volatile_atomic* latch=%p", latch);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_072: [ InterlockedHL_LatchCountDown shall decrement the value at latch by calling interlocked_decrement. ]*/
+        int32_t new_value = interlocked_decrement(latch);
+        if (new_value < 0)
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_073: [ If the decremented value is less than 0 then InterlockedHL_LatchCountDown shall fail and return INTERLOCKED_HL_ERROR. ]*/
+            LogError("latch=%p counted down too many times, value is now %" PRId32 "", latch, new_value);
+            result = INTERLOCKED_HL_ERROR;
+        }
+        else
+        {
+            if (new_value == 0)
+            {
+                /*Codes_SRS_INTERLOCKED_HL_02_074: [ If the decremented value is 0 then InterlockedHL_LatchCountDown shall call wake_by_address_all on latch. ]*/
+                wake_by_address_all(latch);
+            }
+            /*Codes_SRS_INTERLOCKED_HL_02_075: [ InterlockedHL_LatchCountDown shall succeed and return INTERLOCKED_HL_OK. ]*/
+            result = INTERLOCKED_HL_OK;
+        }
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_LatchWait, int32_t volatile_atomic*, latch, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (latch == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_076: [ If latch is NULL then InterlockedHL_LatchWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments int32_t volatile_atomic* latch=%p, uint32_t milliseconds=%" PRIu32 "",
+            latch, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        int32_t one = 1;
+        /*Codes_SRS_INTERLOCKED_HL_02_077: [ If the value at latch is less than or equal to 0 then InterlockedHL_LatchWait shall return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_078: [ Otherwise InterlockedHL_LatchWait shall spin and then wait with wait_on_address (with milliseconds as timeout) until the value at latch is less than or equal to 0. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_079: [ If wait_on_address fails then InterlockedHL_LatchWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_condition(latch, interlocked_hl_is_less_than, &one, milliseconds);
+    }
+    return result;
+}
+
+#define INTERLOCKED_HL_BARRIER_ARRIVED_MASK 0xFFFF
+#define INTERLOCKED_HL_BARRIER_GENERATION_SHIFT 16
+
+static bool interlocked_hl_barrier_generation_changed(int32_t current_value, void* context)
+{
+    return ((uint32_t)current_value >> INTERLOCKED_HL_BARRIER_GENERATION_SHIFT) != *(uint32_t*)context;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_BarrierArriveAndWait, int32_t volatile_atomic*, barrier, int32_t, parties, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (
+        /*Codes_SRS_INTERLOCKED_HL_02_080: [ If barrier is NULL then InterlockedHL_BarrierArriveAndWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        (barrier == NULL) ||
+        /*Codes_SRS_INTERLOCKED_HL_02_081: [ If parties is less than 1 or greater than INTERLOCKED_HL_BARRIER_MAX_PARTIES then InterlockedHL_BarrierArriveAndWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        (parties < 1) ||
+        (parties > INTERLOCKED_HL_BARRIER_MAX_PARTIES)
+        )
+    {
+        LogError("invalid arguments int32_t volatile_atomic* barrier=%p, int32_t parties=%" PRId32 ", uint32_t milliseconds=%" PRIu32 "",
+            barrier, parties, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_082: [ InterlockedHL_BarrierArriveAndWait shall arrive at the barrier by adding 1 to the value at barrier with interlocked_add. ]*/
+        int32_t arrived_value = interlocked_add(barrier, 1);
+        int32_t arrived = arrived_value & INTERLOCKED_HL_BARRIER_ARRIVED_MASK;
+        uint32_t generation = (uint32_t)arrived_value >> INTERLOCKED_HL_BARRIER_GENERATION_SHIFT;
+
+        if (arrived > parties)
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_083: [ If more than parties parties arrived in the current generation then InterlockedHL_BarrierArriveAndWait shall undo its arrival by adding -1 to the value at barrier with interlocked_add, fail and return INTERLOCKED_HL_ERROR. ]*/
+            /*the arrival is not counted, otherwise the next generation would start with it and release its parties before all of them arrived*/
+            (void)interlocked_add(barrier, -1);
+            LogError("barrier=%p has %" PRId32 " arrived parties in generation %" PRIu32 ", more than parties=%" PRId32 "",
+                barrier, arrived, generation, parties);
+            result = INTERLOCKED_HL_ERROR;
+        }
+        else if (arrived == parties)
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_084: [ If the caller is the last party to arrive then InterlockedHL_BarrierArriveAndWait shall reset the number of arrived parties to 0 and increment the generation with one interlocked_add, call wake_by_address_all on barrier, succeed and return INTERLOCKED_HL_OK. ]*/
+            (void)interlocked_add(barrier, (1 << INTERLOCKED_HL_BARRIER_GENERATION_SHIFT) - parties);
+            wake_by_address_all(barrier);
+            result = INTERLOCKED_HL_OK;
+        }
+        else
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_085: [ Otherwise InterlockedHL_BarrierArriveAndWait shall spin and then wait with wait_on_address (with milliseconds as timeout) until the generation of the barrier changes and return INTERLOCKED_HL_OK. ]*/
+            /*Codes_SRS_INTERLOCKED_HL_02_086: [ If wait_on_address fails then InterlockedHL_BarrierArriveAndWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+            result = interlocked_hl_wait_for_condition(barrier, interlocked_hl_barrier_generation_changed, &generation, milliseconds);
+        }
+    }
+    return result;
+}
+
+#define INTERLOCKED_HL_MUTEX_LOCKED 1
+#define INTERLOCKED_HL_MUTEX_WAITER 2
+
+static bool interlocked_hl_mutex_is_unlocked(int32_t current_value, void* context)
+{
+    (void)context;
+    return (current_value & INTERLOCKED_HL_MUTEX_LOCKED) == 0;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_MutexLock, int32_t volatile_atomic*, mutex)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (mutex == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_087: [ If mutex is NULL then InterlockedHL_MutexLock shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument int32_t volatile_atomic* mutex=%p", mutex);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        int32_t current_value;
+        /*Codes_SRS_INTERLOCKED_HL_02_088: [ InterlockedHL_MutexLock shall try to own the mutex by calling interlocked_compare_exchange to change the value at mutex from 0 to 1. ]*/
+        if (interlocked_compare_exchange(mutex, INTERLOCKED_HL_MUTEX_LOCKED, 0) == 0)
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_089: [ If the mutex was owned then InterlockedHL_MutexLock shall succeed and return INTERLOCKED_HL_OK. ]*/
+            result = INTERLOCKED_HL_OK;
+        }
+        /*Codes_SRS_INTERLOCKED_HL_02_090: [ Otherwise InterlockedHL_MutexLock shall spin until the mutex is not owned and try to own it with interlocked_compare_exchange. ]*/
+        else if (
+            interlocked_hl_spin(mutex, interlocked_hl_mutex_is_unlocked, NULL, &current_value) &&
+            (interlocked_compare_exchange(mutex, current_value | INTERLOCKED_HL_MUTEX_LOCKED, current_value) == current_value)
+            )
+        {
+            result = INTERLOCKED_HL_OK;
+        }
+        else
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_091: [ If the mutex is still owned then InterlockedHL_MutexLock shall register as waiter by adding 2 to the value at mutex. ]*/
+            (void)interlocked_add(mutex, INTERLOCKED_HL_MUTEX_WAITER);
+            do
+            {
+                current_value = interlocked_add(mutex, 0);
+                if ((current_value & INTERLOCKED_HL_MUTEX_LOCKED) == 0)
+                {
+                    /*Codes_SRS_INTERLOCKED_HL_02_092: [ When the mutex is not owned InterlockedHL_MutexLock shall own it and unregister as waiter with one interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+                    if (interlocked_compare_exchange(mutex, (current_value | INTERLOCKED_HL_MUTEX_LOCKED) - INTERLOCKED_HL_MUTEX_WAITER, current_value) == current_value)
+                    {
+                        result = INTERLOCKED_HL_OK;
+                        break;
+                    }
+                    /*another thread owned the mutex meanwhile, try again*/
+                }
+                /*Codes_SRS_INTERLOCKED_HL_02_093: [ While the mutex is owned InterlockedHL_MutexLock shall wait with wait_on_address (with UINT32_MAX as timeout). ]*/
+                else if (!wait_on_address(mutex, current_value, UINT32_MAX))
+                {
+                    /*Codes_SRS_INTERLOCKED_HL_02_094: [ If wait_on_address fails then InterlockedHL_MutexLock shall unregister as waiter, fail and return INTERLOCKED_HL_ERROR. ]*/
+                    LogError("failure in wait_on_address(mutex=%p, current_value=%" PRId32 ", UINT32_MAX)", mutex, current_value);
+                    (void)interlocked_add(mutex, -INTERLOCKED_HL_MUTEX_WAITER);
+                    result = INTERLOCKED_HL_ERROR;
+                    break;
+                }
+                else
+                {
+                    /*woken up (or spuriously), look again*/
+                }
+            } while (1);
+        }
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_MutexUnlock, int32_t volatile_atomic*, mutex)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (mutex == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_095: [ If mutex is NULL then InterlockedHL_MutexUnlock shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument int32_t volatile_atomic* mutex=%p", mutex);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_096: [ InterlockedHL_MutexUnlock shall release the mutex by subtracting 1 from the value at mutex with interlocked_add. ]*/
+        int32_t new_value = interlocked_add(mutex, -INTERLOCKED_HL_MUTEX_LOCKED);
+        if ((new_value & INTERLOCKED_HL_MUTEX_LOCKED) != 0)
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_097: [ If the mutex was not owned then InterlockedHL_MutexUnlock shall add 1 back to the value at mutex, fail and return INTERLOCKED_HL_ERROR. ]*/
+            (void)interlocked_add(mutex, INTERLOCKED_HL_MUTEX_LOCKED);
+            LogError("mutex=%p was not locked", mutex);
+            result = INTERLOCKED_HL_ERROR;
+        }
+        else
+        {
+            if (new_value != 0)
+            {
+                /*Codes_SRS_INTERLOCKED_HL_02_098: [ If there are waiters then InterlockedHL_MutexUnlock shall call wake_by_address_single on mutex. ]*/
+                wake_by_address_single(mutex);
+            }
+            /*Codes_SRS_INTERLOCKED_HL_02_099: [ InterlockedHL_MutexUnlock shall succeed and return INTERLOCKED_HL_OK. ]*/
+            result = INTERLOCKED_HL_OK;
+        }
+    }
+    return result;
+}
+
+#define INTERLOCKED_HL_RWLOCK_WRITER            0x40000000
+#define INTERLOCKED_HL_RWLOCK_WRITER_WAITING    0x20000000
+#define INTERLOCKED_HL_RWLOCK_READERS_MASK      0x1FFFFFFF
+
+/*waiter_count holds both the threads sleeping on state (low bits, changed by interlocked_hl_sleep_while_value) and the writers that stopped spinning (high bits), so the lock stays 2 int32_t*/
+#define INTERLOCKED_HL_RWLOCK_SLEEPERS_MASK     0x0000FFFF
+#define INTERLOCKED_HL_RWLOCK_WAITING_WRITER    0x00010000
+
+/*readers do not enter while a writer owns the lock or waits for it, so a stream of readers does not starve the writers*/
+static bool interlocked_hl_rwlock_can_acquire_shared(int32_t current_value, void* context)
+{
+    (void)context;
+    return (current_value & (INTERLOCKED_HL_RWLOCK_WRITER | INTERLOCKED_HL_RWLOCK_WRITER_WAITING)) == 0;
+}
+
+static bool interlocked_hl_rwlock_can_acquire_exclusive(int32_t current_value, void* context)
+{
+    (void)context;
+    return (current_value & ~INTERLOCKED_HL_RWLOCK_WRITER_WAITING) == 0;
+}
+
+/*sleeps on address while it has current_value. The sleeper increments waiter_count before reading address for the last time and the wakers change address before reading waiter_count,
+so either the waker sees the sleeper (and wakes it) or the sleeper sees the new value (and does not sleep)*/
+static bool interlocked_hl_sleep_while_value(int32_t volatile_atomic* address, int32_t volatile_atomic* waiter_count, int32_t current_value)
+{
+    bool result = true;
+    (void)interlocked_increment(waiter_count);
+    if (interlocked_add(address, 0) == current_value)
+    {
+        result = wait_on_address(address, current_value, UINT32_MAX);
+    }
+    (void)interlocked_decrement(waiter_count);
+    return result;
+}
+
+static INTERLOCKED_HL_RESULT interlocked_hl_rwlock_acquire(INTERLOCKED_HL_RWLOCK* rwlock, bool exclusive)
+{
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_WAIT_PREDICATE can_acquire = exclusive ? interlocked_hl_rwlock_can_acquire_exclusive : interlocked_hl_rwlock_can_acquire_shared;
+    bool spun = false;
+    bool counted_as_waiting_writer = false;
+    do
+    {
+        int32_t current_value = interlocked_add(&rwlock->state, 0);
+        if (can_acquire(current_value, NULL))
+        {
+            int32_t new_value;
+            if (exclusive)
+            {
+                /*the other waiting writers still need the readers kept out, a writer counted after this read sets the bit again when it reads the new state*/
+                int32_t other_waiting_writers = (interlocked_add(&rwlock->waiter_count, 0) / INTERLOCKED_HL_RWLOCK_WAITING_WRITER) - (counted_as_waiting_writer ? 1 : 0);
+                new_value = INTERLOCKED_HL_RWLOCK_WRITER | ((other_waiting_writers > 0) ? INTERLOCKED_HL_RWLOCK_WRITER_WAITING : 0);
+            }
+            else
+            {
+                new_value = current_value + 1;
+            }
+
+            if (interlocked_compare_exchange(&rwlock->state, new_value, current_value) == current_value)
+            {
+                result = INTERLOCKED_HL_OK;
+                break;
+            }
+        }
+        else if (!spun)
+        {
+            spun = true;
+            if (
+                !interlocked_hl_spin(&rwlock->state, can_acquire, NULL, &current_value) &&
+                exclusive
+                )
+            {
+                /*counted before the state is read again, so the writer that gets the lock first either sees this writer or changes the state this writer reads*/
+                (void)interlocked_add(&rwlock->waiter_count, INTERLOCKED_HL_RWLOCK_WAITING_WRITER);
+                counted_as_waiting_writer = true;
+            }
+        }
+        else if (exclusive && ((current_value & INTERLOCKED_HL_RWLOCK_WRITER_WAITING) == 0))
+        {
+            (void)interlocked_compare_exchange(&rwlock->state, current_value | INTERLOCKED_HL_RWLOCK_WRITER_WAITING, current_value);
+        }
+        else if (!interlocked_hl_sleep_while_value(&rwlock->state, &rwlock->waiter_count, current_value))
+        {
+            LogError("failure in interlocked_hl_sleep_while_value(&rwlock->state=%p, &rwlock->waiter_count=%p, current_value=%" PRIx32 ")", &rwlock->state, &rwlock->waiter_count, (uint32_t)current_value);
+            result = INTERLOCKED_HL_ERROR;
+            break;
+        }
+        else
+        {
+            /*woken up (or spuriously), look again*/
+        }
+    } while (1);
+
+    if (counted_as_waiting_writer)
+    {
+        (void)interlocked_add(&rwlock->waiter_count, -INTERLOCKED_HL_RWLOCK_WAITING_WRITER);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockInit, INTERLOCKED_HL_RWLOCK*, rwlock)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (rwlock == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_100: [ If rwlock is NULL then InterlockedHL_RWLockInit shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_RWLOCK* rwlock=%p", rwlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_101: [ InterlockedHL_RWLockInit shall set the state and the waiter count of rwlock to 0 with interlocked_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+        (void)interlocked_exchange(&rwlock->state, 0);
+        (void)interlocked_exchange(&rwlock->waiter_count, 0);
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockAcquireShared, INTERLOCKED_HL_RWLOCK*, rwlock)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (rwlock == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_102: [ If rwlock is NULL then InterlockedHL_RWLockAcquireShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_RWLOCK* rwlock=%p", rwlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_103: [ If no writer owns or waits for rwlock then InterlockedHL_RWLockAcquireShared shall increment the number of readers with interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_104: [ Otherwise InterlockedHL_RWLockAcquireShared shall spin and then increment the waiter count of rwlock and wait with wait_on_address (with UINT32_MAX as timeout) until no writer owns or waits for rwlock. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_105: [ If wait_on_address fails then InterlockedHL_RWLockAcquireShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_rwlock_acquire(rwlock, false);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockReleaseShared, INTERLOCKED_HL_RWLOCK*, rwlock)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (rwlock == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_106: [ If rwlock is NULL then InterlockedHL_RWLockReleaseShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_RWLOCK* rwlock=%p", rwlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    /*Codes_SRS_INTERLOCKED_HL_02_107: [ If rwlock has no readers then InterlockedHL_RWLockReleaseShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    else if ((rwlock->state & INTERLOCKED_HL_RWLOCK_READERS_MASK) == 0)
+    {
+        LogError("rwlock=%p is not owned by readers, state=%" PRIx32 "", rwlock, (uint32_t)rwlock->state);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_108: [ InterlockedHL_RWLockReleaseShared shall decrement the number of readers with interlocked_decrement. ]*/
+        int32_t new_value = interlocked_decrement(&rwlock->state);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_109: [ If there are no readers left and the number of threads sleeping on rwlock (the low 16 bits of the waiter count) is not 0 then InterlockedHL_RWLockReleaseShared shall call wake_by_address_all on the state of rwlock. ]*/
+        if (
+            ((new_value & INTERLOCKED_HL_RWLOCK_READERS_MASK) == 0) &&
+            ((interlocked_add(&rwlock->waiter_count, 0) & INTERLOCKED_HL_RWLOCK_SLEEPERS_MASK) != 0)
+            )
+        {
+            wake_by_address_all(&rwlock->state);
+        }
+
+        /*Codes_SRS_INTERLOCKED_HL_02_110: [ InterlockedHL_RWLockReleaseShared shall succeed and return INTERLOCKED_HL_OK. ]*/
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockAcquireExclusive, INTERLOCKED_HL_RWLOCK*, rwlock)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (rwlock == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_111: [ If rwlock is NULL then InterlockedHL_RWLockAcquireExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_RWLOCK* rwlock=%p", rwlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_112: [ If rwlock has no readers and no writer then InterlockedHL_RWLockAcquireExclusive shall become the writer with interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_113: [ Otherwise InterlockedHL_RWLockAcquireExclusive shall spin, then add 0x10000 to the waiter count of rwlock (counting itself as a waiting writer), mark that a writer waits (so that no new readers enter), increment the waiter count of rwlock and wait with wait_on_address (with UINT32_MAX as timeout) until rwlock has no readers and no writer, and then subtract 0x10000 from the waiter count. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_156: [ When it becomes the writer, InterlockedHL_RWLockAcquireExclusive shall keep the mark that a writer waits if the number of waiting writers of rwlock (the waiter count read with interlocked_add, divided by 0x10000, not counting the caller) is not 0, and clear it otherwise. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_114: [ If wait_on_address fails then InterlockedHL_RWLockAcquireExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_rwlock_acquire(rwlock, true);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_RWLockReleaseExclusive, INTERLOCKED_HL_RWLOCK*, rwlock)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (rwlock == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_115: [ If rwlock is NULL then InterlockedHL_RWLockReleaseExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_RWLOCK* rwlock=%p", rwlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    /*Codes_SRS_INTERLOCKED_HL_02_116: [ If rwlock is not owned by a writer then InterlockedHL_RWLockReleaseExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    else if ((rwlock->state & INTERLOCKED_HL_RWLOCK_WRITER) == 0)
+    {
+        LogError("rwlock=%p is not owned by a writer, state=%" PRIx32 "", rwlock, (uint32_t)rwlock->state);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_117: [ InterlockedHL_RWLockReleaseExclusive shall clear the writer with interlocked_add. ]*/
+        (void)interlocked_add(&rwlock->state, -INTERLOCKED_HL_RWLOCK_WRITER);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_118: [ If the number of threads sleeping on rwlock (the low 16 bits of the waiter count) is not 0 then InterlockedHL_RWLockReleaseExclusive shall call wake_by_address_all on the state of rwlock. ]*/
+        if ((interlocked_add(&rwlock->waiter_count, 0) & INTERLOCKED_HL_RWLOCK_SLEEPERS_MASK) != 0)
+        {
+            wake_by_address_all(&rwlock->state);
+        }
+
+        /*Codes_SRS_INTERLOCKED_HL_02_119: [ InterlockedHL_RWLockReleaseExclusive shall succeed and return INTERLOCKED_HL_OK. ]*/
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
+static bool interlocked_hl_seqlock_is_even(int32_t current_value, void* context)
+{
+    (void)context;
+    return (current_value & 1) == 0;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockInit, INTERLOCKED_HL_SEQLOCK*, seqlock)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (seqlock == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_120: [ If seqlock is NULL then InterlockedHL_SeqLockInit shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_SEQLOCK* seqlock=%p", seqlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_121: [ InterlockedHL_SeqLockInit shall set the sequence and the waiter count of seqlock to 0 with interlocked_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+        (void)interlocked_exchange(&seqlock->sequence, 0);
+        (void)interlocked_exchange(&seqlock->waiter_count, 0);
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockReadBegin, INTERLOCKED_HL_SEQLOCK*, seqlock, int32_t*, sequence)
 {
     INTERLOCKED_HL_RESULT result;
-    /*Codes_SRS_INTERLOCKED_HL_02_001: [ If Addend is NULL then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
-    /*Codes_SRS_INTERLOCKED_HL_02_006: [ If originalAddend is NULL then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
     if (
-        (Addend == NULL) ||
-        (originalAddend == NULL)
+        /*Codes_SRS_INTERLOCKED_HL_02_122: [ If seqlock is NULL then InterlockedHL_SeqLockReadBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        (seqlock == NULL) ||
+        /*Codes_SRS_INTERLOCKED_HL_02_123: [ If sequence is NULL then InterlockedHL_SeqLockReadBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        (sequence == NULL)
         )
     {
-        LogError("invalid arguments int64_t volatile_atomic* Addend=%p, int64_t Ceiling=%" PRId64 ", int64_t Value=%" PRId64 ", int64_t* originalAddend=%p",
-            Addend, Ceiling, Value, originalAddend);
+        LogError("invalid arguments INTERLOCKED_HL_SEQLOCK* seqlock=%p, int32_t* sequence=%p", seqlock, sequence);
         result = INTERLOCKED_HL_ERROR;
     }
     else
     {
-        while(1)
-        {
-            /*checking if Addend + Value is representable*/
-            int64_t addend_copy;
-            int64_t expected_operation_result;
-
-            addend_copy = interlocked_add_64(Addend, 0);
+        /*Codes_SRS_INTERLOCKED_HL_02_124: [ InterlockedHL_SeqLockReadBegin shall read the sequence of seqlock with a load-acquire (without writing to seqlock). ]*/
+        int32_t current_value = interlocked_hl_load_acquire(&seqlock->sequence);
 
-            /*Codes_SRS_INTERLOCKED_HL_02_003: [ If Addend + Value would overflow then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
-            if (
-                ((addend_copy >= 0) && (Value > INT64_MAX - addend_copy)) ||
-                ((addend_copy < 0) && (Value < INT64_MIN - addend_copy))
-                )
-            {
-                /*Codes_SRS_INTERLOCKED_HL_02_002: [ If Addend + Value would underflow then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
-                /*would overflow*/
-                result = INTERLOCKED_HL_ERROR;
-                break;
-            }
-            else
+        /*Codes_SRS_INTERLOCKED_HL_02_125: [ If the sequence is even then InterlockedHL_SeqLockReadBegin shall write it in sequence, succeed and return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_126: [ Otherwise InterlockedHL_SeqLockReadBegin shall spin and then increment the waiter count of seqlock and wait with wait_on_address (with UINT32_MAX as timeout) until the sequence is even. ]*/
+        if (
+            interlocked_hl_seqlock_is_even(current_value, NULL) ||
+            interlocked_hl_spin(&seqlock->sequence, interlocked_hl_seqlock_is_even, NULL, &current_value)
+            )
+        {
+            *sequence = current_value;
+            result = INTERLOCKED_HL_OK;
+        }
+        else
+        {
+            do
             {
-                expected_operation_result = addend_copy + Value;
-                /*Codes_SRS_INTERLOCKED_HL_02_004: [ If Addend + Value would be greater than Ceiling then InterlockedHL_Add64WithCeiling shall fail and return INTERLOCKED_HL_ERROR. ]*/
-                if (expected_operation_result > Ceiling)
+                if (!interlocked_hl_sleep_while_value(&seqlock->sequence, &seqlock->waiter_count, current_value))
                 {
+                    /*Codes_SRS_INTERLOCKED_HL_02_127: [ If wait_on_address fails then InterlockedHL_SeqLockReadBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+                    LogError("failure in interlocked_hl_sleep_while_value(&seqlock->sequence=%p, &seqlock->waiter_count=%p, current_value=%" PRId32 ")", &seqlock->sequence, &seqlock->waiter_count, current_value);
                     result = INTERLOCKED_HL_ERROR;
                     break;
                 }
-                else
+
+                current_value = interlocked_hl_load_acquire(&seqlock->sequence);
+                if (interlocked_hl_seqlock_is_even(current_value, NULL))
                 {
-                    /*Codes_SRS_INTERLOCKED_HL_02_005: [ Otherwise, InterlockedHL_Add64WithCeiling shall atomically write in Addend the sum of Addend and Value, succeed and return INTERLOCKED_HL_OK. ]*/
-                    if (interlocked_compare_exchange_64(Addend, expected_operation_result, addend_copy) == addend_copy)
-                    {
-                        /*Codes_SRS_INTERLOCKED_HL_02_007: [ In all failure cases InterlockedHL_Add64WithCeiling shall not modify Addend or originalAddend*/
-                        *originalAddend = addend_copy;
-                        result = INTERLOCKED_HL_OK;
-                        break;
-                    }
-                    else
-                    {
-                        /*go back to while(1)*/
-                    }
+                    *sequence = current_value;
+                    result = INTERLOCKED_HL_OK;
+                    break;
                 }
-            }
+            } while (1);
         }
     }
     return result;
 }
 
-IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForValue, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockReadRetry, INTERLOCKED_HL_SEQLOCK*, seqlock, int32_t, sequence)
 {
     INTERLOCKED_HL_RESULT result;
-
-    /* Codes_SRS_INTERLOCKED_HL_01_002: [ If address is NULL, InterlockedHL_WaitForValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
-    if (address == NULL)
+    if (seqlock == NULL)
     {
+        /*Codes_SRS_INTERLOCKED_HL_02_128: [ If seqlock is NULL then InterlockedHL_SeqLockReadRetry shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments INTERLOCKED_HL_SEQLOCK* seqlock=%p, int32_t sequence=%" PRId32 "", seqlock, sequence);
         result = INTERLOCKED_HL_ERROR;
     }
     else
     {
-        int32_t current_value;
+        /*Codes_SRS_INTERLOCKED_HL_02_129: [ InterlockedHL_SeqLockReadRetry shall issue an acquire fence (so that the reads of the data are not moved after it) and read the sequence of seqlock (without writing to seqlock). ]*/
+        interlocked_hl_fence_acquire();
+        if (seqlock->sequence == sequence)
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_130: [ If the sequence is equal to sequence then InterlockedHL_SeqLockReadRetry shall return INTERLOCKED_HL_OK. ]*/
+            result = INTERLOCKED_HL_OK;
+        }
+        else
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_131: [ Otherwise InterlockedHL_SeqLockReadRetry shall return INTERLOCKED_HL_CHANGED. ]*/
+            result = INTERLOCKED_HL_CHANGED;
+        }
+    }
+    return result;
+}
 
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockWriteBegin, INTERLOCKED_HL_SEQLOCK*, seqlock)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (seqlock == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_132: [ If seqlock is NULL then InterlockedHL_SeqLockWriteBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_SEQLOCK* seqlock=%p", seqlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        bool spun = false;
         do
         {
-            /* Codes_SRS_INTERLOCKED_HL_01_007: [ When wait_on_address succeeds, the value at address shall be compared to the target value passed in value by using interlocked_add. ]*/
-            current_value = interlocked_add(address, 0);
-            if (current_value == value)
+            int32_t current_value = interlocked_add(&seqlock->sequence, 0);
+            if (interlocked_hl_seqlock_is_even(current_value, NULL))
             {
-                /* Codes_SRS_INTERLOCKED_HL_01_003: [ If the value at address is equal to value, InterlockedHL_WaitForValue shall return INTERLOCKED_HL_OK. ]*/
-                result = INTERLOCKED_HL_OK;
-                break;
+                /*Codes_SRS_INTERLOCKED_HL_02_133: [ If the sequence is even then InterlockedHL_SeqLockWriteBegin shall make it odd by incrementing it with interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+                if (interlocked_compare_exchange(&seqlock->sequence, current_value + 1, current_value) == current_value)
+                {
+                    result = INTERLOCKED_HL_OK;
+                    break;
+                }
+                /*another writer started meanwhile, look again*/
             }
-
-            /* Codes_SRS_INTERLOCKED_HL_01_008: [ If the value at address does not match, InterlockedHL_WaitForValue shall issue another call to wait_on_address. ]*/
-
-            /* Codes_SRS_INTERLOCKED_HL_01_004: [ If the value at address is not equal to value, InterlockedHL_WaitForValue shall wait until the value at address changes in order to compare it again to value by using wait_on_address. ]*/
-            /* Codes_SRS_INTERLOCKED_HL_01_005: [ When waiting for the value at address to change, the milliseconds argument value shall be used as timeout. ]*/
-            if (!wait_on_address(address, current_value, milliseconds))
+            /*Codes_SRS_INTERLOCKED_HL_02_134: [ Otherwise InterlockedHL_SeqLockWriteBegin shall spin and then increment the waiter count of seqlock and wait with wait_on_address (with UINT32_MAX as timeout) until the sequence is even. ]*/
+            else if (!spun)
+            {
+                spun = true;
+                (void)interlocked_hl_spin(&seqlock->sequence, interlocked_hl_seqlock_is_even, NULL, &current_value);
+            }
+            else if (!interlocked_hl_sleep_while_value(&seqlock->sequence, &seqlock->waiter_count, current_value))
             {
-                /* Codes_SRS_INTERLOCKED_HL_01_006: [ If wait_on_address fails, InterlockedHL_WaitForValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
+                /*Codes_SRS_INTERLOCKED_HL_02_135: [ If wait_on_address fails then InterlockedHL_SeqLockWriteBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+                LogError("failure in interlocked_hl_sleep_while_value(&seqlock->sequence=%p, &seqlock->waiter_count=%p, current_value=%" PRId32 ")", &seqlock->sequence, &seqlock->waiter_count, current_value);
                 result = INTERLOCKED_HL_ERROR;
                 break;
             }
+            else
+            {
+                /*woken up (or spuriously), look again*/
+            }
         } while (1);
     }
-
     return result;
 }
 
-IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForNotValue, int32_t volatile_atomic*, address, int32_t, value, uint32_t, milliseconds)
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SeqLockWriteEnd, INTERLOCKED_HL_SEQLOCK*, seqlock)
 {
     INTERLOCKED_HL_RESULT result;
-
-    /* Codes_SRS_INTERLOCKED_HL_42_001: [ If address is NULL, InterlockedHL_WaitForNotValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
-    if (address == NULL)
+    if (seqlock == NULL)
     {
-        LogError("invalid arguments int32_t volatile_atomic* address=%p, int32_t value=%" PRId32 ", uint32_t milliseconds=%" PRIu32 "",
-            address, value, milliseconds);
+        /*Codes_SRS_INTERLOCKED_HL_02_136: [ If seqlock is NULL then InterlockedHL_SeqLockWriteEnd shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid argument INTERLOCKED_HL_SEQLOCK* seqlock=%p", seqlock);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    /*Codes_SRS_INTERLOCKED_HL_02_137: [ If the sequence of seqlock is even (there is no write in progress) then InterlockedHL_SeqLockWriteEnd shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    else if (interlocked_hl_seqlock_is_even(seqlock->sequence, NULL))
+    {
+        LogError("seqlock=%p has no write in progress, sequence=%" PRId32 "", seqlock, seqlock->sequence);
         result = INTERLOCKED_HL_ERROR;
     }
     else
     {
-        int32_t current_value;
+        /*Codes_SRS_INTERLOCKED_HL_02_138: [ InterlockedHL_SeqLockWriteEnd shall make the sequence even by calling interlocked_increment. ]*/
+        (void)interlocked_increment(&seqlock->sequence);
 
-        do
+        /*Codes_SRS_INTERLOCKED_HL_02_139: [ If the waiter count of seqlock is not 0 then InterlockedHL_SeqLockWriteEnd shall call wake_by_address_all on the sequence of seqlock. ]*/
+        if (interlocked_add(&seqlock->waiter_count, 0) != 0)
         {
-            /* Codes_SRS_INTERLOCKED_HL_42_005: [ When wait_on_address succeeds, the value at address shall be compared to the target value passed in value by using interlocked_add. ]*/
-            current_value = interlocked_add(address, 0);
-            if (current_value != value)
-            {
-                /* Codes_SRS_INTERLOCKED_HL_42_002: [ If the value at address is not equal to value, InterlockedHL_WaitForNotValue shall return INTERLOCKED_HL_OK. ]*/
-                result = INTERLOCKED_HL_OK;
-                break;
-            }
+            wake_by_address_all(&seqlock->sequence);
+        }
 
-            /* Codes_SRS_INTERLOCKED_HL_42_006: [ If the value at address matches, InterlockedHL_WaitForNotValue shall issue another call to wait_on_address. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_140: [ InterlockedHL_SeqLockWriteEnd shall succeed and return INTERLOCKED_HL_OK. ]*/
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
 
-            /* Codes_SRS_INTERLOCKED_HL_42_003: [ If the value at address is equal to value, InterlockedHL_WaitForNotValue shall wait until the value at address changes in order to compare it again to value by using wait_on_address. ]*/
-            /* Codes_SRS_INTERLOCKED_HL_42_004: [ When waiting for the value at address to change, the milliseconds argument value shall be used as timeout. ]*/
-            if (!wait_on_address(address, current_value, milliseconds))
-            {
-                LogError("failure in wait_on_address(address=%p, &current_value=%p, milliseconds=%" PRIu32 ")",
-                    address, &current_value, milliseconds);
-                /* Codes_SRS_INTERLOCKED_HL_42_007: [ If wait_on_address fails, InterlockedHL_WaitForNotValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
-                result = INTERLOCKED_HL_ERROR;
-                break;
-            }
-        } while (1);
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SetWaitSpinCount, uint32_t, max_spin_count)
+{
+    INTERLOCKED_HL_RESULT result;
+    /*Codes_SRS_INTERLOCKED_HL_02_036: [ If max_spin_count is greater than INTERLOCKED_HL_MAX_WAIT_SPIN_COUNT then InterlockedHL_SetWaitSpinCount shall fail and return INTERLOCKED_HL_ERROR. ]*/
+    if (max_spin_count > INTERLOCKED_HL_MAX_WAIT_SPIN_COUNT)
+    {
+        LogError("invalid argument uint32_t max_spin_count=%" PRIu32 ", maximum is INTERLOCKED_HL_MAX_WAIT_SPIN_COUNT=%d", max_spin_count, INTERLOCKED_HL_MAX_WAIT_SPIN_COUNT);
+        result = INTERLOCKED_HL_ERROR;
     }
+    else
+    {
+        uint32_t i;
+
+        /*Codes_SRS_INTERLOCKED_HL_02_037: [ InterlockedHL_SetWaitSpinCount shall set the maximum number of spins of the waits to max_spin_count with interlocked_exchange and reset the spin budget of all the wait cells to max_spin_count. ]*/
+        (void)interlocked_exchange(&interlocked_hl_max_wait_spin_count, (int32_t)max_spin_count);
+        for (i = 0; i < INTERLOCKED_HL_WAIT_CELL_COUNT; i++)
+        {
+            interlocked_hl_store_relaxed(&interlocked_hl_wait_cells[i].spin_budget_deficit, 0);
+        }
 
+        /*Codes_SRS_INTERLOCKED_HL_02_038: [ InterlockedHL_SetWaitSpinCount shall succeed and return INTERLOCKED_HL_OK. ]*/
+        result = INTERLOCKED_HL_OK;
+    }
     return result;
 }
 
@@ -189,10 +1161,15 @@ IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_CompareExchan
             /*Codes_SRS_INTERLOCKED_HL_02_014: [ If target did not change meanwhile then InterlockedHL_CompareExchange64If shall return return INTERLOCKED_HL_OK and shall peform the exchange of values. ]*/
             if (interlocked_compare_exchange_64(target, exchange, copyOfTarget) == copyOfTarget)
             {
+                /*Codes_SRS_INTERLOCKED_HL_02_153: [ If the exchange was performed and there are threads waiting on the wait cell of target then InterlockedHL_CompareExchange64If shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+                interlocked_hl_wake_cell(target);
                 result = INTERLOCKED_HL_OK;
             }
             else
             {
+                /*Codes_SRS_INTERLOCKED_HL_02_151: [ If target changed meanwhile then InterlockedHL_CompareExchange64If shall increment the number of compare exchange retries of the current processor (as returned by processor_index_get_current) by calling interlocked_increment_64. ]*/
+                /*the caller decides whether to retry (and can back off with InterlockedHL_Backoff), this only makes the contention visible*/
+                (void)interlocked_increment_64(&interlocked_hl_get_statistics_slot()->cas_retries);
                 result = INTERLOCKED_HL_CHANGED;
             }
         }
@@ -207,6 +1184,94 @@ IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_CompareExchan
     return result;
 }
 
+/*xorshift32, the jitter only needs to differ between the threads that back off at the same time*/
+static uint32_t interlocked_hl_backoff_next_random(INTERLOCKED_HL_BACKOFF* backoff)
+{
+    uint32_t x = backoff->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    backoff->seed = x;
+    return x;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_Backoff, INTERLOCKED_HL_BACKOFF*, backoff)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (backoff == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_141: [ If backoff is NULL then InterlockedHL_Backoff shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments INTERLOCKED_HL_BACKOFF* backoff=%p", backoff);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        uint32_t half;
+        uint32_t pauses;
+        uint32_t i;
+        INTERLOCKED_HL_STATISTICS_SLOT* statistics_slot;
+
+        if (backoff->pause_count == 0)
+        {
+            /*Codes_SRS_INTERLOCKED_HL_02_142: [ If this is the first backoff then InterlockedHL_Backoff shall set the limit of pauses of backoff to INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT and seed the jitter of backoff from the address of backoff. ]*/
+            /*backoff is on the stack of the retrying thread, so its address is different for threads that retry at the same time*/
+            backoff->pause_count = INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT;
+            backoff->seed = ((uint32_t)((uintptr_t)backoff >> 4) * 2654435761u) | 1;
+        }
+
+        /*Codes_SRS_INTERLOCKED_HL_02_143: [ InterlockedHL_Backoff shall increment the number of compare exchange retries of the current processor (as returned by processor_index_get_current) by calling interlocked_increment_64. ]*/
+        statistics_slot = interlocked_hl_get_statistics_slot();
+        (void)interlocked_increment_64(&statistics_slot->cas_retries);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_144: [ InterlockedHL_Backoff shall execute a random number of pause instructions between half of the limit of pauses of backoff and the limit of pauses of backoff. ]*/
+        half = backoff->pause_count / 2;
+        pauses = half + interlocked_hl_backoff_next_random(backoff) % (backoff->pause_count - half + 1);
+        for (i = 0; i < pauses; i++)
+        {
+            interlocked_hl_cpu_pause();
+        }
+
+        /*Codes_SRS_INTERLOCKED_HL_02_145: [ InterlockedHL_Backoff shall add the number of pause instructions executed to the number of backoff pauses of the same processor by calling interlocked_add_64. ]*/
+        (void)interlocked_add_64(&statistics_slot->backoff_pauses, pauses);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_146: [ InterlockedHL_Backoff shall double the limit of pauses of backoff, without exceeding INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT. ]*/
+        backoff->pause_count = (backoff->pause_count > INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT / 2) ? INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT : (backoff->pause_count * 2);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_147: [ InterlockedHL_Backoff shall succeed and return INTERLOCKED_HL_OK. ]*/
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_GetStatistics, INTERLOCKED_HL_STATISTICS*, statistics)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (statistics == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_148: [ If statistics is NULL then InterlockedHL_GetStatistics shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments INTERLOCKED_HL_STATISTICS* statistics=%p", statistics);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        int64_t cas_retries = 0;
+        int64_t backoff_pauses = 0;
+        uint32_t i;
+
+        /*Codes_SRS_INTERLOCKED_HL_02_149: [ InterlockedHL_GetStatistics shall sum the numbers of compare exchange retries and the numbers of backoff pauses of all the INTERLOCKED_HL_STATISTICS_SLOT_COUNT processor slots (reading each by calling interlocked_add_64), write the sums in statistics, succeed and return INTERLOCKED_HL_OK. ]*/
+        /*the counters are read one by one while other threads might update them, so the sums are not a snapshot of one moment in time*/
+        for (i = 0; i < INTERLOCKED_HL_STATISTICS_SLOT_COUNT; i++)
+        {
+            cas_retries += interlocked_add_64(&interlocked_hl_statistics_slots[i].cas_retries, 0);
+            backoff_pauses += interlocked_add_64(&interlocked_hl_statistics_slots[i].backoff_pauses, 0);
+        }
+        statistics->cas_retries = (uint64_t)cas_retries;
+        statistics->backoff_pauses = (uint64_t)backoff_pauses;
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
 IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SetAndWake, int32_t volatile_atomic*, address, int32_t, value)
 {
     INTERLOCKED_HL_RESULT result;
@@ -256,3 +1321,137 @@ IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SetAndWakeAll
     return result;
 
 }
+
+/*waits until (value at address == value) == wait_for_equal: checks, spins, and then sleeps on the generation of the wait cell of address*/
+static INTERLOCKED_HL_RESULT interlocked_hl_wait_for_value_64(int64_t volatile_atomic* address, int64_t value, bool wait_for_equal, uint32_t milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_WAIT_CELL* cell = interlocked_hl_get_wait_cell(address);
+
+    if ((interlocked_add_64(address, 0) == value) == wait_for_equal)
+    {
+        result = INTERLOCKED_HL_OK;
+    }
+    else if (interlocked_hl_spin_64(address, value, wait_for_equal))
+    {
+        result = INTERLOCKED_HL_OK;
+    }
+    else
+    {
+        /*the updaters only bump and wake the cell when it has waiters*/
+        (void)interlocked_increment(&cell->waiter_count);
+        do
+        {
+            /*the generation is read before the value: an updater that changes the value after it was read below also changes the generation, so wait_on_address does not sleep*/
+            int32_t generation = interlocked_add(&cell->generation, 0);
+            int64_t current_value = interlocked_add_64(address, 0);
+            if ((current_value == value) == wait_for_equal)
+            {
+                result = INTERLOCKED_HL_OK;
+                break;
+            }
+
+            if (!wait_on_address(&cell->generation, generation, milliseconds))
+            {
+                LogError("failure in wait_on_address(&cell->generation=%p, generation=%" PRId32 ", milliseconds=%" PRIu32 ")",
+                    &cell->generation, generation, milliseconds);
+                result = INTERLOCKED_HL_ERROR;
+                break;
+            }
+
+            /*woken up by an updater of this address, of another address in the same cell or spuriously: check again*/
+        } while (1);
+        (void)interlocked_decrement(&cell->waiter_count);
+    }
+
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_SetAndWakeAll64, int64_t volatile_atomic*, address, int64_t, value)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (address == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_043: [ If address is NULL then InterlockedHL_SetAndWakeAll64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments int64_t volatile_atomic* address=%p, int64_t value=%" PRId64 "",
+            address, value);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_044: [ InterlockedHL_SetAndWakeAll64 shall set address to value. ]*/
+        (void)interlocked_exchange_64(address, value);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_045: [ If there are threads waiting on the wait cell of address then InterlockedHL_SetAndWakeAll64 shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+        interlocked_hl_wake_cell(address);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_046: [ InterlockedHL_SetAndWakeAll64 shall succeed and return INTERLOCKED_HL_OK. ]*/
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WakeAll64, int64_t volatile_atomic*, address)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (address == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_157: [ If address is NULL then InterlockedHL_WakeAll64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments int64_t volatile_atomic* address=%p", address);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_158: [ InterlockedHL_WakeAll64 shall not read or write the value at address. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_159: [ If there are threads waiting on the wait cell of address then InterlockedHL_WakeAll64 shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+        interlocked_hl_wake_cell(address);
+
+        /*Codes_SRS_INTERLOCKED_HL_02_160: [ InterlockedHL_WakeAll64 shall succeed and return INTERLOCKED_HL_OK. ]*/
+        result = INTERLOCKED_HL_OK;
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForValue64, int64_t volatile_atomic*, address, int64_t, value, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (address == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_047: [ If address is NULL then InterlockedHL_WaitForValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments int64_t volatile_atomic* address=%p, int64_t value=%" PRId64 ", uint32_t milliseconds=%" PRIu32 "",
+            address, value, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_048: [ InterlockedHL_WaitForValue64 shall read the value at address by using interlocked_add_64. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_049: [ If the value at address is equal to value then InterlockedHL_WaitForValue64 shall return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_154: [ Otherwise InterlockedHL_WaitForValue64 shall first spin (executing a pause instruction between reads) for at most the spin budget of the wait cell of address waiting for the value at address to be equal to value. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_050: [ If the value is still not equal to value then InterlockedHL_WaitForValue64 shall increment the waiter count of the wait cell of address, read the generation of the wait cell and the value at address, and call wait_on_address on the generation with milliseconds as timeout until the value is equal to value, and then decrement the waiter count. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_051: [ If wait_on_address fails then InterlockedHL_WaitForValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_value_64(address, value, true, milliseconds);
+    }
+    return result;
+}
+
+IMPLEMENT_MOCKABLE_FUNCTION(, INTERLOCKED_HL_RESULT, InterlockedHL_WaitForNotValue64, int64_t volatile_atomic*, address, int64_t, value, uint32_t, milliseconds)
+{
+    INTERLOCKED_HL_RESULT result;
+    if (address == NULL)
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_052: [ If address is NULL then InterlockedHL_WaitForNotValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        LogError("invalid arguments int64_t volatile_atomic* address=%p, int64_t value=%" PRId64 ", uint32_t milliseconds=%" PRIu32 "",
+            address, value, milliseconds);
+        result = INTERLOCKED_HL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_INTERLOCKED_HL_02_053: [ InterlockedHL_WaitForNotValue64 shall read the value at address by using interlocked_add_64. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_054: [ If the value at address is not equal to value then InterlockedHL_WaitForNotValue64 shall return INTERLOCKED_HL_OK. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_155: [ Otherwise InterlockedHL_WaitForNotValue64 shall first spin (executing a pause instruction between reads) for at most the spin budget of the wait cell of address waiting for the value at address to be different than value. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_055: [ If the value is still equal to value then InterlockedHL_WaitForNotValue64 shall increment the waiter count of the wait cell of address, read the generation of the wait cell and the value at address, and call wait_on_address on the generation with milliseconds as timeout until the value is not equal to value, and then decrement the waiter count. ]*/
+        /*Codes_SRS_INTERLOCKED_HL_02_056: [ If wait_on_address fails then InterlockedHL_WaitForNotValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+        result = interlocked_hl_wait_for_value_64(address, value, false, milliseconds);
+    }
+    return result;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/interlocked.h"
+
+#include "azure_c_util/log_ratelimit.h"
+
+/*all the call sites that were hit at least once. Sites are only ever added (at the head), never removed*/
+static LOG_RATELIMIT_SITE* volatile_atomic log_ratelimit_sites = NULL;
+
+int64_t log_ratelimit_hit(LOG_RATELIMIT_SITE* site)
+{
+    int64_t result;
+    /*Codes_SRS_LOG_RATELIMIT_02_001: [ If site is NULL then log_ratelimit_hit shall return 0. ]*/
+    if (site == NULL)
+    {
+        LogError("invalid argument LOG_RATELIMIT_SITE* site=%p", site);
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_LOG_RATELIMIT_02_002: [ log_ratelimit_hit shall increment the count of site. ]*/
+        int64_t count = interlocked_increment_64(&site->count);
+
+        if (
+            (count == 1) &&
+            (interlocked_compare_exchange(&site->listed, 1, 0) == 0)
+            )
+        {
+            /*Codes_SRS_LOG_RATELIMIT_02_003: [ If this is the first hit of site then log_ratelimit_hit shall add site to the list of sites. ]*/
+            /*the count is 1 again after every log_ratelimit_flush, listed makes sure that every site is added exactly once*/
+            LOG_RATELIMIT_SITE* head;
+            do
+            {
+                head = interlocked_compare_exchange_pointer((void* volatile_atomic*)&log_ratelimit_sites, NULL, NULL);
+                (void)interlocked_exchange_pointer((void* volatile_atomic*)&site->next, head);
+            } while (interlocked_compare_exchange_pointer((void* volatile_atomic*)&log_ratelimit_sites, site, head) != head);
+        }
+
+        if ((count & (count - 1)) == 0)
+        {
+            /*Codes_SRS_LOG_RATELIMIT_02_004: [ If the count is a power of 2 then log_ratelimit_hit shall return the count. ]*/
+            /*the count restarts from 0 at every log_ratelimit_flush, so a hit after a quiet period is always logged*/
+            result = count;
+        }
+        else
+        {
+            /*Codes_SRS_LOG_RATELIMIT_02_005: [ Otherwise log_ratelimit_hit shall return 0. ]*/
+            result = 0;
+        }
+    }
+    return result;
+}
+
+void log_ratelimit_flush(void)
+{
+    /*Codes_SRS_LOG_RATELIMIT_02_006: [ log_ratelimit_flush shall visit all the sites that were hit at least once. ]*/
+    LOG_RATELIMIT_SITE* site = interlocked_compare_exchange_pointer((void* volatile_atomic*)&log_ratelimit_sites, NULL, NULL);
+    while (site != NULL)
+    {
+        /*Codes_SRS_LOG_RATELIMIT_02_008: [ log_ratelimit_flush shall set the count of every site to 0 and add it to the total count of the site. ]*/
+        int64_t count = interlocked_exchange_64(&site->count, 0);
+        int64_t total_count = interlocked_add_64(&site->total_count, count);
+
+        /*Codes_SRS_LOG_RATELIMIT_02_007: [ For every site that was hit since the previous call to log_ratelimit_flush, log_ratelimit_flush shall log the number of hits since the previous call and the total number of hits. ]*/
+        if (count > 0)
+        {
+            LogError("%s:%d %s: %" PRId64 " hits since last flush, %" PRId64 " in total", site->file, site->line, site->func, count, total_count);
+        }
+
+        site = interlocked_compare_exchange_pointer((void* volatile_atomic*)&site->next, NULL, NULL);
+    }
+}
@@ -0,0 +1,282 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_pal/sync.h"
+#include "azure_c_pal/timer.h"
+#include "azure_c_util/interlocked_hl.h"
+
+#include "azure_c_util/memory_budget.h"
+
+MU_DEFINE_ENUM_STRINGS(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+
+typedef struct MEMORY_BUDGET_TAG
+{
+    int64_t limit;
+    MEMORY_BUDGET_HANDLE parent;
+    volatile_atomic int64_t used;               /*charged with InterlockedHL_Add64WithCeiling(&used, limit, size)*/
+    volatile_atomic int32_t release_generation; /*incremented by every release that has waiters, memory_budget_charge waits for it to change*/
+    volatile_atomic int32_t waiter_count;
+    char name[];
+}MEMORY_BUDGET;
+
+MEMORY_BUDGET_HANDLE memory_budget_create(const char* name, int64_t limit, MEMORY_BUDGET_HANDLE parent)
+{
+    MEMORY_BUDGET_HANDLE result;
+    if (
+        /*Codes_SRS_MEMORY_BUDGET_02_001: [ If name is NULL then memory_budget_create shall fail and return NULL. ]*/
+        (name == NULL) ||
+        /*Codes_SRS_MEMORY_BUDGET_02_002: [ If limit is less than 0 then memory_budget_create shall fail and return NULL. ]*/
+        (limit < 0)
+        )
+    {
+        LogError("invalid arguments const char* name=%s, int64_t limit=%" PRId64 ", MEMORY_BUDGET_HANDLE parent=%p", MU_P_OR_NULL(name), limit, parent);
+        result = NULL;
+    }
+    else
+    {
+        size_t name_size = strlen(name) + 1;
+        /*Codes_SRS_MEMORY_BUDGET_02_003: [ memory_budget_create shall allocate memory for the budget and a copy of name. ]*/
+        result = malloc(sizeof(MEMORY_BUDGET) + name_size);
+        if (result == NULL)
+        {
+            /*Codes_SRS_MEMORY_BUDGET_02_004: [ If there are any failures then memory_budget_create shall fail and return NULL. ]*/
+            LogError("failure in malloc(sizeof(MEMORY_BUDGET)=%zu + name_size=%zu)", sizeof(MEMORY_BUDGET), name_size);
+            /*return as is*/
+        }
+        else
+        {
+            /*Codes_SRS_MEMORY_BUDGET_02_005: [ memory_budget_create shall set the used bytes to 0, succeed and return a non-NULL value. ]*/
+            (void)memcpy(result->name, name, name_size);
+            result->limit = limit;
+            result->parent = parent;
+            (void)interlocked_exchange_64(&result->used, 0);
+            (void)interlocked_exchange(&result->release_generation, 0);
+            (void)interlocked_exchange(&result->waiter_count, 0);
+            /*return as is*/
+        }
+    }
+    return result;
+}
+
+void memory_budget_destroy(MEMORY_BUDGET_HANDLE memory_budget)
+{
+    /*Codes_SRS_MEMORY_BUDGET_02_006: [ If memory_budget is NULL then memory_budget_destroy shall return. ]*/
+    if (memory_budget == NULL)
+    {
+        LogError("invalid argument MEMORY_BUDGET_HANDLE memory_budget=%p", memory_budget);
+    }
+    else
+    {
+        int64_t used = interlocked_add_64(&memory_budget->used, 0);
+        if (used != 0)
+        {
+            LogError("memory budget %s destroyed while %" PRId64 " bytes are still charged", memory_budget->name, used);
+        }
+        /*Codes_SRS_MEMORY_BUDGET_02_007: [ memory_budget_destroy shall free all used resources. ]*/
+        free(memory_budget);
+    }
+}
+
+/*gives size bytes back to memory_budget and its parents up to (excluding) stop, and wakes up whoever waits for them*/
+static void memory_budget_give_back(MEMORY_BUDGET_HANDLE memory_budget, MEMORY_BUDGET_HANDLE stop, int64_t size)
+{
+    MEMORY_BUDGET_HANDLE current;
+    for (current = memory_budget; current != stop; current = current->parent)
+    {
+        (void)interlocked_add_64(&current->used, -size);
+
+        if (interlocked_add(&current->waiter_count, 0) != 0)
+        {
+            (void)interlocked_increment(&current->release_generation);
+            wake_by_address_all(&current->release_generation);
+        }
+    }
+}
+
+/*returns true when size is not above the limit of memory_budget and of all its parents, otherwise the bytes would never be accepted. The limits do not change after memory_budget_create*/
+static bool memory_budget_can_ever_charge(MEMORY_BUDGET_HANDLE memory_budget, int64_t size)
+{
+    MEMORY_BUDGET_HANDLE current;
+    for (current = memory_budget; current != NULL; current = current->parent)
+    {
+        if (size > current->limit)
+        {
+            LogError("memory budget %s: %" PRId64 " bytes are more than the limit of %" PRId64 " bytes of %s", memory_budget->name, size, current->limit, current->name);
+            break;
+        }
+    }
+    return (current == NULL);
+}
+
+/*charges size bytes to memory_budget and its parents. Returns NULL when all the budgets accepted the bytes, otherwise undoes the charges already made and returns the budget that refused them*/
+static MEMORY_BUDGET_HANDLE memory_budget_try_charge(MEMORY_BUDGET_HANDLE memory_budget, int64_t size)
+{
+    MEMORY_BUDGET_HANDLE current;
+    for (current = memory_budget; current != NULL; current = current->parent)
+    {
+        int64_t original_used;
+        if (InterlockedHL_Add64WithCeiling(&current->used, current->limit, size, &original_used) != INTERLOCKED_HL_OK)
+        {
+            break;
+        }
+    }
+
+    if (current != NULL)
+    {
+        memory_budget_give_back(memory_budget, current, size);
+    }
+    return current;
+}
+
+MEMORY_BUDGET_RESULT memory_budget_charge(MEMORY_BUDGET_HANDLE memory_budget, int64_t size, uint32_t timeout_ms)
+{
+    MEMORY_BUDGET_RESULT result;
+    if (
+        /*Codes_SRS_MEMORY_BUDGET_02_008: [ If memory_budget is NULL then memory_budget_charge shall fail and return MEMORY_BUDGET_ERROR. ]*/
+        (memory_budget == NULL) ||
+        /*Codes_SRS_MEMORY_BUDGET_02_009: [ If size is less than 0 then memory_budget_charge shall fail and return MEMORY_BUDGET_ERROR. ]*/
+        (size < 0)
+        )
+    {
+        LogError("invalid arguments MEMORY_BUDGET_HANDLE memory_budget=%p, int64_t size=%" PRId64 ", uint32_t timeout_ms=%" PRIu32 "", memory_budget, size, timeout_ms);
+        result = MEMORY_BUDGET_ERROR;
+    }
+    /*Codes_SRS_MEMORY_BUDGET_02_025: [ If size is greater than the limit of memory_budget or of any parent of memory_budget then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED without charging or waiting. ]*/
+    else if (!memory_budget_can_ever_charge(memory_budget, size))
+    {
+        result = MEMORY_BUDGET_EXHAUSTED;
+    }
+    else
+    {
+        /*Codes_SRS_MEMORY_BUDGET_02_010: [ memory_budget_charge shall charge size bytes to memory_budget and to every parent of memory_budget by calling InterlockedHL_Add64WithCeiling with the limit of the budget as ceiling. ]*/
+        MEMORY_BUDGET_HANDLE refused_by = memory_budget_try_charge(memory_budget, size);
+        if (refused_by == NULL)
+        {
+            /*Codes_SRS_MEMORY_BUDGET_02_011: [ If all the budgets accept the bytes then memory_budget_charge shall succeed and return MEMORY_BUDGET_OK. ]*/
+            result = MEMORY_BUDGET_OK;
+        }
+        else if (timeout_ms == 0)
+        {
+            /*Codes_SRS_MEMORY_BUDGET_02_012: [ If a budget refuses the bytes then memory_budget_charge shall give back the bytes charged to the other budgets. ]*/
+            /*Codes_SRS_MEMORY_BUDGET_02_013: [ If a budget refuses the bytes and timeout_ms is 0 then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED. ]*/
+            result = MEMORY_BUDGET_EXHAUSTED;
+        }
+        else
+        {
+            double start_ms = timer_global_get_elapsed_ms();
+            while (1)
+            {
+                /*Codes_SRS_MEMORY_BUDGET_02_014: [ Otherwise memory_budget_charge shall wait with wait_on_address for bytes to be released to the budget that refused, at most until timeout_ms expires, and then try again. ]*/
+                (void)interlocked_increment(&refused_by->waiter_count);
+                int32_t generation = interlocked_add(&refused_by->release_generation, 0);
+
+                /*bytes released before this thread was counted as a waiter did not wake it up, so try again before waiting*/
+                MEMORY_BUDGET_HANDLE refused_again_by = memory_budget_try_charge(memory_budget, size);
+                if (refused_again_by == NULL)
+                {
+                    (void)interlocked_decrement(&refused_by->waiter_count);
+                    result = MEMORY_BUDGET_OK;
+                    break;
+                }
+                else
+                {
+                    double elapsed_ms = timer_global_get_elapsed_ms() - start_ms;
+
+                    /*Codes_SRS_MEMORY_BUDGET_02_015: [ If timeout_ms is not UINT32_MAX and timeout_ms milliseconds have elapsed since memory_budget_charge was called then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED. ]*/
+                    if (
+                        (timeout_ms != UINT32_MAX) &&
+                        (elapsed_ms >= (double)timeout_ms)
+                        )
+                    {
+                        (void)interlocked_decrement(&refused_by->waiter_count);
+                        LogError("memory budget %s: %" PRId64 " bytes were not released in %" PRIu32 " ms", refused_again_by->name, size, timeout_ms);
+                        result = MEMORY_BUDGET_EXHAUSTED;
+                        break;
+                    }
+                    else
+                    {
+                        /*when another budget refused this time there is nothing to wait for, the loop tries again right away*/
+                        if (refused_again_by == refused_by)
+                        {
+                            /*wait_on_address returns false when the time expires, the loop then checks the timeout*/
+                            (void)wait_on_address(&refused_by->release_generation, generation, (timeout_ms == UINT32_MAX) ? UINT32_MAX : (uint32_t)((double)timeout_ms - elapsed_ms) + 1);
+                        }
+                        (void)interlocked_decrement(&refused_by->waiter_count);
+                        refused_by = refused_again_by;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void memory_budget_release(MEMORY_BUDGET_HANDLE memory_budget, int64_t size)
+{
+    if (
+        /*Codes_SRS_MEMORY_BUDGET_02_016: [ If memory_budget is NULL then memory_budget_release shall return. ]*/
+        (memory_budget == NULL) ||
+        /*Codes_SRS_MEMORY_BUDGET_02_017: [ If size is less than 0 then memory_budget_release shall return. ]*/
+        (size < 0)
+        )
+    {
+        LogError("invalid arguments MEMORY_BUDGET_HANDLE memory_budget=%p, int64_t size=%" PRId64 "", memory_budget, size);
+    }
+    else
+    {
+        /*Codes_SRS_MEMORY_BUDGET_02_018: [ memory_budget_release shall subtract size from the used bytes of memory_budget and of every parent of memory_budget. ]*/
+        /*Codes_SRS_MEMORY_BUDGET_02_019: [ For every budget that has threads waiting in memory_budget_charge, memory_budget_release shall wake them up with wake_by_address_all. ]*/
+        memory_budget_give_back(memory_budget, NULL, size);
+    }
+}
+
+int memory_budget_get_used(MEMORY_BUDGET_HANDLE memory_budget, int64_t* used)
+{
+    int result;
+    if (
+        /*Codes_SRS_MEMORY_BUDGET_02_020: [ If memory_budget is NULL then memory_budget_get_used shall fail and return a non-zero value. ]*/
+        (memory_budget == NULL) ||
+        /*Codes_SRS_MEMORY_BUDGET_02_021: [ If used is NULL then memory_budget_get_used shall fail and return a non-zero value. ]*/
+        (used == NULL)
+        )
+    {
+        LogError("invalid arguments MEMORY_BUDGET_HANDLE memory_budget=%p, int64_t* used=%p", memory_budget, used);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /*Codes_SRS_MEMORY_BUDGET_02_022: [ memory_budget_get_used shall write in used the number of bytes charged to memory_budget, succeed and return 0. ]*/
+        *used = interlocked_add_64(&memory_budget->used, 0);
+        result = 0;
+    }
+    return result;
+}
+
+const char* memory_budget_get_name(MEMORY_BUDGET_HANDLE memory_budget)
+{
+    const char* result;
+    /*Codes_SRS_MEMORY_BUDGET_02_023: [ If memory_budget is NULL then memory_budget_get_name shall return NULL. ]*/
+    if (memory_budget == NULL)
+    {
+        LogError("invalid argument MEMORY_BUDGET_HANDLE memory_budget=%p", memory_budget);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MEMORY_BUDGET_02_024: [ memory_budget_get_name shall return the name of memory_budget. ]*/
+        result = memory_budget->name;
+    }
+    return result;
+}
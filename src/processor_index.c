@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef _WIN32
+#include "windows.h"
+#else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /*for sched_getcpu*/
+#endif
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include <stdint.h>
+
+#include "azure_c_logging/xlogging.h"
+
+#include "azure_c_util/processor_index.h"
+
+uint32_t processor_index_get_count(void)
+{
+    uint32_t result;
+#ifdef _WIN32
+    /*Codes_SRS_PROCESSOR_INDEX_02_001: [ processor_index_get_count shall return the number of processors of the system. ]*/
+    result = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+    /*Codes_SRS_PROCESSOR_INDEX_02_001: [ processor_index_get_count shall return the number of processors of the system. ]*/
+    long count = sysconf(_SC_NPROCESSORS_CONF);
+    result = (count <= 0) ? 0 : (uint32_t)count;
+#endif
+
+    if (result == 0)
+    {
+        /*Codes_SRS_PROCESSOR_INDEX_02_002: [ If the number of processors cannot be determined then processor_index_get_count shall return 1. ]*/
+        LogError("unable to determine the number of processors, assuming 1");
+        result = 1;
+    }
+    return result;
+}
+
+uint32_t processor_index_get_current(void)
+{
+    uint32_t result;
+#ifdef _WIN32
+    /*Codes_SRS_PROCESSOR_INDEX_02_003: [ processor_index_get_current shall return the index of the processor executing the calling thread. ]*/
+    PROCESSOR_NUMBER processor_number;
+    GetCurrentProcessorNumberEx(&processor_number);
+    result = ((uint32_t)processor_number.Group * 64) + processor_number.Number;
+#else
+    /*Codes_SRS_PROCESSOR_INDEX_02_003: [ processor_index_get_current shall return the index of the processor executing the calling thread. ]*/
+    int cpu = sched_getcpu();
+    /*Codes_SRS_PROCESSOR_INDEX_02_004: [ If the index of the processor cannot be determined then processor_index_get_current shall return 0. ]*/
+    result = (cpu < 0) ? 0 : (uint32_t)cpu;
+#endif
+    return result;
+}
@@ -6,15 +6,17 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
-#include "windows.h"
-
 #include "azure_macro_utils/macro_utils.h"
 
 #include "azure_c_logging/xlogging.h"
 #include "azure_c_pal/gballoc_hl.h"
 #include "azure_c_pal/gballoc_hl_redirect.h"
 #include "azure_c_pal/interlocked.h"
+#include "azure_c_pal/sync.h"
+#include "azure_c_pal/timer.h"
 #include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/processor_index.h"
+#include "azure_c_util/log_ratelimit.h"
 
 #include "azure_c_util/sm.h"
 
@@ -30,9 +32,11 @@
 MU_DEFINE_ENUM(SM_STATE, SM_STATE_VALUES)
 
 #define SM_STATE_MASK       ((1<<7)-1) /*127*/
-#define SM_STATE_INCREMENT  (1<<8)  /*256*/ /*at every state change, the state is incremented by this much*/
+#define SM_STATE_INCREMENT  (1<<10) /*1024*/ /*at every state change, the state is incremented by this much*/
 
 #define SM_CLOSE_BIT        (1<<7)
+#define SM_ASYNC_BIT        (1<<8) /*set together with a draining state by sm_close_begin_async/sm_barrier_begin_async: the thread that sees n reaching 0 calls the callback*/
+#define SM_THROTTLE_BIT     (1<<9) /*set by a sm_exec_begin that waits for n to go below max_exec_count, cleared by the sm_exec_end that decrements n (which then wakes up the waiters)*/
 
 /*a PRI macro for the SM state*/
 #define PRI_SM_STATE "" PRI_MU_ENUM " SM_CLOSE_BIT=%d"
@@ -40,10 +44,83 @@ MU_DEFINE_ENUM(SM_STATE, SM_STATE_VALUES)
 /*a VALUE macro corresponding to PRI_SM_STATE - it takes SM_HANDLE_DATA.state as argument*/
 #define SM_STATE_VALUE(state) MU_ENUM_VALUE(SM_STATE, (SM_STATE)((state) & SM_STATE_MASK)), (((state)&SM_CLOSE_BIT)>0)
 
+#define SM_CACHE_LINE_SIZE 64
+
+/*values of async_state*/
+#define SM_ASYNC_NONE       0 /*no sm_close_begin_async/sm_barrier_begin_async is pending*/
+#define SM_ASYNC_ARMING     1 /*a sm_close_begin_async/sm_barrier_begin_async is setting up the callback*/
+#define SM_ASYNC_ARMED      2 /*the callback is published, it is called by the thread that sees n reaching 0*/
+#define SM_ASYNC_COMPLETING 3 /*a thread claimed the callback and is calling it*/
+#define SM_ASYNC_DRAINED    4 /*n reached 0 before the callback was published, the thread publishing it calls it*/
+
+#define SM_SHARD_FROZEN     INT32_MIN /*value of a shard from the moment sm_freeze_shards collected it until sm_thaw_shards*/
+#define SM_FREEZE_BIAS      (1<<30) /*added to n in the state word while the shards are collected, so n cannot be seen reaching 0 before all of them were added*/
+
+typedef struct SM_EXEC_SHARD_TAG
+{
+    volatile_atomic int32_t non_barrier_call_count; /*this shard's part of n. Can be negative when sm_exec_end executes on another processor than its sm_exec_begin. SM_SHARD_FROZEN while draining*/
+    uint8_t padding[SM_CACHE_LINE_SIZE - sizeof(int32_t)]; /*every shard has its own cache line*/
+}SM_EXEC_SHARD;
+
+/*indexes of the statistics counters kept per processor when SM_OPTIONS.collect_statistics is true*/
+typedef enum SM_COUNTER_TAG
+{
+    SM_COUNTER_OPEN_BEGIN_GRANTED,
+    SM_COUNTER_OPEN_BEGIN_REFUSED,
+    SM_COUNTER_CLOSE_BEGIN_GRANTED,
+    SM_COUNTER_CLOSE_BEGIN_REFUSED,
+    SM_COUNTER_EXEC_BEGIN_GRANTED,
+    SM_COUNTER_EXEC_BEGIN_REFUSED,
+    SM_COUNTER_EXEC_BEGIN_THROTTLED,
+    SM_COUNTER_BARRIER_BEGIN_GRANTED,
+    SM_COUNTER_BARRIER_BEGIN_REFUSED,
+    SM_COUNTER_STATE_CHANGED_MEANWHILE,
+    SM_COUNTER_CAS_RETRIES,
+    SM_COUNTER_DRAIN_WAIT_HISTOGRAM, /*first of SM_STATISTICS_DRAIN_WAIT_BUCKET_COUNT counters*/
+    SM_COUNTER_COUNT = SM_COUNTER_DRAIN_WAIT_HISTOGRAM + SM_STATISTICS_DRAIN_WAIT_BUCKET_COUNT
+}SM_COUNTER;
+
+typedef struct SM_STATISTICS_SLOT_TAG
+{
+    volatile_atomic int64_t counters[SM_COUNTER_COUNT];
+    uint8_t padding[SM_CACHE_LINE_SIZE - (SM_COUNTER_COUNT * sizeof(int64_t)) % SM_CACHE_LINE_SIZE]; /*every slot starts in its own cache line*/
+}SM_STATISTICS_SLOT;
+
+#ifdef SM_TRACE
+typedef struct SM_TRACE_SLOT_TAG
+{
+    volatile_atomic int64_t sequence; /*record.sequence + 1 once the record is written (0 until the first record is written)*/
+    SM_TRACE_RECORD record;
+}SM_TRACE_SLOT;
+#endif
+
+/*state and n share one 64 bit word, so that sm_exec_begin can check the state and increment n with one compare exchange*/
+/*the low 32 bits are the state (SM_STATE, SM_CLOSE_BIT, SM_ASYNC_BIT and the ever increasing counter), the high 32 bits are n (when n is sharded: the part of n that was folded in by sm_freeze_shards)*/
+#define SM_N_INCREMENT      ((int64_t)1 << 32)
+
+#define SM_STATE_OF(word)   ((int32_t)(uint32_t)((uint64_t)(word) & UINT32_MAX))
+#define SM_N_OF(word)       ((int32_t)(uint32_t)((uint64_t)(word) >> 32))
+#define SM_WORD(n, state)   ((int64_t)(((uint64_t)(uint32_t)(n) << 32) | (uint64_t)(uint32_t)(state)))
+
 typedef struct SM_HANDLE_DATA_TAG
 {
-    volatile_atomic int32_t state;
-    volatile_atomic int32_t non_barrier_call_count; /*number of API calls to non-barriers*/
+    volatile_atomic int64_t state; /*low 32 bits: state, high 32 bits: number of API calls to non-barriers (when n is not sharded)*/
+    uint32_t shard_count; /*0 when n is not sharded. Otherwise n is the sum of shards[0..shard_count-1]*/
+    SM_EXEC_SHARD* shards; /*SM_CACHE_LINE_SIZE aligned, points inside shards_memory*/
+    void* shards_memory;
+    volatile_atomic int32_t state_signal; /*incremented after every barrier or drain state transition, sm_close_begin waits on it when it cannot proceed*/
+    volatile_atomic int32_t async_state; /*one of SM_ASYNC_NONE/ARMING/ARMED/COMPLETING/DRAINED*/
+    SM_ON_DRAINED_FUNC on_drained; /*only valid when async_state is not SM_ASYNC_NONE*/
+    void* on_drained_context;
+    int32_t max_exec_count; /*0 when n is not capped. Otherwise sm_exec_begin does not let n go above it*/
+    bool wait_when_throttled; /*when true, sm_exec_begin waits for n to go below max_exec_count instead of returning SM_EXEC_THROTTLED*/
+    uint32_t statistics_slot_count; /*0 when statistics are not collected*/
+    SM_STATISTICS_SLOT* statistics_slots; /*one slot per processor, SM_CACHE_LINE_SIZE aligned, points inside statistics_memory*/
+    void* statistics_memory;
+#ifdef SM_TRACE
+    volatile_atomic int64_t trace_next; /*sequence of the next trace record. The record goes in trace[trace_next % SM_TRACE_RECORD_COUNT]*/
+    SM_TRACE_SLOT trace[SM_TRACE_RECORD_COUNT];
+#endif
     char name[]; /*used in printing "who this is"*/
 }SM_HANDLE_DATA;
 
@@ -52,7 +129,7 @@ static const char NO_NAME[] = "NO_NAME";
 MU_DEFINE_ENUM_STRINGS(SM_RESULT, SM_RESULT_VALUES);
 MU_DEFINE_ENUM_STRINGS(SM_STATE, SM_STATE_VALUES);
 
-SM_HANDLE sm_create(const char* name)
+static SM_HANDLE sm_create_internal(const char* name, const SM_OPTIONS* options)
 {
     SM_HANDLE result;
     
@@ -76,15 +153,536 @@ SM_HANDLE sm_create(const char* name)
     }
     else
     {
-        /*Codes_SRS_SM_02_037: [ sm_create shall set state to SM_CREATED and n to 0. ]*/
-        (void)interlocked_exchange(&result->state, SM_CREATED);
-        (void)interlocked_exchange(&result->non_barrier_call_count, 0);
-        (void)memcpy(result->name, name, flexSize);
+        result->shard_count = 0;
+        result->shards = NULL;
+        result->shards_memory = NULL;
+        result->statistics_slot_count = 0;
+        result->statistics_slots = NULL;
+        result->statistics_memory = NULL;
+        /*Codes_SRS_SM_02_122: [ sm_create_with_options shall cap n to options->max_exec_count (0 meaning no cap). ]*/
+        result->max_exec_count = (options == NULL) ? 0 : (int32_t)options->max_exec_count;
+        result->wait_when_throttled = (options == NULL) ? false : options->wait_when_throttled;
+
+        if (
+            (options != NULL) &&
+            (options->use_sharded_exec_count)
+            )
+        {
+            /*Codes_SRS_SM_02_077: [ If options->use_sharded_exec_count is true and options->shard_count is 0 then sm_create_with_options shall use as many shards as processor_index_get_count returns. ]*/
+            uint32_t shard_count = (options->shard_count == 0) ? processor_index_get_count() : options->shard_count;
+
+            if ((SIZE_MAX - (SM_CACHE_LINE_SIZE - 1)) / sizeof(SM_EXEC_SHARD) < shard_count)
+            {
+                /*Codes_SRS_SM_02_079: [ If there are any failures then sm_create_with_options shall fail and return NULL. ]*/
+                LogError("sm name=%s, shard_count=%" PRIu32 " produces arithmetic overflows", name, shard_count);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_SM_02_078: [ If options->use_sharded_exec_count is true then sm_create_with_options shall allocate memory for the shards of n, each shard in its own cache line. ]*/
+                result->shards_memory = malloc(shard_count * sizeof(SM_EXEC_SHARD) + (SM_CACHE_LINE_SIZE - 1));
+                if (result->shards_memory == NULL)
+                {
+                    /*Codes_SRS_SM_02_079: [ If there are any failures then sm_create_with_options shall fail and return NULL. ]*/
+                    LogError("sm name=%s, failure in malloc(shard_count=%" PRIu32 " * sizeof(SM_EXEC_SHARD)=%zu + (SM_CACHE_LINE_SIZE - 1)=%d)",
+                        name, shard_count, sizeof(SM_EXEC_SHARD), SM_CACHE_LINE_SIZE - 1);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    result->shards = (SM_EXEC_SHARD*)(((uintptr_t)result->shards_memory + (SM_CACHE_LINE_SIZE - 1)) & ~(uintptr_t)(SM_CACHE_LINE_SIZE - 1));
+                    result->shard_count = shard_count;
+                    for (uint32_t i = 0; i < shard_count; i++)
+                    {
+                        /*Codes_SRS_SM_02_083: [ sm_create_with_options shall set state to SM_CREATED and all the shards of n to 0. ]*/
+                        (void)interlocked_exchange(&result->shards[i].non_barrier_call_count, 0);
+                    }
+                }
+            }
+        }
+
+        if (
+            (result != NULL) &&
+            (options != NULL) &&
+            (options->collect_statistics)
+            )
+        {
+            uint32_t slot_count = processor_index_get_count();
+
+            /*Codes_SRS_SM_02_128: [ If options->collect_statistics is true then sm_create_with_options shall allocate one block of statistics counters for every processor, each block starting in its own cache line. ]*/
+            result->statistics_memory = malloc(slot_count * sizeof(SM_STATISTICS_SLOT) + (SM_CACHE_LINE_SIZE - 1));
+            if (result->statistics_memory == NULL)
+            {
+                /*Codes_SRS_SM_02_079: [ If there are any failures then sm_create_with_options shall fail and return NULL. ]*/
+                LogError("sm name=%s, failure in malloc(slot_count=%" PRIu32 " * sizeof(SM_STATISTICS_SLOT)=%zu + (SM_CACHE_LINE_SIZE - 1)=%d)",
+                    name, slot_count, sizeof(SM_STATISTICS_SLOT), SM_CACHE_LINE_SIZE - 1);
+                if (result->shards_memory != NULL)
+                {
+                    free(result->shards_memory);
+                }
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                result->statistics_slots = (SM_STATISTICS_SLOT*)(((uintptr_t)result->statistics_memory + (SM_CACHE_LINE_SIZE - 1)) & ~(uintptr_t)(SM_CACHE_LINE_SIZE - 1));
+                result->statistics_slot_count = slot_count;
+                for (uint32_t i = 0; i < slot_count; i++)
+                {
+                    /*Codes_SRS_SM_02_129: [ sm_create_with_options shall set all the statistics counters to 0. ]*/
+                    for (uint32_t j = 0; j < SM_COUNTER_COUNT; j++)
+                    {
+                        (void)interlocked_exchange_64(&result->statistics_slots[i].counters[j], 0);
+                    }
+                }
+            }
+        }
+
+        if (result != NULL)
+        {
+            /*Codes_SRS_SM_02_037: [ sm_create shall set state to SM_CREATED and n to 0. ]*/
+            (void)interlocked_exchange_64(&result->state, SM_WORD(0, SM_CREATED));
+            (void)interlocked_exchange(&result->state_signal, 0);
+            (void)interlocked_exchange(&result->async_state, SM_ASYNC_NONE);
+#ifdef SM_TRACE
+            /*Codes_SRS_SM_02_138: [ If sm.c is compiled with SM_TRACE then sm_create and sm_create_with_options shall initialize an empty trace of SM_TRACE_RECORD_COUNT records. ]*/
+            (void)interlocked_exchange_64(&result->trace_next, 0);
+            for (uint32_t i = 0; i < SM_TRACE_RECORD_COUNT; i++)
+            {
+                (void)interlocked_exchange_64(&result->trace[i].sequence, 0);
+            }
+#endif
+            (void)memcpy(result->name, name, flexSize);
+        }
         /*return as is*/
     }
     return result;
 }
 
+SM_HANDLE sm_create(const char* name)
+{
+    return sm_create_internal(name, NULL);
+}
+
+SM_HANDLE sm_create_with_options(const char* name, const SM_OPTIONS* options)
+{
+    SM_HANDLE result;
+    if (
+        (options != NULL) &&
+        (
+            /*Codes_SRS_SM_02_120: [ If options->max_exec_count is greater than INT32_MAX then sm_create_with_options shall fail and return NULL. ]*/
+            (options->max_exec_count > INT32_MAX) ||
+            /*Codes_SRS_SM_02_121: [ If options->max_exec_count is not 0 and options->use_sharded_exec_count is true then sm_create_with_options shall fail and return NULL. ]*/
+            ((options->max_exec_count != 0) && options->use_sharded_exec_count)
+        )
+        )
+    {
+        LogError("sm name=%s, invalid options: use_sharded_exec_count=%d, max_exec_count=%" PRIu32 "", MU_P_OR_NULL(name), options->use_sharded_exec_count, options->max_exec_count);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_SM_02_076: [ If options is NULL then sm_create_with_options shall behave as sm_create. ]*/
+        result = sm_create_internal(name, options);
+    }
+    return result;
+}
+
+/*increments a statistics counter in the slot of the processor executing the calling thread. Nobody else writes that cache line (unless the thread migrates meanwhile) so the interlocked increment is uncontended*/
+static void sm_count(SM_HANDLE sm, SM_COUNTER counter)
+{
+    if (sm->statistics_slot_count != 0)
+    {
+        (void)interlocked_increment_64(&sm->statistics_slots[processor_index_get_current() % sm->statistics_slot_count].counters[counter]);
+    }
+}
+
+static void sm_count_result(SM_HANDLE sm, SM_RESULT result, SM_COUNTER granted, SM_COUNTER refused)
+{
+    if (result == SM_EXEC_GRANTED)
+    {
+        sm_count(sm, granted);
+    }
+    else if (result == SM_EXEC_REFUSED)
+    {
+        sm_count(sm, refused);
+    }
+    else
+    {
+        /*errors are not counted*/
+    }
+}
+
+/*bucket 0 counts waits shorter than 1 microsecond, bucket i counts waits in [2^(i-1), 2^i) microseconds, the last bucket counts everything longer*/
+static uint32_t sm_drain_wait_bucket(double elapsed_ms)
+{
+    uint32_t result = 0;
+    double elapsed_us = elapsed_ms * 1000;
+    while ((elapsed_us >= 1) && (result < SM_STATISTICS_DRAIN_WAIT_BUCKET_COUNT - 1))
+    {
+        result++;
+        elapsed_us /= 2;
+    }
+    return result;
+}
+
+#ifdef SM_TRACE
+/*the slot is reserved with one interlocked increment and the record is published by storing its sequence, so writers never wait for each other or for sm_trace_get.
+sm_trace_get knows that a slot is being overwritten from trace_next, which is incremented before the slot is written*/
+static void sm_trace(SM_HANDLE sm, int32_t old_state, int32_t new_state)
+{
+    int64_t sequence = interlocked_increment_64(&sm->trace_next) - 1;
+    SM_TRACE_SLOT* slot = &sm->trace[sequence & (SM_TRACE_RECORD_COUNT - 1)];
+
+    slot->record.sequence = sequence;
+    slot->record.timestamp_ms = timer_global_get_elapsed_ms();
+    slot->record.old_state = old_state;
+    slot->record.new_state = new_state;
+    (void)interlocked_exchange_64(&slot->sequence, sequence + 1);
+}
+
+/*Codes_SRS_SM_02_139: [ If sm.c is compiled with SM_TRACE then every state transition shall be recorded in the trace with the time, the state before and the state after. ]*/
+#define SM_TRACE_TRANSITION(sm, old_state, new_state) sm_trace((sm), (old_state), (new_state))
+#else
+#define SM_TRACE_TRANSITION(sm, old_state, new_state)
+#endif
+
+static int32_t sm_get_state(SM_HANDLE sm)
+{
+    return SM_STATE_OF(interlocked_add_64(&sm->state, 0));
+}
+
+/*same semantics as interlocked_compare_exchange, but only for the state part of the state word. n is preserved and n_at_exchange is n as it was when the state was exchanged.*/
+static int32_t sm_state_compare_exchange_get_n(SM_HANDLE sm, int32_t exchange, int32_t comperand, int32_t* n_at_exchange)
+{
+    int32_t result;
+    INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    do
+    {
+        int64_t word = interlocked_add_64(&sm->state, 0);
+        result = SM_STATE_OF(word);
+        if (result != comperand)
+        {
+            break;
+        }
+
+        if (interlocked_compare_exchange_64(&sm->state, SM_WORD(SM_N_OF(word), exchange), word) == word)
+        {
+            SM_TRACE_TRANSITION(sm, comperand, exchange);
+            *n_at_exchange = SM_N_OF(word);
+            break;
+        }
+        /*n changed meanwhile, retry*/
+        sm_count(sm, SM_COUNTER_CAS_RETRIES);
+        (void)InterlockedHL_Backoff(&backoff);
+    } while (1);
+    return result;
+}
+
+/*same semantics as interlocked_compare_exchange, but only for the state part of the state word. n is preserved.*/
+static int32_t sm_state_compare_exchange(SM_HANDLE sm, int32_t exchange, int32_t comperand)
+{
+    int32_t n_at_exchange;
+    return sm_state_compare_exchange_get_n(sm, exchange, comperand, &n_at_exchange);
+}
+
+/*adds value to the state part of the state word (wrapping around in 32 bits, never carrying into n). Returns the new state.*/
+static int32_t sm_state_add(SM_HANDLE sm, int32_t value)
+{
+    int32_t result;
+    INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    do
+    {
+        int64_t word = interlocked_add_64(&sm->state, 0);
+        result = (int32_t)((uint32_t)SM_STATE_OF(word) + (uint32_t)value);
+        if (interlocked_compare_exchange_64(&sm->state, SM_WORD(SM_N_OF(word), result), word) == word)
+        {
+            SM_TRACE_TRANSITION(sm, SM_STATE_OF(word), result);
+            break;
+        }
+        sm_count(sm, SM_COUNTER_CAS_RETRIES);
+        (void)InterlockedHL_Backoff(&backoff);
+    } while (1);
+    return result;
+}
+
+/*returns the shard of n of the processor executing the calling thread*/
+static volatile_atomic int32_t* sm_get_current_shard_n(SM_HANDLE sm)
+{
+    return &sm->shards[processor_index_get_current() % sm->shard_count].non_barrier_call_count;
+}
+
+/*publishes a state change to the threads waiting for the state to change (a sm_close_begin that cannot proceed while a barrier is executing)*/
+static void sm_signal_state_change(SM_HANDLE sm)
+{
+    (void)interlocked_increment(&sm->state_signal);
+    wake_by_address_all(&sm->state_signal);
+
+    /*a throttled sm_exec_begin needs to refuse when the state is no longer SM_OPENED. It waits for the state word to change, which the state change just did*/
+    if ((sm_get_state(sm) & SM_THROTTLE_BIT) == SM_THROTTLE_BIT)
+    {
+        (void)InterlockedHL_WakeAll64(&sm->state);
+    }
+}
+
+/*adds value to a shard of n, unless the shard is frozen. Returns false when the shard is frozen, in which case the shard is not changed*/
+static bool sm_shard_add(volatile_atomic int32_t* shard_n, int32_t value)
+{
+    bool result;
+    do
+    {
+        int32_t shard = interlocked_add(shard_n, 0);
+        if (shard == SM_SHARD_FROZEN)
+        {
+            result = false;
+            break;
+        }
+
+        if (interlocked_compare_exchange(shard_n, shard + value, shard) == shard)
+        {
+            result = true;
+            break;
+        }
+        /*another thread running on the same processor changed the shard meanwhile, retry*/
+    } while (1);
+    return result;
+}
+
+/*when n is sharded, called after the state was switched to draining. Freezes every shard and adds its value to n in the state word. From then on sm_exec_end decrements n in the state word, so the sm_exec_end that makes n reach 0 knows it. Returns n*/
+static int32_t sm_freeze_shards(SM_HANDLE sm)
+{
+    int32_t sum = 0;
+
+    /*sm_exec_end on an already frozen shard subtracts from the state word, the bias keeps that from reaching 0 before the sum is added*/
+    (void)interlocked_add_64(&sm->state, (int64_t)SM_FREEZE_BIAS * SM_N_INCREMENT);
+    for (uint32_t i = 0; i < sm->shard_count; i++)
+    {
+        sum += interlocked_exchange(&sm->shards[i].non_barrier_call_count, SM_SHARD_FROZEN);
+    }
+    return SM_N_OF(interlocked_add_64(&sm->state, ((int64_t)sum - SM_FREEZE_BIAS) * SM_N_INCREMENT));
+}
+
+/*gives the shards back to sm_exec_begin/sm_exec_end. Called when no execution can be granted, whatever is left of n stays in the state word*/
+static void sm_thaw_shards(SM_HANDLE sm)
+{
+    for (uint32_t i = 0; i < sm->shard_count; i++)
+    {
+        (void)interlocked_exchange(&sm->shards[i].non_barrier_call_count, 0);
+    }
+}
+
+/*finishes the transition of a pending sm_close_begin_async/sm_barrier_begin_async and calls the callback. Only the thread that moved async_state to SM_ASYNC_COMPLETING calls this. sm cannot be destroyed before the callback is called, so this can still use sm*/
+static void sm_complete_async(SM_HANDLE sm)
+{
+    SM_ON_DRAINED_FUNC on_drained = sm->on_drained;
+    void* on_drained_context = sm->on_drained_context;
+
+    int32_t state = sm_get_state(sm);
+    if ((state & SM_STATE_MASK) == SM_OPENED_DRAINING_TO_CLOSE)
+    {
+        /*Codes_SRS_SM_02_108: [ If the pending operation is sm_close_begin_async then the state shall be switched to SM_CLOSING and SM_CLOSE_BIT shall be set to 0. ]*/
+        (void)sm_state_add(sm, -SM_OPENED_DRAINING_TO_CLOSE + SM_CLOSING - SM_ASYNC_BIT + SM_STATE_INCREMENT);
+        (void)interlocked_and_64(&sm->state, ~(int64_t)SM_CLOSE_BIT);
+    }
+    else
+    {
+        /*Codes_SRS_SM_02_109: [ If the pending operation is sm_barrier_begin_async then the state shall be switched to SM_OPENED_BARRIER. ]*/
+        (void)sm_state_add(sm, -SM_OPENED_DRAINING_TO_BARRIER + SM_OPENED_BARRIER - SM_ASYNC_BIT + SM_STATE_INCREMENT);
+    }
+    sm_signal_state_change(sm);
+
+    /*the slot is released before calling the callback so that the callback can start another async operation after ending this one*/
+    (void)interlocked_exchange(&sm->async_state, SM_ASYNC_NONE);
+
+    /*Codes_SRS_SM_02_110: [ The callback shall be called exactly once, with the context passed to sm_close_begin_async or sm_barrier_begin_async. ]*/
+    on_drained(on_drained_context);
+}
+
+/*called by the sm_exec_end that saw n reaching 0 while draining with SM_ASYNC_BIT set. If the callback is published then this thread calls it, otherwise it leaves it to the thread that is still publishing it*/
+static void sm_exec_end_drained_async(SM_HANDLE sm)
+{
+    do
+    {
+        int32_t async_state = interlocked_add(&sm->async_state, 0);
+        if (async_state == SM_ASYNC_ARMED)
+        {
+            if (interlocked_compare_exchange(&sm->async_state, SM_ASYNC_COMPLETING, SM_ASYNC_ARMED) == SM_ASYNC_ARMED)
+            {
+                sm_complete_async(sm);
+                break;
+            }
+        }
+        else if (async_state == SM_ASYNC_ARMING)
+        {
+            if (interlocked_compare_exchange(&sm->async_state, SM_ASYNC_DRAINED, SM_ASYNC_ARMING) == SM_ASYNC_ARMING)
+            {
+                /*sm_publish_async will see SM_ASYNC_DRAINED and call the callback*/
+                break;
+            }
+        }
+        else
+        {
+            /*when n is sharded several threads can see the sum of the shards at 0, another one already took care of the callback*/
+            break;
+        }
+        /*async_state changed meanwhile, retry*/
+    } while (1);
+}
+
+/*reserves the only async slot and stores the callback. Returns false if another async operation is pending*/
+static bool sm_arm_async(SM_HANDLE sm, SM_ON_DRAINED_FUNC on_drained, void* context)
+{
+    bool result;
+    if (interlocked_compare_exchange(&sm->async_state, SM_ASYNC_ARMING, SM_ASYNC_NONE) != SM_ASYNC_NONE)
+    {
+        result = false;
+    }
+    else
+    {
+        sm->on_drained = on_drained;
+        sm->on_drained_context = context;
+        result = true;
+    }
+    return result;
+}
+
+/*called last by sm_close_begin_async/sm_barrier_begin_async, after the state was switched to draining with SM_ASYNC_BIT. n_to_drain is n at the switch (after sm_freeze_shards when n is sharded): if it was 0 no sm_exec_end will see n reaching 0, so this thread calls the callback. Otherwise the callback is published and, from then on, sm is not touched by this thread (the callback might destroy it)*/
+static void sm_publish_async(SM_HANDLE sm, int32_t n_to_drain)
+{
+    if (
+        (n_to_drain == 0) ||
+        (interlocked_compare_exchange(&sm->async_state, SM_ASYNC_ARMED, SM_ASYNC_ARMING) != SM_ASYNC_ARMING) /*n reached 0 while the callback was being published*/
+        )
+    {
+        (void)interlocked_exchange(&sm->async_state, SM_ASYNC_COMPLETING);
+        sm_complete_async(sm);
+    }
+    else
+    {
+        /*the sm_exec_end that makes n reach 0 calls the callback*/
+    }
+}
+
+/*subtracts count from n in the state word. If that makes n reach 0 while draining then the barrier/close is signalled without touching sm after the subtraction (the waiter can return and destroy sm as soon as n is 0). The same goes for waking up the throttled sm_exec_begin calls*/
+static void sm_exec_end_word(SM_HANDLE sm, int32_t count)
+{
+    /*everything needed from sm is read before the subtraction: after it, another sm_exec_end can make n reach 0 and sm can be destroyed*/
+    /*a shard cannot know if the sum of the shards would become negative, so only n that is not sharded is saturated*/
+    bool saturate = (sm->shard_count == 0);
+    bool capped = (sm->max_exec_count != 0);
+
+    int64_t word; /*the word after the subtraction*/
+    bool wake_throttled;
+    if (capped)
+    {
+        /*Codes_SRS_SM_02_162: [ If n is capped then sm_exec_end shall decrement n and set SM_THROTTLE_BIT to 0 in the same atomic operation. ]*/
+        /*the waiters to wake are known from the word that was replaced, not from sm*/
+        INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+        do
+        {
+            int64_t old_word = interlocked_add_64(&sm->state, 0);
+            word = (old_word - count * SM_N_INCREMENT) & ~(int64_t)SM_THROTTLE_BIT;
+            if (interlocked_compare_exchange_64(&sm->state, word, old_word) == old_word)
+            {
+                wake_throttled = ((SM_STATE_OF(old_word) & SM_THROTTLE_BIT) == SM_THROTTLE_BIT);
+                break;
+            }
+            sm_count(sm, SM_COUNTER_CAS_RETRIES);
+            (void)InterlockedHL_Backoff(&backoff);
+        } while (1);
+    }
+    else
+    {
+        word = interlocked_add_64(&sm->state, -count * SM_N_INCREMENT); /*returns the word after the subtraction*/
+        wake_throttled = false;
+    }
+
+    int32_t n = SM_N_OF(word);
+    if (
+        saturate &&
+        (n < 0)
+        )
+    {
+        /*Codes_SRS_SM_02_062: [ sm_exec_end shall decrement n with saturation at 0. ]*/
+        /*too many sm_exec_end, put back what was subtracted below 0*/
+        LogError("sm name=%s. sm_exec_end called more times than sm_exec_begin was granted (n would be %" PRId32 ")", sm->name, n);
+        (void)interlocked_add_64(&sm->state, -(int64_t)n * SM_N_INCREMENT);
+    }
+    else
+    {
+        if (
+            (n == 0) &&
+            (
+                ((SM_STATE_OF(word) & SM_STATE_MASK) == SM_OPENED_DRAINING_TO_BARRIER) ||
+                ((SM_STATE_OF(word) & SM_STATE_MASK) == SM_OPENED_DRAINING_TO_CLOSE)
+            )
+            )
+        {
+            /*Codes_SRS_SM_02_063: [ If n reaches 0 then sm_exec_end shall signal that. ]*/
+            if ((SM_STATE_OF(word) & SM_ASYNC_BIT) == SM_ASYNC_BIT)
+            {
+                /*Codes_SRS_SM_02_107: [ When n reaches 0 while draining, the thread that observes it shall call the callback of the pending sm_close_begin_async or sm_barrier_begin_async. ]*/
+                sm_exec_end_drained_async(sm);
+            }
+            else
+            {
+                /*Codes_SRS_SM_02_155: [ If n reaches 0 in the state word while draining for sm_close_begin or sm_barrier_begin then sm_exec_end shall call InterlockedHL_WakeAll64 on the state word and shall not access sm after decrementing n. ]*/
+                /*InterlockedHL_WakeAll64 only uses the address*/
+                (void)InterlockedHL_WakeAll64(&sm->state);
+            }
+        }
+        else if (wake_throttled)
+        {
+            /*Codes_SRS_SM_02_127: [ If SM_THROTTLE_BIT was 1 then sm_exec_end shall call InterlockedHL_WakeAll64 on the state word and shall not access sm after decrementing n. ]*/
+            /*InterlockedHL_WakeAll64 only uses the address*/
+            (void)InterlockedHL_WakeAll64(&sm->state);
+        }
+    }
+}
+
+/*waits for n to reach 0. Called after the state was switched to draining*/
+static INTERLOCKED_HL_RESULT sm_wait_for_n_to_reach_0(SM_HANDLE sm)
+{
+    INTERLOCKED_HL_RESULT result;
+    double start_ms = (sm->statistics_slot_count != 0) ? timer_global_get_elapsed_ms() : 0;
+
+    if (sm->shard_count != 0)
+    {
+        /*Codes_SRS_SM_02_157: [ If n is sharded then sm_close_begin, sm_barrier_begin, sm_close_begin_async and sm_barrier_begin_async shall, after switching the state to draining, freeze every shard of n and add the values of the shards to n in the state word. ]*/
+        (void)sm_freeze_shards(sm);
+    }
+
+    do
+    {
+        int64_t word = interlocked_add_64(&sm->state, 0);
+        if (SM_N_OF(word) <= 0)
+        {
+            result = INTERLOCKED_HL_OK;
+            break;
+        }
+
+        /*the subtraction of the sm_exec_end that makes n reach 0 changes the word, and that sm_exec_end wakes up this thread without touching sm again (sm can be destroyed as soon as this returns)*/
+        if (InterlockedHL_WaitForNotValue64(&sm->state, word, UINT32_MAX) != INTERLOCKED_HL_OK)
+        {
+            LogError("sm name=%s. failure in InterlockedHL_WaitForNotValue64(&sm->state=%p, word=%" PRIx64 ", UINT32_MAX)", sm->name, &sm->state, (uint64_t)word);
+            result = INTERLOCKED_HL_ERROR;
+            break;
+        }
+    } while (1);
+
+    if (
+        (result == INTERLOCKED_HL_OK) &&
+        (sm->statistics_slot_count != 0)
+        )
+    {
+        /*Codes_SRS_SM_02_130: [ If statistics are collected then sm_barrier_begin and sm_close_begin shall add the time spent waiting for n to reach 0 to a histogram with logarithmic buckets. ]*/
+        sm_count(sm, (SM_COUNTER)(SM_COUNTER_DRAIN_WAIT_HISTOGRAM + sm_drain_wait_bucket(timer_global_get_elapsed_ms() - start_ms)));
+    }
+    return result;
+}
+
 /*forwards*/
 static SM_RESULT sm_close_begin_internal(SM_HANDLE sm);
 static void sm_close_end_internal(SM_HANDLE sm);
@@ -105,6 +703,14 @@ void sm_destroy(SM_HANDLE sm)
         }
 
         /*Codes_SRS_SM_02_006: [ sm_destroy shall free all used resources. ]*/
+        if (sm->shards_memory != NULL)
+        {
+            free(sm->shards_memory);
+        }
+        if (sm->statistics_memory != NULL)
+        {
+            free(sm->statistics_memory);
+        }
         free(sm);
     }
 }
@@ -121,7 +727,7 @@ int sm_open_begin(SM_HANDLE sm)
     else
     {
         /*Codes_SRS_SM_02_039: [ If the state is not SM_CREATED then sm_open_begin shall return SM_EXEC_REFUSED. ]*/
-        int32_t state = interlocked_add(&sm->state, 0);
+        int32_t state = sm_get_state(sm);
         if ((state & SM_STATE_MASK) != SM_CREATED)
         {
             LogError("sm name=%s. Cannot sm_open_begin that which is in %" PRI_SM_STATE " state", sm->name, SM_STATE_VALUE(state));
@@ -130,9 +736,10 @@ int sm_open_begin(SM_HANDLE sm)
         else
         {
             /*Codes_SRS_SM_02_040: [ sm_open_begin shall switch the state to SM_OPENING. ]*/
-            if (interlocked_compare_exchange(&sm->state, state - SM_CREATED + SM_OPENING + SM_STATE_INCREMENT, state) != state)
+            if (sm_state_compare_exchange(sm, state - SM_CREATED + SM_OPENING + SM_STATE_INCREMENT, state) != state)
             {
                 LogError("sm name=%s. sm_open_begin state changed meanwhile (it was %" PRI_SM_STATE "). likely competing threads.", sm->name, SM_STATE_VALUE(state));
+                sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
                 result = SM_EXEC_REFUSED;
             }
             else
@@ -141,6 +748,9 @@ int sm_open_begin(SM_HANDLE sm)
                 result = SM_EXEC_GRANTED;
             }
         }
+
+        /*Codes_SRS_SM_02_131: [ If statistics are collected then sm_open_begin, sm_close_begin, sm_close_begin_async, sm_exec_begin, sm_exec_begin_n, sm_barrier_begin and sm_barrier_begin_async shall count the calls that returned SM_EXEC_GRANTED and SM_EXEC_REFUSED. ]*/
+        sm_count_result(sm, result, SM_COUNTER_OPEN_BEGIN_GRANTED, SM_COUNTER_OPEN_BEGIN_REFUSED);
     }
     return result;
 }
@@ -155,7 +765,7 @@ void sm_open_end(SM_HANDLE sm, bool success)
     else
     {
         /*Codes_SRS_SM_02_041: [ If state is not SM_OPENING then sm_open_end shall return. ]*/
-        int32_t state = interlocked_add(&sm->state, 0);
+        int32_t state = sm_get_state(sm);
         if ((state & SM_STATE_MASK) != SM_OPENING)
         {
             LogError("sm name=%s. cannot sm_open_end that which is in %" PRI_SM_STATE " state", sm->name, SM_STATE_VALUE(state));
@@ -165,9 +775,10 @@ void sm_open_end(SM_HANDLE sm, bool success)
             if (success)
             {
                 /*Codes_SRS_SM_02_074: [ If success is true then sm_open_end shall switch the state to SM_OPENED. ]*/
-                if (interlocked_compare_exchange(&sm->state, state - SM_OPENING + SM_OPENED + SM_STATE_INCREMENT, state) != state)
+                if (sm_state_compare_exchange(sm, state - SM_OPENING + SM_OPENED + SM_STATE_INCREMENT, state) != state)
                 {
                     LogError("sm name=%s. sm_open_end state changed meanwhile (it was %" PRI_SM_STATE ", likely competing threads.", sm->name, SM_STATE_VALUE(state));
+                    sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
                 }
                 else
                 {
@@ -177,9 +788,10 @@ void sm_open_end(SM_HANDLE sm, bool success)
             else
             {
                 /*Codes_SRS_SM_02_075: [ If success is false then sm_open_end shall switch the state to SM_CREATED. ]*/
-                if (interlocked_compare_exchange(&sm->state, state - SM_OPENING + SM_CREATED + SM_STATE_INCREMENT, state) != state)
+                if (sm_state_compare_exchange(sm, state - SM_OPENING + SM_CREATED + SM_STATE_INCREMENT, state) != state)
                 {
                     LogError("sm name=%s. sm_open_end state changed meanwhile (it was %" PRI_SM_STATE ", likely competing threads.", sm->name, SM_STATE_VALUE(state));
+                    sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
                 }
                 else
                 {
@@ -196,7 +808,7 @@ static SM_RESULT sm_close_begin_internal(SM_HANDLE sm)
 
     int32_t state;
     /*Codes_SRS_SM_02_045: [ sm_close_begin shall set SM_CLOSE_BIT to 1. ]*/
-    if (((state=interlocked_or(&sm->state, SM_CLOSE_BIT)) & SM_CLOSE_BIT) == SM_CLOSE_BIT)
+    if (((state = SM_STATE_OF(interlocked_or_64(&sm->state, SM_CLOSE_BIT))) & SM_CLOSE_BIT) == SM_CLOSE_BIT)
     {
         /*Codes_SRS_SM_02_046: [ If SM_CLOSE_BIT was already 1 then sm_close_begin shall return SM_EXEC_REFUSED. ]*/
         LogError("sm name=%s. another thread is performing close (state=%" PRI_SM_STATE ")", sm->name, SM_STATE_VALUE(state));
@@ -204,31 +816,44 @@ static SM_RESULT sm_close_begin_internal(SM_HANDLE sm)
     }
     else
     {
+        INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
         do
         {
-            state = interlocked_add(&sm->state, 0);
+            /*state_signal is read before the state so that any state change that happens after the state was read will wake up this thread*/
+            int32_t state_signal = interlocked_add(&sm->state_signal, 0);
+            state = sm_get_state(sm);
 
             /*Codes_SRS_SM_02_047: [ If the state is SM_OPENED then sm_close_begin shall switch it to SM_OPENED_DRAINING_TO_CLOSE. ]*/
             if ((state & SM_STATE_MASK) == SM_OPENED)
             {
-                if (interlocked_compare_exchange(&sm->state, state - SM_OPENED + SM_OPENED_DRAINING_TO_CLOSE + SM_STATE_INCREMENT, state) != state)
+                if (sm_state_compare_exchange(sm, state - SM_OPENED + SM_OPENED_DRAINING_TO_CLOSE + SM_STATE_INCREMENT, state) != state)
                 {
                     /*go and retry*/
+                    sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
+                    /*Codes_SRS_SM_02_153: [ If the state changed meanwhile then sm_close_begin shall call InterlockedHL_Backoff before re-evaluating the state. ]*/
+                    (void)InterlockedHL_Backoff(&backoff);
                 }
                 else
                 {
+                    /*Codes_SRS_SM_02_089: [ sm_close_begin shall signal every state change it makes. ]*/
+                    sm_signal_state_change(sm);
+
                     /*Codes_SRS_SM_02_048: [ sm_close_begin shall wait for n to reach 0. ]*/
-                    if (InterlockedHL_WaitForValue(&sm->non_barrier_call_count, 0, UINT32_MAX) != INTERLOCKED_HL_OK)
+                    /*Codes_SRS_SM_02_084: [ If n is sharded then sm_close_begin shall wait for n in the state word to reach 0 after freezing the shards of n. ]*/
+                    if (sm_wait_for_n_to_reach_0(sm) != INTERLOCKED_HL_OK)
                     {
                         /*Codes_SRS_SM_02_071: [ If there are any failures then sm_close_begin shall fail and return SM_ERROR. ]*/
-                        LogError("sm name=%s. failure in InterlockedHL_WaitForValue(&sm->non_barrier_call_count=%p, 0, UINT32_MAX), state was %" PRI_SM_STATE "", sm->name, &sm->non_barrier_call_count, SM_STATE_VALUE(state));
-                        (void)interlocked_add(&sm->state, -SM_OPENED_DRAINING_TO_CLOSE + SM_OPENED + SM_STATE_INCREMENT); /*undo state to SM_OPENED...*/
+                        LogError("sm name=%s. failure in sm_wait_for_n_to_reach_0(sm=%p), state was %" PRI_SM_STATE "", sm->name, sm, SM_STATE_VALUE(state));
+                        sm_thaw_shards(sm);
+                        (void)sm_state_add(sm, -SM_OPENED_DRAINING_TO_CLOSE + SM_OPENED + SM_STATE_INCREMENT); /*undo state to SM_OPENED...*/
+                        sm_signal_state_change(sm);
                         result = SM_ERROR;
                         break;
                     }
                     
                     /*Codes_SRS_SM_02_049: [ sm_close_begin shall switch the state to SM_CLOSING and return SM_EXEC_GRANTED. ]*/
-                    (void)interlocked_add(&sm->state, -SM_OPENED_DRAINING_TO_CLOSE + SM_CLOSING + SM_STATE_INCREMENT);
+                    (void)sm_state_add(sm, -SM_OPENED_DRAINING_TO_CLOSE + SM_CLOSING + SM_STATE_INCREMENT);
+                    sm_signal_state_change(sm);
                     result = SM_EXEC_GRANTED;
                     break;
                 }
@@ -240,7 +865,14 @@ static SM_RESULT sm_close_begin_internal(SM_HANDLE sm)
                 ((state & SM_STATE_MASK) == SM_OPENED_DRAINING_TO_BARRIER)
                 )
             {
-                Sleep(1);
+                /*Codes_SRS_SM_02_090: [ If the state is SM_OPENED_BARRIER or SM_OPENED_DRAINING_TO_BARRIER then sm_close_begin shall wait for the state to change before re-evaluating it. ]*/
+                if (InterlockedHL_WaitForNotValue(&sm->state_signal, state_signal, UINT32_MAX) != INTERLOCKED_HL_OK)
+                {
+                    /*Codes_SRS_SM_02_071: [ If there are any failures then sm_close_begin shall fail and return SM_ERROR. ]*/
+                    LogError("sm name=%s. failure in InterlockedHL_WaitForNotValue(&sm->state_signal=%p, state_signal=%" PRId32 ", UINT32_MAX), state was %" PRI_SM_STATE "", sm->name, &sm->state_signal, state_signal, SM_STATE_VALUE(state));
+                    result = SM_ERROR;
+                    break;
+                }
             }
             else
             {
@@ -251,7 +883,7 @@ static SM_RESULT sm_close_begin_internal(SM_HANDLE sm)
         } while (1);
 
         /*Codes_SRS_SM_02_053: [ sm_close_begin shall set SM_CLOSE_BIT to 0. ]*/
-        (void)interlocked_and(&sm->state, ~(uint32_t)SM_CLOSE_BIT);
+        (void)interlocked_and_64(&sm->state, ~(int64_t)SM_CLOSE_BIT);
     }
     return result;
 }
@@ -269,23 +901,28 @@ SM_RESULT sm_close_begin(SM_HANDLE sm)
     else
     {
         result = sm_close_begin_internal(sm);
+
+        sm_count_result(sm, result, SM_COUNTER_CLOSE_BEGIN_GRANTED, SM_COUNTER_CLOSE_BEGIN_REFUSED);
     }
-    
+
     return result;
 }
 
 static void sm_close_end_internal(SM_HANDLE sm)
 {
     /*Codes_SRS_SM_02_043: [ If the state is not SM_CLOSING then sm_close_end shall return. ]*/
-    int32_t state = interlocked_add(&sm->state, 0);
+    int32_t state = sm_get_state(sm);
     if ((state & SM_STATE_MASK) != SM_CLOSING)
     {
         LogError("sm name=%s. cannot sm_close_end_internal that which is in %" PRI_SM_STATE " state", sm->name, SM_STATE_VALUE(state));
     }
     else
     {
+        /*Codes_SRS_SM_02_160: [ If n is sharded then sm_close_end shall set all the shards of n to 0 before switching the state to SM_CREATED. ]*/
+        sm_thaw_shards(sm);
+
         /*Codes_SRS_SM_02_044: [ sm_close_end shall switch the state to SM_CREATED. ]*/
-        if (interlocked_compare_exchange(&sm->state, state - SM_CLOSING + SM_CREATED + SM_STATE_INCREMENT, state) != state)
+        if (sm_state_compare_exchange(sm, state - SM_CLOSING + SM_CREATED + SM_STATE_INCREMENT, state) != state)
         {
             LogError("sm name=%s. state changed meanwhile (it was %" PRI_SM_STATE "), likely competing threads", sm->name, SM_STATE_VALUE(state));
         }
@@ -309,18 +946,115 @@ void sm_close_end(SM_HANDLE sm)
     }
 }
 
-SM_RESULT sm_exec_begin(SM_HANDLE sm)
+/*waits until the state word is different than word. Used by sm_exec_begin when n reached max_exec_count*/
+static INTERLOCKED_HL_RESULT sm_wait_for_throttle(SM_HANDLE sm, int64_t word)
+{
+    INTERLOCKED_HL_RESULT result;
+
+    /*Codes_SRS_SM_02_161: [ If n + count would be greater than max_exec_count and wait_when_throttled is true then sm_exec_begin shall set SM_THROTTLE_BIT in the state word if the state word did not change and wait for the state word to change. ]*/
+    /*SM_THROTTLE_BIT tells the sm_exec_end that decrements n that there is someone to wake up. It is only set in the word that was evaluated: if n or the state changed meanwhile there is nothing to wait for*/
+    int64_t throttled_word = word | SM_THROTTLE_BIT;
+    if (
+        (throttled_word != word) &&
+        (interlocked_compare_exchange_64(&sm->state, throttled_word, word) != word)
+        )
+    {
+        /*changed meanwhile, re-evaluate*/
+        result = INTERLOCKED_HL_OK;
+    }
+    else
+    {
+        result = InterlockedHL_WaitForNotValue64(&sm->state, throttled_word, UINT32_MAX);
+        if (result != INTERLOCKED_HL_OK)
+        {
+            LogError("sm name=%s. failure in InterlockedHL_WaitForNotValue64(&sm->state=%p, throttled_word=%" PRIx64 ", UINT32_MAX)", sm->name, &sm->state, (uint64_t)throttled_word);
+        }
+    }
+    return result;
+}
+
+static SM_RESULT sm_exec_begin_internal(SM_HANDLE sm, int32_t count)
 {
     SM_RESULT result;
-    /*Codes_SRS_SM_02_021: [ If sm is NULL then sm_exec_begin shall fail and return SM_ERROR. ]*/
-    if (sm == NULL)
+    if (sm->shard_count == 0)
     {
-        LogError("invalid argument SM_HANDLE sm=%p", sm);
-        result = SM_ERROR;
+        INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+        do
+        {
+            int64_t word = interlocked_add_64(&sm->state, 0);
+            int32_t state = SM_STATE_OF(word);
+            if (
+                /*Codes_SRS_SM_02_054: [ If state is not SM_OPENED then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/
+                ((state & SM_STATE_MASK) != SM_OPENED) ||
+                /*Codes_SRS_SM_02_055: [ If SM_CLOSE_BIT is 1 then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/
+                ((state & SM_CLOSE_BIT) == SM_CLOSE_BIT)
+                )
+            {
+                LogErrorRateLimited("sm name=%s. cannot call sm_exec_begin when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state));
+                /*Codes_SRS_SM_02_140: [ If sm.c is compiled with SM_TRACE then every sm_exec_begin/sm_exec_begin_n refused because of the state shall be recorded in the trace as a transition from the state to itself. ]*/
+                SM_TRACE_TRANSITION(sm, state, state);
+                result = SM_EXEC_REFUSED;
+                break;
+            }
+
+            /*Codes_SRS_SM_02_096: [ If n + count would overflow then sm_exec_begin_n shall return SM_EXEC_REFUSED. ]*/
+            if (SM_N_OF(word) > INT32_MAX - count)
+            {
+                LogError("sm name=%s. n=%" PRId32 " cannot be incremented by count=%" PRId32 "", sm->name, SM_N_OF(word), count);
+                result = SM_EXEC_REFUSED;
+                break;
+            }
+
+            if (sm->max_exec_count != 0)
+            {
+                if (count > sm->max_exec_count)
+                {
+                    /*Codes_SRS_SM_02_123: [ If count is greater than max_exec_count then sm_exec_begin_n shall return SM_EXEC_REFUSED. ]*/
+                    LogError("sm name=%s. count=%" PRId32 " can never be granted, max_exec_count=%" PRId32 "", sm->name, count, sm->max_exec_count);
+                    result = SM_EXEC_REFUSED;
+                    break;
+                }
+
+                /*the cap is checked against the same word that is compare-exchanged below, so n never goes above max_exec_count*/
+                if (SM_N_OF(word) > sm->max_exec_count - count)
+                {
+                    if (!sm->wait_when_throttled)
+                    {
+                        /*Codes_SRS_SM_02_124: [ If n + count would be greater than max_exec_count and wait_when_throttled is false then sm_exec_begin shall return SM_EXEC_THROTTLED. ]*/
+                        result = SM_EXEC_THROTTLED;
+                        break;
+                    }
+
+                    /*Codes_SRS_SM_02_125: [ If n + count would be greater than max_exec_count and wait_when_throttled is true then sm_exec_begin shall wait for n or the state to change and re-evaluate the state. ]*/
+                    if (sm_wait_for_throttle(sm, word) != INTERLOCKED_HL_OK)
+                    {
+                        /*Codes_SRS_SM_02_126: [ If waiting fails then sm_exec_begin shall return SM_ERROR. ]*/
+                        LogError("sm name=%s. failure in sm_wait_for_throttle(sm=%p, word=%" PRIx64 ")", sm->name, sm, (uint64_t)word);
+                        result = SM_ERROR;
+                        break;
+                    }
+                    continue;
+                }
+            }
+
+            /*Codes_SRS_SM_02_056: [ sm_exec_begin shall increment n. ]*/
+            /*Codes_SRS_SM_02_086: [ If n is not sharded then sm_exec_begin shall increment n only if the state did not change, in the same atomic operation. ]*/
+            if (interlocked_compare_exchange_64(&sm->state, word + count * SM_N_INCREMENT, word) == word)
+            {
+                /*Codes_SRS_SM_02_058: [ sm_exec_begin shall return SM_EXEC_GRANTED. ]*/
+                result = SM_EXEC_GRANTED;
+                break;
+            }
+
+            /*Codes_SRS_SM_02_087: [ If the state or n changed meanwhile then sm_exec_begin shall re-evaluate the state. ]*/
+            sm_count(sm, SM_COUNTER_CAS_RETRIES);
+            /*Codes_SRS_SM_02_152: [ If the state or n changed meanwhile then sm_exec_begin shall call InterlockedHL_Backoff before re-evaluating the state. ]*/
+            (void)InterlockedHL_Backoff(&backoff);
+        } while (1);
     }
     else
     {
-        int32_t state1 = interlocked_add(&sm->state, 0);
+        int32_t state1 = sm_get_state(sm);
         if (
             /*Codes_SRS_SM_02_054: [ If state is not SM_OPENED then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/
             ((state1 & SM_STATE_MASK) != SM_OPENED) ||
@@ -328,33 +1062,114 @@ SM_RESULT sm_exec_begin(SM_HANDLE sm)
             ((state1 & SM_CLOSE_BIT) == SM_CLOSE_BIT)
             )
         {
-            LogError("sm name=%s. cannot call sm_exec_begin when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state1));
+            LogErrorRateLimited("sm name=%s. cannot call sm_exec_begin when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state1));
+            /*Codes_SRS_SM_02_140: [ If sm.c is compiled with SM_TRACE then every sm_exec_begin/sm_exec_begin_n refused because of the state shall be recorded in the trace as a transition from the state to itself. ]*/
+            SM_TRACE_TRANSITION(sm, state1, state1);
             result = SM_EXEC_REFUSED;
         }
         else
         {
-            /*Codes_SRS_SM_02_056: [ sm_exec_begin shall increment n. ]*/
-            (void)interlocked_increment(&sm->non_barrier_call_count);
-            int32_t state2 = interlocked_add(&sm->state, 0);
-
-            /*Codes_SRS_SM_02_057: [ If the state changed after incrementing n then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/
-            if (state1 != state2)
+            /*Codes_SRS_SM_02_080: [ If n is sharded then sm_exec_begin shall increment the shard of n of the current processor. ]*/
+            volatile_atomic int32_t* shard_n = sm_get_current_shard_n(sm);
+            if (!sm_shard_add(shard_n, count))
             {
-                LogError("sm name=%s. state changed meanwhile from %" PRI_SM_STATE " to %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state1), SM_STATE_VALUE(state2));
-                int32_t n = interlocked_decrement(&sm->non_barrier_call_count);
-                if (n == 0)
+                /*Codes_SRS_SM_02_158: [ If n is sharded and the shard of n of the current processor is frozen then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/
+                LogErrorRateLimited("sm name=%s. state changed meanwhile from %" PRI_SM_STATE ", the shards of n are frozen", sm->name, SM_STATE_VALUE(state1));
+                sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
+                /*Codes_SRS_SM_02_140: [ If sm.c is compiled with SM_TRACE then every sm_exec_begin/sm_exec_begin_n refused because of the state shall be recorded in the trace as a transition from the state to itself. ]*/
+                SM_TRACE_TRANSITION(sm, state1, state1);
+                result = SM_EXEC_REFUSED;
+            }
+            else
+            {
+                int32_t state2 = sm_get_state(sm);
+
+                /*Codes_SRS_SM_02_057: [ If n is sharded and the state changed after incrementing n then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/
+                if (state1 != state2)
                 {
-                    WakeByAddressSingle((void*)&sm->non_barrier_call_count);
+                    LogErrorRateLimited("sm name=%s. state changed meanwhile from %" PRI_SM_STATE " to %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state1), SM_STATE_VALUE(state2));
+                    sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
+                    /*Codes_SRS_SM_02_140: [ If sm.c is compiled with SM_TRACE then every sm_exec_begin/sm_exec_begin_n refused because of the state shall be recorded in the trace as a transition from the state to itself. ]*/
+                    SM_TRACE_TRANSITION(sm, state2, state2);
+
+                    /*if the shard was frozen meanwhile then the increment was added to the state word and a barrier/close waits for it*/
+                    if (!sm_shard_add(shard_n, -count))
+                    {
+                        sm_exec_end_word(sm, count);
+                    }
+                    result = SM_EXEC_REFUSED;
+                }
+                else
+                {
+                    /*Codes_SRS_SM_02_058: [ sm_exec_begin shall return SM_EXEC_GRANTED. ]*/
+                    result = SM_EXEC_GRANTED;
                 }
-                result = SM_EXEC_REFUSED;
+            }
+        }
+    }
+
+    if (result == SM_EXEC_THROTTLED)
+    {
+        /*Codes_SRS_SM_02_132: [ If statistics are collected then sm_exec_begin and sm_exec_begin_n shall count the calls that returned SM_EXEC_THROTTLED. ]*/
+        sm_count(sm, SM_COUNTER_EXEC_BEGIN_THROTTLED);
+    }
+    else
+    {
+        sm_count_result(sm, result, SM_COUNTER_EXEC_BEGIN_GRANTED, SM_COUNTER_EXEC_BEGIN_REFUSED);
+    }
+    return result;
+}
+
+static void sm_exec_end_internal(SM_HANDLE sm, int32_t count)
+{
+    int32_t state = sm_get_state(sm);
+    if (
+        /*Codes_SRS_SM_02_059: [ If state is not SM_OPENED then sm_exec_end shall return. ]*/
+        ((state & SM_STATE_MASK) != SM_OPENED) &&
+        /*Codes_SRS_SM_02_060: [ If state is not SM_OPENED_DRAINING_TO_BARRIER then sm_exec_end shall return. ]*/
+        ((state & SM_STATE_MASK) != SM_OPENED_DRAINING_TO_BARRIER) &&
+        /*Codes_SRS_SM_02_061: [ If state is not SM_OPENED_DRAINING_TO_CLOSE then sm_exec_end shall return. ]*/
+        ((state & SM_STATE_MASK) != SM_OPENED_DRAINING_TO_CLOSE)
+        )
+    {
+        LogErrorRateLimited("sm name=%s. cannot execute exec end when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state));
+    }
+    else
+    {
+        if (sm->shard_count == 0)
+        {
+            /*Codes_SRS_SM_02_088: [ If n is not sharded then sm_exec_end shall decrement n with one atomic subtraction. ]*/
+            sm_exec_end_word(sm, count);
+        }
+        else
+        {
+            /*Codes_SRS_SM_02_081: [ If n is sharded and the shard of n of the current processor is not frozen then sm_exec_end shall decrement the shard. ]*/
+            if (!sm_shard_add(sm_get_current_shard_n(sm), -count))
+            {
+                /*Codes_SRS_SM_02_082: [ If n is sharded and the shard of n of the current processor is frozen then sm_exec_end shall decrement n in the state word with one atomic subtraction. ]*/
+                sm_exec_end_word(sm, count);
             }
             else
             {
-                /*Codes_SRS_SM_02_058: [ sm_exec_begin shall return SM_EXEC_GRANTED. ]*/
-                result = SM_EXEC_GRANTED;
+                /*the barrier/close that freezes the shard collects this decrement*/
             }
         }
     }
+}
+
+SM_RESULT sm_exec_begin(SM_HANDLE sm)
+{
+    SM_RESULT result;
+    /*Codes_SRS_SM_02_021: [ If sm is NULL then sm_exec_begin shall fail and return SM_ERROR. ]*/
+    if (sm == NULL)
+    {
+        LogError("invalid argument SM_HANDLE sm=%p", sm);
+        result = SM_ERROR;
+    }
+    else
+    {
+        result = sm_exec_begin_internal(sm, 1);
+    }
     return result;
 }
 
@@ -367,99 +1182,271 @@ void sm_exec_end(SM_HANDLE sm)
     }
     else
     {
-        int32_t state = interlocked_add(&sm->state, 0);
+        sm_exec_end_internal(sm, 1);
+    }
+}
+
+SM_RESULT sm_exec_begin_n(SM_HANDLE sm, uint32_t count)
+{
+    SM_RESULT result;
+    if (
+        /*Codes_SRS_SM_02_093: [ If sm is NULL then sm_exec_begin_n shall fail and return SM_ERROR. ]*/
+        (sm == NULL) ||
+        /*Codes_SRS_SM_02_094: [ If count is 0 or greater than INT32_MAX then sm_exec_begin_n shall fail and return SM_ERROR. ]*/
+        (count == 0) ||
+        (count > INT32_MAX)
+        )
+    {
+        LogError("invalid argument SM_HANDLE sm=%p, uint32_t count=%" PRIu32 "", sm, count);
+        result = SM_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_SM_02_095: [ sm_exec_begin_n shall behave as sm_exec_begin, except that it shall increment n by count in the same atomic operation. ]*/
+        result = sm_exec_begin_internal(sm, (int32_t)count);
+    }
+    return result;
+}
+
+void sm_exec_end_n(SM_HANDLE sm, uint32_t count)
+{
+    if (
+        /*Codes_SRS_SM_02_097: [ If sm is NULL then sm_exec_end_n shall return. ]*/
+        (sm == NULL) ||
+        /*Codes_SRS_SM_02_098: [ If count is 0 or greater than INT32_MAX then sm_exec_end_n shall return. ]*/
+        (count == 0) ||
+        (count > INT32_MAX)
+        )
+    {
+        LogError("invalid argument SM_HANDLE sm=%p, uint32_t count=%" PRIu32 "", sm, count);
+    }
+    else
+    {
+        /*Codes_SRS_SM_02_099: [ sm_exec_end_n shall behave as sm_exec_end, except that it shall decrement n by count in the same atomic operation. ]*/
+        sm_exec_end_internal(sm, (int32_t)count);
+    }
+}
+
+SM_RESULT sm_barrier_begin(SM_HANDLE sm)
+{
+    SM_RESULT result;
+    /*Codes_SRS_SM_02_027: [ If sm is NULL then sm_barrier_begin shall fail and return SM_ERROR. ]*/
+    if (sm == NULL)
+    {
+        LogError("invalid arg SM_HANDLE sm=%p", sm);
+        result = SM_ERROR;
+    }
+    else
+    {
+        int32_t state = sm_get_state(sm);
         if (
-            /*Codes_SRS_SM_02_059: [ If state is not SM_OPENED then sm_exec_end shall return. ]*/
-            ((state & SM_STATE_MASK) != SM_OPENED) &&
-            /*Codes_SRS_SM_02_060: [ If state is not SM_OPENED_DRAINING_TO_BARRIER then sm_exec_end shall return. ]*/
-            ((state & SM_STATE_MASK) != SM_OPENED_DRAINING_TO_BARRIER) &&
-            /*Codes_SRS_SM_02_061: [ If state is not SM_OPENED_DRAINING_TO_CLOSE then sm_exec_end shall return. ]*/
-            ((state & SM_STATE_MASK) != SM_OPENED_DRAINING_TO_CLOSE)
+            /*Codes_SRS_SM_02_064: [ If state is not SM_OPENED then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+            ((state & SM_STATE_MASK) != SM_OPENED) ||
+            /*Codes_SRS_SM_02_065: [ If SM_CLOSE_BIT is set to 1 then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+            ((state & SM_CLOSE_BIT) == SM_CLOSE_BIT)
             )
         {
-            LogError("sm name=%s. cannot execute exec end when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state));
+            LogErrorRateLimited("sm name=%s. cannot execute barrier begin when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state));
+            result = SM_EXEC_REFUSED;
         }
         else
         {
-            /*Codes_SRS_SM_02_062: [ sm_exec_end shall decrement n with saturation at 0. ]*/
-            do /*a rather convoluted loop to make _end be idempotent (too many _end will be ignored)*/
+            /*Codes_SRS_SM_02_066: [ sm_barrier_begin shall switch the state to SM_OPENED_DRAINING_TO_BARRIER. ]*/
+            if (sm_state_compare_exchange(sm, state - SM_OPENED + SM_OPENED_DRAINING_TO_BARRIER + SM_STATE_INCREMENT, state) != state)
+            {
+                /*Codes_SRS_SM_02_067: [ If the state changed meanwhile then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+                LogErrorRateLimited("sm name=%s. state changed meanwhile (it was %" PRI_SM_STATE "), this thread cannot start a barrier, likely competing threads", sm->name, SM_STATE_VALUE(state));
+                sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
+                result = SM_EXEC_REFUSED;
+            }
+            else
             {
-                int32_t n = interlocked_add(&sm->non_barrier_call_count, 0);
-                if (n <= 0)
+                /*Codes_SRS_SM_02_091: [ sm_barrier_begin shall signal every state change it makes. ]*/
+                sm_signal_state_change(sm);
+
+                /*Codes_SRS_SM_02_068: [ sm_barrier_begin shall wait for n to reach 0. ]*/
+                /*Codes_SRS_SM_02_085: [ If n is sharded then sm_barrier_begin shall wait for n in the state word to reach 0 after freezing the shards of n. ]*/
+                if (sm_wait_for_n_to_reach_0(sm) != INTERLOCKED_HL_OK)
                 {
-                    break;
+                    /*switch back the state*/
+                    /*Codes_SRS_SM_02_070: [ If there are any failures then sm_barrier_begin shall return SM_ERROR. ]*/
+                    sm_thaw_shards(sm);
+                    (void)sm_state_add(sm, -SM_OPENED_DRAINING_TO_BARRIER + SM_OPENED + SM_STATE_INCREMENT);
+                    /*Codes_SRS_SM_02_091: [ sm_barrier_begin shall signal every state change it makes. ]*/
+                    sm_signal_state_change(sm);
+                    LogError("sm name=%s. failure in sm_wait_for_n_to_reach_0(sm=%p), state was %" PRI_SM_STATE "", sm->name, sm, SM_STATE_VALUE(state));
+                    result = SM_ERROR;
                 }
                 else
                 {
-                    if (interlocked_compare_exchange(&sm->non_barrier_call_count, n - 1, n) != n)
+                    /*Codes_SRS_SM_02_069: [ sm_barrier_begin shall switch the state to SM_OPENED_BARRIER and return SM_EXEC_GRANTED. ]*/
+                    (void)sm_state_add(sm, -SM_OPENED_DRAINING_TO_BARRIER + SM_OPENED_BARRIER + SM_STATE_INCREMENT);
+                    /*Codes_SRS_SM_02_091: [ sm_barrier_begin shall signal every state change it makes. ]*/
+                    sm_signal_state_change(sm);
+                    result = SM_EXEC_GRANTED;
+                }
+            }
+        }
+
+        sm_count_result(sm, result, SM_COUNTER_BARRIER_BEGIN_GRANTED, SM_COUNTER_BARRIER_BEGIN_REFUSED);
+    }
+    return result;
+}
+
+SM_RESULT sm_close_begin_async(SM_HANDLE sm, SM_ON_DRAINED_FUNC on_drained, void* context)
+{
+    SM_RESULT result;
+    if (
+        /*Codes_SRS_SM_02_100: [ If sm is NULL then sm_close_begin_async shall fail and return SM_ERROR. ]*/
+        (sm == NULL) ||
+        /*Codes_SRS_SM_02_101: [ If on_drained is NULL then sm_close_begin_async shall fail and return SM_ERROR. ]*/
+        (on_drained == NULL)
+        )
+    {
+        LogError("invalid arguments SM_HANDLE sm=%p, SM_ON_DRAINED_FUNC on_drained=%p, void* context=%p", sm, on_drained, context);
+        result = SM_ERROR;
+    }
+    else
+    {
+        int32_t state;
+        int32_t n_to_drain = 0;
+        /*Codes_SRS_SM_02_105: [ sm_close_begin_async shall set SM_CLOSE_BIT to 1. ]*/
+        if (((state = SM_STATE_OF(interlocked_or_64(&sm->state, SM_CLOSE_BIT))) & SM_CLOSE_BIT) == SM_CLOSE_BIT)
+        {
+            /*Codes_SRS_SM_02_106: [ If SM_CLOSE_BIT was already 1 then sm_close_begin_async shall return SM_EXEC_REFUSED. ]*/
+            LogError("sm name=%s. another thread is performing close (state=%" PRI_SM_STATE ")", sm->name, SM_STATE_VALUE(state));
+            result = SM_EXEC_REFUSED;
+        }
+        /*Codes_SRS_SM_02_102: [ If another sm_close_begin_async or sm_barrier_begin_async is pending then sm_close_begin_async shall set SM_CLOSE_BIT to 0 and return SM_EXEC_REFUSED. ]*/
+        else if (!sm_arm_async(sm, on_drained, context))
+        {
+            LogError("sm name=%s. another asynchronous close or barrier is pending", sm->name);
+            (void)interlocked_and_64(&sm->state, ~(int64_t)SM_CLOSE_BIT);
+            result = SM_EXEC_REFUSED;
+        }
+        else
+        {
+            INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+            do
+            {
+                state = sm_get_state(sm);
+                if ((state & SM_STATE_MASK) == SM_OPENED)
+                {
+                    /*Codes_SRS_SM_02_119: [ If the state is SM_OPENED then sm_close_begin_async shall switch it to SM_OPENED_DRAINING_TO_CLOSE. ]*/
+                    /*Codes_SRS_SM_02_156: [ sm_close_begin_async and sm_barrier_begin_async shall set SM_ASYNC_BIT in the same atomic operation that switches the state to draining. ]*/
+                    if (sm_state_compare_exchange_get_n(sm, state - SM_OPENED + SM_OPENED_DRAINING_TO_CLOSE + SM_ASYNC_BIT + SM_STATE_INCREMENT, state, &n_to_drain) != state)
                     {
-                        /*well - retry sort of...*/
+                        /*go and retry*/
+                        sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
+                        /*Codes_SRS_SM_02_154: [ If the state changed meanwhile then sm_close_begin_async shall call InterlockedHL_Backoff before re-evaluating the state. ]*/
+                        (void)InterlockedHL_Backoff(&backoff);
                     }
                     else
                     {
-                        /*Codes_SRS_SM_02_063: [ If n reaches 0 then sm_exec_end shall signal that. ]*/
-                        if (n - 1 == 0)
+                        if (sm->shard_count != 0)
                         {
-                            WakeByAddressSingle((void*)&sm->non_barrier_call_count);
+                            /*Codes_SRS_SM_02_157: [ If n is sharded then sm_close_begin, sm_barrier_begin, sm_close_begin_async and sm_barrier_begin_async shall, after switching the state to draining, freeze every shard of n and add the values of the shards to n in the state word. ]*/
+                            n_to_drain = sm_freeze_shards(sm);
                         }
+
+                        sm_signal_state_change(sm);
+
+                        /*Codes_SRS_SM_02_104: [ sm_close_begin_async shall return SM_EXEC_GRANTED and call on_drained (possibly before returning, from the calling thread) when n reaches 0. ]*/
+                        result = SM_EXEC_GRANTED;
                         break;
                     }
                 }
+                else
+                {
+                    /*Codes_SRS_SM_02_103: [ If the state is not SM_OPENED then sm_close_begin_async shall set SM_CLOSE_BIT to 0 and return SM_EXEC_REFUSED. ]*/
+                    /*a barrier executing or draining would require waiting*/
+                    LogError("sm name=%s. cannot call sm_close_begin_async when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state));
+                    (void)interlocked_exchange(&sm->async_state, SM_ASYNC_NONE);
+                    (void)interlocked_and_64(&sm->state, ~(int64_t)SM_CLOSE_BIT);
+                    result = SM_EXEC_REFUSED;
+                    break;
+                }
             } while (1);
         }
+
+        sm_count_result(sm, result, SM_COUNTER_CLOSE_BEGIN_GRANTED, SM_COUNTER_CLOSE_BEGIN_REFUSED);
+
+        if (result == SM_EXEC_GRANTED)
+        {
+            /*last, because on_drained might destroy sm*/
+            sm_publish_async(sm, n_to_drain);
+        }
     }
+    return result;
 }
 
-SM_RESULT sm_barrier_begin(SM_HANDLE sm)
+SM_RESULT sm_barrier_begin_async(SM_HANDLE sm, SM_ON_DRAINED_FUNC on_drained, void* context)
 {
     SM_RESULT result;
-    /*Codes_SRS_SM_02_027: [ If sm is NULL then sm_barrier_begin shall fail and return SM_ERROR. ]*/
-    if (sm == NULL)
+    if (
+        /*Codes_SRS_SM_02_111: [ If sm is NULL then sm_barrier_begin_async shall fail and return SM_ERROR. ]*/
+        (sm == NULL) ||
+        /*Codes_SRS_SM_02_112: [ If on_drained is NULL then sm_barrier_begin_async shall fail and return SM_ERROR. ]*/
+        (on_drained == NULL)
+        )
     {
-        LogError("invalid arg SM_HANDLE sm=%p", sm);
+        LogError("invalid arguments SM_HANDLE sm=%p, SM_ON_DRAINED_FUNC on_drained=%p, void* context=%p", sm, on_drained, context);
         result = SM_ERROR;
     }
     else
     {
-        int32_t state = interlocked_add(&sm->state, 0);
+        int32_t n_to_drain = 0;
+        int32_t state = sm_get_state(sm);
         if (
-            /*Codes_SRS_SM_02_064: [ If state is not SM_OPENED then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+            /*Codes_SRS_SM_02_113: [ If state is not SM_OPENED then sm_barrier_begin_async shall return SM_EXEC_REFUSED. ]*/
             ((state & SM_STATE_MASK) != SM_OPENED) ||
-            /*Codes_SRS_SM_02_065: [ If SM_CLOSE_BIT is set to 1 then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+            /*Codes_SRS_SM_02_114: [ If SM_CLOSE_BIT is set to 1 then sm_barrier_begin_async shall return SM_EXEC_REFUSED. ]*/
             ((state & SM_CLOSE_BIT) == SM_CLOSE_BIT)
             )
         {
-            LogError("sm name=%s. cannot execute barrier begin when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state));
+            LogErrorRateLimited("sm name=%s. cannot execute barrier begin when state is %" PRI_SM_STATE "", sm->name, SM_STATE_VALUE(state));
+            result = SM_EXEC_REFUSED;
+        }
+        /*Codes_SRS_SM_02_115: [ If another sm_close_begin_async or sm_barrier_begin_async is pending then sm_barrier_begin_async shall return SM_EXEC_REFUSED. ]*/
+        else if (!sm_arm_async(sm, on_drained, context))
+        {
+            LogError("sm name=%s. another asynchronous close or barrier is pending", sm->name);
             result = SM_EXEC_REFUSED;
         }
         else
         {
-            /*Codes_SRS_SM_02_066: [ sm_barrier_begin shall switch the state to SM_OPENED_DRAINING_TO_BARRIER. ]*/
-            if (interlocked_compare_exchange(&sm->state, state - SM_OPENED + SM_OPENED_DRAINING_TO_BARRIER + SM_STATE_INCREMENT, state) != state)
+            /*Codes_SRS_SM_02_116: [ sm_barrier_begin_async shall switch the state to SM_OPENED_DRAINING_TO_BARRIER. ]*/
+            /*Codes_SRS_SM_02_156: [ sm_close_begin_async and sm_barrier_begin_async shall set SM_ASYNC_BIT in the same atomic operation that switches the state to draining. ]*/
+            if (sm_state_compare_exchange_get_n(sm, state - SM_OPENED + SM_OPENED_DRAINING_TO_BARRIER + SM_ASYNC_BIT + SM_STATE_INCREMENT, state, &n_to_drain) != state)
             {
-                /*Codes_SRS_SM_02_067: [ If the state changed meanwhile then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+                /*Codes_SRS_SM_02_117: [ If the state changed meanwhile then sm_barrier_begin_async shall return SM_EXEC_REFUSED. ]*/
                 LogError("sm name=%s. state changed meanwhile (it was %" PRI_SM_STATE "), this thread cannot start a barrier, likely competing threads", sm->name, SM_STATE_VALUE(state));
+                sm_count(sm, SM_COUNTER_STATE_CHANGED_MEANWHILE);
+                (void)interlocked_exchange(&sm->async_state, SM_ASYNC_NONE);
                 result = SM_EXEC_REFUSED;
             }
             else
             {
-                /*Codes_SRS_SM_02_068: [ sm_barrier_begin shall wait for n to reach 0. ]*/
-                if (InterlockedHL_WaitForValue(&sm->non_barrier_call_count, 0, UINT32_MAX) != INTERLOCKED_HL_OK)
+                if (sm->shard_count != 0)
                 {
-                    /*switch back the state*/
-                    /*Codes_SRS_SM_02_070: [ If there are any failures then sm_barrier_begin shall return SM_ERROR. ]*/
-                    (void)interlocked_add(&sm->state, -SM_OPENED_DRAINING_TO_BARRIER + SM_OPENED + SM_STATE_INCREMENT);
-                    LogError("sm name=%s. failure in InterlockedHL_WaitForValue(&sm->non_barrier_call_count=%p, 0, UINT32_MAX), state was %" PRI_SM_STATE "", sm->name, &sm->non_barrier_call_count, SM_STATE_VALUE(state));
-                    result = SM_ERROR;
-                }
-                else
-                {
-                    /*Codes_SRS_SM_02_069: [ sm_barrier_begin shall switch the state to SM_OPENED_BARRIER and return SM_EXEC_GRANTED. ]*/
-                    (void)interlocked_add(&sm->state, -SM_OPENED_DRAINING_TO_BARRIER + SM_OPENED_BARRIER + SM_STATE_INCREMENT);
-                    result = SM_EXEC_GRANTED;
+                    /*Codes_SRS_SM_02_157: [ If n is sharded then sm_close_begin, sm_barrier_begin, sm_close_begin_async and sm_barrier_begin_async shall, after switching the state to draining, freeze every shard of n and add the values of the shards to n in the state word. ]*/
+                    n_to_drain = sm_freeze_shards(sm);
                 }
+
+                sm_signal_state_change(sm);
+
+                /*Codes_SRS_SM_02_118: [ sm_barrier_begin_async shall return SM_EXEC_GRANTED and call on_drained (possibly before returning, from the calling thread) when n reaches 0. ]*/
+                result = SM_EXEC_GRANTED;
             }
         }
+
+        sm_count_result(sm, result, SM_COUNTER_BARRIER_BEGIN_GRANTED, SM_COUNTER_BARRIER_BEGIN_REFUSED);
+
+        if (result == SM_EXEC_GRANTED)
+        {
+            /*last, because on_drained might destroy sm*/
+            sm_publish_async(sm, n_to_drain);
+        }
     }
     return result;
 }
@@ -473,7 +1460,7 @@ void sm_barrier_end(SM_HANDLE sm)
     }
     else
     {
-        int32_t state = interlocked_add(&sm->state, 0);
+        int32_t state = sm_get_state(sm);
         /*Codes_SRS_SM_02_072: [ If state is not SM_OPENED_BARRIER then sm_barrier_end shall return. ]*/
         if ((state & SM_STATE_MASK) != SM_OPENED_BARRIER)
         {
@@ -481,14 +1468,157 @@ void sm_barrier_end(SM_HANDLE sm)
         }
         else
         {
+            /*Codes_SRS_SM_02_159: [ If n is sharded then sm_barrier_end shall set all the shards of n to 0 before switching the state to SM_OPENED. ]*/
+            sm_thaw_shards(sm);
+
             /*Codes_SRS_SM_02_073: [ sm_barrier_end shall switch the state to SM_OPENED. ]*/
-            if (interlocked_compare_exchange(&sm->state, state - SM_OPENED_BARRIER + SM_OPENED + SM_STATE_INCREMENT, state) != state)
+            if (sm_state_compare_exchange(sm, state - SM_OPENED_BARRIER + SM_OPENED + SM_STATE_INCREMENT, state) != state)
             {
                 LogError("sm name=%s. state changed meanwhile (it was %" PRI_SM_STATE "), likely competing threads", sm->name, SM_STATE_VALUE(state));
             }
             else
             {
                 /*it's all fine, we're back to SM_OPENED*/ /*let a close know about that, if any*/
+                /*Codes_SRS_SM_02_092: [ sm_barrier_end shall signal the state change and wake all the threads waiting for it. ]*/
+                sm_signal_state_change(sm);
+            }
+        }
+    }
+}
+
+int sm_get_statistics(SM_HANDLE sm, SM_STATISTICS* statistics)
+{
+    int result;
+    if (
+        /*Codes_SRS_SM_02_133: [ If sm is NULL then sm_get_statistics shall fail and return a non-zero value. ]*/
+        (sm == NULL) ||
+        /*Codes_SRS_SM_02_134: [ If statistics is NULL then sm_get_statistics shall fail and return a non-zero value. ]*/
+        (statistics == NULL)
+        )
+    {
+        LogError("invalid arguments SM_HANDLE sm=%p, SM_STATISTICS* statistics=%p", sm, statistics);
+        result = MU_FAILURE;
+    }
+    /*Codes_SRS_SM_02_135: [ If sm was not created with collect_statistics set to true then sm_get_statistics shall fail and return a non-zero value. ]*/
+    else if (sm->statistics_slot_count == 0)
+    {
+        LogError("sm name=%s. statistics are not collected", sm->name);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        int64_t sums[SM_COUNTER_COUNT] = { 0 };
+
+        /*Codes_SRS_SM_02_136: [ sm_get_statistics shall fill statistics with the sum of the counters of all the processors. ]*/
+        /*the counters are read one by one while other threads might update them, so the sums are not a snapshot of one moment in time*/
+        for (uint32_t i = 0; i < sm->statistics_slot_count; i++)
+        {
+            for (uint32_t j = 0; j < SM_COUNTER_COUNT; j++)
+            {
+                sums[j] += interlocked_add_64(&sm->statistics_slots[i].counters[j], 0);
+            }
+        }
+
+        statistics->open_begin.granted = (uint64_t)sums[SM_COUNTER_OPEN_BEGIN_GRANTED];
+        statistics->open_begin.refused = (uint64_t)sums[SM_COUNTER_OPEN_BEGIN_REFUSED];
+        statistics->close_begin.granted = (uint64_t)sums[SM_COUNTER_CLOSE_BEGIN_GRANTED];
+        statistics->close_begin.refused = (uint64_t)sums[SM_COUNTER_CLOSE_BEGIN_REFUSED];
+        statistics->exec_begin.granted = (uint64_t)sums[SM_COUNTER_EXEC_BEGIN_GRANTED];
+        statistics->exec_begin.refused = (uint64_t)sums[SM_COUNTER_EXEC_BEGIN_REFUSED];
+        statistics->barrier_begin.granted = (uint64_t)sums[SM_COUNTER_BARRIER_BEGIN_GRANTED];
+        statistics->barrier_begin.refused = (uint64_t)sums[SM_COUNTER_BARRIER_BEGIN_REFUSED];
+        statistics->exec_begin_throttled = (uint64_t)sums[SM_COUNTER_EXEC_BEGIN_THROTTLED];
+        statistics->state_changed_meanwhile = (uint64_t)sums[SM_COUNTER_STATE_CHANGED_MEANWHILE];
+        statistics->cas_retries = (uint64_t)sums[SM_COUNTER_CAS_RETRIES];
+        for (uint32_t i = 0; i < SM_STATISTICS_DRAIN_WAIT_BUCKET_COUNT; i++)
+        {
+            statistics->drain_wait_us[i] = (uint64_t)sums[SM_COUNTER_DRAIN_WAIT_HISTOGRAM + i];
+        }
+
+        /*Codes_SRS_SM_02_137: [ sm_get_statistics shall succeed and return 0. ]*/
+        result = 0;
+    }
+    return result;
+}
+
+int sm_trace_get(SM_HANDLE sm, SM_TRACE_RECORD* records, uint32_t* record_count)
+{
+    int result;
+    if (
+        /*Codes_SRS_SM_02_141: [ If sm is NULL then sm_trace_get shall fail and return a non-zero value. ]*/
+        (sm == NULL) ||
+        /*Codes_SRS_SM_02_142: [ If records is NULL then sm_trace_get shall fail and return a non-zero value. ]*/
+        (records == NULL) ||
+        /*Codes_SRS_SM_02_143: [ If record_count is NULL then sm_trace_get shall fail and return a non-zero value. ]*/
+        (record_count == NULL)
+        )
+    {
+        LogError("invalid arguments SM_HANDLE sm=%p, SM_TRACE_RECORD* records=%p, uint32_t* record_count=%p", sm, records, record_count);
+        result = MU_FAILURE;
+    }
+    else
+    {
+#ifdef SM_TRACE
+        int64_t next = interlocked_add_64(&sm->trace_next, 0);
+        int64_t first = (next > SM_TRACE_RECORD_COUNT) ? next - SM_TRACE_RECORD_COUNT : 0;
+        uint32_t count = 0;
+
+        /*Codes_SRS_SM_02_145: [ sm_trace_get shall copy the most recent records of the trace in records, oldest first, and set record_count to the number of records copied. ]*/
+        for (int64_t sequence = first; sequence < next; sequence++)
+        {
+            SM_TRACE_SLOT* slot = &sm->trace[sequence & (SM_TRACE_RECORD_COUNT - 1)];
+            if (interlocked_add_64(&slot->sequence, 0) == sequence + 1)
+            {
+                records[count] = slot->record;
+
+                /*Codes_SRS_SM_02_146: [ sm_trace_get shall skip the records that are being written or that are overwritten while they are copied. ]*/
+                /*a writer reserves the slot (by incrementing trace_next) before overwriting it, so if no newer record reserved it by now, the copy is intact*/
+                if (interlocked_add_64(&sm->trace_next, 0) <= sequence + SM_TRACE_RECORD_COUNT)
+                {
+                    count++;
+                }
+            }
+        }
+
+        *record_count = count;
+
+        /*Codes_SRS_SM_02_147: [ sm_trace_get shall succeed and return 0. ]*/
+        result = 0;
+#else
+        /*Codes_SRS_SM_02_144: [ If sm.c is not compiled with SM_TRACE then sm_trace_get shall fail and return a non-zero value. ]*/
+        LogError("sm name=%s. sm was compiled without SM_TRACE", sm->name);
+        result = MU_FAILURE;
+#endif
+    }
+    return result;
+}
+
+void sm_trace_dump(SM_HANDLE sm)
+{
+    /*Codes_SRS_SM_02_148: [ If sm is NULL then sm_trace_dump shall return. ]*/
+    if (sm == NULL)
+    {
+        LogError("invalid argument SM_HANDLE sm=%p", sm);
+    }
+    else
+    {
+        SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+        uint32_t record_count;
+
+        /*Codes_SRS_SM_02_149: [ sm_trace_dump shall get the trace records as sm_trace_get does. ]*/
+        if (sm_trace_get(sm, records, &record_count) != 0)
+        {
+            /*Codes_SRS_SM_02_150: [ If getting the records fails then sm_trace_dump shall return. ]*/
+            LogError("sm name=%s. failure in sm_trace_get(sm=%p, records=%p, &record_count=%p)", sm->name, sm, records, &record_count);
+        }
+        else
+        {
+            /*Codes_SRS_SM_02_151: [ sm_trace_dump shall log every record, oldest first. ]*/
+            LogInfo("sm name=%s. last %" PRIu32 " transitions:", sm->name, record_count);
+            for (uint32_t i = 0; i < record_count; i++)
+            {
+                LogInfo("sm name=%s. [%" PRId64 "] %.3f ms: %" PRI_SM_STATE " -> %" PRI_SM_STATE "",
+                    sm->name, records[i].sequence, records[i].timestamp_ms, SM_STATE_VALUE(records[i].old_state), SM_STATE_VALUE(records[i].new_state));
             }
         }
     }
@@ -0,0 +1,300 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_pal/sync.h"
+#include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/sm.h"
+
+#include "azure_c_util/sm_group.h"
+
+/*values of operation*/
+#define SM_GROUP_NONE       0 /*no group operation is in progress*/
+#define SM_GROUP_BUSY       1 /*a group _begin or _end is executing*/
+#define SM_GROUP_CLOSE      2 /*sm_group_close_begin was granted, sm_group_close_end is expected*/
+#define SM_GROUP_BARRIER    3 /*sm_group_barrier_begin was granted, sm_group_barrier_end is expected*/
+#define SM_GROUP_FAILED     4 /*waiting for the children to drain failed, the children can still call back into the group: it is never used again*/
+
+typedef SM_RESULT(*SM_BEGIN_ASYNC_FUNC)(SM_HANDLE sm, SM_ON_DRAINED_FUNC on_drained, void* context);
+typedef void(*SM_END_FUNC)(SM_HANDLE sm);
+
+typedef struct SM_GROUP_CHILD_TAG
+{
+    SM_HANDLE sm;
+    bool granted; /*true when the last group _begin was granted by this child and the matching _end was not yet called*/
+}SM_GROUP_CHILD;
+
+typedef struct SM_GROUP_TAG
+{
+    volatile_atomic int32_t operation; /*one of SM_GROUP_NONE/BUSY/CLOSE/BARRIER*/
+    volatile_atomic int32_t pending_drains; /*number of children that were granted and did not yet drain*/
+    uint32_t child_count;
+    SM_GROUP_CHILD children[];
+}SM_GROUP;
+
+static void on_child_drained(void* context)
+{
+    SM_GROUP_HANDLE group = (SM_GROUP_HANDLE)context;
+
+    /*Codes_SRS_SM_GROUP_02_012: [ When the last child drains, the thread waiting in sm_group_close_begin/sm_group_barrier_begin shall be woken up. ]*/
+    if (interlocked_decrement(&group->pending_drains) == 0)
+    {
+        wake_by_address_single(&group->pending_drains);
+    }
+}
+
+/*undoes a granted sm_close_begin_async of a child when another child refused: the user did not yet run its close code (that happens between sm_group_close_begin and sm_group_close_end), so the child is opened again instead of being left closed*/
+static void sm_group_reopen_child(SM_HANDLE sm)
+{
+    sm_close_end(sm);
+    if (sm_open_begin(sm) != SM_EXEC_GRANTED)
+    {
+        /*another thread opened the child meanwhile*/
+        LogError("sm=%p. failure in sm_open_begin, the child was not reopened by the group", sm);
+    }
+    else
+    {
+        sm_open_end(sm, true);
+    }
+}
+
+/*asks every child to begin the operation without waiting for the child to drain, then waits for all the drains at once. If a child refuses, the children that granted are given back with rollback, so a refused group operation leaves every child as it was*/
+static SM_RESULT sm_group_begin(SM_GROUP_HANDLE group, int32_t operation, SM_BEGIN_ASYNC_FUNC begin_async, SM_END_FUNC rollback)
+{
+    SM_RESULT result;
+    int32_t current;
+
+    if ((current = interlocked_compare_exchange(&group->operation, SM_GROUP_BUSY, SM_GROUP_NONE)) != SM_GROUP_NONE)
+    {
+        /*Codes_SRS_SM_GROUP_02_008: [ If another group operation is in progress then sm_group_close_begin shall return SM_EXEC_REFUSED. ]*/
+        /*Codes_SRS_SM_GROUP_02_024: [ If a previous group _begin returned SM_ERROR then sm_group_close_begin shall return SM_EXEC_REFUSED. ]*/
+        LogError("group=%p. cannot begin operation %" PRId32 " when the group is in %" PRId32 "", group, operation, current);
+        result = SM_EXEC_REFUSED;
+    }
+    else
+    {
+        bool all_granted = true;
+
+        /*this thread holds 1 until all the children were asked, so that the drains that complete meanwhile do not make pending_drains reach 0*/
+        (void)interlocked_exchange(&group->pending_drains, 1);
+
+        for (uint32_t i = 0; i < group->child_count; i++)
+        {
+            (void)interlocked_increment(&group->pending_drains);
+
+            /*Codes_SRS_SM_GROUP_02_009: [ sm_group_close_begin shall call sm_close_begin_async on every child. ]*/
+            if (begin_async(group->children[i].sm, on_child_drained, group) == SM_EXEC_GRANTED)
+            {
+                group->children[i].granted = true;
+            }
+            else
+            {
+                /*Codes_SRS_SM_GROUP_02_023: [ If a child refuses then sm_group_close_begin shall not call sm_close_begin_async on the remaining children. ]*/
+                LogError("group=%p. child %" PRIu32 " (sm=%p) refused", group, i, group->children[i].sm);
+                all_granted = false;
+                (void)interlocked_decrement(&group->pending_drains);
+                break;
+            }
+        }
+
+        /*Codes_SRS_SM_GROUP_02_010: [ sm_group_close_begin shall wait for all the children that granted to drain. ]*/
+        if (
+            (interlocked_decrement(&group->pending_drains) != 0) &&
+            (InterlockedHL_WaitForValue(&group->pending_drains, 0, UINT32_MAX) != INTERLOCKED_HL_OK)
+            )
+        {
+            /*Codes_SRS_SM_GROUP_02_013: [ If waiting fails then sm_group_close_begin shall return SM_ERROR. ]*/
+            /*the children can still call on_child_drained, so the group cannot be used (nor rolled back) anymore*/
+            LogError("group=%p. failure in InterlockedHL_WaitForValue(&group->pending_drains=%p, 0, UINT32_MAX), the group cannot be used anymore", group, &group->pending_drains);
+            (void)interlocked_exchange(&group->operation, SM_GROUP_FAILED);
+            result = SM_ERROR;
+        }
+        else if (!all_granted)
+        {
+            /*Codes_SRS_SM_GROUP_02_014: [ If any child refused then sm_group_close_begin shall call sm_close_end, sm_open_begin and sm_open_end (with success true) on the children that granted and return SM_EXEC_REFUSED. ]*/
+            for (uint32_t i = 0; i < group->child_count; i++)
+            {
+                if (group->children[i].granted)
+                {
+                    rollback(group->children[i].sm);
+                    group->children[i].granted = false;
+                }
+            }
+            (void)interlocked_exchange(&group->operation, SM_GROUP_NONE);
+            result = SM_EXEC_REFUSED;
+        }
+        else
+        {
+            /*Codes_SRS_SM_GROUP_02_011: [ sm_group_close_begin shall return SM_EXEC_GRANTED. ]*/
+            (void)interlocked_exchange(&group->operation, operation);
+            result = SM_EXEC_GRANTED;
+        }
+    }
+    return result;
+}
+
+static void sm_group_end(SM_GROUP_HANDLE group, int32_t operation, SM_END_FUNC end)
+{
+    int32_t current = interlocked_compare_exchange(&group->operation, SM_GROUP_BUSY, operation);
+    if (current != operation)
+    {
+        /*Codes_SRS_SM_GROUP_02_016: [ If sm_group_close_begin was not granted then sm_group_close_end shall return. ]*/
+        LogError("group=%p. cannot end operation %" PRId32 " when the group is in %" PRId32 "", group, operation, current);
+    }
+    else
+    {
+        /*Codes_SRS_SM_GROUP_02_017: [ sm_group_close_end shall call sm_close_end on every child. ]*/
+        for (uint32_t i = 0; i < group->child_count; i++)
+        {
+            end(group->children[i].sm);
+            group->children[i].granted = false;
+        }
+        (void)interlocked_exchange(&group->operation, SM_GROUP_NONE);
+    }
+}
+
+SM_GROUP_HANDLE sm_group_create(SM_HANDLE* children, uint32_t child_count)
+{
+    SM_GROUP_HANDLE result;
+    if (
+        /*Codes_SRS_SM_GROUP_02_001: [ If children is NULL then sm_group_create shall fail and return NULL. ]*/
+        (children == NULL) ||
+        /*Codes_SRS_SM_GROUP_02_002: [ If child_count is 0 then sm_group_create shall fail and return NULL. ]*/
+        (child_count == 0)
+        )
+    {
+        LogError("invalid arguments SM_HANDLE* children=%p, uint32_t child_count=%" PRIu32 "", children, child_count);
+        result = NULL;
+    }
+    else
+    {
+        uint32_t i;
+        for (i = 0; i < child_count; i++)
+        {
+            if (children[i] == NULL)
+            {
+                break;
+            }
+        }
+
+        if (i < child_count)
+        {
+            /*Codes_SRS_SM_GROUP_02_003: [ If any of the children is NULL then sm_group_create shall fail and return NULL. ]*/
+            LogError("invalid argument children[%" PRIu32 "]=NULL", i);
+            result = NULL;
+        }
+        else if ((SIZE_MAX - sizeof(SM_GROUP)) / sizeof(SM_GROUP_CHILD) < child_count)
+        {
+            /*Codes_SRS_SM_GROUP_02_005: [ If there are any failures then sm_group_create shall fail and return NULL. ]*/
+            LogError("child_count=%" PRIu32 " produces arithmetic overflows", child_count);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_SM_GROUP_02_004: [ sm_group_create shall allocate memory for the group and copy the children handles. ]*/
+            result = malloc(sizeof(SM_GROUP) + child_count * sizeof(SM_GROUP_CHILD));
+            if (result == NULL)
+            {
+                /*Codes_SRS_SM_GROUP_02_005: [ If there are any failures then sm_group_create shall fail and return NULL. ]*/
+                LogError("failure in malloc(sizeof(SM_GROUP)=%zu + child_count=%" PRIu32 " * sizeof(SM_GROUP_CHILD)=%zu)", sizeof(SM_GROUP), child_count, sizeof(SM_GROUP_CHILD));
+                /*return as is*/
+            }
+            else
+            {
+                (void)interlocked_exchange(&result->operation, SM_GROUP_NONE);
+                (void)interlocked_exchange(&result->pending_drains, 0);
+                result->child_count = child_count;
+                for (i = 0; i < child_count; i++)
+                {
+                    result->children[i].sm = children[i];
+                    result->children[i].granted = false;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void sm_group_destroy(SM_GROUP_HANDLE group)
+{
+    /*Codes_SRS_SM_GROUP_02_006: [ If group is NULL then sm_group_destroy shall return. ]*/
+    if (group == NULL)
+    {
+        LogError("invalid argument SM_GROUP_HANDLE group=%p", group);
+    }
+    else
+    {
+        /*Codes_SRS_SM_GROUP_02_018: [ sm_group_destroy shall free the memory used by the group. The children are not destroyed. ]*/
+        free(group);
+    }
+}
+
+SM_RESULT sm_group_close_begin(SM_GROUP_HANDLE group)
+{
+    SM_RESULT result;
+    /*Codes_SRS_SM_GROUP_02_007: [ If group is NULL then sm_group_close_begin shall fail and return SM_ERROR. ]*/
+    if (group == NULL)
+    {
+        LogError("invalid argument SM_GROUP_HANDLE group=%p", group);
+        result = SM_ERROR;
+    }
+    else
+    {
+        result = sm_group_begin(group, SM_GROUP_CLOSE, sm_close_begin_async, sm_group_reopen_child);
+    }
+    return result;
+}
+
+void sm_group_close_end(SM_GROUP_HANDLE group)
+{
+    /*Codes_SRS_SM_GROUP_02_015: [ If group is NULL then sm_group_close_end shall return. ]*/
+    if (group == NULL)
+    {
+        LogError("invalid argument SM_GROUP_HANDLE group=%p", group);
+    }
+    else
+    {
+        sm_group_end(group, SM_GROUP_CLOSE, sm_close_end);
+    }
+}
+
+SM_RESULT sm_group_barrier_begin(SM_GROUP_HANDLE group)
+{
+    SM_RESULT result;
+    /*Codes_SRS_SM_GROUP_02_019: [ If group is NULL then sm_group_barrier_begin shall fail and return SM_ERROR. ]*/
+    if (group == NULL)
+    {
+        LogError("invalid argument SM_GROUP_HANDLE group=%p", group);
+        result = SM_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_SM_GROUP_02_020: [ sm_group_barrier_begin shall behave as sm_group_close_begin, except that it shall call sm_barrier_begin_async instead of sm_close_begin_async and, on the children that granted when another child refused, sm_barrier_end. ]*/
+        result = sm_group_begin(group, SM_GROUP_BARRIER, sm_barrier_begin_async, sm_barrier_end);
+    }
+    return result;
+}
+
+void sm_group_barrier_end(SM_GROUP_HANDLE group)
+{
+    /*Codes_SRS_SM_GROUP_02_021: [ If group is NULL then sm_group_barrier_end shall return. ]*/
+    if (group == NULL)
+    {
+        LogError("invalid argument SM_GROUP_HANDLE group=%p", group);
+    }
+    else
+    {
+        /*Codes_SRS_SM_GROUP_02_022: [ sm_group_barrier_end shall behave as sm_group_close_end, except that it shall call sm_barrier_end instead of sm_close_end. ]*/
+        sm_group_end(group, SM_GROUP_BARRIER, sm_barrier_end);
+    }
+}
@@ -0,0 +1,143 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_util/interlocked_hl.h"
+
+#include "azure_c_util/thandle_atomic.h"
+
+/*waits until no reader uses the count reader_index anymore*/
+static void wait_for_readers(THANDLE_ATOMIC_SLOT* slot, int32_t reader_index)
+{
+    INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    /*Codes_SRS_THANDLE_ATOMIC_02_018: [ thandle_atomic_slot_exchange shall wait for the readers count to reach 0 by calling InterlockedHL_Backoff between the reads. ]*/
+    while (interlocked_add(&slot->readers[reader_index], 0) != 0)
+    {
+        (void)InterlockedHL_Backoff(&backoff);
+    }
+}
+
+int thandle_atomic_slot_init(THANDLE_ATOMIC_SLOT* slot, void* value)
+{
+    int result;
+    if (slot == NULL)
+    {
+        /*Codes_SRS_THANDLE_ATOMIC_02_001: [ If slot is NULL then thandle_atomic_slot_init shall fail and return a non-zero value. ]*/
+        LogError("invalid argument THANDLE_ATOMIC_SLOT* slot=%p, void* value=%p", slot, value);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_ATOMIC_02_002: [ thandle_atomic_slot_init shall store value in the slot, set both reader counts and the reader index to 0 and unlock the writer mutex. ]*/
+        (void)interlocked_exchange_pointer(&slot->value, value);
+        (void)interlocked_exchange(&slot->readers[0], 0);
+        (void)interlocked_exchange(&slot->readers[1], 0);
+        (void)interlocked_exchange(&slot->reader_index, 0);
+        (void)interlocked_exchange(&slot->writer_mutex, 0);
+
+        /*Codes_SRS_THANDLE_ATOMIC_02_003: [ thandle_atomic_slot_init shall succeed and return 0. ]*/
+        result = 0;
+    }
+    return result;
+}
+
+void* thandle_atomic_slot_read_begin(THANDLE_ATOMIC_SLOT* slot, int32_t* reader_index)
+{
+    void* result;
+    if (
+        /*Codes_SRS_THANDLE_ATOMIC_02_004: [ If slot is NULL then thandle_atomic_slot_read_begin shall fail and return NULL. ]*/
+        (slot == NULL) ||
+        /*Codes_SRS_THANDLE_ATOMIC_02_005: [ If reader_index is NULL then thandle_atomic_slot_read_begin shall fail and return NULL. ]*/
+        (reader_index == NULL)
+        )
+    {
+        LogError("invalid arguments THANDLE_ATOMIC_SLOT* slot=%p, int32_t* reader_index=%p", slot, reader_index);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_ATOMIC_02_006: [ thandle_atomic_slot_read_begin shall read the reader index and increment the readers count at that index. ]*/
+        int32_t index = interlocked_add(&slot->reader_index, 0);
+        (void)interlocked_increment(&slot->readers[index]);
+        *reader_index = index;
+
+        /*Codes_SRS_THANDLE_ATOMIC_02_007: [ thandle_atomic_slot_read_begin shall return the value in the slot (read after the increment of the readers count). ]*/
+        result = interlocked_compare_exchange_pointer(&slot->value, NULL, NULL);
+    }
+    return result;
+}
+
+void thandle_atomic_slot_read_end(THANDLE_ATOMIC_SLOT* slot, int32_t reader_index)
+{
+    if (
+        /*Codes_SRS_THANDLE_ATOMIC_02_008: [ If slot is NULL then thandle_atomic_slot_read_end shall return. ]*/
+        (slot == NULL) ||
+        /*Codes_SRS_THANDLE_ATOMIC_02_009: [ If reader_index is not 0 or 1 then thandle_atomic_slot_read_end shall return. ]*/
+        (reader_index < 0) ||
+        (reader_index > 1)
+        )
+    {
+        LogError("invalid arguments THANDLE_ATOMIC_SLOT* slot=%p, int32_t reader_index=%" PRId32 "", slot, reader_index);
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_ATOMIC_02_010: [ thandle_atomic_slot_read_end shall decrement the readers count at reader_index. ]*/
+        (void)interlocked_decrement(&slot->readers[reader_index]);
+    }
+}
+
+int thandle_atomic_slot_exchange(THANDLE_ATOMIC_SLOT* slot, void* value, void** previous_value)
+{
+    int result;
+    if (
+        /*Codes_SRS_THANDLE_ATOMIC_02_011: [ If slot is NULL then thandle_atomic_slot_exchange shall fail and return a non-zero value. ]*/
+        (slot == NULL) ||
+        /*Codes_SRS_THANDLE_ATOMIC_02_012: [ If previous_value is NULL then thandle_atomic_slot_exchange shall fail and return a non-zero value. ]*/
+        (previous_value == NULL)
+        )
+    {
+        LogError("invalid arguments THANDLE_ATOMIC_SLOT* slot=%p, void* value=%p, void** previous_value=%p", slot, value, previous_value);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_ATOMIC_02_013: [ thandle_atomic_slot_exchange shall lock the writer mutex by calling InterlockedHL_MutexLock. ]*/
+        if (InterlockedHL_MutexLock(&slot->writer_mutex) != INTERLOCKED_HL_OK)
+        {
+            /*Codes_SRS_THANDLE_ATOMIC_02_014: [ If InterlockedHL_MutexLock fails then thandle_atomic_slot_exchange shall fail and return a non-zero value. ]*/
+            LogError("failure in InterlockedHL_MutexLock(&slot->writer_mutex=%p)", &slot->writer_mutex);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            /*Codes_SRS_THANDLE_ATOMIC_02_015: [ thandle_atomic_slot_exchange shall exchange the value in the slot with value. ]*/
+            void* previous = interlocked_exchange_pointer(&slot->value, value);
+
+            /*the readers that could have read previous are counted in either count: readers that read the reader index during the wait of a previous writer
+            use count 1. So both counts are drained, every time after moving the new readers to the other count so that a stream of readers cannot starve the writer*/
+
+            /*Codes_SRS_THANDLE_ATOMIC_02_016: [ thandle_atomic_slot_exchange shall set the reader index to 1 and wait for the readers count 0 to reach 0. ]*/
+            (void)interlocked_exchange(&slot->reader_index, 1);
+            wait_for_readers(slot, 0);
+
+            /*Codes_SRS_THANDLE_ATOMIC_02_017: [ thandle_atomic_slot_exchange shall set the reader index to 0 and wait for the readers count 1 to reach 0. ]*/
+            (void)interlocked_exchange(&slot->reader_index, 0);
+            wait_for_readers(slot, 1);
+
+            /*Codes_SRS_THANDLE_ATOMIC_02_019: [ thandle_atomic_slot_exchange shall unlock the writer mutex by calling InterlockedHL_MutexUnlock. ]*/
+            (void)InterlockedHL_MutexUnlock(&slot->writer_mutex);
+
+            /*Codes_SRS_THANDLE_ATOMIC_02_020: [ thandle_atomic_slot_exchange shall store the previous value of the slot in *previous_value, succeed and return 0. ]*/
+            *previous_value = previous;
+            result = 0;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,323 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/processor_index.h"
+
+#include "azure_c_util/thandle_pool.h"
+
+#define THANDLE_POOL_CACHE_LINE_SIZE 64
+#define THANDLE_POOL_ITEM_ALIGNMENT 16 /*every item of the slab is aligned as malloc would align it*/
+
+typedef struct THANDLE_POOL_PARTITION_TAG
+{
+    volatile_atomic int64_t free_items; /*bit i is set when item i of the partition is in the pool*/
+    volatile_atomic int64_t hits;
+    volatile_atomic int64_t misses;
+    volatile_atomic int64_t returns;
+    volatile_atomic int64_t foreign_frees;
+    uint8_t padding[THANDLE_POOL_CACHE_LINE_SIZE - (5 * sizeof(int64_t)) % THANDLE_POOL_CACHE_LINE_SIZE]; /*every partition starts in its own cache line*/
+}THANDLE_POOL_PARTITION;
+
+typedef struct THANDLE_POOL_TAG
+{
+    size_t item_size; /*rounded up to THANDLE_POOL_ITEM_ALIGNMENT*/
+    uint32_t items_per_processor;
+    uint32_t partition_count;
+    THANDLE_POOL_PARTITION* partitions; /*one partition per processor, THANDLE_POOL_CACHE_LINE_SIZE aligned, points inside partitions_memory*/
+    void* partitions_memory;
+    unsigned char* items; /*the slab: items of partition p are items[p * items_per_processor * item_size ...]*/
+    unsigned char* items_end;
+}THANDLE_POOL;
+
+static int64_t all_items_free(uint32_t items_per_processor)
+{
+    return (items_per_processor == 64) ? (int64_t)UINT64_MAX : (int64_t)(((uint64_t)1 << items_per_processor) - 1);
+}
+
+static uint32_t count_free_items(int64_t free_items)
+{
+    uint32_t result = 0;
+    uint64_t bits = (uint64_t)free_items;
+    while (bits != 0)
+    {
+        bits &= bits - 1;
+        result++;
+    }
+    return result;
+}
+
+/*takes the lowest free item of partition, returns its index in the partition or UINT32_MAX if the partition is empty*/
+static uint32_t take_item(THANDLE_POOL_PARTITION* partition)
+{
+    uint32_t result = UINT32_MAX;
+    INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    int64_t free_items = interlocked_add_64(&partition->free_items, 0);
+    while (free_items != 0)
+    {
+        uint64_t lowest = (uint64_t)free_items & (~(uint64_t)free_items + 1);
+        int64_t previous = interlocked_compare_exchange_64(&partition->free_items, (int64_t)((uint64_t)free_items & ~lowest), free_items);
+        if (previous == free_items)
+        {
+            result = 0;
+            while (lowest != 1)
+            {
+                lowest >>= 1;
+                result++;
+            }
+            break;
+        }
+        else
+        {
+            /*Codes_SRS_THANDLE_POOL_02_015: [ If the compare exchange fails then thandle_pool_malloc shall call InterlockedHL_Backoff and try again. ]*/
+            (void)InterlockedHL_Backoff(&backoff);
+            free_items = previous;
+        }
+    }
+    return result;
+}
+
+THANDLE_POOL_HANDLE thandle_pool_create(size_t item_size, uint32_t items_per_processor)
+{
+    THANDLE_POOL_HANDLE result;
+    if (
+        /*Codes_SRS_THANDLE_POOL_02_001: [ If item_size is 0 or greater than SIZE_MAX - THANDLE_POOL_ITEM_ALIGNMENT then thandle_pool_create shall fail and return NULL. ]*/
+        (item_size == 0) ||
+        (item_size > SIZE_MAX - THANDLE_POOL_ITEM_ALIGNMENT) ||
+        /*Codes_SRS_THANDLE_POOL_02_002: [ If items_per_processor is 0 or greater than THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR then thandle_pool_create shall fail and return NULL. ]*/
+        (items_per_processor == 0) ||
+        (items_per_processor > THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR)
+        )
+    {
+        LogError("invalid arguments size_t item_size=%zu, uint32_t items_per_processor=%" PRIu32 "", item_size, items_per_processor);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_POOL_02_003: [ thandle_pool_create shall allocate memory for the pool. ]*/
+        result = malloc(sizeof(THANDLE_POOL));
+        if (result == NULL)
+        {
+            /*Codes_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+            LogError("failure in malloc(sizeof(THANDLE_POOL)=%zu)", sizeof(THANDLE_POOL));
+            /*return as is*/
+        }
+        else
+        {
+            result->item_size = (item_size + (THANDLE_POOL_ITEM_ALIGNMENT - 1)) & ~(size_t)(THANDLE_POOL_ITEM_ALIGNMENT - 1);
+            result->items_per_processor = items_per_processor;
+
+            /*Codes_SRS_THANDLE_POOL_02_004: [ thandle_pool_create shall allocate one cache line aligned partition for every processor returned by processor_index_get_count. ]*/
+            result->partition_count = processor_index_get_count();
+            if (
+                (result->partition_count == 0) ||
+                ((SIZE_MAX - (THANDLE_POOL_CACHE_LINE_SIZE - 1)) / sizeof(THANDLE_POOL_PARTITION) < result->partition_count) ||
+                (SIZE_MAX / result->item_size / items_per_processor < result->partition_count)
+                )
+            {
+                /*Codes_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+                LogError("invalid partition_count=%" PRIu32 " for item_size=%zu, items_per_processor=%" PRIu32 "", result->partition_count, result->item_size, items_per_processor);
+            }
+            else
+            {
+                result->partitions_memory = malloc(result->partition_count * sizeof(THANDLE_POOL_PARTITION) + (THANDLE_POOL_CACHE_LINE_SIZE - 1));
+                if (result->partitions_memory == NULL)
+                {
+                    /*Codes_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+                    LogError("failure in malloc(partition_count=%" PRIu32 " * sizeof(THANDLE_POOL_PARTITION)=%zu + (THANDLE_POOL_CACHE_LINE_SIZE - 1)=%d)",
+                        result->partition_count, sizeof(THANDLE_POOL_PARTITION), THANDLE_POOL_CACHE_LINE_SIZE - 1);
+                }
+                else
+                {
+                    size_t slab_size = (size_t)result->partition_count * items_per_processor * result->item_size;
+
+                    /*Codes_SRS_THANDLE_POOL_02_005: [ thandle_pool_create shall allocate a slab of items_per_processor items of item_size bytes for every partition. ]*/
+                    result->items = malloc(slab_size);
+                    if (result->items == NULL)
+                    {
+                        /*Codes_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+                        LogError("failure in malloc(slab_size=%zu)", slab_size);
+                    }
+                    else
+                    {
+                        uint32_t i;
+                        result->items_end = result->items + slab_size;
+                        result->partitions = (THANDLE_POOL_PARTITION*)(((uintptr_t)result->partitions_memory + (THANDLE_POOL_CACHE_LINE_SIZE - 1)) & ~(uintptr_t)(THANDLE_POOL_CACHE_LINE_SIZE - 1));
+
+                        /*Codes_SRS_THANDLE_POOL_02_007: [ thandle_pool_create shall put all the items in the pool, set all the statistics to 0, succeed and return a non-NULL value. ]*/
+                        for (i = 0; i < result->partition_count; i++)
+                        {
+                            (void)interlocked_exchange_64(&result->partitions[i].free_items, all_items_free(items_per_processor));
+                            (void)interlocked_exchange_64(&result->partitions[i].hits, 0);
+                            (void)interlocked_exchange_64(&result->partitions[i].misses, 0);
+                            (void)interlocked_exchange_64(&result->partitions[i].returns, 0);
+                            (void)interlocked_exchange_64(&result->partitions[i].foreign_frees, 0);
+                        }
+                        goto allOk;
+                    }
+                    free(result->partitions_memory);
+                }
+            }
+            free(result);
+            result = NULL;
+        }
+    }
+allOk:;
+    return result;
+}
+
+void thandle_pool_destroy(THANDLE_POOL_HANDLE thandle_pool)
+{
+    /*Codes_SRS_THANDLE_POOL_02_008: [ If thandle_pool is NULL then thandle_pool_destroy shall return. ]*/
+    if (thandle_pool == NULL)
+    {
+        LogError("invalid argument THANDLE_POOL_HANDLE thandle_pool=%p", thandle_pool);
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_POOL_02_009: [ thandle_pool_destroy shall free the slab, the partitions and the pool. ]*/
+        free(thandle_pool->items);
+        free(thandle_pool->partitions_memory);
+        free(thandle_pool);
+    }
+}
+
+void* thandle_pool_malloc(THANDLE_POOL_HANDLE thandle_pool, size_t size)
+{
+    void* result;
+    if (thandle_pool == NULL)
+    {
+        /*Codes_SRS_THANDLE_POOL_02_010: [ If thandle_pool is NULL then thandle_pool_malloc shall fail and return NULL. ]*/
+        LogError("invalid arguments THANDLE_POOL_HANDLE thandle_pool=%p, size_t size=%zu", thandle_pool, size);
+        result = NULL;
+    }
+    else
+    {
+        uint32_t current = processor_index_get_current() % thandle_pool->partition_count;
+        if (size > thandle_pool->item_size)
+        {
+            /*Codes_SRS_THANDLE_POOL_02_011: [ If size is greater than the size of the items then thandle_pool_malloc shall count a miss and return NULL. ]*/
+            (void)interlocked_increment_64(&thandle_pool->partitions[current].misses);
+            result = NULL;
+        }
+        else
+        {
+            uint32_t i;
+            result = NULL;
+            /*Codes_SRS_THANDLE_POOL_02_012: [ thandle_pool_malloc shall look for a free item in the partition of the current processor (as returned by processor_index_get_current) and then in the partitions of the other processors. ]*/
+            for (i = 0; i < thandle_pool->partition_count; i++)
+            {
+                uint32_t partition = (current + i) % thandle_pool->partition_count;
+                /*Codes_SRS_THANDLE_POOL_02_013: [ thandle_pool_malloc shall take the free item by clearing its bit in the free items of the partition with interlocked_compare_exchange_64. ]*/
+                uint32_t index = take_item(&thandle_pool->partitions[partition]);
+                if (index != UINT32_MAX)
+                {
+                    result = thandle_pool->items + ((size_t)partition * thandle_pool->items_per_processor + index) * thandle_pool->item_size;
+                    break;
+                }
+            }
+
+            if (result == NULL)
+            {
+                /*Codes_SRS_THANDLE_POOL_02_016: [ If there are no free items then thandle_pool_malloc shall count a miss and return NULL. ]*/
+                (void)interlocked_increment_64(&thandle_pool->partitions[current].misses);
+            }
+            else
+            {
+                /*Codes_SRS_THANDLE_POOL_02_014: [ thandle_pool_malloc shall count a hit and return the item. ]*/
+                (void)interlocked_increment_64(&thandle_pool->partitions[current].hits);
+            }
+        }
+    }
+    return result;
+}
+
+bool thandle_pool_free(THANDLE_POOL_HANDLE thandle_pool, void* ptr)
+{
+    bool result;
+    if (
+        /*Codes_SRS_THANDLE_POOL_02_017: [ If thandle_pool is NULL then thandle_pool_free shall fail and return false. ]*/
+        (thandle_pool == NULL) ||
+        /*Codes_SRS_THANDLE_POOL_02_018: [ If ptr is NULL then thandle_pool_free shall fail and return false. ]*/
+        (ptr == NULL)
+        )
+    {
+        LogError("invalid arguments THANDLE_POOL_HANDLE thandle_pool=%p, void* ptr=%p", thandle_pool, ptr);
+        result = false;
+    }
+    else
+    {
+        uint32_t current = processor_index_get_current() % thandle_pool->partition_count;
+        if (
+            ((unsigned char*)ptr < thandle_pool->items) ||
+            ((unsigned char*)ptr >= thandle_pool->items_end)
+            )
+        {
+            /*Codes_SRS_THANDLE_POOL_02_019: [ If ptr is not an item of the slab then thandle_pool_free shall count a foreign free and return false. ]*/
+            (void)interlocked_increment_64(&thandle_pool->partitions[current].foreign_frees);
+            result = false;
+        }
+        else
+        {
+            size_t item = (size_t)((unsigned char*)ptr - thandle_pool->items) / thandle_pool->item_size;
+            uint32_t partition = (uint32_t)(item / thandle_pool->items_per_processor);
+            uint32_t index = (uint32_t)(item % thandle_pool->items_per_processor);
+
+            /*Codes_SRS_THANDLE_POOL_02_020: [ thandle_pool_free shall put the item back in the partition that owns it by setting its bit with interlocked_or_64. ]*/
+            (void)interlocked_or_64(&thandle_pool->partitions[partition].free_items, (int64_t)((uint64_t)1 << index));
+
+            /*Codes_SRS_THANDLE_POOL_02_021: [ thandle_pool_free shall count a return and return true. ]*/
+            (void)interlocked_increment_64(&thandle_pool->partitions[current].returns);
+            result = true;
+        }
+    }
+    return result;
+}
+
+int thandle_pool_get_statistics(THANDLE_POOL_HANDLE thandle_pool, THANDLE_POOL_STATISTICS* statistics)
+{
+    int result;
+    if (
+        /*Codes_SRS_THANDLE_POOL_02_022: [ If thandle_pool is NULL then thandle_pool_get_statistics shall fail and return a non-zero value. ]*/
+        (thandle_pool == NULL) ||
+        /*Codes_SRS_THANDLE_POOL_02_023: [ If statistics is NULL then thandle_pool_get_statistics shall fail and return a non-zero value. ]*/
+        (statistics == NULL)
+        )
+    {
+        LogError("invalid arguments THANDLE_POOL_HANDLE thandle_pool=%p, THANDLE_POOL_STATISTICS* statistics=%p", thandle_pool, statistics);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        uint32_t i;
+        statistics->hits = 0;
+        statistics->misses = 0;
+        statistics->returns = 0;
+        statistics->foreign_frees = 0;
+        statistics->item_count = thandle_pool->partition_count * thandle_pool->items_per_processor;
+        statistics->free_item_count = 0;
+
+        /*Codes_SRS_THANDLE_POOL_02_024: [ thandle_pool_get_statistics shall sum the counters of all the partitions, count the items that are in the pool, succeed and return 0. ]*/
+        for (i = 0; i < thandle_pool->partition_count; i++)
+        {
+            statistics->hits += (uint64_t)interlocked_add_64(&thandle_pool->partitions[i].hits, 0);
+            statistics->misses += (uint64_t)interlocked_add_64(&thandle_pool->partitions[i].misses, 0);
+            statistics->returns += (uint64_t)interlocked_add_64(&thandle_pool->partitions[i].returns, 0);
+            statistics->foreign_frees += (uint64_t)interlocked_add_64(&thandle_pool->partitions[i].foreign_frees, 0);
+            statistics->free_item_count += count_free_items(interlocked_add_64(&thandle_pool->partitions[i].free_items, 0));
+        }
+        result = 0;
+    }
+    return result;
+}
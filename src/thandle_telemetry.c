@@ -0,0 +1,323 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/processor_index.h"
+
+#include "azure_c_util/thandle_telemetry.h"
+
+#define THANDLE_TELEMETRY_CACHE_LINE_SIZE 64
+
+typedef struct THANDLE_TELEMETRY_PARTITION_TAG
+{
+    volatile_atomic int64_t pending_count; /*live count not folded yet in live_count of THANDLE_TELEMETRY, between -THANDLE_TELEMETRY_BATCH and THANDLE_TELEMETRY_BATCH*/
+    volatile_atomic int64_t live_bytes;
+    volatile_atomic int64_t created_count;
+    uint8_t padding[THANDLE_TELEMETRY_CACHE_LINE_SIZE - (3 * sizeof(int64_t)) % THANDLE_TELEMETRY_CACHE_LINE_SIZE]; /*every partition starts in its own cache line*/
+}THANDLE_TELEMETRY_PARTITION;
+
+/*the name THANDLE_TELEMETRY is the build flag of thandle.h, so the telemetry is only known by its handle*/
+struct THANDLE_TELEMETRY_TAG
+{
+    const char* type_name;
+    volatile_atomic int64_t live_count; /*the sum of the folded pending counts*/
+    volatile_atomic int64_t peak_count;
+    uint32_t partition_count;
+    THANDLE_TELEMETRY_PARTITION* partitions; /*one partition per processor, THANDLE_TELEMETRY_CACHE_LINE_SIZE aligned, points inside partitions_memory*/
+    void* partitions_memory;
+    THANDLE_TELEMETRY_HANDLE next; /*next registered type*/
+};
+
+/*the registered types. Registering and unregistering are rare, so the registry is a list guarded by a spin mutex*/
+static volatile_atomic int32_t g_registry_mutex = 0;
+static THANDLE_TELEMETRY_HANDLE g_registry_head = NULL;
+
+static void update_peak_count(THANDLE_TELEMETRY_HANDLE thandle_telemetry, int64_t live_count)
+{
+    INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    int64_t peak_count = interlocked_add_64(&thandle_telemetry->peak_count, 0);
+    while (live_count > peak_count)
+    {
+        int64_t previous = interlocked_compare_exchange_64(&thandle_telemetry->peak_count, live_count, peak_count);
+        if (previous == peak_count)
+        {
+            break;
+        }
+        peak_count = previous;
+        (void)InterlockedHL_Backoff(&backoff);
+    }
+}
+
+static void fill_statistics(THANDLE_TELEMETRY_HANDLE thandle_telemetry, THANDLE_TELEMETRY_STATISTICS* statistics)
+{
+    uint32_t i;
+    statistics->type_name = thandle_telemetry->type_name;
+    statistics->created_count = 0;
+    statistics->live_count = interlocked_add_64(&thandle_telemetry->live_count, 0);
+    statistics->live_bytes = 0;
+    for (i = 0; i < thandle_telemetry->partition_count; i++)
+    {
+        statistics->created_count += (uint64_t)interlocked_add_64(&thandle_telemetry->partitions[i].created_count, 0);
+        statistics->live_count += interlocked_add_64(&thandle_telemetry->partitions[i].pending_count, 0);
+        statistics->live_bytes += interlocked_add_64(&thandle_telemetry->partitions[i].live_bytes, 0);
+    }
+    update_peak_count(thandle_telemetry, statistics->live_count);
+    statistics->peak_count = interlocked_add_64(&thandle_telemetry->peak_count, 0);
+}
+
+THANDLE_TELEMETRY_HANDLE thandle_telemetry_register(const char* type_name)
+{
+    THANDLE_TELEMETRY_HANDLE result;
+    if (type_name == NULL)
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_001: [ If type_name is NULL then thandle_telemetry_register shall fail and return NULL. ]*/
+        LogError("invalid argument const char* type_name=%p", type_name);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_002: [ thandle_telemetry_register shall allocate memory for the telemetry of type_name. ]*/
+        result = malloc(sizeof(struct THANDLE_TELEMETRY_TAG));
+        if (result == NULL)
+        {
+            /*Codes_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+            LogError("failure in malloc(sizeof(struct THANDLE_TELEMETRY_TAG)=%zu)", sizeof(struct THANDLE_TELEMETRY_TAG));
+            /*return as is*/
+        }
+        else
+        {
+            /*Codes_SRS_THANDLE_TELEMETRY_02_003: [ thandle_telemetry_register shall allocate one cache line aligned partition for every processor returned by processor_index_get_count. ]*/
+            result->partition_count = processor_index_get_count();
+            if (
+                (result->partition_count == 0) ||
+                ((SIZE_MAX - (THANDLE_TELEMETRY_CACHE_LINE_SIZE - 1)) / sizeof(THANDLE_TELEMETRY_PARTITION) < result->partition_count)
+                )
+            {
+                /*Codes_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+                LogError("invalid partition_count=%" PRIu32 "", result->partition_count);
+            }
+            else
+            {
+                result->partitions_memory = malloc(result->partition_count * sizeof(THANDLE_TELEMETRY_PARTITION) + (THANDLE_TELEMETRY_CACHE_LINE_SIZE - 1));
+                if (result->partitions_memory == NULL)
+                {
+                    /*Codes_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+                    LogError("failure in malloc(partition_count=%" PRIu32 " * sizeof(THANDLE_TELEMETRY_PARTITION)=%zu + (THANDLE_TELEMETRY_CACHE_LINE_SIZE - 1)=%d)",
+                        result->partition_count, sizeof(THANDLE_TELEMETRY_PARTITION), THANDLE_TELEMETRY_CACHE_LINE_SIZE - 1);
+                }
+                else
+                {
+                    uint32_t i;
+                    result->type_name = type_name;
+                    result->partitions = (THANDLE_TELEMETRY_PARTITION*)(((uintptr_t)result->partitions_memory + (THANDLE_TELEMETRY_CACHE_LINE_SIZE - 1)) & ~(uintptr_t)(THANDLE_TELEMETRY_CACHE_LINE_SIZE - 1));
+                    (void)interlocked_exchange_64(&result->live_count, 0);
+                    (void)interlocked_exchange_64(&result->peak_count, 0);
+                    for (i = 0; i < result->partition_count; i++)
+                    {
+                        (void)interlocked_exchange_64(&result->partitions[i].pending_count, 0);
+                        (void)interlocked_exchange_64(&result->partitions[i].live_bytes, 0);
+                        (void)interlocked_exchange_64(&result->partitions[i].created_count, 0);
+                    }
+
+                    /*Codes_SRS_THANDLE_TELEMETRY_02_004: [ thandle_telemetry_register shall lock the registry by calling InterlockedHL_MutexLock. ]*/
+                    if (InterlockedHL_MutexLock(&g_registry_mutex) != INTERLOCKED_HL_OK)
+                    {
+                        /*Codes_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+                        LogError("failure in InterlockedHL_MutexLock(&g_registry_mutex=%p)", &g_registry_mutex);
+                    }
+                    else
+                    {
+                        /*Codes_SRS_THANDLE_TELEMETRY_02_005: [ thandle_telemetry_register shall set all the counters to 0, add the telemetry to the registry, unlock the registry, succeed and return a non-NULL value. ]*/
+                        result->next = g_registry_head;
+                        g_registry_head = result;
+                        (void)InterlockedHL_MutexUnlock(&g_registry_mutex);
+                        goto allOk;
+                    }
+                    free(result->partitions_memory);
+                }
+            }
+            free(result);
+            result = NULL;
+        }
+    }
+allOk:;
+    return result;
+}
+
+void thandle_telemetry_unregister(THANDLE_TELEMETRY_HANDLE thandle_telemetry)
+{
+    if (thandle_telemetry == NULL)
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_007: [ If thandle_telemetry is NULL then thandle_telemetry_unregister shall return. ]*/
+        LogError("invalid argument THANDLE_TELEMETRY_HANDLE thandle_telemetry=%p", thandle_telemetry);
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_008: [ thandle_telemetry_unregister shall lock the registry by calling InterlockedHL_MutexLock. ]*/
+        if (InterlockedHL_MutexLock(&g_registry_mutex) != INTERLOCKED_HL_OK)
+        {
+            /*Codes_SRS_THANDLE_TELEMETRY_02_009: [ If InterlockedHL_MutexLock fails then thandle_telemetry_unregister shall return. ]*/
+            LogError("failure in InterlockedHL_MutexLock(&g_registry_mutex=%p), the telemetry of %s is not freed", &g_registry_mutex, thandle_telemetry->type_name);
+        }
+        else
+        {
+            /*Codes_SRS_THANDLE_TELEMETRY_02_010: [ thandle_telemetry_unregister shall remove the telemetry from the registry and unlock the registry. ]*/
+            THANDLE_TELEMETRY_HANDLE* current = &g_registry_head;
+            while ((*current != NULL) && (*current != thandle_telemetry))
+            {
+                current = &(*current)->next;
+            }
+            if (*current != NULL)
+            {
+                *current = thandle_telemetry->next;
+            }
+            (void)InterlockedHL_MutexUnlock(&g_registry_mutex);
+
+            /*Codes_SRS_THANDLE_TELEMETRY_02_011: [ thandle_telemetry_unregister shall free the partitions and the telemetry. ]*/
+            free(thandle_telemetry->partitions_memory);
+            free(thandle_telemetry);
+        }
+    }
+}
+
+void thandle_telemetry_on_create(THANDLE_TELEMETRY_HANDLE thandle_telemetry, size_t size)
+{
+    if (thandle_telemetry == NULL)
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_012: [ If thandle_telemetry is NULL then thandle_telemetry_on_create shall return. ]*/
+        LogError("invalid arguments THANDLE_TELEMETRY_HANDLE thandle_telemetry=%p, size_t size=%zu", thandle_telemetry, size);
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_013: [ thandle_telemetry_on_create shall add 1 to the created count, 1 to the pending count and size to the live bytes of the partition of the current processor (as returned by processor_index_get_current). ]*/
+        THANDLE_TELEMETRY_PARTITION* partition = &thandle_telemetry->partitions[processor_index_get_current() % thandle_telemetry->partition_count];
+        int64_t pending_count;
+        (void)interlocked_increment_64(&partition->created_count);
+        (void)interlocked_add_64(&partition->live_bytes, (int64_t)size);
+        pending_count = interlocked_increment_64(&partition->pending_count);
+        if (pending_count >= THANDLE_TELEMETRY_BATCH)
+        {
+            /*Codes_SRS_THANDLE_TELEMETRY_02_014: [ If the pending count of the partition reaches THANDLE_TELEMETRY_BATCH then thandle_telemetry_on_create shall move it to the live count and raise the peak count to the live count. ]*/
+            (void)interlocked_add_64(&partition->pending_count, -pending_count);
+            update_peak_count(thandle_telemetry, interlocked_add_64(&thandle_telemetry->live_count, pending_count));
+        }
+    }
+}
+
+void thandle_telemetry_on_free(THANDLE_TELEMETRY_HANDLE thandle_telemetry, size_t size)
+{
+    if (thandle_telemetry == NULL)
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_015: [ If thandle_telemetry is NULL then thandle_telemetry_on_free shall return. ]*/
+        LogError("invalid arguments THANDLE_TELEMETRY_HANDLE thandle_telemetry=%p, size_t size=%zu", thandle_telemetry, size);
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_016: [ thandle_telemetry_on_free shall subtract 1 from the pending count and size from the live bytes of the partition of the current processor (as returned by processor_index_get_current). ]*/
+        THANDLE_TELEMETRY_PARTITION* partition = &thandle_telemetry->partitions[processor_index_get_current() % thandle_telemetry->partition_count];
+        int64_t pending_count;
+        (void)interlocked_add_64(&partition->live_bytes, -(int64_t)size);
+        pending_count = interlocked_decrement_64(&partition->pending_count);
+        if (pending_count <= -THANDLE_TELEMETRY_BATCH)
+        {
+            /*Codes_SRS_THANDLE_TELEMETRY_02_017: [ If the pending count of the partition reaches -THANDLE_TELEMETRY_BATCH then thandle_telemetry_on_free shall move it to the live count. ]*/
+            (void)interlocked_add_64(&partition->pending_count, -pending_count);
+            (void)interlocked_add_64(&thandle_telemetry->live_count, pending_count);
+        }
+    }
+}
+
+int thandle_telemetry_get_statistics(THANDLE_TELEMETRY_HANDLE thandle_telemetry, THANDLE_TELEMETRY_STATISTICS* statistics)
+{
+    int result;
+    if (
+        /*Codes_SRS_THANDLE_TELEMETRY_02_018: [ If thandle_telemetry is NULL then thandle_telemetry_get_statistics shall fail and return a non-zero value. ]*/
+        (thandle_telemetry == NULL) ||
+        /*Codes_SRS_THANDLE_TELEMETRY_02_019: [ If statistics is NULL then thandle_telemetry_get_statistics shall fail and return a non-zero value. ]*/
+        (statistics == NULL)
+        )
+    {
+        LogError("invalid arguments THANDLE_TELEMETRY_HANDLE thandle_telemetry=%p, THANDLE_TELEMETRY_STATISTICS* statistics=%p", thandle_telemetry, statistics);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_020: [ thandle_telemetry_get_statistics shall add the pending counts of all the partitions to the live count and sum the created counts and the live bytes of all the partitions. ]*/
+        /*Codes_SRS_THANDLE_TELEMETRY_02_021: [ thandle_telemetry_get_statistics shall raise the peak count to the live count, succeed and return 0. ]*/
+        fill_statistics(thandle_telemetry, statistics);
+        result = 0;
+    }
+    return result;
+}
+
+int thandle_telemetry_enumerate(THANDLE_TELEMETRY_ON_TYPE on_type, void* context)
+{
+    int result;
+    if (on_type == NULL)
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_022: [ If on_type is NULL then thandle_telemetry_enumerate shall fail and return a non-zero value. ]*/
+        LogError("invalid arguments THANDLE_TELEMETRY_ON_TYPE on_type=%p, void* context=%p", on_type, context);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_023: [ thandle_telemetry_enumerate shall lock the registry by calling InterlockedHL_MutexLock. ]*/
+        if (InterlockedHL_MutexLock(&g_registry_mutex) != INTERLOCKED_HL_OK)
+        {
+            /*Codes_SRS_THANDLE_TELEMETRY_02_024: [ If InterlockedHL_MutexLock fails then thandle_telemetry_enumerate shall fail and return a non-zero value. ]*/
+            LogError("failure in InterlockedHL_MutexLock(&g_registry_mutex=%p)", &g_registry_mutex);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            THANDLE_TELEMETRY_HANDLE current;
+            /*Codes_SRS_THANDLE_TELEMETRY_02_025: [ For every registered type thandle_telemetry_enumerate shall call on_type with context and the statistics of the type (as thandle_telemetry_get_statistics would return them). ]*/
+            for (current = g_registry_head; current != NULL; current = current->next)
+            {
+                THANDLE_TELEMETRY_STATISTICS statistics;
+                fill_statistics(current, &statistics);
+                on_type(context, &statistics);
+            }
+
+            /*Codes_SRS_THANDLE_TELEMETRY_02_026: [ thandle_telemetry_enumerate shall unlock the registry, succeed and return 0. ]*/
+            (void)InterlockedHL_MutexUnlock(&g_registry_mutex);
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static void log_type(void* context, const THANDLE_TELEMETRY_STATISTICS* statistics)
+{
+    (void)context;
+    LogInfo("THANDLE(%s): live_count=%" PRId64 ", live_bytes=%" PRId64 ", peak_count=%" PRId64 ", created_count=%" PRIu64 "",
+        statistics->type_name, statistics->live_count, statistics->live_bytes, statistics->peak_count, statistics->created_count);
+}
+
+int thandle_telemetry_log_all(void)
+{
+    int result;
+    /*Codes_SRS_THANDLE_TELEMETRY_02_027: [ thandle_telemetry_log_all shall call thandle_telemetry_enumerate with a callback that logs the statistics of every type. ]*/
+    if (thandle_telemetry_enumerate(log_type, NULL) != 0)
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_028: [ If thandle_telemetry_enumerate fails then thandle_telemetry_log_all shall fail and return a non-zero value. ]*/
+        LogError("failure in thandle_telemetry_enumerate(log_type=%p, NULL)", log_type);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        /*Codes_SRS_THANDLE_TELEMETRY_02_029: [ thandle_telemetry_log_all shall succeed and return 0. ]*/
+        result = 0;
+    }
+    return result;
+}
@@ -0,0 +1,229 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_pal/sync.h"
+#include "azure_c_pal/timer.h"
+#include "azure_c_util/interlocked_hl.h"
+
+#include "azure_c_util/token_bucket.h"
+
+MU_DEFINE_ENUM_STRINGS(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_RESULT_VALUES);
+
+/*the bucket is never locked. "used" is the number of tokens taken out of the bucket and not yet given back by a refill,
+so the bucket has capacity - used tokens. Taking tokens is InterlockedHL_Add64WithCeiling(&used, capacity, count).
+The refill is lazy: every caller computes from the clock how many tokens should have been given back since the creation,
+and the one caller that wins the compare exchange of "refilled" gives back the difference*/
+typedef struct TOKEN_BUCKET_TAG
+{
+    int64_t capacity;
+    double tokens_per_ms;
+    double start_ms;
+    volatile_atomic int64_t used;
+    volatile_atomic int64_t refilled;           /*number of tokens given back since start_ms (including those that did not fit in the bucket)*/
+    volatile_atomic int32_t refill_generation;  /*incremented by every refill that has waiters, token_bucket_acquire waits for it to change*/
+    volatile_atomic int32_t waiter_count;
+}TOKEN_BUCKET;
+
+TOKEN_BUCKET_HANDLE token_bucket_create(int64_t capacity, int64_t tokens_per_second)
+{
+    TOKEN_BUCKET_HANDLE result;
+    if (
+        /*Codes_SRS_TOKEN_BUCKET_02_001: [ If capacity is less than or equal to 0 then token_bucket_create shall fail and return NULL. ]*/
+        (capacity <= 0) ||
+        /*Codes_SRS_TOKEN_BUCKET_02_002: [ If tokens_per_second is less than or equal to 0 then token_bucket_create shall fail and return NULL. ]*/
+        (tokens_per_second <= 0)
+        )
+    {
+        LogError("invalid arguments int64_t capacity=%" PRId64 ", int64_t tokens_per_second=%" PRId64 "", capacity, tokens_per_second);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_TOKEN_BUCKET_02_003: [ token_bucket_create shall allocate memory for the bucket. ]*/
+        result = malloc(sizeof(TOKEN_BUCKET));
+        if (result == NULL)
+        {
+            /*Codes_SRS_TOKEN_BUCKET_02_004: [ If there are any failures then token_bucket_create shall fail and return NULL. ]*/
+            LogError("failure in malloc(sizeof(TOKEN_BUCKET)=%zu)", sizeof(TOKEN_BUCKET));
+            /*return as is*/
+        }
+        else
+        {
+            /*Codes_SRS_TOKEN_BUCKET_02_005: [ token_bucket_create shall record the current time from timer_global_get_elapsed_ms, set the bucket to hold capacity tokens, succeed and return a non-NULL value. ]*/
+            result->capacity = capacity;
+            result->tokens_per_ms = (double)tokens_per_second / 1000.0;
+            result->start_ms = timer_global_get_elapsed_ms();
+            (void)interlocked_exchange_64(&result->used, 0);
+            (void)interlocked_exchange_64(&result->refilled, 0);
+            (void)interlocked_exchange(&result->refill_generation, 0);
+            (void)interlocked_exchange(&result->waiter_count, 0);
+            /*return as is*/
+        }
+    }
+    return result;
+}
+
+void token_bucket_destroy(TOKEN_BUCKET_HANDLE token_bucket)
+{
+    /*Codes_SRS_TOKEN_BUCKET_02_006: [ If token_bucket is NULL then token_bucket_destroy shall return. ]*/
+    if (token_bucket == NULL)
+    {
+        LogError("invalid argument TOKEN_BUCKET_HANDLE token_bucket=%p", token_bucket);
+    }
+    else
+    {
+        /*Codes_SRS_TOKEN_BUCKET_02_007: [ token_bucket_destroy shall free all used resources. ]*/
+        free(token_bucket);
+    }
+}
+
+static void token_bucket_refill(TOKEN_BUCKET_HANDLE token_bucket)
+{
+    /*Codes_SRS_TOKEN_BUCKET_02_010: [ token_bucket_try_acquire shall compute from timer_global_get_elapsed_ms the number of tokens due since the creation of the bucket and give back to the bucket the tokens that were not given back yet, without exceeding capacity. ]*/
+    /*Codes_SRS_TOKEN_BUCKET_02_016: [ token_bucket_acquire shall refill the bucket as token_bucket_try_acquire does. ]*/
+    int64_t due = (int64_t)((timer_global_get_elapsed_ms() - token_bucket->start_ms) * token_bucket->tokens_per_ms);
+    int64_t refilled = interlocked_add_64(&token_bucket->refilled, 0);
+
+    /*only the thread that moves "refilled" forward gives back the tokens, so every token is given back once*/
+    if (
+        (due > refilled) &&
+        (interlocked_compare_exchange_64(&token_bucket->refilled, due, refilled) == refilled)
+        )
+    {
+        int64_t given_back = due - refilled;
+        int64_t used;
+        int64_t new_used;
+        do
+        {
+            used = interlocked_add_64(&token_bucket->used, 0);
+            /*the tokens that do not fit in the bucket are lost*/
+            new_used = (used > given_back) ? (used - given_back) : 0;
+        } while (interlocked_compare_exchange_64(&token_bucket->used, new_used, used) != used);
+
+        /*Codes_SRS_TOKEN_BUCKET_02_020: [ When the refill gives back tokens and there are threads waiting in token_bucket_acquire, the waiting threads shall be woken up with wake_by_address_all. ]*/
+        if (interlocked_add(&token_bucket->waiter_count, 0) != 0)
+        {
+            (void)interlocked_increment(&token_bucket->refill_generation);
+            wake_by_address_all(&token_bucket->refill_generation);
+        }
+    }
+}
+
+static bool token_bucket_take(TOKEN_BUCKET_HANDLE token_bucket, int64_t count)
+{
+    int64_t original_used;
+    return (InterlockedHL_Add64WithCeiling(&token_bucket->used, token_bucket->capacity, count, &original_used) == INTERLOCKED_HL_OK);
+}
+
+TOKEN_BUCKET_RESULT token_bucket_try_acquire(TOKEN_BUCKET_HANDLE token_bucket, int64_t count)
+{
+    TOKEN_BUCKET_RESULT result;
+    if (
+        /*Codes_SRS_TOKEN_BUCKET_02_008: [ If token_bucket is NULL then token_bucket_try_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+        (token_bucket == NULL) ||
+        /*Codes_SRS_TOKEN_BUCKET_02_009: [ If count is less than or equal to 0 or count is greater than the capacity of the bucket then token_bucket_try_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+        (count <= 0) ||
+        (count > token_bucket->capacity)
+        )
+    {
+        LogError("invalid arguments TOKEN_BUCKET_HANDLE token_bucket=%p, int64_t count=%" PRId64 "", token_bucket, count);
+        result = TOKEN_BUCKET_ERROR;
+    }
+    else
+    {
+        token_bucket_refill(token_bucket);
+
+        /*Codes_SRS_TOKEN_BUCKET_02_011: [ token_bucket_try_acquire shall take count tokens from the bucket by calling InterlockedHL_Add64WithCeiling with the capacity of the bucket as ceiling. ]*/
+        if (token_bucket_take(token_bucket, count))
+        {
+            /*Codes_SRS_TOKEN_BUCKET_02_012: [ If InterlockedHL_Add64WithCeiling succeeds then token_bucket_try_acquire shall succeed and return TOKEN_BUCKET_OK. ]*/
+            result = TOKEN_BUCKET_OK;
+        }
+        else
+        {
+            /*Codes_SRS_TOKEN_BUCKET_02_013: [ Otherwise token_bucket_try_acquire shall return TOKEN_BUCKET_NOT_ENOUGH_TOKENS. ]*/
+            result = TOKEN_BUCKET_NOT_ENOUGH_TOKENS;
+        }
+    }
+    return result;
+}
+
+TOKEN_BUCKET_RESULT token_bucket_acquire(TOKEN_BUCKET_HANDLE token_bucket, int64_t count, uint32_t timeout_ms)
+{
+    TOKEN_BUCKET_RESULT result;
+    if (
+        /*Codes_SRS_TOKEN_BUCKET_02_014: [ If token_bucket is NULL then token_bucket_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+        (token_bucket == NULL) ||
+        /*Codes_SRS_TOKEN_BUCKET_02_015: [ If count is less than or equal to 0 or count is greater than the capacity of the bucket then token_bucket_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+        (count <= 0) ||
+        (count > token_bucket->capacity)
+        )
+    {
+        LogError("invalid arguments TOKEN_BUCKET_HANDLE token_bucket=%p, int64_t count=%" PRId64 ", uint32_t timeout_ms=%" PRIu32 "", token_bucket, count, timeout_ms);
+        result = TOKEN_BUCKET_ERROR;
+    }
+    else
+    {
+        double start_ms = timer_global_get_elapsed_ms();
+        while (1)
+        {
+            token_bucket_refill(token_bucket);
+
+            /*Codes_SRS_TOKEN_BUCKET_02_017: [ token_bucket_acquire shall take count tokens from the bucket by calling InterlockedHL_Add64WithCeiling with the capacity of the bucket as ceiling. If that succeeds then token_bucket_acquire shall succeed and return TOKEN_BUCKET_OK. ]*/
+            if (token_bucket_take(token_bucket, count))
+            {
+                result = TOKEN_BUCKET_OK;
+                break;
+            }
+            else
+            {
+                double elapsed_ms = timer_global_get_elapsed_ms() - start_ms;
+
+                /*Codes_SRS_TOKEN_BUCKET_02_018: [ If timeout_ms is not UINT32_MAX and timeout_ms milliseconds have elapsed since token_bucket_acquire was called then token_bucket_acquire shall return TOKEN_BUCKET_TIMEOUT. ]*/
+                if (
+                    (timeout_ms != UINT32_MAX) &&
+                    (elapsed_ms >= (double)timeout_ms)
+                    )
+                {
+                    result = TOKEN_BUCKET_TIMEOUT;
+                    break;
+                }
+                else
+                {
+                    /*Codes_SRS_TOKEN_BUCKET_02_019: [ Otherwise token_bucket_acquire shall wait with wait_on_address for the bucket to be refilled, at most for the time needed to refill the missing tokens and at most until timeout_ms expires, and then try again. ]*/
+                    int64_t missing = interlocked_add_64(&token_bucket->used, 0) + count - token_bucket->capacity;
+                    double wait_ms = (missing > 0) ? ((double)missing / token_bucket->tokens_per_ms) + 1 : 1;
+                    if (
+                        (timeout_ms != UINT32_MAX) &&
+                        (wait_ms > (double)timeout_ms - elapsed_ms)
+                        )
+                    {
+                        wait_ms = (double)timeout_ms - elapsed_ms + 1;
+                    }
+                    if (wait_ms > (double)(UINT32_MAX - 1))
+                    {
+                        wait_ms = (double)(UINT32_MAX - 1);
+                    }
+
+                    (void)interlocked_increment(&token_bucket->waiter_count);
+                    int32_t generation = interlocked_add(&token_bucket->refill_generation, 0);
+                    /*wait_on_address returns false when the time expires, which is the common case here (the time was computed to be just enough), so the result is not an error*/
+                    (void)wait_on_address(&token_bucket->refill_generation, generation, (uint32_t)wait_ms);
+                    (void)interlocked_decrement(&token_bucket->waiter_count);
+                }
+            }
+        }
+    }
+    return result;
+}
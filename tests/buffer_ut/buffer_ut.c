@@ -12,6 +12,7 @@
 #include "azure_macro_utils/macro_utils.h"
 #include "umock_c/umock_c.h"
 #include "umock_c/umock_c_negative_tests.h"
+#include "umock_c/umocktypes_stdint.h"
 
 #include "testrunnerswitcher.h"
 
@@ -76,6 +77,7 @@ void my_gballoc_free(void* ptr)
 #define ENABLE_MOCKS
 #include "azure_c_pal/gballoc_hl.h"
 #include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_util/memory_budget.h"
 #undef ENABLE_MOCKS
 
 #include "real_gballoc_hl.h"
@@ -96,6 +98,12 @@ static const unsigned char TOTAL_BUFFER[] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,
 
 static TEST_MUTEX_HANDLE g_testByTest;
 
+#define TEST_MEMORY_BUDGET ((MEMORY_BUDGET_HANDLE)0x4242)
+#define TEST_MEMORY_BUDGET_2 ((MEMORY_BUDGET_HANDLE)0x4243)
+
+MU_DEFINE_ENUM_STRINGS(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+
 MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
@@ -120,6 +128,12 @@ BEGIN_TEST_SUITE(Buffer_UnitTests)
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_hl_realloc, my_gballoc_realloc);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(realloc, NULL);
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_hl_free, my_gballoc_free);
+
+        ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
+        REGISTER_UMOCK_ALIAS_TYPE(MEMORY_BUDGET_HANDLE, void*);
+        REGISTER_TYPE(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT);
+        REGISTER_GLOBAL_MOCK_RETURN(memory_budget_charge, MEMORY_BUDGET_OK);
+        REGISTER_GLOBAL_MOCK_RETURN(memory_budget_get_name, "test budget");
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -138,6 +152,8 @@ BEGIN_TEST_SUITE(Buffer_UnitTests)
             ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
         }
 
+        BUFFER_set_memory_budget(NULL, 0);
+
         umock_c_reset_all_calls();
 
         ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
@@ -1741,4 +1757,311 @@ TEST_FUNCTION(BUFFER_prepend_Succeed)
         BUFFER_delete(buffer);
     }
 
+    /* BUFFER_set_memory_budget */
+
+    /* Tests_SRS_BUFFER_02_009: [ BUFFER_set_memory_budget shall store memory_budget and timeout_ms to be used by all the BUFFER_HANDLEs created afterwards. ]*/
+    /* Tests_SRS_BUFFER_02_006: [ If the BUFFER_HANDLE was created after a memory budget was set by BUFFER_set_memory_budget then before growing its content above the size that was already charged, BUFFER_create, BUFFER_create_with_size, BUFFER_build, BUFFER_append_build, BUFFER_pre_build, BUFFER_enlarge, BUFFER_append, BUFFER_prepend and BUFFER_clone shall charge the growth by calling memory_budget_charge with the timeout set by BUFFER_set_memory_budget. ]*/
+    TEST_FUNCTION(after_BUFFER_set_memory_budget_BUFFER_create_charges_the_content)
+    {
+        ///arrange
+        BUFFER_HANDLE buffer;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 42);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, ALLOCATION_SIZE, 42));
+        STRICT_EXPECTED_CALL(malloc(ALLOCATION_SIZE));
+
+        ///act
+        buffer = BUFFER_create(BUFFER_TEST_VALUE, ALLOCATION_SIZE);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        BUFFER_delete(buffer);
+    }
+
+    /* Tests_SRS_BUFFER_02_006: [ If the BUFFER_HANDLE was created after a memory budget was set by BUFFER_set_memory_budget then before growing its content above the size that was already charged, BUFFER_create, BUFFER_create_with_size, BUFFER_build, BUFFER_append_build, BUFFER_pre_build, BUFFER_enlarge, BUFFER_append, BUFFER_prepend and BUFFER_clone shall charge the growth by calling memory_budget_charge with the timeout set by BUFFER_set_memory_budget. ]*/
+    TEST_FUNCTION(after_BUFFER_set_memory_budget_BUFFER_enlarge_charges_only_the_growth)
+    {
+        ///arrange
+        int result;
+        BUFFER_HANDLE buffer;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        buffer = BUFFER_create(BUFFER_TEST_VALUE, ALLOCATION_SIZE);
+        ASSERT_IS_NOT_NULL(buffer);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, ALLOCATION_SIZE, 0));
+        STRICT_EXPECTED_CALL(realloc(IGNORED_ARG, TOTAL_ALLOCATION_SIZE));
+
+        ///act
+        result = BUFFER_enlarge(buffer, ALLOCATION_SIZE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        BUFFER_delete(buffer);
+    }
+
+    /* Tests_SRS_BUFFER_02_006: [ If the BUFFER_HANDLE was created after a memory budget was set by BUFFER_set_memory_budget then before growing its content above the size that was already charged, BUFFER_create, BUFFER_create_with_size, BUFFER_build, BUFFER_append_build, BUFFER_pre_build, BUFFER_enlarge, BUFFER_append, BUFFER_prepend and BUFFER_clone shall charge the growth by calling memory_budget_charge with the timeout set by BUFFER_set_memory_budget. ]*/
+    TEST_FUNCTION(BUFFER_build_below_the_charged_size_does_not_charge_again)
+    {
+        ///arrange
+        int result;
+        BUFFER_HANDLE buffer;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        buffer = BUFFER_create(BUFFER_TEST_VALUE, ALLOCATION_SIZE);
+        ASSERT_IS_NOT_NULL(buffer);
+        ASSERT_ARE_EQUAL(int, 0, BUFFER_shrink(buffer, ALLOCATION_SIZE - BUFFER_TEST1_SIZE, true));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(realloc(IGNORED_ARG, BUFFER_TEST2_SIZE));
+
+        ///act
+        result = BUFFER_build(buffer, BUFFER_Test2, BUFFER_TEST2_SIZE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        BUFFER_delete(buffer);
+    }
+
+    /* Tests_SRS_BUFFER_02_007: [ If memory_budget_charge fails then the function shall fail without changing the content of the BUFFER_HANDLE. ]*/
+    TEST_FUNCTION(when_memory_budget_charge_fails_BUFFER_append_fails)
+    {
+        ///arrange
+        int result;
+        BUFFER_HANDLE buffer1;
+        BUFFER_HANDLE buffer2;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        buffer1 = BUFFER_create(BUFFER_TEST_VALUE, ALLOCATION_SIZE);
+        ASSERT_IS_NOT_NULL(buffer1);
+        buffer2 = BUFFER_create(ADDITIONAL_BUFFER, ALLOCATION_SIZE);
+        ASSERT_IS_NOT_NULL(buffer2);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, ALLOCATION_SIZE, 0))
+            .SetReturn(MEMORY_BUDGET_EXHAUSTED);
+        STRICT_EXPECTED_CALL(memory_budget_get_name(TEST_MEMORY_BUDGET));
+
+        ///act
+        result = BUFFER_append(buffer1, buffer2);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, ALLOCATION_SIZE, BUFFER_length(buffer1));
+        ASSERT_ARE_EQUAL(int, 0, memcmp(BUFFER_u_char(buffer1), BUFFER_TEST_VALUE, ALLOCATION_SIZE));
+
+        ///cleanup
+        BUFFER_delete(buffer1);
+        BUFFER_delete(buffer2);
+    }
+
+    /* Tests_SRS_BUFFER_02_007: [ If memory_budget_charge fails then the function shall fail without changing the content of the BUFFER_HANDLE. ]*/
+    TEST_FUNCTION(when_memory_budget_charge_fails_BUFFER_create_fails)
+    {
+        ///arrange
+        BUFFER_HANDLE buffer;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, ALLOCATION_SIZE, 0))
+            .SetReturn(MEMORY_BUDGET_EXHAUSTED);
+        STRICT_EXPECTED_CALL(memory_budget_get_name(TEST_MEMORY_BUDGET));
+        STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+        ///act
+        buffer = BUFFER_create(BUFFER_TEST_VALUE, ALLOCATION_SIZE);
+
+        ///assert
+        ASSERT_IS_NULL(buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_BUFFER_02_008: [ If the BUFFER_HANDLE was charged to a memory budget, BUFFER_delete shall give back all the charged bytes by calling memory_budget_release. ]*/
+    TEST_FUNCTION(BUFFER_delete_gives_back_the_largest_charged_size)
+    {
+        ///arrange
+        BUFFER_HANDLE buffer;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        buffer = BUFFER_create(BUFFER_TEST_VALUE, ALLOCATION_SIZE);
+        ASSERT_IS_NOT_NULL(buffer);
+        ASSERT_ARE_EQUAL(int, 0, BUFFER_enlarge(buffer, ALLOCATION_SIZE));
+        ASSERT_ARE_EQUAL(int, 0, BUFFER_shrink(buffer, ALLOCATION_SIZE, true));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+        STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET, TOTAL_ALLOCATION_SIZE));
+        STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+        ///act
+        BUFFER_delete(buffer);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_BUFFER_02_010: [ If memory_budget is NULL then the BUFFER_HANDLEs created afterwards shall not be charged to any memory budget. ]*/
+    TEST_FUNCTION(BUFFER_created_before_BUFFER_set_memory_budget_is_not_charged)
+    {
+        ///arrange
+        int result;
+        BUFFER_HANDLE buffer = BUFFER_create(BUFFER_TEST_VALUE, ALLOCATION_SIZE);
+        ASSERT_IS_NOT_NULL(buffer);
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(realloc(IGNORED_ARG, TOTAL_ALLOCATION_SIZE));
+
+        ///act
+        result = BUFFER_enlarge(buffer, ALLOCATION_SIZE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        BUFFER_delete(buffer);
+    }
+
+    /* BUFFER_create_with_memory_budget */
+
+    /* Tests_SRS_BUFFER_02_011: [ If source is NULL then BUFFER_create_with_memory_budget shall fail and return NULL. ]*/
+    TEST_FUNCTION(BUFFER_create_with_memory_budget_with_NULL_source_fails)
+    {
+        ///act
+        BUFFER_HANDLE buffer = BUFFER_create_with_memory_budget(NULL, ALLOCATION_SIZE, TEST_MEMORY_BUDGET_2, 0);
+
+        ///assert
+        ASSERT_IS_NULL(buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_BUFFER_02_012: [ If memory_budget is not NULL then BUFFER_create_with_memory_budget shall charge the content to memory_budget (and not to the budget set by BUFFER_set_memory_budget) by calling memory_budget_charge with timeout_ms, and so shall every later growth of the BUFFER_HANDLE. ]*/
+    /* Tests_SRS_BUFFER_02_014: [ Otherwise BUFFER_create_with_memory_budget shall copy size bytes from source in a new BUFFER_HANDLE and return it. ]*/
+    TEST_FUNCTION(BUFFER_create_with_memory_budget_charges_memory_budget_and_not_the_one_set_by_BUFFER_set_memory_budget)
+    {
+        ///arrange
+        BUFFER_HANDLE buffer;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, ALLOCATION_SIZE, 42));
+        STRICT_EXPECTED_CALL(malloc(ALLOCATION_SIZE));
+
+        ///act
+        buffer = BUFFER_create_with_memory_budget(BUFFER_TEST_VALUE, ALLOCATION_SIZE, TEST_MEMORY_BUDGET_2, 42);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, ALLOCATION_SIZE, BUFFER_length(buffer));
+        ASSERT_ARE_EQUAL(int, 0, memcmp(BUFFER_u_char(buffer), BUFFER_TEST_VALUE, ALLOCATION_SIZE));
+
+        ///cleanup
+        BUFFER_delete(buffer);
+    }
+
+    /* Tests_SRS_BUFFER_02_012: [ If memory_budget is not NULL then BUFFER_create_with_memory_budget shall charge the content to memory_budget (and not to the budget set by BUFFER_set_memory_budget) by calling memory_budget_charge with timeout_ms, and so shall every later growth of the BUFFER_HANDLE. ]*/
+    TEST_FUNCTION(BUFFER_enlarge_charges_the_growth_of_a_BUFFER_created_with_memory_budget_with_its_timeout)
+    {
+        ///arrange
+        int result;
+        BUFFER_HANDLE buffer = BUFFER_create_with_memory_budget(BUFFER_TEST_VALUE, ALLOCATION_SIZE, TEST_MEMORY_BUDGET_2, 42);
+        ASSERT_IS_NOT_NULL(buffer);
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, ALLOCATION_SIZE, 42));
+        STRICT_EXPECTED_CALL(realloc(IGNORED_ARG, TOTAL_ALLOCATION_SIZE));
+
+        ///act
+        result = BUFFER_enlarge(buffer, ALLOCATION_SIZE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        BUFFER_delete(buffer);
+    }
+
+    /* Tests_SRS_BUFFER_02_013: [ If memory_budget is NULL then the BUFFER_HANDLE created by BUFFER_create_with_memory_budget shall not be charged to any memory budget. ]*/
+    TEST_FUNCTION(BUFFER_create_with_memory_budget_with_NULL_memory_budget_does_not_charge)
+    {
+        ///arrange
+        BUFFER_HANDLE buffer;
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+        STRICT_EXPECTED_CALL(malloc(ALLOCATION_SIZE));
+
+        ///act
+        buffer = BUFFER_create_with_memory_budget(BUFFER_TEST_VALUE, ALLOCATION_SIZE, NULL, 0);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        BUFFER_delete(buffer);
+    }
+
+    /* Tests_SRS_BUFFER_02_015: [ If there are any failures then BUFFER_create_with_memory_budget shall fail and return NULL. ]*/
+    TEST_FUNCTION(when_memory_budget_charge_fails_BUFFER_create_with_memory_budget_fails)
+    {
+        ///arrange
+        BUFFER_HANDLE buffer;
+
+        STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, ALLOCATION_SIZE, 0))
+            .SetReturn(MEMORY_BUDGET_EXHAUSTED);
+        STRICT_EXPECTED_CALL(memory_budget_get_name(TEST_MEMORY_BUDGET_2));
+        STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+        ///act
+        buffer = BUFFER_create_with_memory_budget(BUFFER_TEST_VALUE, ALLOCATION_SIZE, TEST_MEMORY_BUDGET_2, 0);
+
+        ///assert
+        ASSERT_IS_NULL(buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_BUFFER_02_016: [ BUFFER_clone shall charge the clone to the memory budget of handle, with the timeout of handle. ]*/
+    TEST_FUNCTION(BUFFER_clone_charges_the_clone_to_the_memory_budget_of_handle)
+    {
+        ///arrange
+        BUFFER_HANDLE clone;
+        BUFFER_HANDLE buffer = BUFFER_create_with_memory_budget(BUFFER_TEST_VALUE, ALLOCATION_SIZE, TEST_MEMORY_BUDGET_2, 42);
+        ASSERT_IS_NOT_NULL(buffer);
+        BUFFER_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+        STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, ALLOCATION_SIZE, 42));
+        STRICT_EXPECTED_CALL(malloc(ALLOCATION_SIZE));
+
+        ///act
+        clone = BUFFER_clone(buffer);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(clone);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        BUFFER_delete(clone);
+        BUFFER_delete(buffer);
+    }
+
 END_TEST_SUITE(Buffer_UnitTests)
@@ -34,6 +34,7 @@ static void my_gballoc_free(void* s)
 #include "azure_c_pal/gballoc_hl_redirect.h"
 #include "azure_c_pal/interlocked.h"
 #include "azure_c_util/constbuffer.h"
+#include "azure_c_util/log_ratelimit.h"
 #undef ENABLE_MOCKS
 
 #include "real_interlocked.h"
@@ -65,6 +66,23 @@ static CONSTBUFFER_HANDLE TEST_CONSTBUFFER_HANDLE_4;
 static CONSTBUFFER_HANDLE TEST_CONSTBUFFER_HANDLE_5;
 static CONSTBUFFER_HANDLE TEST_CONSTBUFFER_HANDLE_6;
 
+#define TEST_MEMORY_BUDGET ((MEMORY_BUDGET_HANDLE)0x4242)
+#define TEST_MEMORY_BUDGET_2 ((MEMORY_BUDGET_HANDLE)0x4243)
+
+/*the bytes charged by the last call to memory_budget_charge*/
+static int64_t g_memory_budget_charged;
+
+static MEMORY_BUDGET_RESULT my_memory_budget_charge(MEMORY_BUDGET_HANDLE memory_budget, int64_t size, uint32_t timeout_ms)
+{
+    (void)memory_budget;
+    (void)timeout_ms;
+    g_memory_budget_charged = size;
+    return MEMORY_BUDGET_OK;
+}
+
+MU_DEFINE_ENUM_STRINGS(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+
 static void constbuffer_array_create_empty_inert_path(void)
 {
     STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
@@ -257,6 +275,11 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
 
     REGISTER_INTERLOCKED_GLOBAL_MOCK_HOOK();
+
+    REGISTER_UMOCK_ALIAS_TYPE(MEMORY_BUDGET_HANDLE, void*);
+    REGISTER_TYPE(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT);
+    REGISTER_GLOBAL_MOCK_HOOK(memory_budget_charge, my_memory_budget_charge);
+    REGISTER_GLOBAL_MOCK_RETURN(memory_budget_get_name, "test budget");
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -293,6 +316,9 @@ TEST_FUNCTION_INITIALIZE(method_init)
     TEST_CONSTBUFFER_HANDLE_6 = real_CONSTBUFFER_Create(six, sizeof(six));
     ASSERT_IS_NOT_NULL(TEST_CONSTBUFFER_HANDLE_6);
 
+    constbuffer_array_set_memory_budget(NULL, 0);
+    g_memory_budget_charged = 0;
+
     umock_c_reset_all_calls();
     umock_c_negative_tests_init();
 }
@@ -1698,6 +1724,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_count_with_NULL_constbuffer_array_han
     // arrange
     uint32_t buffer_count;
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     int result = constbuffer_array_get_buffer_count(NULL, &buffer_count);
 
@@ -1712,6 +1740,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_count_with_NULL_buffer_count_fails)
     // arrange
     CONSTBUFFER_ARRAY_HANDLE constbuffer_array = TEST_constbuffer_array_create_empty();
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     int result = constbuffer_array_get_buffer_count(constbuffer_array, NULL);
 
@@ -1789,6 +1819,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_with_NULL_constbuffer_array_handle_fa
     // arrange
     CONSTBUFFER_HANDLE result;
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     result = constbuffer_array_get_buffer(NULL, 0);
 
@@ -1811,6 +1843,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_with_index_equal_to_number_of_buffers
     constbuffer_array = constbuffer_array_create(test_buffers, sizeof(test_buffers) / sizeof(test_buffers[0]));
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     result = constbuffer_array_get_buffer(constbuffer_array, 2);
 
@@ -1836,6 +1870,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_with_index_grater_than_number_of_buff
     constbuffer_array = constbuffer_array_create(test_buffers, sizeof(test_buffers) / sizeof(test_buffers[0]));
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     result = constbuffer_array_get_buffer(constbuffer_array, 3);
 
@@ -1856,6 +1892,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_with_index_0_on_empty_array_fails)
 
     constbuffer_array = TEST_constbuffer_array_create_empty();
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     result = constbuffer_array_get_buffer(constbuffer_array, 0);
 
@@ -1875,6 +1913,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_content_with_NULL_constbuffer_array_h
     // arrange
     const CONSTBUFFER* result;
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     result = constbuffer_array_get_buffer_content(NULL, 0);
 
@@ -1953,6 +1993,8 @@ TEST_FUNCTION(constbuffer_array_get_buffer_content_with_index_out_of_range_fails
     constbuffer_array = constbuffer_array_create(test_buffers, sizeof(test_buffers) / sizeof(test_buffers[0]));
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     // act
     result = constbuffer_array_get_buffer_content(constbuffer_array, 2);
 
@@ -2016,6 +2058,8 @@ TEST_FUNCTION(constbuffer_array_inc_ref_with_NULL_constbuffer_array_handle_retur
 {
     ///arrange
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     ///act
     constbuffer_array_inc_ref(NULL);
 
@@ -2030,6 +2074,8 @@ TEST_FUNCTION(constbuffer_array_dec_ref_with_constbuffer_array_handle_NULL_retur
 {
     ///arrange
 
+    STRICT_EXPECTED_CALL(log_ratelimit_hit(IGNORED_ARG));
+
     ///act
     constbuffer_array_dec_ref(NULL);
 
@@ -2509,5 +2555,217 @@ TEST_FUNCTION(CONSTBUFFER_ARRAY_HANDLE_contain_same_with_content_of_buffers_same
     constbuffer_array_dec_ref(right);
 }
 
+/* constbuffer_array_set_memory_budget */
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_059: [ constbuffer_array_set_memory_budget shall store memory_budget and timeout_ms to be used by all the CONSTBUFFER_ARRAY_HANDLEs created afterwards. ]*/
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_056: [ If a memory budget was set by constbuffer_array_set_memory_budget then the functions creating a CONSTBUFFER_ARRAY_HANDLE shall charge the memory budget with the bytes of the new CONSTBUFFER_ARRAY_HANDLE by calling memory_budget_charge with the timeout set by constbuffer_array_set_memory_budget. ]*/
+TEST_FUNCTION(after_constbuffer_array_set_memory_budget_constbuffer_array_create_charges_the_memory_budget)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    CONSTBUFFER_HANDLE test_buffers[2];
+    test_buffers[0] = TEST_CONSTBUFFER_HANDLE_1;
+    test_buffers[1] = TEST_CONSTBUFFER_HANDLE_2;
+    constbuffer_array_set_memory_budget(TEST_MEMORY_BUDGET, 42);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, IGNORED_ARG, 42));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_exchange(IGNORED_ARG, 1));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(TEST_CONSTBUFFER_HANDLE_1));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(TEST_CONSTBUFFER_HANDLE_2));
+
+    ///act
+    result = constbuffer_array_create(test_buffers, 2);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_memory_budget_charged >= (int64_t)(2 * sizeof(CONSTBUFFER_HANDLE))); /*the array and the handle*/
+
+    ///clean
+    constbuffer_array_dec_ref(result);
+}
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_057: [ If memory_budget_charge fails then the functions creating a CONSTBUFFER_ARRAY_HANDLE shall fail and return NULL. ]*/
+TEST_FUNCTION(when_memory_budget_charge_fails_constbuffer_array_create_empty_fails)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    constbuffer_array_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, IGNORED_ARG, 0))
+        .SetReturn(MEMORY_BUDGET_EXHAUSTED);
+    STRICT_EXPECTED_CALL(memory_budget_get_name(TEST_MEMORY_BUDGET));
+
+    ///act
+    result = constbuffer_array_create_empty();
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_057: [ If memory_budget_charge fails then the functions creating a CONSTBUFFER_ARRAY_HANDLE shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_constbuffer_array_create_empty_gives_back_the_charged_bytes)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    constbuffer_array_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET, IGNORED_ARG));
+
+    ///act
+    result = constbuffer_array_create_empty();
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_058: [ If the reference count reaches 0 and the CONSTBUFFER_ARRAY_HANDLE was charged to a memory budget, constbuffer_array_dec_ref shall give back the charged bytes by calling memory_budget_release. ]*/
+TEST_FUNCTION(constbuffer_array_dec_ref_gives_back_the_charged_bytes)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    constbuffer_array_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+    result = constbuffer_array_create_empty();
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_decrement(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET, g_memory_budget_charged));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    constbuffer_array_dec_ref(result);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_060: [ If memory_budget is NULL then the CONSTBUFFER_ARRAY_HANDLEs created afterwards shall not be charged to any memory budget. ]*/
+TEST_FUNCTION(after_constbuffer_array_set_memory_budget_with_NULL_constbuffer_array_create_empty_does_not_charge)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    constbuffer_array_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+    constbuffer_array_set_memory_budget(NULL, 0);
+    umock_c_reset_all_calls();
+
+    constbuffer_array_create_empty_inert_path();
+
+    ///act
+    result = constbuffer_array_create_empty();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    constbuffer_array_dec_ref(result);
+}
+
+/* constbuffer_array_create_with_memory_budget */
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_061: [ If buffers is NULL and buffer_count is not 0, constbuffer_array_create_with_memory_budget shall fail and return NULL. ]*/
+TEST_FUNCTION(constbuffer_array_create_with_memory_budget_with_NULL_buffers_and_non_zero_buffer_count_fails)
+{
+    ///act
+    CONSTBUFFER_ARRAY_HANDLE result = constbuffer_array_create_with_memory_budget(NULL, 1, TEST_MEMORY_BUDGET, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_062: [ If memory_budget is not NULL then constbuffer_array_create_with_memory_budget shall charge memory_budget (and not the budget set by constbuffer_array_set_memory_budget) with the bytes of the new CONSTBUFFER_ARRAY_HANDLE by calling memory_budget_charge with timeout_ms. ]*/
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_064: [ constbuffer_array_create_with_memory_budget shall clone the buffers in buffers, store them and return a non-NULL handle. ]*/
+TEST_FUNCTION(constbuffer_array_create_with_memory_budget_charges_memory_budget_and_not_the_one_set_by_constbuffer_array_set_memory_budget)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    uint32_t buffer_count;
+    CONSTBUFFER_HANDLE test_buffers[2];
+    test_buffers[0] = TEST_CONSTBUFFER_HANDLE_1;
+    test_buffers[1] = TEST_CONSTBUFFER_HANDLE_2;
+    constbuffer_array_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, IGNORED_ARG, 42));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_exchange(IGNORED_ARG, 1));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(TEST_CONSTBUFFER_HANDLE_1));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(TEST_CONSTBUFFER_HANDLE_2));
+
+    ///act
+    result = constbuffer_array_create_with_memory_budget(test_buffers, 2, TEST_MEMORY_BUDGET_2, 42);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, constbuffer_array_get_buffer_count(result, &buffer_count));
+    ASSERT_ARE_EQUAL(uint32_t, 2, buffer_count);
+
+    ///clean
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(interlocked_decrement(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_DecRef(TEST_CONSTBUFFER_HANDLE_1));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_DecRef(TEST_CONSTBUFFER_HANDLE_2));
+    STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET_2, g_memory_budget_charged));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    constbuffer_array_dec_ref(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_063: [ If memory_budget is NULL then constbuffer_array_create_with_memory_budget shall not charge any memory budget. ]*/
+TEST_FUNCTION(constbuffer_array_create_with_memory_budget_with_NULL_memory_budget_does_not_charge)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    CONSTBUFFER_HANDLE test_buffers[1];
+    test_buffers[0] = TEST_CONSTBUFFER_HANDLE_1;
+    constbuffer_array_set_memory_budget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_exchange(IGNORED_ARG, 1));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(TEST_CONSTBUFFER_HANDLE_1));
+
+    ///act
+    result = constbuffer_array_create_with_memory_budget(test_buffers, 1, NULL, 0);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    constbuffer_array_dec_ref(result);
+}
+
+/*Tests_SRS_CONSTBUFFER_ARRAY_02_065: [ If any error occurs, constbuffer_array_create_with_memory_budget shall fail and return NULL. ]*/
+TEST_FUNCTION(when_memory_budget_charge_fails_constbuffer_array_create_with_memory_budget_fails)
+{
+    ///arrange
+    CONSTBUFFER_ARRAY_HANDLE result;
+    CONSTBUFFER_HANDLE test_buffers[1];
+    test_buffers[0] = TEST_CONSTBUFFER_HANDLE_1;
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, IGNORED_ARG, 0))
+        .SetReturn(MEMORY_BUDGET_EXHAUSTED);
+    STRICT_EXPECTED_CALL(memory_budget_get_name(TEST_MEMORY_BUDGET_2));
+
+    ///act
+    result = constbuffer_array_create_with_memory_budget(test_buffers, 1, TEST_MEMORY_BUDGET_2, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
 
 END_TEST_SUITE(constbuffer_array_unittests)
@@ -11,6 +11,7 @@
 
 #include "azure_macro_utils/macro_utils.h"
 #include "testrunnerswitcher.h"
+#include "umock_c/umocktypes_stdint.h"
 
 #include "real_gballoc_ll.h"
 void* my_gballoc_malloc(size_t size)
@@ -26,6 +27,7 @@ void my_gballoc_free(void* ptr)
 #define ENABLE_MOCKS
 #include "umock_c/umock_c.h"
 #include "azure_c_util/buffer_.h"
+#include "azure_c_util/memory_budget.h"
 #include "azure_c_pal/gballoc_hl.h"
 #include "azure_c_pal/gballoc_hl_redirect.h"
 #undef ENABLE_MOCKS
@@ -85,6 +87,23 @@ static size_t my_BUFFER_length(BUFFER_HANDLE handle)
 MOCK_FUNCTION_WITH_CODE(, void, test_free_func, void*, context)
 MOCK_FUNCTION_END()
 
+#define TEST_MEMORY_BUDGET ((MEMORY_BUDGET_HANDLE)0x4242)
+#define TEST_MEMORY_BUDGET_2 ((MEMORY_BUDGET_HANDLE)0x4243)
+
+/*the bytes charged by the last call to memory_budget_charge*/
+static int64_t g_memory_budget_charged;
+
+static MEMORY_BUDGET_RESULT my_memory_budget_charge(MEMORY_BUDGET_HANDLE memory_budget, int64_t size, uint32_t timeout_ms)
+{
+    (void)memory_budget;
+    (void)timeout_ms;
+    g_memory_budget_charged = size;
+    return MEMORY_BUDGET_OK;
+}
+
+MU_DEFINE_ENUM_STRINGS(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+
 MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
@@ -105,10 +124,15 @@ BEGIN_TEST_SUITE(constbuffer_unittests)
         umock_c_init(on_umock_c_error);
 
         REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(MEMORY_BUDGET_HANDLE, void*);
+        REGISTER_TYPE(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT);
+        ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
 
         REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
         REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
         REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, my_BUFFER_length);
+        REGISTER_GLOBAL_MOCK_HOOK(memory_budget_charge, my_memory_budget_charge);
+        REGISTER_GLOBAL_MOCK_RETURN(memory_budget_get_name, "test budget");
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -127,6 +151,9 @@ BEGIN_TEST_SUITE(constbuffer_unittests)
             ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
         }
 
+        CONSTBUFFER_SetMemoryBudget(NULL, 0);
+        g_memory_budget_charged = 0;
+
         umock_c_reset_all_calls();
     }
 
@@ -1554,4 +1581,249 @@ TEST_FUNCTION(CONSTBUFFER_CreateFromOffsetAndSizeWithCopy_unhappy_path) /*this f
     CONSTBUFFER_DecRef(origin);
 }
 
+/* CONSTBUFFER_SetMemoryBudget */
+
+/*Tests_SRS_CONSTBUFFER_02_044: [ CONSTBUFFER_SetMemoryBudget shall store memory_budget and timeout_ms to be used by all the CONSTBUFFER_HANDLEs created afterwards. ]*/
+/*Tests_SRS_CONSTBUFFER_02_041: [ If a memory budget was set by CONSTBUFFER_SetMemoryBudget then the CONSTBUFFER_Create* functions shall charge the memory budget with the bytes of the new CONSTBUFFER_HANDLE by calling memory_budget_charge with the timeout set by CONSTBUFFER_SetMemoryBudget. ]*/
+TEST_FUNCTION(after_CONSTBUFFER_SetMemoryBudget_CONSTBUFFER_Create_charges_the_memory_budget)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 42);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, IGNORED_ARG, 42));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    handle = CONSTBUFFER_Create(BUFFER1_u_char, BUFFER1_length);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_memory_budget_charged > (int64_t)BUFFER1_length); /*the content and the handle*/
+
+    ///cleanup
+    CONSTBUFFER_DecRef(handle);
+}
+
+/*Tests_SRS_CONSTBUFFER_02_041: [ If a memory budget was set by CONSTBUFFER_SetMemoryBudget then the CONSTBUFFER_Create* functions shall charge the memory budget with the bytes of the new CONSTBUFFER_HANDLE by calling memory_budget_charge with the timeout set by CONSTBUFFER_SetMemoryBudget. ]*/
+TEST_FUNCTION(after_CONSTBUFFER_SetMemoryBudget_CONSTBUFFER_CreateWithMoveMemory_charges_the_moved_memory)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    unsigned char* moved = (unsigned char*)my_gballoc_malloc(1000);
+    ASSERT_IS_NOT_NULL(moved);
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    handle = CONSTBUFFER_CreateWithMoveMemory(moved, 1000);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_memory_budget_charged > 1000);
+
+    ///cleanup
+    CONSTBUFFER_DecRef(handle);
+}
+
+/*Tests_SRS_CONSTBUFFER_02_042: [ If memory_budget_charge fails then the CONSTBUFFER_Create* functions shall fail and return NULL. ]*/
+TEST_FUNCTION(when_memory_budget_charge_fails_CONSTBUFFER_Create_fails)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, IGNORED_ARG, 0))
+        .SetReturn(MEMORY_BUDGET_EXHAUSTED);
+    STRICT_EXPECTED_CALL(memory_budget_get_name(TEST_MEMORY_BUDGET));
+
+    ///act
+    handle = CONSTBUFFER_Create(BUFFER1_u_char, BUFFER1_length);
+
+    ///assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_02_042: [ If memory_budget_charge fails then the CONSTBUFFER_Create* functions shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_CONSTBUFFER_Create_gives_back_the_charged_bytes)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET, IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET, IGNORED_ARG));
+
+    ///act
+    handle = CONSTBUFFER_Create(BUFFER1_u_char, BUFFER1_length);
+
+    ///assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_02_043: [ If the refcount reaches zero and the CONSTBUFFER_HANDLE was charged to a memory budget, CONSTBUFFER_DecRef shall give back the charged bytes by calling memory_budget_release. ]*/
+TEST_FUNCTION(CONSTBUFFER_DecRef_gives_back_the_charged_bytes)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 0);
+    handle = CONSTBUFFER_Create(BUFFER1_u_char, BUFFER1_length);
+    ASSERT_IS_NOT_NULL(handle);
+    CONSTBUFFER_IncRef(handle);
+    umock_c_reset_all_calls();
+
+    CONSTBUFFER_DecRef(handle); /*not the last reference, nothing is given back*/
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET, g_memory_budget_charged));
+    STRICT_EXPECTED_CALL(free(handle));
+
+    ///act
+    CONSTBUFFER_DecRef(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_02_045: [ If memory_budget is NULL then the CONSTBUFFER_HANDLEs created afterwards shall not be charged to any memory budget. ]*/
+TEST_FUNCTION(after_CONSTBUFFER_SetMemoryBudget_with_NULL_CONSTBUFFER_Create_does_not_charge)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 0);
+    CONSTBUFFER_SetMemoryBudget(NULL, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    handle = CONSTBUFFER_Create(BUFFER1_u_char, BUFFER1_length);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    CONSTBUFFER_DecRef(handle);
+}
+
+/* CONSTBUFFER_CreateWithMemoryBudget */
+
+/*Tests_SRS_CONSTBUFFER_02_046: [ If source is NULL and size is different than 0 then CONSTBUFFER_CreateWithMemoryBudget shall fail and return NULL. ]*/
+TEST_FUNCTION(CONSTBUFFER_CreateWithMemoryBudget_with_NULL_source_and_non_zero_size_fails)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+
+    ///act
+    handle = CONSTBUFFER_CreateWithMemoryBudget(NULL, 1, TEST_MEMORY_BUDGET, 0);
+
+    ///assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_02_047: [ If memory_budget is not NULL then CONSTBUFFER_CreateWithMemoryBudget shall charge memory_budget (and not the budget set by CONSTBUFFER_SetMemoryBudget) with the bytes of the new CONSTBUFFER_HANDLE by calling memory_budget_charge with timeout_ms. ]*/
+/*Tests_SRS_CONSTBUFFER_02_049: [ CONSTBUFFER_CreateWithMemoryBudget shall create a copy of the memory area pointed to by source having size bytes, with its ref count set to 1, and return a non-NULL handle. ]*/
+TEST_FUNCTION(CONSTBUFFER_CreateWithMemoryBudget_charges_memory_budget_and_not_the_one_set_by_CONSTBUFFER_SetMemoryBudget)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    const CONSTBUFFER* content;
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, IGNORED_ARG, 42));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    handle = CONSTBUFFER_CreateWithMemoryBudget(BUFFER1_u_char, BUFFER1_length, TEST_MEMORY_BUDGET_2, 42);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_memory_budget_charged > (int64_t)BUFFER1_length); /*the content and the handle*/
+    content = CONSTBUFFER_GetContent(handle);
+    ASSERT_ARE_EQUAL(size_t, BUFFER1_length, content->size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(BUFFER1_u_char, content->buffer, BUFFER1_length));
+
+    ///cleanup
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET_2, g_memory_budget_charged));
+    STRICT_EXPECTED_CALL(free(handle));
+    CONSTBUFFER_DecRef(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_02_048: [ If memory_budget is NULL then CONSTBUFFER_CreateWithMemoryBudget shall not charge any memory budget. ]*/
+TEST_FUNCTION(CONSTBUFFER_CreateWithMemoryBudget_with_NULL_memory_budget_does_not_charge)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+    CONSTBUFFER_SetMemoryBudget(TEST_MEMORY_BUDGET, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    handle = CONSTBUFFER_CreateWithMemoryBudget(BUFFER1_u_char, BUFFER1_length, NULL, 0);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    CONSTBUFFER_DecRef(handle);
+}
+
+/*Tests_SRS_CONSTBUFFER_02_042: [ If memory_budget_charge fails then the CONSTBUFFER_Create* functions shall fail and return NULL. ]*/
+/*Tests_SRS_CONSTBUFFER_02_050: [ If there are any failures then CONSTBUFFER_CreateWithMemoryBudget shall fail and return NULL. ]*/
+TEST_FUNCTION(when_memory_budget_charge_fails_CONSTBUFFER_CreateWithMemoryBudget_fails)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, IGNORED_ARG, 0))
+        .SetReturn(MEMORY_BUDGET_EXHAUSTED);
+    STRICT_EXPECTED_CALL(memory_budget_get_name(TEST_MEMORY_BUDGET_2));
+
+    ///act
+    handle = CONSTBUFFER_CreateWithMemoryBudget(BUFFER1_u_char, BUFFER1_length, TEST_MEMORY_BUDGET_2, 0);
+
+    ///assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_CONSTBUFFER_02_050: [ If there are any failures then CONSTBUFFER_CreateWithMemoryBudget shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_CONSTBUFFER_CreateWithMemoryBudget_gives_back_the_charged_bytes)
+{
+    ///arrange
+    CONSTBUFFER_HANDLE handle;
+
+    STRICT_EXPECTED_CALL(memory_budget_charge(TEST_MEMORY_BUDGET_2, IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(memory_budget_release(TEST_MEMORY_BUDGET_2, IGNORED_ARG));
+
+    ///act
+    handle = CONSTBUFFER_CreateWithMemoryBudget(BUFFER1_u_char, BUFFER1_length, TEST_MEMORY_BUDGET_2, 0);
+
+    ///assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 END_TEST_SUITE(constbuffer_unittests)
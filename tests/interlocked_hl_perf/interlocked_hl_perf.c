@@ -0,0 +1,143 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#else
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#include "testrunnerswitcher.h"
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_pal/threadapi.h"
+#include "azure_c_pal/timer.h"
+
+#include "azure_c_util/interlocked_hl.h"
+
+/*interlocked_hl_perf measures the latency of InterlockedHL_WaitForValue when the value is set by another thread shortly after the wait starts,
+with and without the spin phase. It does not assert on the numbers (the machines running the tests are too different),
+it prints one CSV line per measurement on stdout so that the results of different builds can be compared by scripts:
+scenario,max_spin_count,work_us,round_trips,elapsed_ms,avg_round_trip_us*/
+
+TEST_DEFINE_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+#define INTERLOCKED_HL_PERF_ROUND_TRIPS 2000 /*how many round trips are measured for every combination of spin count and work*/
+
+#define TURN_VALUES \
+    TURN_MAIN, \
+    TURN_WORKER, \
+    TURN_STOP
+
+MU_DEFINE_ENUM(TURN, TURN_VALUES)
+
+typedef struct PING_PONG_TAG
+{
+    volatile_atomic int32_t turn;
+    double work_us; /*how long the worker thread works before giving the turn back*/
+}PING_PONG;
+
+static void busy_work(double work_us)
+{
+    double start = timer_global_get_elapsed_ms();
+    while ((timer_global_get_elapsed_ms() - start) * 1000 < work_us)
+    {
+        /*spin*/
+    }
+}
+
+/*waits for its turn, works for work_us and then gives the turn back to the main thread*/
+static int worker_thread(void* arg)
+{
+    PING_PONG* ping_pong = (PING_PONG*)arg;
+
+    while (1)
+    {
+        ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_WaitForNotValue(&ping_pong->turn, TURN_MAIN, UINT32_MAX));
+        if (interlocked_add(&ping_pong->turn, 0) == TURN_STOP)
+        {
+            break;
+        }
+
+        busy_work(ping_pong->work_us);
+
+        ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetAndWake(&ping_pong->turn, TURN_MAIN));
+    }
+
+    return 0;
+}
+
+static void print_csv_line(const char* scenario, uint32_t max_spin_count, double work_us, int64_t round_trips, double elapsed_ms)
+{
+    (void)printf("%s,%" PRIu32 ",%.1f,%" PRId64 ",%.3f,%.3f\n",
+        scenario, max_spin_count, work_us, round_trips, elapsed_ms, (round_trips > 0) ? elapsed_ms * 1000 / round_trips : 0);
+    (void)fflush(stdout);
+}
+
+BEGIN_TEST_SUITE(interlocked_hl_perf)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    ASSERT_ARE_EQUAL(int, 0, gballoc_hl_init(NULL, NULL));
+
+    (void)printf("scenario,max_spin_count,work_us,round_trips,elapsed_ms,avg_round_trip_us\n");
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetWaitSpinCount(INTERLOCKED_HL_DEFAULT_WAIT_SPIN_COUNT));
+
+    gballoc_hl_deinit();
+}
+
+/*the main thread gives the turn to the worker thread and waits for it to come back, INTERLOCKED_HL_PERF_ROUND_TRIPS times.
+Short works are the case the spin phase is for, long works show the cost of spinning when the wait is long*/
+TEST_FUNCTION(interlocked_hl_perf_wait_for_value_round_trip)
+{
+    uint32_t max_spin_counts[] = { 0, INTERLOCKED_HL_DEFAULT_WAIT_SPIN_COUNT, 10 * INTERLOCKED_HL_DEFAULT_WAIT_SPIN_COUNT };
+    double works_us[] = { 0, 1, 10, 100, 1000 };
+
+    for (uint32_t i = 0; i < sizeof(max_spin_counts) / sizeof(max_spin_counts[0]); i++)
+    {
+        for (uint32_t j = 0; j < sizeof(works_us) / sizeof(works_us[0]); j++)
+        {
+            ///arrange
+            PING_PONG ping_pong;
+            THREAD_HANDLE worker;
+            int dont_care;
+            (void)interlocked_exchange(&ping_pong.turn, TURN_MAIN);
+            ping_pong.work_us = works_us[j];
+            ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetWaitSpinCount(max_spin_counts[i]));
+            ASSERT_ARE_EQUAL(THREADAPI_RESULT, THREADAPI_OK, ThreadAPI_Create(&worker, worker_thread, &ping_pong));
+
+            ///act
+            double start = timer_global_get_elapsed_ms();
+            for (int64_t round_trip = 0; round_trip < INTERLOCKED_HL_PERF_ROUND_TRIPS; round_trip++)
+            {
+                ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetAndWake(&ping_pong.turn, TURN_WORKER));
+                ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_WaitForValue(&ping_pong.turn, TURN_MAIN, UINT32_MAX));
+            }
+            double elapsed_ms = timer_global_get_elapsed_ms() - start;
+
+            ///assert
+            print_csv_line("wait_for_value_round_trip", max_spin_counts[i], works_us[j], INTERLOCKED_HL_PERF_ROUND_TRIPS, elapsed_ms);
+
+            ///clean
+            ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetAndWake(&ping_pong.turn, TURN_STOP));
+            ASSERT_ARE_EQUAL(THREADAPI_RESULT, THREADAPI_OK, ThreadAPI_Join(worker, &dont_care));
+        }
+    }
+}
+
+END_TEST_SUITE(interlocked_hl_perf)
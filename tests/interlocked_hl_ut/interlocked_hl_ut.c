@@ -34,6 +34,7 @@ static TEST_MUTEX_HANDLE g_testByTest;
 #define ENABLE_MOCKS
 #include "azure_c_pal/interlocked.h"
 #include "azure_c_pal/sync.h"
+#include "azure_c_util/processor_index.h"
 #undef ENABLE_MOCKS
 
 #include "real_interlocked.h"
@@ -51,6 +52,9 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 
 MOCK_FUNCTION_WITH_CODE(, bool, TEST_IS_GREATER, int64_t, original_target, int64_t, exchange)
 MOCK_FUNCTION_END(original_target<exchange)
+
+MOCK_FUNCTION_WITH_CODE(, bool, TEST_IS_0x42, int32_t, current_value, void*, context)
+MOCK_FUNCTION_END(current_value == 0x42)
 #undef ENABLE_MOCKS
 
 typedef  struct ADDEND_AND_VALUE_TAG
@@ -74,6 +78,86 @@ static bool hook_wait_on_address(volatile_atomic int32_t* address, int32_t compa
     return true;
 }
 
+/*changes the value at g_address_changed_after_first_read right after the first interlocked_add on it, like another thread would do while InterlockedHL_WaitForValue/InterlockedHL_WaitForNotValue spins*/
+static int32_t volatile_atomic* g_address_changed_after_first_read;
+static int32_t g_value_after_first_read;
+
+static int32_t hook_interlocked_add_changes_value_after_first_read(int32_t volatile_atomic* addend, int32_t value)
+{
+    int32_t result = real_interlocked_add(addend, value);
+    if (addend == g_address_changed_after_first_read)
+    {
+        (void)real_interlocked_exchange(addend, g_value_after_first_read);
+        g_address_changed_after_first_read = NULL;
+    }
+    return result;
+}
+
+/*changes the 64 bit value at g_address_64_changed_after_first_read right after the first interlocked_add_64 on it, like another thread would do while InterlockedHL_WaitForValue64/InterlockedHL_WaitForNotValue64 spins*/
+static int64_t volatile_atomic* g_address_64_changed_after_first_read;
+static int64_t g_value_64_after_first_read;
+
+static int64_t hook_interlocked_add_64_changes_value_after_first_read(int64_t volatile_atomic* addend, int64_t value)
+{
+    int64_t result = real_interlocked_add_64(addend, value);
+    if (addend == g_address_64_changed_after_first_read)
+    {
+        (void)real_interlocked_exchange_64(addend, g_value_64_after_first_read);
+        g_address_64_changed_after_first_read = NULL;
+    }
+    return result;
+}
+
+/*sets the 64 bit value at g_value64_address to g_value64_set_by_wait (and increments g_value64_set_by_wait for the next wait), like a thread calling InterlockedHL_SetAndWakeAll64 would do while InterlockedHL_WaitForValue64 waits*/
+static int64_t volatile_atomic* g_value64_address;
+static int64_t g_value64_set_by_wait;
+
+static bool hook_wait_on_address_sets_value64(volatile_atomic int32_t* address, int32_t compare_value, uint32_t milliseconds)
+{
+    (void)address;
+    (void)compare_value;
+    (void)milliseconds;
+    (void)real_interlocked_exchange_64(g_value64_address, g_value64_set_by_wait);
+    g_value64_set_by_wait++;
+    return true;
+}
+
+/*calls g_update_value64_while_waiting on g_value64_address from inside wait_on_address (so while the waiter is counted in its wait cell) and records whether the update changed the value waited on by wait_on_address, which makes a real wait_on_address return*/
+static void(*g_update_value64_while_waiting)(int64_t volatile_atomic* address);
+static bool g_wait_value_changed_by_update;
+
+static bool hook_wait_on_address_updates_value64(volatile_atomic int32_t* address, int32_t compare_value, uint32_t milliseconds)
+{
+    (void)milliseconds;
+    g_update_value64_while_waiting(g_value64_address);
+    g_wait_value_changed_by_update = (real_interlocked_add(address, 0) != compare_value);
+    return true;
+}
+
+static void add_1_with_InterlockedHL_Add64WithCeiling(int64_t volatile_atomic* address)
+{
+    int64_t original_value;
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_Add64WithCeiling(address, INT64_MAX, 1, &original_value));
+}
+
+static void add_1_with_InterlockedHL_CompareExchange64If(int64_t volatile_atomic* address)
+{
+    int64_t original_value;
+    int64_t value = real_interlocked_add_64(address, 0);
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_CompareExchange64If(address, value + 1, TEST_IS_GREATER, &original_value));
+}
+
+static void add_1_with_InterlockedHL_SetAndWakeAll64(int64_t volatile_atomic* address)
+{
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetAndWakeAll64(address, real_interlocked_add_64(address, 0) + 1));
+}
+
+static void add_1_with_interlocked_add_64_and_InterlockedHL_WakeAll64(int64_t volatile_atomic* address)
+{
+    (void)real_interlocked_add_64(address, 1);
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_WakeAll64(address));
+}
+
 TEST_DEFINE_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
 
@@ -95,6 +179,7 @@ TEST_SUITE_INITIALIZE(a)
     REGISTER_SYNC_GLOBAL_MOCK_HOOK();
 
     REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address);
+    REGISTER_GLOBAL_MOCK_RETURN(processor_index_get_current, 0);
 }
 
 TEST_SUITE_CLEANUP(b)
@@ -111,6 +196,13 @@ TEST_FUNCTION_INITIALIZE(c)
         ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
     }
 
+    REGISTER_GLOBAL_MOCK_HOOK(interlocked_add, real_interlocked_add);
+    REGISTER_GLOBAL_MOCK_HOOK(interlocked_add_64, real_interlocked_add_64);
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address);
+    g_address_changed_after_first_read = NULL;
+    g_address_64_changed_after_first_read = NULL;
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetWaitSpinCount(INTERLOCKED_HL_DEFAULT_WAIT_SPIN_COUNT));
+
     umock_c_reset_all_calls();
 }
 
@@ -307,6 +399,34 @@ TEST_FUNCTION(InterlockedHL_Add64WithCeiling_succeeds)
     my_gballoc_free(cloneOfInputValues);
 }
 
+/*Tests_SRS_INTERLOCKED_HL_02_150: [ If Addend changed meanwhile then InterlockedHL_Add64WithCeiling shall call InterlockedHL_Backoff and try again. ]*/
+TEST_FUNCTION(InterlockedHL_Add64WithCeiling_backs_off_and_retries_when_Addend_changed_meanwhile)
+{
+    ///arrange
+    int64_t originalAddend;
+    volatile_atomic int64_t Addend;
+    (void)interlocked_exchange_64(&Addend, 5);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&Addend, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange_64(&Addend, 7, 5))
+        .SetReturn(6);
+    STRICT_EXPECTED_CALL(processor_index_get_current()); /*InterlockedHL_Backoff*/
+    STRICT_EXPECTED_CALL(interlocked_increment_64(IGNORED_ARG)); /*InterlockedHL_Backoff*/
+    STRICT_EXPECTED_CALL(interlocked_add_64(IGNORED_ARG, IGNORED_ARG)); /*InterlockedHL_Backoff*/
+    STRICT_EXPECTED_CALL(interlocked_add_64(&Addend, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange_64(&Addend, 7, 5));
+
+    ///act
+    INTERLOCKED_HL_RESULT result = InterlockedHL_Add64WithCeiling(&Addend, 10, 2, &originalAddend);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int64_t, 5, originalAddend);
+    ASSERT_ARE_EQUAL(int64_t, 7, Addend);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /* InterlockedHL_WaitForValue */
 
 /* Tests_SRS_INTERLOCKED_HL_01_002: [ If address is NULL, InterlockedHL_WaitForValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
@@ -412,6 +532,53 @@ TEST_FUNCTION(when_the_wait_on_address_fails_InterlockedHL_WaitForValue_also_fai
     ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
 }
 
+/* Tests_SRS_INTERLOCKED_HL_02_032: [ If the value at address is not equal to value, InterlockedHL_WaitForValue shall first spin (executing a pause instruction between reads) for at most the current spin budget waiting for the value at address to be equal to value. ]*/
+/* Tests_SRS_INTERLOCKED_HL_02_033: [ If the value at address becomes equal to value while spinning then InterlockedHL_WaitForValue shall return INTERLOCKED_HL_OK without calling wait_on_address. ]*/
+TEST_FUNCTION(when_the_value_equals_target_value_while_spinning_InterlockedHL_WaitForValue_returns_OK_without_waiting)
+{
+    // arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x41;
+
+    g_address_changed_after_first_read = &value;
+    g_value_after_first_read = 0x42;
+    REGISTER_GLOBAL_MOCK_HOOK(interlocked_add, hook_interlocked_add_changes_value_after_first_read);
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+
+    // act
+    result = InterlockedHL_WaitForValue(&value, 0x42, UINT32_MAX);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/* Tests_SRS_INTERLOCKED_HL_02_032: [ If the value at address is not equal to value, InterlockedHL_WaitForValue shall first spin (executing a pause instruction between reads) for at most the current spin budget waiting for the value at address to be equal to value. ]*/
+TEST_FUNCTION(when_spinning_is_disabled_InterlockedHL_WaitForValue_calls_wait_on_address_right_away)
+{
+    // arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x41;
+    int32_t target_value = 0x42;
+
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetWaitSpinCount(0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 0x41, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&target_value, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+
+    // act
+    result = InterlockedHL_WaitForValue(&value, 0x42, UINT32_MAX);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
 /* InterlockedHL_WaitForNotValue */
 
 /* Tests_SRS_INTERLOCKED_HL_42_001: [ If address is NULL, InterlockedHL_WaitForNotValue shall fail and return INTERLOCKED_HL_ERROR. ]*/
@@ -515,211 +682,2450 @@ TEST_FUNCTION(when_the_wait_on_address_fails_InterlockedHL_WaitForNotValue_also_
     ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
 }
 
+/* Tests_SRS_INTERLOCKED_HL_02_034: [ If the value at address is equal to value, InterlockedHL_WaitForNotValue shall first spin (executing a pause instruction between reads) for at most the current spin budget waiting for the value at address to be different than value. ]*/
+/* Tests_SRS_INTERLOCKED_HL_02_035: [ If the value at address becomes different than value while spinning then InterlockedHL_WaitForNotValue shall return INTERLOCKED_HL_OK without calling wait_on_address. ]*/
+TEST_FUNCTION(when_the_value_changes_while_spinning_InterlockedHL_WaitForNotValue_returns_OK_without_waiting)
+{
+    // arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x42;
 
-/*Tests_SRS_INTERLOCKED_HL_02_008: [ If target is NULL then InterlockedHL_CompareExchange64If shall return fail and return INTERLOCKED_HL_ERROR. ]*/
-TEST_FUNCTION(interlocked_compare_exchange_64If_with_target_NULL_fails)
+    g_address_changed_after_first_read = &value;
+    g_value_after_first_read = 0x43;
+    REGISTER_GLOBAL_MOCK_HOOK(interlocked_add, hook_interlocked_add_changes_value_after_first_read);
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+
+    // act
+    result = InterlockedHL_WaitForNotValue(&value, 0x42, UINT32_MAX);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/* InterlockedHL_WaitForMask */
+
+/*Tests_SRS_INTERLOCKED_HL_02_057: [ If address is NULL then InterlockedHL_WaitForMask shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForMask_with_address_NULL_fails)
 {
     ///arrange
-    int64_t original_target;
+    INTERLOCKED_HL_RESULT result;
 
     ///act
-    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(NULL, 1, TEST_IS_GREATER, &original_target);
+    result = InterlockedHL_WaitForMask(NULL, 0x0F, 0x01, UINT32_MAX);
 
     ///assert
-    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///clean
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_009: [ If compare is NULL then InterlockedHL_CompareExchange64If shall return fail and return INTERLOCKED_HL_ERROR. ]*/
-TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_NULL_fails)
+/*Tests_SRS_INTERLOCKED_HL_02_058: [ If expected has bits set outside of mask then InterlockedHL_WaitForMask shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForMask_with_expected_outside_of_mask_fails)
 {
     ///arrange
-    int64_t original_target;
-    volatile_atomic int64_t target;
-    (void)interlocked_exchange_64(&target, 34);
-    umock_c_reset_all_calls();
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x10;
 
     ///act
-    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 1, NULL, &original_target);
+    result = InterlockedHL_WaitForMask(&value, 0x0F, 0x10, UINT32_MAX);
 
     ///assert
-    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///clean
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_010: [ If original_target is NULL then InterlockedHL_CompareExchange64If shall return fail and return INTERLOCKED_HL_ERROR. ]*/
-TEST_FUNCTION(interlocked_compare_exchange_64If_with_original_target_NULL_fails)
+/*Tests_SRS_INTERLOCKED_HL_02_059: [ If the value at address bitwise and mask is equal to expected then InterlockedHL_WaitForMask shall return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(when_the_masked_value_equals_expected_InterlockedHL_WaitForMask_returns_OK)
 {
     ///arrange
-    volatile_atomic int64_t target;
-    (void)interlocked_exchange_64(&target, 34);
-    umock_c_reset_all_calls();
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x81; /*bit 7 set, the other bits are ignored*/
 
-    ///act
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
 
-    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 1, TEST_IS_GREATER, NULL);
+    ///act
+    result = InterlockedHL_WaitForMask(&value, 0x80, 0x80, UINT32_MAX);
 
     ///assert
-    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///clean
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_011: [ InterlockedHL_CompareExchange64If shall acquire the initial value of target. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_012: [ If compare(target, exchange) returns true then InterlockedHL_CompareExchange64If shall exchange target with exchange. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_014: [ If target did not change meanwhile then InterlockedHL_CompareExchange64If shall return return INTERLOCKED_HL_OK and shall peform the exchange of values. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_016: [ original_target shall be set to the original value of target. ]*/
-TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_true_changed_false_succeeds)
+/*Tests_SRS_INTERLOCKED_HL_02_060: [ Otherwise InterlockedHL_WaitForMask shall spin and then wait with wait_on_address (with milliseconds as timeout) until the value at address bitwise and mask is equal to expected. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForMask_waits_again_when_only_other_bits_change)
 {
     ///arrange
-    int64_t original_target;
-    volatile_atomic int64_t target;
-    (void)interlocked_exchange_64(&target, 34);
-    umock_c_reset_all_calls();
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x81;
+    int32_t other_bits_changed = 0x83;
+    int32_t bit_7_cleared = 0x03;
 
-    STRICT_EXPECTED_CALL(interlocked_add_64(&target, 0));
-    STRICT_EXPECTED_CALL(TEST_IS_GREATER(34, 99));
-    STRICT_EXPECTED_CALL(interlocked_compare_exchange_64(&target, 99, 34));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 0x81, 1234))
+        .CopyOutArgumentBuffer_address(&other_bits_changed, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 0x83, 1234))
+        .CopyOutArgumentBuffer_address(&bit_7_cleared, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
 
     ///act
-
-    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 99, TEST_IS_GREATER, &original_target);
+    result = InterlockedHL_WaitForMask(&value, 0x80, 0, 1234);
 
     ///assert
-    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
-    ASSERT_ARE_EQUAL(int64_t, 34, original_target);
-    ASSERT_ARE_EQUAL(int64_t, 99, target);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///clean
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_011: [ InterlockedHL_CompareExchange64If shall acquire the initial value of target. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_015: [ If compare returns false then InterlockedHL_CompareExchange64If shall not perform any exchanges and return INTERLOCKED_HL_OK. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_013: [ If target changed meanwhile then InterlockedHL_CompareExchange64If shall return return INTERLOCKED_HL_CHANGED and shall not peform any exchange of values. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_016: [ original_target shall be set to the original value of target. ]*/
-TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_true_changed_true_succeeds)
+/*Tests_SRS_INTERLOCKED_HL_02_060: [ Otherwise InterlockedHL_WaitForMask shall spin and then wait with wait_on_address (with milliseconds as timeout) until the value at address bitwise and mask is equal to expected. ]*/
+TEST_FUNCTION(when_the_masked_value_equals_expected_while_spinning_InterlockedHL_WaitForMask_returns_OK_without_waiting)
 {
     ///arrange
-    int64_t original_target;
-    volatile_atomic int64_t target;
-    (void)interlocked_exchange_64(&target, 34);
-    umock_c_reset_all_calls();
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x01;
 
-    STRICT_EXPECTED_CALL(interlocked_add_64(&target, 0));
-    STRICT_EXPECTED_CALL(TEST_IS_GREATER(34, 99));
-    STRICT_EXPECTED_CALL(interlocked_compare_exchange_64(&target, 99, 34))
-        .SetReturn(35);
+    g_address_changed_after_first_read = &value;
+    g_value_after_first_read = 0x81;
+    REGISTER_GLOBAL_MOCK_HOOK(interlocked_add, hook_interlocked_add_changes_value_after_first_read);
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
 
     ///act
-    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 99, TEST_IS_GREATER, &original_target);
+    result = InterlockedHL_WaitForMask(&value, 0x80, 0x80, UINT32_MAX);
 
     ///assert
-    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_CHANGED, result);
-    ASSERT_ARE_EQUAL(int64_t, 34, original_target);
-    ASSERT_ARE_EQUAL(int64_t, 34, target);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///clean
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_011: [ InterlockedHL_CompareExchange64If shall acquire the initial value of target. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_012: [ If compare(target, exchange) returns true then InterlockedHL_CompareExchange64If shall exchange target with exchange. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_013: [ If target changed meanwhile then InterlockedHL_CompareExchange64If shall return return INTERLOCKED_HL_CHANGED and shall not peform any exchange of values. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_016: [ original_target shall be set to the original value of target. ]*/
-TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_false_succeeds)
+/*Tests_SRS_INTERLOCKED_HL_02_061: [ If wait_on_address fails then InterlockedHL_WaitForMask shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_WaitForMask_fails)
 {
     ///arrange
-    int64_t original_target;
-    volatile_atomic int64_t target;
-    (void)interlocked_exchange_64(&target, 34);
-    umock_c_reset_all_calls();
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x01;
 
-    STRICT_EXPECTED_CALL(interlocked_add_64(&target, 0));
-    STRICT_EXPECTED_CALL(TEST_IS_GREATER(34, 33)); /*33 is smaller, no exchanges happen*/
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 0x01, UINT32_MAX))
+        .SetReturn(false);
 
     ///act
-
-    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 33, TEST_IS_GREATER, &original_target);
+    result = InterlockedHL_WaitForMask(&value, 0x80, 0x80, UINT32_MAX);
 
     ///assert
-    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
-    ASSERT_ARE_EQUAL(int64_t, 34, original_target);
-    ASSERT_ARE_EQUAL(int64_t, 34, target);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///clean
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_020: [ If address is NULL then InterlockedHL_SetAndWake shall fail and return INTERLOCKED_HL_ERROR. ]*/
-TEST_FUNCTION(InterlockedHL_SetAndWake_with_address_NULL_fails)
+/* InterlockedHL_WaitForLessThan */
+
+/*Tests_SRS_INTERLOCKED_HL_02_062: [ If address is NULL then InterlockedHL_WaitForLessThan shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForLessThan_with_address_NULL_fails)
 {
     ///arrange
     INTERLOCKED_HL_RESULT result;
 
     ///act
-    result = InterlockedHL_SetAndWake(NULL, 3);
+    result = InterlockedHL_WaitForLessThan(NULL, 10, UINT32_MAX);
 
     ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_017: [ InterlockedHL_SetAndWake shall set address to value. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_018: [ InterlockedHL_SetAndWake shall call wake_by_address_single. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_019: [ InterlockedHL_SetAndWake shall succeed and return INTERLOCKED_HL_OK. ]*/
-TEST_FUNCTION(InterlockedHL_SetAndWake_succeeds)
+/*Tests_SRS_INTERLOCKED_HL_02_063: [ If the value at address is less than value then InterlockedHL_WaitForLessThan shall return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(when_the_value_is_less_than_value_InterlockedHL_WaitForLessThan_returns_OK)
 {
     ///arrange
-    volatile_atomic int32_t hereLiesAThree = 3;
-    int32_t thatIsGoingToTurn4 = 4;
     INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 9;
 
-    STRICT_EXPECTED_CALL(interlocked_exchange(&hereLiesAThree, thatIsGoingToTurn4));
-    STRICT_EXPECTED_CALL(wake_by_address_single(&hereLiesAThree));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
 
     ///act
-    result = InterlockedHL_SetAndWake(&hereLiesAThree, thatIsGoingToTurn4);
+    result = InterlockedHL_WaitForLessThan(&value, 10, UINT32_MAX);
 
     ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_028: [ If address is NULL then InterlockedHL_SetAndWakeAll shall fail and return INTERLOCKED_HL_ERROR. ]*/
-TEST_FUNCTION(InterlockedHL_SetAndWakeAll_with_address_NULL_fails)
+/*Tests_SRS_INTERLOCKED_HL_02_064: [ Otherwise InterlockedHL_WaitForLessThan shall spin and then wait with wait_on_address (with milliseconds as timeout) until the value at address is less than value. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForLessThan_waits_until_the_value_is_less_than_value)
 {
     ///arrange
     INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 12;
+    int32_t still_equal = 10;
+    int32_t less = 9;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 12, 1234))
+        .CopyOutArgumentBuffer_address(&still_equal, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 10, 1234))
+        .CopyOutArgumentBuffer_address(&less, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
 
     ///act
-    result = InterlockedHL_SetAndWakeAll(NULL, 3);
+    result = InterlockedHL_WaitForLessThan(&value, 10, 1234);
 
     ///assert
-    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
 }
 
-/*Tests_SRS_INTERLOCKED_HL_02_029: [ InterlockedHL_SetAndWakeAll shall set address to value. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_030: [ InterlockedHL_SetAndWakeAll shall call wake_by_address_all. ]*/
-/*Tests_SRS_INTERLOCKED_HL_02_031: [ InterlockedHL_SetAndWakeAll shall succeed and return INTERLOCKED_HL_OK. ]*/
-TEST_FUNCTION(InterlockedHL_SetAndWakeAll_succeeds)
+/*Tests_SRS_INTERLOCKED_HL_02_065: [ If wait_on_address fails then InterlockedHL_WaitForLessThan shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_WaitForLessThan_fails)
 {
     ///arrange
-    volatile_atomic int32_t hereLiesAThree = 3;
-    int32_t thatIsGoingToTurn4 = 4;
     INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 10;
 
-    STRICT_EXPECTED_CALL(interlocked_exchange(&hereLiesAThree, thatIsGoingToTurn4));
-    STRICT_EXPECTED_CALL(wake_by_address_all(&hereLiesAThree));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 10, UINT32_MAX))
+        .SetReturn(false);
 
     ///act
-    result = InterlockedHL_SetAndWakeAll(&hereLiesAThree, thatIsGoingToTurn4);
+    result = InterlockedHL_WaitForLessThan(&value, 10, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_WaitForPredicate */
+
+/*Tests_SRS_INTERLOCKED_HL_02_066: [ If address is NULL then InterlockedHL_WaitForPredicate shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForPredicate_with_address_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_WaitForPredicate(NULL, TEST_IS_0x42, (void*)0x33, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_067: [ If predicate is NULL then InterlockedHL_WaitForPredicate shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForPredicate_with_predicate_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x42;
+
+    ///act
+    result = InterlockedHL_WaitForPredicate(&value, NULL, (void*)0x33, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_068: [ If predicate(value at address, context) returns true then InterlockedHL_WaitForPredicate shall return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(when_the_predicate_returns_true_InterlockedHL_WaitForPredicate_returns_OK)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x42;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_0x42(0x42, (void*)0x33));
+
+    ///act
+    result = InterlockedHL_WaitForPredicate(&value, TEST_IS_0x42, (void*)0x33, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_069: [ Otherwise InterlockedHL_WaitForPredicate shall spin and then wait with wait_on_address (with milliseconds as timeout) until predicate returns true. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForPredicate_waits_until_the_predicate_returns_true)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x40;
+    int32_t intermediate_value = 0x41;
+    int32_t final_value = 0x42;
+
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetWaitSpinCount(0)); /*the predicate is a mock, spinning would call it many times*/
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_0x42(0x40, (void*)0x33));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 0x40, 1234))
+        .CopyOutArgumentBuffer_address(&intermediate_value, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_0x42(0x41, (void*)0x33));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 0x41, 1234))
+        .CopyOutArgumentBuffer_address(&final_value, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_0x42(0x42, (void*)0x33));
+
+    ///act
+    result = InterlockedHL_WaitForPredicate(&value, TEST_IS_0x42, (void*)0x33, 1234);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_070: [ If wait_on_address fails then InterlockedHL_WaitForPredicate shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_WaitForPredicate_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t value = 0x40;
+
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_SetWaitSpinCount(0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add(&value, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_0x42(0x40, (void*)0x33));
+    STRICT_EXPECTED_CALL(wait_on_address(&value, 0x40, UINT32_MAX))
+        .SetReturn(false);
+
+    ///act
+    result = InterlockedHL_WaitForPredicate(&value, TEST_IS_0x42, (void*)0x33, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_LatchCountDown */
+
+/*Tests_SRS_INTERLOCKED_HL_02_071: [ If latch is NULL then InterlockedHL_LatchCountDown shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_LatchCountDown_with_latch_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_LatchCountDown(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_072: [ InterlockedHL_LatchCountDown shall decrement the value at latch by calling interlocked_decrement. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_075: [ InterlockedHL_LatchCountDown shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_LatchCountDown_above_0_does_not_wake)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t latch = 2;
+
+    STRICT_EXPECTED_CALL(interlocked_decrement(&latch));
+
+    ///act
+    result = InterlockedHL_LatchCountDown(&latch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 1, latch);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_074: [ If the decremented value is 0 then InterlockedHL_LatchCountDown shall call wake_by_address_all on latch. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_075: [ InterlockedHL_LatchCountDown shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_LatchCountDown_to_0_wakes_all)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t latch = 1;
+
+    STRICT_EXPECTED_CALL(interlocked_decrement(&latch));
+    STRICT_EXPECTED_CALL(wake_by_address_all(&latch));
+
+    ///act
+    result = InterlockedHL_LatchCountDown(&latch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, latch);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_073: [ If the decremented value is less than 0 then InterlockedHL_LatchCountDown shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_LatchCountDown_below_0_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t latch = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_decrement(&latch));
+
+    ///act
+    result = InterlockedHL_LatchCountDown(&latch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_LatchWait */
+
+/*Tests_SRS_INTERLOCKED_HL_02_076: [ If latch is NULL then InterlockedHL_LatchWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_LatchWait_with_latch_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_LatchWait(NULL, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_077: [ If the value at latch is less than or equal to 0 then InterlockedHL_LatchWait shall return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(when_the_latch_is_0_InterlockedHL_LatchWait_returns_OK)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t latch = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&latch, 0));
+
+    ///act
+    result = InterlockedHL_LatchWait(&latch, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_078: [ Otherwise InterlockedHL_LatchWait shall spin and then wait with wait_on_address (with milliseconds as timeout) until the value at latch is less than or equal to 0. ]*/
+TEST_FUNCTION(InterlockedHL_LatchWait_waits_until_the_latch_is_0)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t latch = 2;
+    int32_t one = 1;
+    int32_t zero = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&latch, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&latch, 2, 1234))
+        .CopyOutArgumentBuffer_address(&one, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&latch, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&latch, 1, 1234))
+        .CopyOutArgumentBuffer_address(&zero, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&latch, 0));
+
+    ///act
+    result = InterlockedHL_LatchWait(&latch, 1234);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_079: [ If wait_on_address fails then InterlockedHL_LatchWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_LatchWait_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t latch = 1;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&latch, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&latch, 1, UINT32_MAX))
+        .SetReturn(false);
+
+    ///act
+    result = InterlockedHL_LatchWait(&latch, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_BarrierArriveAndWait */
+
+/*Tests_SRS_INTERLOCKED_HL_02_080: [ If barrier is NULL then InterlockedHL_BarrierArriveAndWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_BarrierArriveAndWait_with_barrier_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(NULL, 3, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_081: [ If parties is less than 1 or greater than INTERLOCKED_HL_BARRIER_MAX_PARTIES then InterlockedHL_BarrierArriveAndWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_BarrierArriveAndWait_with_parties_0_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0;
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, 0, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_081: [ If parties is less than 1 or greater than INTERLOCKED_HL_BARRIER_MAX_PARTIES then InterlockedHL_BarrierArriveAndWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_BarrierArriveAndWait_with_too_many_parties_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0;
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, INTERLOCKED_HL_BARRIER_MAX_PARTIES + 1, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_082: [ InterlockedHL_BarrierArriveAndWait shall arrive at the barrier by adding 1 to the value at barrier with interlocked_add. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_084: [ If the caller is the last party to arrive then InterlockedHL_BarrierArriveAndWait shall reset the number of arrived parties to 0 and increment the generation with one interlocked_add, call wake_by_address_all on barrier, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_BarrierArriveAndWait_last_party_starts_the_next_generation)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0x00020002; /*generation 2, 2 parties arrived*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 1));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0x10000 - 3));
+    STRICT_EXPECTED_CALL(wake_by_address_all(&barrier));
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, 3, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x00030000, barrier);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_082: [ InterlockedHL_BarrierArriveAndWait shall arrive at the barrier by adding 1 to the value at barrier with interlocked_add. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_084: [ If the caller is the last party to arrive then InterlockedHL_BarrierArriveAndWait shall reset the number of arrived parties to 0 and increment the generation with one interlocked_add, call wake_by_address_all on barrier, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_BarrierArriveAndWait_with_1_party_does_not_wait)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 1));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0x10000 - 1));
+    STRICT_EXPECTED_CALL(wake_by_address_all(&barrier));
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, 1, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x00010000, barrier);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_083: [ If more than parties parties arrived in the current generation then InterlockedHL_BarrierArriveAndWait shall undo its arrival by adding -1 to the value at barrier with interlocked_add, fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_BarrierArriveAndWait_with_too_many_arrivals_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0x00020003; /*3 parties arrived, the barrier is used with different parties*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 1));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, -1));
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, 3, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x00020003, barrier);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_083: [ If more than parties parties arrived in the current generation then InterlockedHL_BarrierArriveAndWait shall undo its arrival by adding -1 to the value at barrier with interlocked_add, fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(after_too_many_arrivals_the_next_generation_of_InterlockedHL_BarrierArriveAndWait_still_waits_for_all_the_parties)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0x00020002; /*generation 2, the last of 2 parties arrived and did not start the next generation yet*/
+    int32_t next_generation = 0x00040000; /*the other party arrived and started generation 4*/
+
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, InterlockedHL_BarrierArriveAndWait(&barrier, 2, UINT32_MAX)); /*one party too many*/
+    (void)real_interlocked_add(&barrier, 0x10000 - 2); /*the last party starts generation 3*/
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 1));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&barrier, 0x00030001, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&next_generation, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0));
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, 2, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls()); /*the first party of generation 3 waits, it is not the last one*/
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_085: [ Otherwise InterlockedHL_BarrierArriveAndWait shall spin and then wait with wait_on_address (with milliseconds as timeout) until the generation of the barrier changes and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_BarrierArriveAndWait_waits_until_the_generation_changes)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0x00020001;
+    int32_t one_more_arrived = 0x00020003; /*the barrier is used with 4 parties, another party arrived*/
+    int32_t next_generation = 0x00030001; /*last party arrived and another party already arrived in the next generation*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 1));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&barrier, 0x00020002, 1234))
+        .CopyOutArgumentBuffer_address(&one_more_arrived, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&barrier, 0x00020003, 1234))
+        .CopyOutArgumentBuffer_address(&next_generation, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0));
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, 4, 1234);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_086: [ If wait_on_address fails then InterlockedHL_BarrierArriveAndWait shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_BarrierArriveAndWait_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t barrier = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 1));
+    STRICT_EXPECTED_CALL(interlocked_add(&barrier, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&barrier, 1, UINT32_MAX))
+        .SetReturn(false);
+
+    ///act
+    result = InterlockedHL_BarrierArriveAndWait(&barrier, 2, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_MutexLock */
+
+/*Tests_SRS_INTERLOCKED_HL_02_087: [ If mutex is NULL then InterlockedHL_MutexLock shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_MutexLock_with_mutex_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_MutexLock(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_088: [ InterlockedHL_MutexLock shall try to own the mutex by calling interlocked_compare_exchange to change the value at mutex from 0 to 1. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_089: [ If the mutex was owned then InterlockedHL_MutexLock shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_MutexLock_owns_a_free_mutex)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t mutex = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&mutex, 1, 0));
+
+    ///act
+    result = InterlockedHL_MutexLock(&mutex);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 1, mutex);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_090: [ Otherwise InterlockedHL_MutexLock shall spin until the mutex is not owned and try to own it with interlocked_compare_exchange. ]*/
+TEST_FUNCTION(InterlockedHL_MutexLock_owns_a_free_mutex_that_has_waiters_after_spinning)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t mutex = 2; /*not owned, 1 waiter that was woken up and did not get to own the mutex yet*/
+
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&mutex, 1, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&mutex, 3, 2));
+
+    ///act
+    result = InterlockedHL_MutexLock(&mutex);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 3, mutex);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_091: [ If the mutex is still owned then InterlockedHL_MutexLock shall register as waiter by adding 2 to the value at mutex. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_092: [ When the mutex is not owned InterlockedHL_MutexLock shall own it and unregister as waiter with one interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_093: [ While the mutex is owned InterlockedHL_MutexLock shall wait with wait_on_address (with UINT32_MAX as timeout). ]*/
+TEST_FUNCTION(InterlockedHL_MutexLock_waits_for_an_owned_mutex)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t mutex = 1;
+    int32_t released_with_1_waiter = 2;
+
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&mutex, 1, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, 2));
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&mutex, 3, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&released_with_1_waiter, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&mutex, 1, 2));
+
+    ///act
+    result = InterlockedHL_MutexLock(&mutex);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 1, mutex);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_094: [ If wait_on_address fails then InterlockedHL_MutexLock shall unregister as waiter, fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_MutexLock_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t mutex = 1;
+
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&mutex, 1, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, 2));
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&mutex, 3, UINT32_MAX))
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, -2));
+
+    ///act
+    result = InterlockedHL_MutexLock(&mutex);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(int32_t, 1, mutex);
+}
+
+/* InterlockedHL_MutexUnlock */
+
+/*Tests_SRS_INTERLOCKED_HL_02_095: [ If mutex is NULL then InterlockedHL_MutexUnlock shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_MutexUnlock_with_mutex_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_MutexUnlock(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_096: [ InterlockedHL_MutexUnlock shall release the mutex by subtracting 1 from the value at mutex with interlocked_add. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_099: [ InterlockedHL_MutexUnlock shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_MutexUnlock_without_waiters_does_not_wake)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t mutex = 1;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, -1));
+
+    ///act
+    result = InterlockedHL_MutexUnlock(&mutex);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, mutex);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_098: [ If there are waiters then InterlockedHL_MutexUnlock shall call wake_by_address_single on mutex. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_099: [ InterlockedHL_MutexUnlock shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_MutexUnlock_with_waiters_wakes_one)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t mutex = 5; /*owned, 2 waiters*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, -1));
+    STRICT_EXPECTED_CALL(wake_by_address_single(&mutex));
+
+    ///act
+    result = InterlockedHL_MutexUnlock(&mutex);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 4, mutex);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_097: [ If the mutex was not owned then InterlockedHL_MutexUnlock shall add 1 back to the value at mutex, fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_MutexUnlock_of_a_mutex_not_owned_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int32_t mutex = 2; /*not owned, 1 waiter*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, -1));
+    STRICT_EXPECTED_CALL(interlocked_add(&mutex, 1));
+
+    ///act
+    result = InterlockedHL_MutexUnlock(&mutex);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(int32_t, 2, mutex);
+}
+
+/* InterlockedHL_RWLockInit */
+
+/*Tests_SRS_INTERLOCKED_HL_02_100: [ If rwlock is NULL then InterlockedHL_RWLockInit shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockInit_with_rwlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_RWLockInit(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_101: [ InterlockedHL_RWLockInit shall set the state and the waiter count of rwlock to 0 with interlocked_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockInit_succeeds)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock;
+
+    STRICT_EXPECTED_CALL(interlocked_exchange(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_exchange(&rwlock.waiter_count, 0));
+
+    ///act
+    result = InterlockedHL_RWLockInit(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, rwlock.state);
+    ASSERT_ARE_EQUAL(int32_t, 0, rwlock.waiter_count);
+}
+
+/* InterlockedHL_RWLockAcquireShared */
+
+/*Tests_SRS_INTERLOCKED_HL_02_102: [ If rwlock is NULL then InterlockedHL_RWLockAcquireShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireShared_with_rwlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_RWLockAcquireShared(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_103: [ If no writer owns or waits for rwlock then InterlockedHL_RWLockAcquireShared shall increment the number of readers with interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireShared_with_other_readers_succeeds)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 2, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&rwlock.state, 3, 2));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 3, rwlock.state);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_104: [ Otherwise InterlockedHL_RWLockAcquireShared shall spin and then increment the waiter count of rwlock and wait with wait_on_address (with UINT32_MAX as timeout) until no writer owns or waits for rwlock. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireShared_waits_for_the_writer)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x40000000, 0 }; /*owned by a writer*/
+    int32_t released = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0)); /*after spinning*/
+    STRICT_EXPECTED_CALL(interlocked_increment(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&rwlock.state, 0x40000000, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&released, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&rwlock.state, 1, 0));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 1, rwlock.state);
+    ASSERT_ARE_EQUAL(int32_t, 0, rwlock.waiter_count);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_104: [ Otherwise InterlockedHL_RWLockAcquireShared shall spin and then increment the waiter count of rwlock and wait with wait_on_address (with UINT32_MAX as timeout) until no writer owns or waits for rwlock. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireShared_waits_while_a_writer_waits)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x20000001, 0x10001 }; /*1 reader and a writer waiting (and sleeping)*/
+    int32_t writer_is_done = 0;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&rwlock.state, 0x20000001, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&writer_is_done, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&rwlock.state, 1, 0));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_105: [ If wait_on_address fails then InterlockedHL_RWLockAcquireShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_RWLockAcquireShared_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x40000000, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&rwlock.state, 0x40000000, UINT32_MAX))
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.waiter_count));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, rwlock.waiter_count);
+}
+
+/* InterlockedHL_RWLockReleaseShared */
+
+/*Tests_SRS_INTERLOCKED_HL_02_106: [ If rwlock is NULL then InterlockedHL_RWLockReleaseShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseShared_with_rwlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_RWLockReleaseShared(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_107: [ If rwlock has no readers then InterlockedHL_RWLockReleaseShared shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseShared_without_readers_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x40000000, 0 };
+
+    ///act
+    result = InterlockedHL_RWLockReleaseShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_108: [ InterlockedHL_RWLockReleaseShared shall decrement the number of readers with interlocked_decrement. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_110: [ InterlockedHL_RWLockReleaseShared shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseShared_with_other_readers_does_not_wake)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x20000002, 0x10001 };
+
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.state));
+
+    ///act
+    result = InterlockedHL_RWLockReleaseShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x20000001, rwlock.state);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_108: [ InterlockedHL_RWLockReleaseShared shall decrement the number of readers with interlocked_decrement. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_110: [ InterlockedHL_RWLockReleaseShared shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseShared_of_the_last_reader_without_waiters_does_not_wake)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 1, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.state));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+
+    ///act
+    result = InterlockedHL_RWLockReleaseShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, rwlock.state);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_109: [ If there are no readers left and the number of threads sleeping on rwlock (the low 16 bits of the waiter count) is not 0 then InterlockedHL_RWLockReleaseShared shall call wake_by_address_all on the state of rwlock. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_110: [ InterlockedHL_RWLockReleaseShared shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseShared_of_the_last_reader_wakes_the_waiters)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x20000001, 0x10001 };
+
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.state));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+    STRICT_EXPECTED_CALL(wake_by_address_all(&rwlock.state));
+
+    ///act
+    result = InterlockedHL_RWLockReleaseShared(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x20000000, rwlock.state);
+}
+
+/* InterlockedHL_RWLockAcquireExclusive */
+
+/*Tests_SRS_INTERLOCKED_HL_02_111: [ If rwlock is NULL then InterlockedHL_RWLockAcquireExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireExclusive_with_rwlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_RWLockAcquireExclusive(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_112: [ If rwlock has no readers and no writer then InterlockedHL_RWLockAcquireExclusive shall become the writer with interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireExclusive_of_a_free_rwlock_succeeds)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&rwlock.state, 0x40000000, 0));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x40000000, rwlock.state);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_156: [ When it becomes the writer, InterlockedHL_RWLockAcquireExclusive shall keep the mark that a writer waits if the number of waiting writers of rwlock (the waiter count read with interlocked_add, divided by 0x10000, not counting the caller) is not 0, and clear it otherwise. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireExclusive_keeps_the_writer_waiting_bit_while_another_writer_waits)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x20000000, 0x10001 }; /*free, another writer waits*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&rwlock.state, 0x60000000, 0x20000000));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x60000000, rwlock.state); /*new readers still wait*/
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_113: [ Otherwise InterlockedHL_RWLockAcquireExclusive shall spin, then add 0x10000 to the waiter count of rwlock (counting itself as a waiting writer), mark that a writer waits (so that no new readers enter), increment the waiter count of rwlock and wait with wait_on_address (with UINT32_MAX as timeout) until rwlock has no readers and no writer, and then subtract 0x10000 from the waiter count. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_156: [ When it becomes the writer, InterlockedHL_RWLockAcquireExclusive shall keep the mark that a writer waits if the number of waiting writers of rwlock (the waiter count read with interlocked_add, divided by 0x10000, not counting the caller) is not 0, and clear it otherwise. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockAcquireExclusive_marks_the_writer_waiting_and_waits_for_the_readers)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 1, 0 };
+    int32_t readers_are_done = 0x20000000;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0x10000)); /*after spinning*/
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&rwlock.state, 0x20000001, 1));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&rwlock.state, 0x20000001, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&readers_are_done, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&rwlock.state, 0x40000000, 0x20000000)); /*no other writer waits*/
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, -0x10000));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x40000000, rwlock.state);
+    ASSERT_ARE_EQUAL(int32_t, 0, rwlock.waiter_count);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_114: [ If wait_on_address fails then InterlockedHL_RWLockAcquireExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_RWLockAcquireExclusive_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x60000000, 0x10001 }; /*owned by a writer, another writer waits*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0x10000));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&rwlock.state, 0x60000000, UINT32_MAX))
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(interlocked_decrement(&rwlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, -0x10000));
+
+    ///act
+    result = InterlockedHL_RWLockAcquireExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_RWLockReleaseExclusive */
+
+/*Tests_SRS_INTERLOCKED_HL_02_115: [ If rwlock is NULL then InterlockedHL_RWLockReleaseExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseExclusive_with_rwlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_RWLockReleaseExclusive(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_116: [ If rwlock is not owned by a writer then InterlockedHL_RWLockReleaseExclusive shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseExclusive_without_writer_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 1, 0 };
+
+    ///act
+    result = InterlockedHL_RWLockReleaseExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_117: [ InterlockedHL_RWLockReleaseExclusive shall clear the writer with interlocked_add. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_119: [ InterlockedHL_RWLockReleaseExclusive shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseExclusive_without_waiters_does_not_wake)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x40000000, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, -0x40000000));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+
+    ///act
+    result = InterlockedHL_RWLockReleaseExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, rwlock.state);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_118: [ If the number of threads sleeping on rwlock (the low 16 bits of the waiter count) is not 0 then InterlockedHL_RWLockReleaseExclusive shall call wake_by_address_all on the state of rwlock. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_119: [ InterlockedHL_RWLockReleaseExclusive shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseExclusive_with_waiters_wakes_them)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x60000000, 0x10002 };
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, -0x40000000));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+    STRICT_EXPECTED_CALL(wake_by_address_all(&rwlock.state));
+
+    ///act
+    result = InterlockedHL_RWLockReleaseExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x20000000, rwlock.state);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_118: [ If the number of threads sleeping on rwlock (the low 16 bits of the waiter count) is not 0 then InterlockedHL_RWLockReleaseExclusive shall call wake_by_address_all on the state of rwlock. ]*/
+TEST_FUNCTION(InterlockedHL_RWLockReleaseExclusive_with_a_waiting_writer_that_does_not_sleep_yet_does_not_wake)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_RWLOCK rwlock = { 0x60000000, 0x10000 }; /*the waiting writer reads the state again before it sleeps*/
+
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.state, -0x40000000));
+    STRICT_EXPECTED_CALL(interlocked_add(&rwlock.waiter_count, 0));
+
+    ///act
+    result = InterlockedHL_RWLockReleaseExclusive(&rwlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0x20000000, rwlock.state);
+}
+
+/* InterlockedHL_SeqLockInit */
+
+/*Tests_SRS_INTERLOCKED_HL_02_120: [ If seqlock is NULL then InterlockedHL_SeqLockInit shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockInit_with_seqlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SeqLockInit(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_121: [ InterlockedHL_SeqLockInit shall set the sequence and the waiter count of seqlock to 0 with interlocked_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockInit_succeeds)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock;
+
+    STRICT_EXPECTED_CALL(interlocked_exchange(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(interlocked_exchange(&seqlock.waiter_count, 0));
+
+    ///act
+    result = InterlockedHL_SeqLockInit(&seqlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, seqlock.sequence);
+    ASSERT_ARE_EQUAL(int32_t, 0, seqlock.waiter_count);
+}
+
+/* InterlockedHL_SeqLockReadBegin */
+
+/*Tests_SRS_INTERLOCKED_HL_02_122: [ If seqlock is NULL then InterlockedHL_SeqLockReadBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadBegin_with_seqlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    int32_t sequence;
+
+    ///act
+    result = InterlockedHL_SeqLockReadBegin(NULL, &sequence);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_123: [ If sequence is NULL then InterlockedHL_SeqLockReadBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadBegin_with_sequence_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 4, 0 };
+
+    ///act
+    result = InterlockedHL_SeqLockReadBegin(&seqlock, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_124: [ InterlockedHL_SeqLockReadBegin shall read the sequence of seqlock with a load-acquire (without writing to seqlock). ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_125: [ If the sequence is even then InterlockedHL_SeqLockReadBegin shall write it in sequence, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadBegin_without_writer_does_not_write_to_the_seqlock)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 4, 0 };
+    int32_t sequence;
+
+    ///act
+    result = InterlockedHL_SeqLockReadBegin(&seqlock, &sequence);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 4, sequence);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_126: [ Otherwise InterlockedHL_SeqLockReadBegin shall spin and then increment the waiter count of seqlock and wait with wait_on_address (with UINT32_MAX as timeout) until the sequence is even. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadBegin_waits_for_the_writer)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 5, 0 };
+    int32_t sequence;
+    int32_t written = 6;
+
+    STRICT_EXPECTED_CALL(interlocked_increment(&seqlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&seqlock.sequence, 5, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&written, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_decrement(&seqlock.waiter_count));
+
+    ///act
+    result = InterlockedHL_SeqLockReadBegin(&seqlock, &sequence);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 6, sequence);
+    ASSERT_ARE_EQUAL(int32_t, 0, seqlock.waiter_count);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_127: [ If wait_on_address fails then InterlockedHL_SeqLockReadBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_SeqLockReadBegin_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 5, 0 };
+    int32_t sequence;
+
+    STRICT_EXPECTED_CALL(interlocked_increment(&seqlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&seqlock.sequence, 5, UINT32_MAX))
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(interlocked_decrement(&seqlock.waiter_count));
+
+    ///act
+    result = InterlockedHL_SeqLockReadBegin(&seqlock, &sequence);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_SeqLockReadRetry */
+
+/*Tests_SRS_INTERLOCKED_HL_02_128: [ If seqlock is NULL then InterlockedHL_SeqLockReadRetry shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadRetry_with_seqlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SeqLockReadRetry(NULL, 4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_129: [ InterlockedHL_SeqLockReadRetry shall issue an acquire fence (so that the reads of the data are not moved after it) and read the sequence of seqlock (without writing to seqlock). ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_130: [ If the sequence is equal to sequence then InterlockedHL_SeqLockReadRetry shall return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadRetry_with_the_same_sequence_returns_OK)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 4, 0 };
+
+    ///act
+    result = InterlockedHL_SeqLockReadRetry(&seqlock, 4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_129: [ InterlockedHL_SeqLockReadRetry shall issue an acquire fence (so that the reads of the data are not moved after it) and read the sequence of seqlock (without writing to seqlock). ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_131: [ Otherwise InterlockedHL_SeqLockReadRetry shall return INTERLOCKED_HL_CHANGED. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadRetry_after_a_write_returns_CHANGED)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 6, 0 };
+
+    ///act
+    result = InterlockedHL_SeqLockReadRetry(&seqlock, 4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_CHANGED, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_129: [ InterlockedHL_SeqLockReadRetry shall issue an acquire fence (so that the reads of the data are not moved after it) and read the sequence of seqlock (without writing to seqlock). ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_131: [ Otherwise InterlockedHL_SeqLockReadRetry shall return INTERLOCKED_HL_CHANGED. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockReadRetry_during_a_write_returns_CHANGED)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 5, 0 };
+
+    ///act
+    result = InterlockedHL_SeqLockReadRetry(&seqlock, 4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_CHANGED, result);
+}
+
+/* InterlockedHL_SeqLockWriteBegin */
+
+/*Tests_SRS_INTERLOCKED_HL_02_132: [ If seqlock is NULL then InterlockedHL_SeqLockWriteBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockWriteBegin_with_seqlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SeqLockWriteBegin(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_133: [ If the sequence is even then InterlockedHL_SeqLockWriteBegin shall make it odd by incrementing it with interlocked_compare_exchange, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockWriteBegin_makes_the_sequence_odd)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 4, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&seqlock.sequence, 5, 4));
+
+    ///act
+    result = InterlockedHL_SeqLockWriteBegin(&seqlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 5, seqlock.sequence);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_134: [ Otherwise InterlockedHL_SeqLockWriteBegin shall spin and then increment the waiter count of seqlock and wait with wait_on_address (with UINT32_MAX as timeout) until the sequence is even. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockWriteBegin_waits_for_the_other_writer)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 5, 0 };
+    int32_t written = 6;
+
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0)); /*after spinning*/
+    STRICT_EXPECTED_CALL(interlocked_increment(&seqlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&seqlock.sequence, 5, UINT32_MAX))
+        .CopyOutArgumentBuffer_address(&written, sizeof(int32_t));
+    STRICT_EXPECTED_CALL(interlocked_decrement(&seqlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange(&seqlock.sequence, 7, 6));
+
+    ///act
+    result = InterlockedHL_SeqLockWriteBegin(&seqlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 7, seqlock.sequence);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_135: [ If wait_on_address fails then InterlockedHL_SeqLockWriteBegin shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_SeqLockWriteBegin_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 5, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(&seqlock.waiter_count));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.sequence, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(&seqlock.sequence, 5, UINT32_MAX))
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(interlocked_decrement(&seqlock.waiter_count));
+
+    ///act
+    result = InterlockedHL_SeqLockWriteBegin(&seqlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/* InterlockedHL_SeqLockWriteEnd */
+
+/*Tests_SRS_INTERLOCKED_HL_02_136: [ If seqlock is NULL then InterlockedHL_SeqLockWriteEnd shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockWriteEnd_with_seqlock_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SeqLockWriteEnd(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_137: [ If the sequence of seqlock is even (there is no write in progress) then InterlockedHL_SeqLockWriteEnd shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockWriteEnd_without_write_in_progress_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 4, 0 };
+
+    ///act
+    result = InterlockedHL_SeqLockWriteEnd(&seqlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(int32_t, 4, seqlock.sequence);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_138: [ InterlockedHL_SeqLockWriteEnd shall make the sequence even by calling interlocked_increment. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_140: [ InterlockedHL_SeqLockWriteEnd shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockWriteEnd_without_waiters_does_not_wake)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 5, 0 };
+
+    STRICT_EXPECTED_CALL(interlocked_increment(&seqlock.sequence));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.waiter_count, 0));
+
+    ///act
+    result = InterlockedHL_SeqLockWriteEnd(&seqlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 6, seqlock.sequence);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_139: [ If the waiter count of seqlock is not 0 then InterlockedHL_SeqLockWriteEnd shall call wake_by_address_all on the sequence of seqlock. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_140: [ InterlockedHL_SeqLockWriteEnd shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SeqLockWriteEnd_with_waiters_wakes_them)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_SEQLOCK seqlock = { 5, 3 };
+
+    STRICT_EXPECTED_CALL(interlocked_increment(&seqlock.sequence));
+    STRICT_EXPECTED_CALL(interlocked_add(&seqlock.waiter_count, 0));
+    STRICT_EXPECTED_CALL(wake_by_address_all(&seqlock.sequence));
+
+    ///act
+    result = InterlockedHL_SeqLockWriteEnd(&seqlock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int32_t, 6, seqlock.sequence);
+}
+
+/* InterlockedHL_SetWaitSpinCount */
+
+/*Tests_SRS_INTERLOCKED_HL_02_036: [ If max_spin_count is greater than INTERLOCKED_HL_MAX_WAIT_SPIN_COUNT then InterlockedHL_SetWaitSpinCount shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SetWaitSpinCount_with_max_spin_count_too_big_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SetWaitSpinCount(INTERLOCKED_HL_MAX_WAIT_SPIN_COUNT + 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_037: [ InterlockedHL_SetWaitSpinCount shall set the maximum number of spins of the waits to max_spin_count with interlocked_exchange and reset the spin budget of all the wait cells to max_spin_count. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_038: [ InterlockedHL_SetWaitSpinCount shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SetWaitSpinCount_succeeds)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    STRICT_EXPECTED_CALL(interlocked_exchange(IGNORED_ARG, 42));
+
+    ///act
+    result = InterlockedHL_SetWaitSpinCount(42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_008: [ If target is NULL then InterlockedHL_CompareExchange64If shall return fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(interlocked_compare_exchange_64If_with_target_NULL_fails)
+{
+    ///arrange
+    int64_t original_target;
+
+    ///act
+    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(NULL, 1, TEST_IS_GREATER, &original_target);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_009: [ If compare is NULL then InterlockedHL_CompareExchange64If shall return fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_NULL_fails)
+{
+    ///arrange
+    int64_t original_target;
+    volatile_atomic int64_t target;
+    (void)interlocked_exchange_64(&target, 34);
+    umock_c_reset_all_calls();
+
+    ///act
+    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 1, NULL, &original_target);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_010: [ If original_target is NULL then InterlockedHL_CompareExchange64If shall return fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(interlocked_compare_exchange_64If_with_original_target_NULL_fails)
+{
+    ///arrange
+    volatile_atomic int64_t target;
+    (void)interlocked_exchange_64(&target, 34);
+    umock_c_reset_all_calls();
+
+    ///act
+
+    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 1, TEST_IS_GREATER, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_011: [ InterlockedHL_CompareExchange64If shall acquire the initial value of target. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_012: [ If compare(target, exchange) returns true then InterlockedHL_CompareExchange64If shall exchange target with exchange. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_014: [ If target did not change meanwhile then InterlockedHL_CompareExchange64If shall return return INTERLOCKED_HL_OK and shall peform the exchange of values. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_016: [ original_target shall be set to the original value of target. ]*/
+TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_true_changed_false_succeeds)
+{
+    ///arrange
+    int64_t original_target;
+    volatile_atomic int64_t target;
+    (void)interlocked_exchange_64(&target, 34);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&target, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_GREATER(34, 99));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange_64(&target, 99, 34));
+
+    ///act
+
+    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 99, TEST_IS_GREATER, &original_target);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int64_t, 34, original_target);
+    ASSERT_ARE_EQUAL(int64_t, 99, target);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_011: [ InterlockedHL_CompareExchange64If shall acquire the initial value of target. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_015: [ If compare returns false then InterlockedHL_CompareExchange64If shall not perform any exchanges and return INTERLOCKED_HL_OK. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_013: [ If target changed meanwhile then InterlockedHL_CompareExchange64If shall return return INTERLOCKED_HL_CHANGED and shall not peform any exchange of values. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_151: [ If target changed meanwhile then InterlockedHL_CompareExchange64If shall increment the number of compare exchange retries of the current processor (as returned by processor_index_get_current) by calling interlocked_increment_64. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_016: [ original_target shall be set to the original value of target. ]*/
+TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_true_changed_true_succeeds)
+{
+    ///arrange
+    int64_t original_target;
+    volatile_atomic int64_t target;
+    (void)interlocked_exchange_64(&target, 34);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&target, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_GREATER(34, 99));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange_64(&target, 99, 34))
+        .SetReturn(35);
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(interlocked_increment_64(IGNORED_ARG));
+
+    ///act
+    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 99, TEST_IS_GREATER, &original_target);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_CHANGED, result);
+    ASSERT_ARE_EQUAL(int64_t, 34, original_target);
+    ASSERT_ARE_EQUAL(int64_t, 34, target);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_011: [ InterlockedHL_CompareExchange64If shall acquire the initial value of target. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_012: [ If compare(target, exchange) returns true then InterlockedHL_CompareExchange64If shall exchange target with exchange. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_013: [ If target changed meanwhile then InterlockedHL_CompareExchange64If shall return return INTERLOCKED_HL_CHANGED and shall not peform any exchange of values. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_016: [ original_target shall be set to the original value of target. ]*/
+TEST_FUNCTION(interlocked_compare_exchange_64If_with_compare_false_succeeds)
+{
+    ///arrange
+    int64_t original_target;
+    volatile_atomic int64_t target;
+    (void)interlocked_exchange_64(&target, 34);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&target, 0));
+    STRICT_EXPECTED_CALL(TEST_IS_GREATER(34, 33)); /*33 is smaller, no exchanges happen*/
+
+    ///act
+
+    INTERLOCKED_HL_RESULT result = InterlockedHL_CompareExchange64If(&target, 33, TEST_IS_GREATER, &original_target);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int64_t, 34, original_target);
+    ASSERT_ARE_EQUAL(int64_t, 34, target);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_020: [ If address is NULL then InterlockedHL_SetAndWake shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SetAndWake_with_address_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SetAndWake(NULL, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_017: [ InterlockedHL_SetAndWake shall set address to value. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_018: [ InterlockedHL_SetAndWake shall call wake_by_address_single. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_019: [ InterlockedHL_SetAndWake shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SetAndWake_succeeds)
+{
+    ///arrange
+    volatile_atomic int32_t hereLiesAThree = 3;
+    int32_t thatIsGoingToTurn4 = 4;
+    INTERLOCKED_HL_RESULT result;
+
+    STRICT_EXPECTED_CALL(interlocked_exchange(&hereLiesAThree, thatIsGoingToTurn4));
+    STRICT_EXPECTED_CALL(wake_by_address_single(&hereLiesAThree));
+
+    ///act
+    result = InterlockedHL_SetAndWake(&hereLiesAThree, thatIsGoingToTurn4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_028: [ If address is NULL then InterlockedHL_SetAndWakeAll shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SetAndWakeAll_with_address_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SetAndWakeAll(NULL, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_029: [ InterlockedHL_SetAndWakeAll shall set address to value. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_030: [ InterlockedHL_SetAndWakeAll shall call wake_by_address_all. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_031: [ InterlockedHL_SetAndWakeAll shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SetAndWakeAll_succeeds)
+{
+    ///arrange
+    volatile_atomic int32_t hereLiesAThree = 3;
+    int32_t thatIsGoingToTurn4 = 4;
+    INTERLOCKED_HL_RESULT result;
+
+    STRICT_EXPECTED_CALL(interlocked_exchange(&hereLiesAThree, thatIsGoingToTurn4));
+    STRICT_EXPECTED_CALL(wake_by_address_all(&hereLiesAThree));
+
+    ///act
+    result = InterlockedHL_SetAndWakeAll(&hereLiesAThree, thatIsGoingToTurn4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/* InterlockedHL_SetAndWakeAll64 */
+
+/*Tests_SRS_INTERLOCKED_HL_02_043: [ If address is NULL then InterlockedHL_SetAndWakeAll64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_SetAndWakeAll64_with_address_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_SetAndWakeAll64(NULL, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_044: [ InterlockedHL_SetAndWakeAll64 shall set address to value. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_046: [ InterlockedHL_SetAndWakeAll64 shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_SetAndWakeAll64_succeeds)
+{
+    ///arrange
+    volatile_atomic int64_t value = 3;
+    INTERLOCKED_HL_RESULT result;
+
+    STRICT_EXPECTED_CALL(interlocked_exchange_64(&value, 0x100000004)); /*nobody waits, so the wait cell is not touched*/
+
+    ///act
+    result = InterlockedHL_SetAndWakeAll64(&value, 0x100000004);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int64_t, 0x100000004, value);
+}
+
+/* InterlockedHL_WakeAll64 */
+
+/*Tests_SRS_INTERLOCKED_HL_02_157: [ If address is NULL then InterlockedHL_WakeAll64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WakeAll64_with_address_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_WakeAll64(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_158: [ InterlockedHL_WakeAll64 shall not read or write the value at address. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_160: [ InterlockedHL_WakeAll64 shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_WakeAll64_succeeds)
+{
+    ///arrange
+    volatile_atomic int64_t value = 0x100000004;
+    INTERLOCKED_HL_RESULT result;
+
+    /*nobody waits, so the wait cell is not touched either*/
+
+    ///act
+    result = InterlockedHL_WakeAll64(&value);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(int64_t, 0x100000004, value);
+}
+
+/* InterlockedHL_WaitForValue64 */
+
+/*Tests_SRS_INTERLOCKED_HL_02_047: [ If address is NULL then InterlockedHL_WaitForValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForValue64_with_address_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_WaitForValue64(NULL, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_048: [ InterlockedHL_WaitForValue64 shall read the value at address by using interlocked_add_64. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_049: [ If the value at address is equal to value then InterlockedHL_WaitForValue64 shall return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(when_the_value_equals_target_value_InterlockedHL_WaitForValue64_returns_OK)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000042;
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_050: [ If the value is still not equal to value then InterlockedHL_WaitForValue64 shall increment the waiter count of the wait cell of address, read the generation of the wait cell and the value at address, and call wait_on_address on the generation with milliseconds as timeout until the value is equal to value, and then decrement the waiter count. ]*/
+TEST_FUNCTION(when_the_value_equals_target_value_after_waiting_InterlockedHL_WaitForValue64_returns_OK)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000041;
+
+    g_value64_address = &value;
+    g_value64_set_by_wait = 0x100000042;
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address_sets_value64);
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, 1234));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_decrement(IGNORED_ARG));
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, 1234);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_050: [ If the value is still not equal to value then InterlockedHL_WaitForValue64 shall increment the waiter count of the wait cell of address, read the generation of the wait cell and the value at address, and call wait_on_address on the generation with milliseconds as timeout until the value is equal to value, and then decrement the waiter count. ]*/
+TEST_FUNCTION(when_the_value_does_not_equal_target_value_after_waiting_InterlockedHL_WaitForValue64_waits_again)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000040;
+    int64_t expected_value = 0x100000042;
+
+    g_value64_address = &value;
+    g_value64_set_by_wait = 0x100000041; /*the first wait sets 0x100000041, the second 0x100000042*/
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address_sets_value64);
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, UINT32_MAX));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, UINT32_MAX));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_decrement(IGNORED_ARG));
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, expected_value, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_051: [ If wait_on_address fails then InterlockedHL_WaitForValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_WaitForValue64_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000041;
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, UINT32_MAX))
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(interlocked_decrement(IGNORED_ARG));
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_154: [ Otherwise InterlockedHL_WaitForValue64 shall first spin (executing a pause instruction between reads) for at most the spin budget of the wait cell of address waiting for the value at address to be equal to value. ]*/
+TEST_FUNCTION(when_the_value_equals_target_value_while_spinning_InterlockedHL_WaitForValue64_returns_OK_without_waiting)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000041;
+
+    g_address_64_changed_after_first_read = &value;
+    g_value_64_after_first_read = 0x100000042;
+    REGISTER_GLOBAL_MOCK_HOOK(interlocked_add_64, hook_interlocked_add_64_changes_value_after_first_read);
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_152: [ If there are threads waiting on the wait cell of Addend then InterlockedHL_Add64WithCeiling shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_050: [ If the value is still not equal to value then InterlockedHL_WaitForValue64 shall increment the waiter count of the wait cell of address, read the generation of the wait cell and the value at address, and call wait_on_address on the generation with milliseconds as timeout until the value is equal to value, and then decrement the waiter count. ]*/
+TEST_FUNCTION(InterlockedHL_Add64WithCeiling_wakes_InterlockedHL_WaitForValue64)
+{
+    ///arrange
+    volatile_atomic int64_t value = 0x100000041;
+    INTERLOCKED_HL_RESULT result;
+
+    g_value64_address = &value;
+    g_update_value64_while_waiting = add_1_with_InterlockedHL_Add64WithCeiling;
+    g_wait_value_changed_by_update = false;
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address_updates_value64);
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_IS_TRUE(g_wait_value_changed_by_update); /*the generation waited on changed, so a real wait_on_address returns*/
+    ASSERT_ARE_EQUAL(int64_t, 0x100000042, value);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_153: [ If the exchange was performed and there are threads waiting on the wait cell of target then InterlockedHL_CompareExchange64If shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+TEST_FUNCTION(InterlockedHL_CompareExchange64If_wakes_InterlockedHL_WaitForValue64)
+{
+    ///arrange
+    volatile_atomic int64_t value = 0x100000041;
+    INTERLOCKED_HL_RESULT result;
+
+    g_value64_address = &value;
+    g_update_value64_while_waiting = add_1_with_InterlockedHL_CompareExchange64If;
+    g_wait_value_changed_by_update = false;
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address_updates_value64);
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_IS_TRUE(g_wait_value_changed_by_update);
+    ASSERT_ARE_EQUAL(int64_t, 0x100000042, value);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_045: [ If there are threads waiting on the wait cell of address then InterlockedHL_SetAndWakeAll64 shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+TEST_FUNCTION(InterlockedHL_SetAndWakeAll64_wakes_InterlockedHL_WaitForValue64)
+{
+    ///arrange
+    volatile_atomic int64_t value = 0x100000041;
+    INTERLOCKED_HL_RESULT result;
+
+    g_value64_address = &value;
+    g_update_value64_while_waiting = add_1_with_InterlockedHL_SetAndWakeAll64;
+    g_wait_value_changed_by_update = false;
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address_updates_value64);
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_IS_TRUE(g_wait_value_changed_by_update);
+    ASSERT_ARE_EQUAL(int64_t, 0x100000042, value);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_159: [ If there are threads waiting on the wait cell of address then InterlockedHL_WakeAll64 shall increment the generation of the wait cell and call wake_by_address_all on it. ]*/
+TEST_FUNCTION(InterlockedHL_WakeAll64_after_interlocked_add_64_wakes_InterlockedHL_WaitForValue64)
+{
+    ///arrange
+    volatile_atomic int64_t value = 0x100000041;
+    INTERLOCKED_HL_RESULT result;
+
+    g_value64_address = &value;
+    g_update_value64_while_waiting = add_1_with_interlocked_add_64_and_InterlockedHL_WakeAll64;
+    g_wait_value_changed_by_update = false;
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address_updates_value64);
+
+    ///act
+    result = InterlockedHL_WaitForValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_IS_TRUE(g_wait_value_changed_by_update);
+    ASSERT_ARE_EQUAL(int64_t, 0x100000042, value);
+}
+
+/* InterlockedHL_WaitForNotValue64 */
+
+/*Tests_SRS_INTERLOCKED_HL_02_052: [ If address is NULL then InterlockedHL_WaitForNotValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_WaitForNotValue64_with_address_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_WaitForNotValue64(NULL, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_053: [ InterlockedHL_WaitForNotValue64 shall read the value at address by using interlocked_add_64. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_054: [ If the value at address is not equal to value then InterlockedHL_WaitForNotValue64 shall return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(when_the_value_does_not_equal_value_InterlockedHL_WaitForNotValue64_returns_OK)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000041;
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+
+    ///act
+    result = InterlockedHL_WaitForNotValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_055: [ If the value is still equal to value then InterlockedHL_WaitForNotValue64 shall increment the waiter count of the wait cell of address, read the generation of the wait cell and the value at address, and call wait_on_address on the generation with milliseconds as timeout until the value is not equal to value, and then decrement the waiter count. ]*/
+TEST_FUNCTION(when_the_value_changes_after_waiting_InterlockedHL_WaitForNotValue64_returns_OK)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000042;
+
+    g_value64_address = &value;
+    g_value64_set_by_wait = 0x200000042;
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address_sets_value64);
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, 1234));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_decrement(IGNORED_ARG));
+
+    ///act
+    result = InterlockedHL_WaitForNotValue64(&value, 0x100000042, 1234);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_056: [ If wait_on_address fails then InterlockedHL_WaitForNotValue64 shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(when_wait_on_address_fails_InterlockedHL_WaitForNotValue64_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000042;
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_increment(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add(IGNORED_ARG, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, UINT32_MAX))
+        .SetReturn(false);
+    STRICT_EXPECTED_CALL(interlocked_decrement(IGNORED_ARG));
+
+    ///act
+    result = InterlockedHL_WaitForNotValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_155: [ Otherwise InterlockedHL_WaitForNotValue64 shall first spin (executing a pause instruction between reads) for at most the spin budget of the wait cell of address waiting for the value at address to be different than value. ]*/
+TEST_FUNCTION(when_the_value_changes_while_spinning_InterlockedHL_WaitForNotValue64_returns_OK_without_waiting)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    volatile_atomic int64_t value = 0x100000042;
+
+    g_address_64_changed_after_first_read = &value;
+    g_value_64_after_first_read = 0x200000042;
+    REGISTER_GLOBAL_MOCK_HOOK(interlocked_add_64, hook_interlocked_add_64_changes_value_after_first_read);
+
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+    STRICT_EXPECTED_CALL(interlocked_add_64(&value, 0));
+
+    ///act
+    result = InterlockedHL_WaitForNotValue64(&value, 0x100000042, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/* InterlockedHL_Backoff */
+
+/*Tests_SRS_INTERLOCKED_HL_02_141: [ If backoff is NULL then InterlockedHL_Backoff shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_Backoff_with_backoff_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_Backoff(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_142: [ If this is the first backoff then InterlockedHL_Backoff shall set the limit of pauses of backoff to INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT and seed the jitter of backoff from the address of backoff. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_143: [ InterlockedHL_Backoff shall increment the number of compare exchange retries of the current processor (as returned by processor_index_get_current) by calling interlocked_increment_64. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_144: [ InterlockedHL_Backoff shall execute a random number of pause instructions between half of the limit of pauses of backoff and the limit of pauses of backoff. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_145: [ InterlockedHL_Backoff shall add the number of pause instructions executed to the number of backoff pauses of the same processor by calling interlocked_add_64. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_146: [ InterlockedHL_Backoff shall double the limit of pauses of backoff, without exceeding INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_147: [ InterlockedHL_Backoff shall succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_Backoff_the_first_time_succeeds)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    INTERLOCKED_HL_STATISTICS before;
+    INTERLOCKED_HL_STATISTICS after;
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_GetStatistics(&before));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(interlocked_increment_64(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add_64(IGNORED_ARG, IGNORED_ARG));
+
+    ///act
+    result = InterlockedHL_Backoff(&backoff);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(uint32_t, 2 * INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT, backoff.pause_count);
+    ASSERT_ARE_NOT_EQUAL(uint32_t, 0, backoff.seed);
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_GetStatistics(&after));
+    ASSERT_ARE_EQUAL(uint64_t, before.cas_retries + 1, after.cas_retries);
+    ASSERT_IS_TRUE(after.backoff_pauses - before.backoff_pauses >= INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT / 2);
+    ASSERT_IS_TRUE(after.backoff_pauses - before.backoff_pauses <= INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_144: [ InterlockedHL_Backoff shall execute a random number of pause instructions between half of the limit of pauses of backoff and the limit of pauses of backoff. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_146: [ InterlockedHL_Backoff shall double the limit of pauses of backoff, without exceeding INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT. ]*/
+TEST_FUNCTION(InterlockedHL_Backoff_doubles_the_pauses_up_to_INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT)
+{
+    ///arrange
+    INTERLOCKED_HL_BACKOFF backoff = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    uint32_t expected_pause_count = INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT;
+
+    ///act
+    for (uint32_t i = 0; i < 12; i++)
+    {
+        INTERLOCKED_HL_STATISTICS before;
+        INTERLOCKED_HL_STATISTICS after;
+        ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_GetStatistics(&before));
+
+        ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_Backoff(&backoff));
+
+        ///assert
+        ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_GetStatistics(&after));
+        ASSERT_IS_TRUE(after.backoff_pauses - before.backoff_pauses >= expected_pause_count / 2);
+        ASSERT_IS_TRUE(after.backoff_pauses - before.backoff_pauses <= expected_pause_count);
+
+        expected_pause_count = (expected_pause_count * 2 > INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT) ? INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT : expected_pause_count * 2;
+        ASSERT_ARE_EQUAL(uint32_t, expected_pause_count, backoff.pause_count);
+    }
+    ASSERT_ARE_EQUAL(uint32_t, INTERLOCKED_HL_BACKOFF_MAX_PAUSE_COUNT, backoff.pause_count);
+}
+
+/* InterlockedHL_GetStatistics */
+
+/*Tests_SRS_INTERLOCKED_HL_02_148: [ If statistics is NULL then InterlockedHL_GetStatistics shall fail and return INTERLOCKED_HL_ERROR. ]*/
+TEST_FUNCTION(InterlockedHL_GetStatistics_with_statistics_NULL_fails)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+
+    ///act
+    result = InterlockedHL_GetStatistics(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_ERROR, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_149: [ InterlockedHL_GetStatistics shall sum the numbers of compare exchange retries and the numbers of backoff pauses of all the INTERLOCKED_HL_STATISTICS_SLOT_COUNT processor slots (reading each by calling interlocked_add_64), write the sums in statistics, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_GetStatistics_succeeds)
+{
+    ///arrange
+    INTERLOCKED_HL_RESULT result;
+    INTERLOCKED_HL_STATISTICS statistics;
+
+    for (uint32_t i = 0; i < INTERLOCKED_HL_STATISTICS_SLOT_COUNT; i++)
+    {
+        STRICT_EXPECTED_CALL(interlocked_add_64(IGNORED_ARG, 0));
+        STRICT_EXPECTED_CALL(interlocked_add_64(IGNORED_ARG, 0));
+    }
+
+    ///act
+    result = InterlockedHL_GetStatistics(&statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_151: [ If target changed meanwhile then InterlockedHL_CompareExchange64If shall increment the number of compare exchange retries of the current processor (as returned by processor_index_get_current) by calling interlocked_increment_64. ]*/
+TEST_FUNCTION(InterlockedHL_GetStatistics_counts_the_changed_InterlockedHL_CompareExchange64If)
+{
+    ///arrange
+    int64_t original_target;
+    volatile_atomic int64_t target;
+    INTERLOCKED_HL_STATISTICS before;
+    INTERLOCKED_HL_STATISTICS after;
+    (void)interlocked_exchange_64(&target, 34);
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_GetStatistics(&before));
+    STRICT_EXPECTED_CALL(interlocked_compare_exchange_64(&target, 99, 34))
+        .SetReturn(35);
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_CHANGED, InterlockedHL_CompareExchange64If(&target, 99, TEST_IS_GREATER, &original_target));
+
+    ///act
+    INTERLOCKED_HL_RESULT result = InterlockedHL_GetStatistics(&after);
+
+    ///assert
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, before.cas_retries + 1, after.cas_retries);
+    ASSERT_ARE_EQUAL(uint64_t, before.backoff_pauses, after.backoff_pauses);
+}
+
+/*Tests_SRS_INTERLOCKED_HL_02_143: [ InterlockedHL_Backoff shall increment the number of compare exchange retries of the current processor (as returned by processor_index_get_current) by calling interlocked_increment_64. ]*/
+/*Tests_SRS_INTERLOCKED_HL_02_149: [ InterlockedHL_GetStatistics shall sum the numbers of compare exchange retries and the numbers of backoff pauses of all the INTERLOCKED_HL_STATISTICS_SLOT_COUNT processor slots (reading each by calling interlocked_add_64), write the sums in statistics, succeed and return INTERLOCKED_HL_OK. ]*/
+TEST_FUNCTION(InterlockedHL_GetStatistics_sums_the_counters_of_all_the_processors)
+{
+    ///arrange
+    INTERLOCKED_HL_BACKOFF backoff_1 = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    INTERLOCKED_HL_BACKOFF backoff_2 = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    INTERLOCKED_HL_BACKOFF backoff_3 = INTERLOCKED_HL_BACKOFF_INITIALIZER;
+    INTERLOCKED_HL_STATISTICS before;
+    INTERLOCKED_HL_STATISTICS after;
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_GetStatistics(&before));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(interlocked_increment_64(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add_64(IGNORED_ARG, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(INTERLOCKED_HL_STATISTICS_SLOT_COUNT - 1);
+    STRICT_EXPECTED_CALL(interlocked_increment_64(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add_64(IGNORED_ARG, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(INTERLOCKED_HL_STATISTICS_SLOT_COUNT + 1); /*shares the slot of processor 1*/
+    STRICT_EXPECTED_CALL(interlocked_increment_64(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(interlocked_add_64(IGNORED_ARG, IGNORED_ARG));
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_Backoff(&backoff_1));
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_Backoff(&backoff_2));
+    ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, InterlockedHL_Backoff(&backoff_3));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///act
+    INTERLOCKED_HL_RESULT result = InterlockedHL_GetStatistics(&after);
 
     ///assert
     ASSERT_ARE_EQUAL(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, before.cas_retries + 3, after.cas_retries);
+    ASSERT_IS_TRUE(after.backoff_pauses - before.backoff_pauses >= 3 * (INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT / 2));
+    ASSERT_IS_TRUE(after.backoff_pauses - before.backoff_pauses <= 3 * INTERLOCKED_HL_BACKOFF_MIN_PAUSE_COUNT);
 }
 
 END_TEST_SUITE(interlocked_hl_win32_ut)
@@ -0,0 +1,226 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#include "azure_c_util/log_ratelimit.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+BEGIN_TEST_SUITE(log_ratelimit_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_001: [ If site is NULL then log_ratelimit_hit shall return 0. ]*/
+TEST_FUNCTION(log_ratelimit_hit_with_site_NULL_returns_0)
+{
+    ///arrange
+
+    ///act
+    int64_t result = log_ratelimit_hit(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int64_t, 0, result);
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_002: [ log_ratelimit_hit shall increment the count of site. ]*/
+TEST_FUNCTION(log_ratelimit_hit_increments_the_count)
+{
+    ///arrange
+    static LOG_RATELIMIT_SITE site = LOG_RATELIMIT_SITE_INITIALIZER;
+    int64_t count_before = interlocked_add_64(&site.count, 0);
+
+    ///act
+    (void)log_ratelimit_hit(&site);
+    (void)log_ratelimit_hit(&site);
+    (void)log_ratelimit_hit(&site);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int64_t, count_before + 3, interlocked_add_64(&site.count, 0));
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_004: [ If the count is a power of 2 then log_ratelimit_hit shall return the count. ]*/
+/*Tests_SRS_LOG_RATELIMIT_02_005: [ Otherwise log_ratelimit_hit shall return 0. ]*/
+TEST_FUNCTION(log_ratelimit_hit_returns_the_count_only_for_powers_of_2)
+{
+    ///arrange
+    static LOG_RATELIMIT_SITE site = LOG_RATELIMIT_SITE_INITIALIZER;
+    int64_t results[9];
+
+    ///act
+    for (int i = 0; i < 9; i++)
+    {
+        results[i] = log_ratelimit_hit(&site);
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(int64_t, 1, results[0]);
+    ASSERT_ARE_EQUAL(int64_t, 2, results[1]);
+    ASSERT_ARE_EQUAL(int64_t, 0, results[2]);
+    ASSERT_ARE_EQUAL(int64_t, 4, results[3]);
+    ASSERT_ARE_EQUAL(int64_t, 0, results[4]);
+    ASSERT_ARE_EQUAL(int64_t, 0, results[5]);
+    ASSERT_ARE_EQUAL(int64_t, 0, results[6]);
+    ASSERT_ARE_EQUAL(int64_t, 8, results[7]);
+    ASSERT_ARE_EQUAL(int64_t, 0, results[8]);
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_003: [ If this is the first hit of site then log_ratelimit_hit shall add site to the list of sites. ]*/
+TEST_FUNCTION(log_ratelimit_hit_adds_the_site_to_the_list_of_sites_on_first_hit)
+{
+    ///arrange
+    static LOG_RATELIMIT_SITE site_1 = LOG_RATELIMIT_SITE_INITIALIZER;
+    static LOG_RATELIMIT_SITE site_2 = LOG_RATELIMIT_SITE_INITIALIZER;
+    (void)log_ratelimit_hit(&site_1);
+
+    ///act
+    (void)log_ratelimit_hit(&site_2);
+    (void)log_ratelimit_hit(&site_2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, &site_1, site_2.next); /*site_2 was added once, in front of site_1*/
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_006: [ log_ratelimit_flush shall visit all the sites that were hit at least once. ]*/
+/*Tests_SRS_LOG_RATELIMIT_02_007: [ For every site that was hit since the previous call to log_ratelimit_flush, log_ratelimit_flush shall log the number of hits since the previous call and the total number of hits. ]*/
+/*Tests_SRS_LOG_RATELIMIT_02_008: [ log_ratelimit_flush shall set the count of every site to 0 and add it to the total count of the site. ]*/
+TEST_FUNCTION(log_ratelimit_flush_moves_the_count_of_every_site_to_the_total_count)
+{
+    ///arrange
+    static LOG_RATELIMIT_SITE site_1 = LOG_RATELIMIT_SITE_INITIALIZER;
+    static LOG_RATELIMIT_SITE site_2 = LOG_RATELIMIT_SITE_INITIALIZER;
+    (void)log_ratelimit_hit(&site_1);
+    (void)log_ratelimit_hit(&site_2);
+    (void)log_ratelimit_hit(&site_2);
+
+    ///act
+    log_ratelimit_flush();
+
+    ///assert
+    ASSERT_ARE_EQUAL(int64_t, 0, interlocked_add_64(&site_1.count, 0));
+    ASSERT_ARE_EQUAL(int64_t, 1, interlocked_add_64(&site_1.total_count, 0));
+    ASSERT_ARE_EQUAL(int64_t, 0, interlocked_add_64(&site_2.count, 0));
+    ASSERT_ARE_EQUAL(int64_t, 2, interlocked_add_64(&site_2.total_count, 0));
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_007: [ For every site that was hit since the previous call to log_ratelimit_flush, log_ratelimit_flush shall log the number of hits since the previous call and the total number of hits. ]*/
+/*Tests_SRS_LOG_RATELIMIT_02_008: [ log_ratelimit_flush shall set the count of every site to 0 and add it to the total count of the site. ]*/
+TEST_FUNCTION(log_ratelimit_flush_after_flush_counts_only_the_new_hits)
+{
+    ///arrange
+    static LOG_RATELIMIT_SITE site = LOG_RATELIMIT_SITE_INITIALIZER;
+    (void)log_ratelimit_hit(&site);
+    log_ratelimit_flush();
+    (void)log_ratelimit_hit(&site);
+    (void)log_ratelimit_hit(&site);
+
+    ///act
+    log_ratelimit_flush();
+
+    ///assert
+    ASSERT_ARE_EQUAL(int64_t, 0, interlocked_add_64(&site.count, 0));
+    ASSERT_ARE_EQUAL(int64_t, 3, interlocked_add_64(&site.total_count, 0));
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_004: [ If the count is a power of 2 then log_ratelimit_hit shall return the count. ]*/
+/*Tests_SRS_LOG_RATELIMIT_02_008: [ log_ratelimit_flush shall set the count of every site to 0 and add it to the total count of the site. ]*/
+TEST_FUNCTION(log_ratelimit_hit_after_a_burst_and_a_flush_returns_1)
+{
+    ///arrange
+    static LOG_RATELIMIT_SITE site = LOG_RATELIMIT_SITE_INITIALIZER;
+    for (int i = 0; i < 1000; i++)
+    {
+        (void)log_ratelimit_hit(&site);
+    }
+    ASSERT_ARE_EQUAL(int64_t, 0, log_ratelimit_hit(&site)); /*hit 1001 is not logged*/
+    log_ratelimit_flush();
+
+    ///act
+    int64_t result = log_ratelimit_hit(&site);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int64_t, 1, result); /*the first hit after the flush is logged*/
+}
+
+/*Tests_SRS_LOG_RATELIMIT_02_003: [ If this is the first hit of site then log_ratelimit_hit shall add site to the list of sites. ]*/
+TEST_FUNCTION(log_ratelimit_hit_after_a_flush_does_not_add_the_site_again)
+{
+    ///arrange
+    static LOG_RATELIMIT_SITE site_1 = LOG_RATELIMIT_SITE_INITIALIZER;
+    static LOG_RATELIMIT_SITE site_2 = LOG_RATELIMIT_SITE_INITIALIZER;
+    (void)log_ratelimit_hit(&site_1);
+    (void)log_ratelimit_hit(&site_2);
+    log_ratelimit_flush();
+
+    ///act
+    (void)log_ratelimit_hit(&site_1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, &site_1, site_2.next); /*site_1 was not moved in front of site_2*/
+}
+
+TEST_FUNCTION(LogErrorRateLimited_counts_the_hits_of_the_call_site)
+{
+    ///arrange
+
+    ///act
+    for (int i = 0; i < 5; i++)
+    {
+        LogErrorRateLimited("this is hit number %d", i + 1);
+    }
+    LogErrorRateLimited("no arguments");
+
+    ///assert
+    /*no explicit assert, the hits are only observable in the log*/
+}
+
+END_TEST_SUITE(log_ratelimit_unittests)
@@ -0,0 +1,762 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/sync.h"
+#include "azure_c_pal/timer.h"
+#include "azure_c_util/interlocked_hl.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+#include "real_gballoc_hl.h"
+
+#include "azure_c_util/memory_budget.h"
+
+MEMORY_BUDGET_SETTING_DEFINE(test_unset_setting)
+MEMORY_BUDGET_SETTING_DEFINE(test_setting)
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_RESULT_VALUES);
+
+/*the clock only moves when a test (or a wait) moves it*/
+static double g_now_ms;
+
+static double hook_timer_global_get_elapsed_ms(void)
+{
+    return g_now_ms;
+}
+
+/*waiting is simulated by moving the clock. When g_budget_released_during_wait is not NULL, another thread releases g_size_released_during_wait bytes meanwhile*/
+static MEMORY_BUDGET_HANDLE g_budget_released_during_wait;
+static int64_t g_size_released_during_wait;
+
+static bool hook_wait_on_address(volatile_atomic int32_t* address, int32_t compare_value, uint32_t timeout_ms)
+{
+    (void)address;
+    (void)compare_value;
+    if (g_budget_released_during_wait != NULL)
+    {
+        MEMORY_BUDGET_HANDLE memory_budget = g_budget_released_during_wait;
+        g_budget_released_during_wait = NULL;
+        g_now_ms += 1;
+        memory_budget_release(memory_budget, g_size_released_during_wait);
+        return true;
+    }
+    else
+    {
+        g_now_ms += timeout_ms;
+        return false;
+    }
+}
+
+static uint32_t g_wake_by_address_all_call_count;
+
+static void hook_wake_by_address_all(volatile_atomic int32_t* address)
+{
+    (void)address;
+    g_wake_by_address_all_call_count++;
+}
+
+static MEMORY_BUDGET_HANDLE TEST_memory_budget_create(const char* name, int64_t limit, MEMORY_BUDGET_HANDLE parent)
+{
+    MEMORY_BUDGET_HANDLE result = memory_budget_create(name, limit, parent);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void ASSERT_USED(MEMORY_BUDGET_HANDLE memory_budget, int64_t expected_used)
+{
+    int64_t used;
+    ASSERT_ARE_EQUAL(int, 0, memory_budget_get_used(memory_budget, &used));
+    ASSERT_ARE_EQUAL(int64_t, expected_used, used);
+}
+
+BEGIN_TEST_SUITE(memory_budget_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    ASSERT_ARE_EQUAL(int, 0, real_gballoc_hl_init(NULL, NULL));
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_bool_register_types());
+
+    REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_GLOBAL_MOCK_HOOK(timer_global_get_elapsed_ms, hook_timer_global_get_elapsed_ms);
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address);
+    REGISTER_GLOBAL_MOCK_HOOK(wake_by_address_all, hook_wake_by_address_all);
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+
+    real_gballoc_hl_deinit();
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_now_ms = 1000;
+    g_budget_released_during_wait = NULL;
+    g_size_released_during_wait = 0;
+    g_wake_by_address_all_call_count = 0;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_001: [ If name is NULL then memory_budget_create shall fail and return NULL. ]*/
+TEST_FUNCTION(memory_budget_create_with_name_NULL_fails)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget;
+
+    ///act
+    memory_budget = memory_budget_create(NULL, 10, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(memory_budget);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_002: [ If limit is less than 0 then memory_budget_create shall fail and return NULL. ]*/
+TEST_FUNCTION(memory_budget_create_with_negative_limit_fails)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget;
+
+    ///act
+    memory_budget = memory_budget_create("test", -1, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(memory_budget);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_003: [ memory_budget_create shall allocate memory for the budget and a copy of name. ]*/
+/*Tests_SRS_MEMORY_BUDGET_02_005: [ memory_budget_create shall set the used bytes to 0, succeed and return a non-NULL value. ]*/
+TEST_FUNCTION(memory_budget_create_succeeds)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    memory_budget = memory_budget_create("test", 10, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(memory_budget);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "test", memory_budget_get_name(memory_budget));
+    ASSERT_USED(memory_budget, 0);
+
+    ///clean
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_003: [ memory_budget_create shall allocate memory for the budget and a copy of name. ]*/
+TEST_FUNCTION(memory_budget_create_with_limit_0_succeeds)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    memory_budget = memory_budget_create("test", 0, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(memory_budget);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_004: [ If there are any failures then memory_budget_create shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_memory_budget_create_fails)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    memory_budget = memory_budget_create("test", 10, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(memory_budget);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_006: [ If memory_budget is NULL then memory_budget_destroy shall return. ]*/
+TEST_FUNCTION(memory_budget_destroy_with_memory_budget_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    memory_budget_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_007: [ memory_budget_destroy shall free all used resources. ]*/
+TEST_FUNCTION(memory_budget_destroy_frees)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+
+    STRICT_EXPECTED_CALL(free(memory_budget));
+
+    ///act
+    memory_budget_destroy(memory_budget);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_008: [ If memory_budget is NULL then memory_budget_charge shall fail and return MEMORY_BUDGET_ERROR. ]*/
+TEST_FUNCTION(memory_budget_charge_with_memory_budget_NULL_fails)
+{
+    ///arrange
+    MEMORY_BUDGET_RESULT result;
+
+    ///act
+    result = memory_budget_charge(NULL, 1, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_009: [ If size is less than 0 then memory_budget_charge shall fail and return MEMORY_BUDGET_ERROR. ]*/
+TEST_FUNCTION(memory_budget_charge_with_negative_size_fails)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+
+    ///act
+    result = memory_budget_charge(memory_budget, -1, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 0);
+
+    ///clean
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_010: [ memory_budget_charge shall charge size bytes to memory_budget and to every parent of memory_budget by calling InterlockedHL_Add64WithCeiling with the limit of the budget as ceiling. ]*/
+/*Tests_SRS_MEMORY_BUDGET_02_011: [ If all the budgets accept the bytes then memory_budget_charge shall succeed and return MEMORY_BUDGET_OK. ]*/
+TEST_FUNCTION(memory_budget_charge_succeeds)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG));
+
+    ///act
+    result = memory_budget_charge(memory_budget, 4, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 4);
+
+    ///clean
+    memory_budget_release(memory_budget, 4);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_010: [ memory_budget_charge shall charge size bytes to memory_budget and to every parent of memory_budget by calling InterlockedHL_Add64WithCeiling with the limit of the budget as ceiling. ]*/
+/*Tests_SRS_MEMORY_BUDGET_02_011: [ If all the budgets accept the bytes then memory_budget_charge shall succeed and return MEMORY_BUDGET_OK. ]*/
+TEST_FUNCTION(memory_budget_charge_charges_the_parents)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE process = TEST_memory_budget_create("process", 100, NULL);
+    MEMORY_BUDGET_HANDLE component = TEST_memory_budget_create("component", 10, process);
+    MEMORY_BUDGET_RESULT result;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 100, 4, IGNORED_ARG));
+
+    ///act
+    result = memory_budget_charge(component, 4, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(component, 4);
+    ASSERT_USED(process, 4);
+
+    ///clean
+    memory_budget_release(component, 4);
+    memory_budget_destroy(component);
+    memory_budget_destroy(process);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_011: [ If all the budgets accept the bytes then memory_budget_charge shall succeed and return MEMORY_BUDGET_OK. ]*/
+TEST_FUNCTION(memory_budget_charge_up_to_the_limit_succeeds)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(memory_budget, 6, 0));
+    umock_c_reset_all_calls();
+
+    ///act
+    result = memory_budget_charge(memory_budget, 4, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, result);
+    ASSERT_USED(memory_budget, 10);
+
+    ///clean
+    memory_budget_release(memory_budget, 10);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_013: [ If a budget refuses the bytes and timeout_ms is 0 then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED. ]*/
+TEST_FUNCTION(memory_budget_charge_above_the_limit_with_timeout_0_returns_MEMORY_BUDGET_EXHAUSTED)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(memory_budget, 7, 0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG));
+
+    ///act
+    result = memory_budget_charge(memory_budget, 4, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_EXHAUSTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 7);
+
+    ///clean
+    memory_budget_release(memory_budget, 7);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_012: [ If a budget refuses the bytes then memory_budget_charge shall give back the bytes charged to the other budgets. ]*/
+/*Tests_SRS_MEMORY_BUDGET_02_013: [ If a budget refuses the bytes and timeout_ms is 0 then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED. ]*/
+TEST_FUNCTION(when_the_parent_refuses_memory_budget_charge_gives_back_the_bytes_and_returns_MEMORY_BUDGET_EXHAUSTED)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE process = TEST_memory_budget_create("process", 5, NULL);
+    MEMORY_BUDGET_HANDLE component = TEST_memory_budget_create("component", 10, process);
+    MEMORY_BUDGET_RESULT result;
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(process, 3, 0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 5, 4, IGNORED_ARG));
+
+    ///act
+    result = memory_budget_charge(component, 4, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_EXHAUSTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(component, 0);
+    ASSERT_USED(process, 3);
+
+    ///clean
+    memory_budget_release(process, 3);
+    memory_budget_destroy(component);
+    memory_budget_destroy(process);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_025: [ If size is greater than the limit of memory_budget or of any parent of memory_budget then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED without charging or waiting. ]*/
+TEST_FUNCTION(memory_budget_charge_above_the_limit_of_the_budget_returns_MEMORY_BUDGET_EXHAUSTED_without_waiting)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+
+    ///act
+    result = memory_budget_charge(memory_budget, 11, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_EXHAUSTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 0);
+
+    ///clean
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_025: [ If size is greater than the limit of memory_budget or of any parent of memory_budget then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED without charging or waiting. ]*/
+TEST_FUNCTION(memory_budget_charge_above_the_limit_of_a_parent_returns_MEMORY_BUDGET_EXHAUSTED_without_waiting)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE process = TEST_memory_budget_create("process", 5, NULL);
+    MEMORY_BUDGET_HANDLE component = TEST_memory_budget_create("component", 10, process);
+    MEMORY_BUDGET_RESULT result;
+
+    ///act
+    result = memory_budget_charge(component, 8, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_EXHAUSTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(component, 0);
+    ASSERT_USED(process, 0);
+
+    ///clean
+    memory_budget_destroy(component);
+    memory_budget_destroy(process);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_014: [ Otherwise memory_budget_charge shall wait with wait_on_address for bytes to be released to the budget that refused, at most until timeout_ms expires, and then try again. ]*/
+TEST_FUNCTION(memory_budget_charge_waits_for_bytes_to_be_released)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(memory_budget, 10, 0));
+    umock_c_reset_all_calls();
+
+    g_budget_released_during_wait = memory_budget;
+    g_size_released_during_wait = 5;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG)); /*refused*/
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG)); /*refused again, nothing was released yet*/
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, 1001));
+    STRICT_EXPECTED_CALL(wake_by_address_all(IGNORED_ARG)); /*the release from the other thread*/
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG)); /*accepted*/
+
+    ///act
+    result = memory_budget_charge(memory_budget, 4, 1000);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 9);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_wake_by_address_all_call_count);
+
+    ///clean
+    memory_budget_release(memory_budget, 9);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_014: [ Otherwise memory_budget_charge shall wait with wait_on_address for bytes to be released to the budget that refused, at most until timeout_ms expires, and then try again. ]*/
+TEST_FUNCTION(memory_budget_charge_with_UINT32_MAX_waits_forever)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(memory_budget, 10, 0));
+    umock_c_reset_all_calls();
+
+    g_budget_released_during_wait = memory_budget;
+    g_size_released_during_wait = 10;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 10, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 10, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, UINT32_MAX));
+    STRICT_EXPECTED_CALL(wake_by_address_all(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 10, IGNORED_ARG));
+
+    ///act
+    result = memory_budget_charge(memory_budget, 10, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 10);
+
+    ///clean
+    memory_budget_release(memory_budget, 10);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_015: [ If timeout_ms is not UINT32_MAX and timeout_ms milliseconds have elapsed since memory_budget_charge was called then memory_budget_charge shall return MEMORY_BUDGET_EXHAUSTED. ]*/
+TEST_FUNCTION(when_no_bytes_are_released_memory_budget_charge_returns_MEMORY_BUDGET_EXHAUSTED_after_timeout)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_RESULT result;
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(memory_budget, 10, 0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 1, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 1, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, IGNORED_ARG, 51));
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 1, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+
+    ///act
+    result = memory_budget_charge(memory_budget, 1, 50);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_EXHAUSTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 10);
+
+    ///clean
+    memory_budget_release(memory_budget, 10);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_016: [ If memory_budget is NULL then memory_budget_release shall return. ]*/
+TEST_FUNCTION(memory_budget_release_with_memory_budget_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    memory_budget_release(NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_017: [ If size is less than 0 then memory_budget_release shall return. ]*/
+TEST_FUNCTION(memory_budget_release_with_negative_size_returns)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(memory_budget, 5, 0));
+    umock_c_reset_all_calls();
+
+    ///act
+    memory_budget_release(memory_budget, -1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(memory_budget, 5);
+
+    ///clean
+    memory_budget_release(memory_budget, 5);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_018: [ memory_budget_release shall subtract size from the used bytes of memory_budget and of every parent of memory_budget. ]*/
+TEST_FUNCTION(memory_budget_release_gives_back_to_the_budget_and_the_parents)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE process = TEST_memory_budget_create("process", 100, NULL);
+    MEMORY_BUDGET_HANDLE component = TEST_memory_budget_create("component", 10, process);
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(component, 8, 0));
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(process, 50, 0));
+    umock_c_reset_all_calls();
+
+    ///act
+    memory_budget_release(component, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_USED(component, 5);
+    ASSERT_USED(process, 55);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_wake_by_address_all_call_count); /*nobody waits*/
+
+    ///clean
+    memory_budget_release(component, 5);
+    memory_budget_release(process, 50);
+    memory_budget_destroy(component);
+    memory_budget_destroy(process);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_020: [ If memory_budget is NULL then memory_budget_get_used shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(memory_budget_get_used_with_memory_budget_NULL_fails)
+{
+    ///arrange
+    int64_t used;
+    int result;
+
+    ///act
+    result = memory_budget_get_used(NULL, &used);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_021: [ If used is NULL then memory_budget_get_used shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(memory_budget_get_used_with_used_NULL_fails)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    int result;
+
+    ///act
+    result = memory_budget_get_used(memory_budget, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    ///clean
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_022: [ memory_budget_get_used shall write in used the number of bytes charged to memory_budget, succeed and return 0. ]*/
+TEST_FUNCTION(memory_budget_get_used_succeeds)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    int64_t used = -1;
+    int result;
+    ASSERT_ARE_EQUAL(MEMORY_BUDGET_RESULT, MEMORY_BUDGET_OK, memory_budget_charge(memory_budget, 3, 0));
+    umock_c_reset_all_calls();
+
+    ///act
+    result = memory_budget_get_used(memory_budget, &used);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int64_t, 3, used);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    memory_budget_release(memory_budget, 3);
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_023: [ If memory_budget is NULL then memory_budget_get_name shall return NULL. ]*/
+TEST_FUNCTION(memory_budget_get_name_with_memory_budget_NULL_returns_NULL)
+{
+    ///arrange
+    const char* result;
+
+    ///act
+    result = memory_budget_get_name(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_024: [ memory_budget_get_name shall return the name of memory_budget. ]*/
+TEST_FUNCTION(memory_budget_get_name_returns_a_copy_of_the_name)
+{
+    ///arrange
+    char name[] = "send queue";
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create(name, 10, NULL);
+    const char* result;
+    name[0] = 'X';
+
+    ///act
+    result = memory_budget_get_name(memory_budget);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, "send queue", result);
+
+    ///clean
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_026: [ MEMORY_BUDGET_SETTING_DEFINE(name) shall define a static setting name without a budget (NULL) and with a timeout of 0. ]*/
+/*Tests_SRS_MEMORY_BUDGET_02_028: [ name_get shall write in memory_budget and timeout_ms the budget and the timeout stored in name. ]*/
+TEST_FUNCTION(MEMORY_BUDGET_SETTING_DEFINE_starts_without_a_budget)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget = TEST_memory_budget_create("test", 10, NULL);
+    MEMORY_BUDGET_HANDLE memory_budget_read = memory_budget;
+    uint32_t timeout_ms_read = 42;
+
+    ///act
+    test_unset_setting_get(&memory_budget_read, &timeout_ms_read);
+
+    ///assert
+    ASSERT_IS_NULL(memory_budget_read);
+    ASSERT_ARE_EQUAL(uint32_t, 0, timeout_ms_read);
+
+    ///clean
+    test_unset_setting_set(NULL, 0); /*the setting is never set by any other test*/
+    memory_budget_destroy(memory_budget);
+}
+
+/*Tests_SRS_MEMORY_BUDGET_02_027: [ name_set shall store memory_budget and timeout_ms in name. ]*/
+/*Tests_SRS_MEMORY_BUDGET_02_028: [ name_get shall write in memory_budget and timeout_ms the budget and the timeout stored in name. ]*/
+/*Tests_SRS_MEMORY_BUDGET_02_029: [ name_set shall make the sequence of name odd by incrementing it from an even value with interlocked_compare_exchange, write memory_budget and timeout_ms and then make the sequence even again. ]*/
+TEST_FUNCTION(MEMORY_BUDGET_SETTING_DEFINE_get_returns_the_last_set_budget_and_timeout)
+{
+    ///arrange
+    MEMORY_BUDGET_HANDLE memory_budget_1 = TEST_memory_budget_create("first", 10, NULL);
+    MEMORY_BUDGET_HANDLE memory_budget_2 = TEST_memory_budget_create("second", 10, NULL);
+    MEMORY_BUDGET_HANDLE memory_budget_read;
+    uint32_t timeout_ms_read;
+    test_setting_set(memory_budget_1, 1);
+
+    ///act
+    test_setting_set(memory_budget_2, UINT32_MAX);
+    test_setting_get(&memory_budget_read, &timeout_ms_read);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, memory_budget_2, memory_budget_read);
+    ASSERT_ARE_EQUAL(uint32_t, UINT32_MAX, timeout_ms_read);
+    ASSERT_ARE_EQUAL(int32_t, 0, test_setting.sequence & 1);
+
+    ///clean
+    test_setting_set(NULL, 0);
+    memory_budget_destroy(memory_budget_2);
+    memory_budget_destroy(memory_budget_1);
+}
+
+END_TEST_SUITE(memory_budget_unittests)
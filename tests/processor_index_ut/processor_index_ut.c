@@ -0,0 +1,70 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "azure_c_util/processor_index.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+BEGIN_TEST_SUITE(processor_index_unittests)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_PROCESSOR_INDEX_02_001: [ processor_index_get_count shall return the number of processors of the system. ]*/
+/*Tests_SRS_PROCESSOR_INDEX_02_002: [ If the number of processors cannot be determined then processor_index_get_count shall return 1. ]*/
+TEST_FUNCTION(processor_index_get_count_returns_at_least_1)
+{
+    ///arrange
+
+    ///act
+    uint32_t count = processor_index_get_count();
+
+    ///assert
+    ASSERT_IS_TRUE(count >= 1);
+}
+
+/*Tests_SRS_PROCESSOR_INDEX_02_003: [ processor_index_get_current shall return the index of the processor executing the calling thread. ]*/
+TEST_FUNCTION(processor_index_get_current_returns_an_index_that_can_be_used_modulo_count)
+{
+    ///arrange
+    uint32_t count = processor_index_get_count();
+
+    ///act
+    uint32_t index = processor_index_get_current();
+
+    ///assert
+    ASSERT_IS_TRUE(index < 64 * count); /*64 is the maximum number of processors in a processor group*/
+}
+
+END_TEST_SUITE(processor_index_unittests)
@@ -3,6 +3,8 @@
 
 #include "real_interlocked_renames.h"
 #include "real_gballoc_hl_renames.h"
+#include "real_log_ratelimit_renames.h"
+#include "real_memory_budget_renames.h"
 
 #include "real_constbuffer_renames.h"
 
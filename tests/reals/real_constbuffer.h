@@ -19,7 +19,9 @@
         CONSTBUFFER_GetContent, \
         CONSTBUFFER_DecRef, \
         CONSTBUFFER_HANDLE_contain_same, \
-        CONSTBUFFER_CreateFromOffsetAndSize \
+        CONSTBUFFER_CreateFromOffsetAndSize, \
+        CONSTBUFFER_SetMemoryBudget, \
+        CONSTBUFFER_CreateWithMemoryBudget \
 )
 
 #ifdef __cplusplus
@@ -53,6 +55,10 @@ bool real_CONSTBUFFER_HANDLE_contain_same(CONSTBUFFER_HANDLE left, CONSTBUFFER_H
 
 CONSTBUFFER_HANDLE real_CONSTBUFFER_CreateFromOffsetAndSize(CONSTBUFFER_HANDLE handle, size_t offset, size_t size);
 
+void real_CONSTBUFFER_SetMemoryBudget(MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms);
+
+CONSTBUFFER_HANDLE real_CONSTBUFFER_CreateWithMemoryBudget(const unsigned char* source, size_t size, MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,7 +30,9 @@
         constbuffer_array_get_buffer_content, \
         constbuffer_array_get_all_buffers_size, \
         constbuffer_array_get_const_buffer_handle_array, \
-        CONSTBUFFER_ARRAY_HANDLE_contain_same \
+        CONSTBUFFER_ARRAY_HANDLE_contain_same, \
+        constbuffer_array_set_memory_budget, \
+        constbuffer_array_create_with_memory_budget \
 )
 
 #include "azure_c_util/constbuffer.h"
@@ -62,6 +64,8 @@ const CONSTBUFFER* real_constbuffer_array_get_buffer_content(CONSTBUFFER_ARRAY_H
 int real_constbuffer_array_get_all_buffers_size(CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle, uint32_t* all_buffers_size);
 const CONSTBUFFER_HANDLE* real_constbuffer_array_get_const_buffer_handle_array(CONSTBUFFER_ARRAY_HANDLE constbuffer_array_handle);
 bool real_CONSTBUFFER_ARRAY_HANDLE_contain_same(CONSTBUFFER_ARRAY_HANDLE left, CONSTBUFFER_ARRAY_HANDLE right);
+void real_constbuffer_array_set_memory_budget(MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms);
+CONSTBUFFER_ARRAY_HANDLE real_constbuffer_array_create_with_memory_budget(const CONSTBUFFER_HANDLE* buffers, uint32_t buffer_count, MEMORY_BUDGET_HANDLE memory_budget, uint32_t timeout_ms);
 
 #ifdef __cplusplus
 }
@@ -16,3 +16,5 @@
 #define constbuffer_array_get_all_buffers_size real_constbuffer_array_get_all_buffers_size
 #define constbuffer_array_get_const_buffer_handle_array real_constbuffer_array_get_const_buffer_handle_array
 #define CONSTBUFFER_ARRAY_HANDLE_contain_same real_CONSTBUFFER_ARRAY_HANDLE_contain_same
+#define constbuffer_array_set_memory_budget real_constbuffer_array_set_memory_budget
+#define constbuffer_array_create_with_memory_budget real_constbuffer_array_create_with_memory_budget
@@ -14,5 +14,7 @@
 #define CONSTBUFFER_DecRef real_CONSTBUFFER_DecRef
 #define CONSTBUFFER_HANDLE_contain_same real_CONSTBUFFER_HANDLE_contain_same
 #define CONSTBUFFER_CreateFromOffsetAndSize real_CONSTBUFFER_CreateFromOffsetAndSize
+#define CONSTBUFFER_SetMemoryBudget real_CONSTBUFFER_SetMemoryBudget
+#define CONSTBUFFER_CreateWithMemoryBudget real_CONSTBUFFER_CreateWithMemoryBudget
 
 #endif // REAL_CONSTBUFFER_RENAMES_H
@@ -3,5 +3,6 @@
 #include "real_interlocked_renames.h"
 #include "real_interlocked_hl_renames.h"
 #include "real_sync_renames.h"
+#include "real_processor_index_renames.h"
 
 #include "interlocked_hl.c"
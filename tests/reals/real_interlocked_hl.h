@@ -15,7 +15,32 @@
         InterlockedHL_WaitForNotValue, \
         InterlockedHL_SetAndWake, \
         InterlockedHL_SetAndWakeAll, \
-        InterlockedHL_CompareExchange64If \
+        InterlockedHL_WaitForMask, \
+        InterlockedHL_WaitForLessThan, \
+        InterlockedHL_WaitForPredicate, \
+        InterlockedHL_LatchCountDown, \
+        InterlockedHL_LatchWait, \
+        InterlockedHL_BarrierArriveAndWait, \
+        InterlockedHL_MutexLock, \
+        InterlockedHL_MutexUnlock, \
+        InterlockedHL_RWLockInit, \
+        InterlockedHL_RWLockAcquireShared, \
+        InterlockedHL_RWLockReleaseShared, \
+        InterlockedHL_RWLockAcquireExclusive, \
+        InterlockedHL_RWLockReleaseExclusive, \
+        InterlockedHL_SeqLockInit, \
+        InterlockedHL_SeqLockReadBegin, \
+        InterlockedHL_SeqLockReadRetry, \
+        InterlockedHL_SeqLockWriteBegin, \
+        InterlockedHL_SeqLockWriteEnd, \
+        InterlockedHL_SetAndWakeAll64, \
+        InterlockedHL_WakeAll64, \
+        InterlockedHL_WaitForValue64, \
+        InterlockedHL_WaitForNotValue64, \
+        InterlockedHL_SetWaitSpinCount, \
+        InterlockedHL_CompareExchange64If, \
+        InterlockedHL_Backoff, \
+        InterlockedHL_GetStatistics \
     )
 
 #include "azure_c_pal/interlocked.h"
@@ -30,7 +55,32 @@ extern "C" {
     INTERLOCKED_HL_RESULT real_InterlockedHL_WaitForNotValue(int32_t volatile_atomic* address, int32_t value, uint32_t milliseconds);
     INTERLOCKED_HL_RESULT real_InterlockedHL_SetAndWake(int32_t volatile_atomic* address, int32_t value);
     INTERLOCKED_HL_RESULT real_InterlockedHL_SetAndWakeAll(int32_t volatile_atomic* address, int32_t value);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_WaitForMask(int32_t volatile_atomic* address, int32_t mask, int32_t expected, uint32_t milliseconds);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_WaitForLessThan(int32_t volatile_atomic* address, int32_t value, uint32_t milliseconds);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_WaitForPredicate(int32_t volatile_atomic* address, INTERLOCKED_HL_WAIT_PREDICATE predicate, void* context, uint32_t milliseconds);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_LatchCountDown(int32_t volatile_atomic* latch);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_LatchWait(int32_t volatile_atomic* latch, uint32_t milliseconds);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_BarrierArriveAndWait(int32_t volatile_atomic* barrier, int32_t parties, uint32_t milliseconds);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_MutexLock(int32_t volatile_atomic* mutex);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_MutexUnlock(int32_t volatile_atomic* mutex);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_RWLockInit(INTERLOCKED_HL_RWLOCK* rwlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_RWLockAcquireShared(INTERLOCKED_HL_RWLOCK* rwlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_RWLockReleaseShared(INTERLOCKED_HL_RWLOCK* rwlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_RWLockAcquireExclusive(INTERLOCKED_HL_RWLOCK* rwlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_RWLockReleaseExclusive(INTERLOCKED_HL_RWLOCK* rwlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_SeqLockInit(INTERLOCKED_HL_SEQLOCK* seqlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_SeqLockReadBegin(INTERLOCKED_HL_SEQLOCK* seqlock, int32_t* sequence);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_SeqLockReadRetry(INTERLOCKED_HL_SEQLOCK* seqlock, int32_t sequence);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_SeqLockWriteBegin(INTERLOCKED_HL_SEQLOCK* seqlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_SeqLockWriteEnd(INTERLOCKED_HL_SEQLOCK* seqlock);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_SetAndWakeAll64(int64_t volatile_atomic* address, int64_t value);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_WakeAll64(int64_t volatile_atomic* address);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_WaitForValue64(int64_t volatile_atomic* address, int64_t value, uint32_t milliseconds);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_WaitForNotValue64(int64_t volatile_atomic* address, int64_t value, uint32_t milliseconds);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_SetWaitSpinCount(uint32_t max_spin_count);
     INTERLOCKED_HL_RESULT real_InterlockedHL_CompareExchange64If(int64_t volatile_atomic* target, int64_t exchange, INTERLOCKED_COMPARE_EXCHANGE_64_IF compare, int64_t* original_target);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_Backoff(INTERLOCKED_HL_BACKOFF* backoff);
+    INTERLOCKED_HL_RESULT real_InterlockedHL_GetStatistics(INTERLOCKED_HL_STATISTICS* statistics);
 
 #ifdef __cplusplus
 }
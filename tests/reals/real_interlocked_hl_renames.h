@@ -7,6 +7,30 @@
 #define InterlockedHL_WaitForNotValue real_InterlockedHL_WaitForNotValue
 #define InterlockedHL_SetAndWake real_InterlockedHL_SetAndWake
 #define InterlockedHL_SetAndWakeAll real_InterlockedHL_SetAndWakeAll
+#define InterlockedHL_WaitForMask real_InterlockedHL_WaitForMask
+#define InterlockedHL_WaitForLessThan real_InterlockedHL_WaitForLessThan
+#define InterlockedHL_WaitForPredicate real_InterlockedHL_WaitForPredicate
+#define InterlockedHL_LatchCountDown real_InterlockedHL_LatchCountDown
+#define InterlockedHL_LatchWait real_InterlockedHL_LatchWait
+#define InterlockedHL_BarrierArriveAndWait real_InterlockedHL_BarrierArriveAndWait
+#define InterlockedHL_MutexLock real_InterlockedHL_MutexLock
+#define InterlockedHL_MutexUnlock real_InterlockedHL_MutexUnlock
+#define InterlockedHL_RWLockInit real_InterlockedHL_RWLockInit
+#define InterlockedHL_RWLockAcquireShared real_InterlockedHL_RWLockAcquireShared
+#define InterlockedHL_RWLockReleaseShared real_InterlockedHL_RWLockReleaseShared
+#define InterlockedHL_RWLockAcquireExclusive real_InterlockedHL_RWLockAcquireExclusive
+#define InterlockedHL_RWLockReleaseExclusive real_InterlockedHL_RWLockReleaseExclusive
+#define InterlockedHL_SeqLockInit real_InterlockedHL_SeqLockInit
+#define InterlockedHL_SeqLockReadBegin real_InterlockedHL_SeqLockReadBegin
+#define InterlockedHL_SeqLockReadRetry real_InterlockedHL_SeqLockReadRetry
+#define InterlockedHL_SeqLockWriteBegin real_InterlockedHL_SeqLockWriteBegin
+#define InterlockedHL_SeqLockWriteEnd real_InterlockedHL_SeqLockWriteEnd
+#define InterlockedHL_WaitForNotValue64 real_InterlockedHL_WaitForNotValue64
+#define InterlockedHL_SetAndWakeAll64 real_InterlockedHL_SetAndWakeAll64
+#define InterlockedHL_WakeAll64 real_InterlockedHL_WakeAll64
+#define InterlockedHL_SetWaitSpinCount real_InterlockedHL_SetWaitSpinCount
 #define InterlockedHL_CompareExchange64If real_InterlockedHL_CompareExchange64If
+#define InterlockedHL_Backoff real_InterlockedHL_Backoff
+#define InterlockedHL_GetStatistics real_InterlockedHL_GetStatistics
 
 #define INTERLOCKED_HL_RESULT real_INTERLOCKED_HL_RESULT
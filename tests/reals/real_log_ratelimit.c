@@ -0,0 +1,9 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+
+#include "real_interlocked_renames.h"
+
+#include "real_log_ratelimit_renames.h"
+
+#include "../../src/log_ratelimit.c"
@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REAL_LOG_RATELIMIT_H
+#define REAL_LOG_RATELIMIT_H
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/log_ratelimit.h"
+
+#define R2(X) REGISTER_GLOBAL_MOCK_HOOK(X, real_##X);
+
+#define REGISTER_LOG_RATELIMIT_GLOBAL_MOCK_HOOK()     \
+    MU_FOR_EACH_1(R2,                                 \
+        log_ratelimit_hit,                            \
+        log_ratelimit_flush                           \
+    )
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+int64_t real_log_ratelimit_hit(LOG_RATELIMIT_SITE* site);
+void real_log_ratelimit_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REAL_LOG_RATELIMIT_H
@@ -0,0 +1,5 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define log_ratelimit_hit      real_log_ratelimit_hit
+#define log_ratelimit_flush    real_log_ratelimit_flush
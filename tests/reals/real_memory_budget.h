@@ -0,0 +1,41 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REAL_MEMORY_BUDGET_H
+#define REAL_MEMORY_BUDGET_H
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/memory_budget.h"
+
+#define R2(X) REGISTER_GLOBAL_MOCK_HOOK(X, real_##X);
+
+#define REGISTER_MEMORY_BUDGET_GLOBAL_MOCK_HOOK()     \
+    MU_FOR_EACH_1(R2,                                 \
+        memory_budget_create,                         \
+        memory_budget_destroy,                        \
+        memory_budget_charge,                         \
+        memory_budget_release,                        \
+        memory_budget_get_used,                       \
+        memory_budget_get_name                        \
+    )
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+MEMORY_BUDGET_HANDLE real_memory_budget_create(const char* name, int64_t limit, MEMORY_BUDGET_HANDLE parent);
+void real_memory_budget_destroy(MEMORY_BUDGET_HANDLE memory_budget);
+MEMORY_BUDGET_RESULT real_memory_budget_charge(MEMORY_BUDGET_HANDLE memory_budget, int64_t size, uint32_t timeout_ms);
+void real_memory_budget_release(MEMORY_BUDGET_HANDLE memory_budget, int64_t size);
+int real_memory_budget_get_used(MEMORY_BUDGET_HANDLE memory_budget, int64_t* used);
+const char* real_memory_budget_get_name(MEMORY_BUDGET_HANDLE memory_budget);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REAL_MEMORY_BUDGET_H
@@ -0,0 +1,11 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define memory_budget_create        real_memory_budget_create
+#define memory_budget_destroy       real_memory_budget_destroy
+#define memory_budget_charge        real_memory_budget_charge
+#define memory_budget_release       real_memory_budget_release
+#define memory_budget_get_used      real_memory_budget_get_used
+#define memory_budget_get_name      real_memory_budget_get_name
+
+#define MEMORY_BUDGET_RESULT        real_MEMORY_BUDGET_RESULT
@@ -0,0 +1,31 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REAL_PROCESSOR_INDEX_H
+#define REAL_PROCESSOR_INDEX_H
+
+#include "azure_macro_utils/macro_utils.h"
+
+#define R2(X) REGISTER_GLOBAL_MOCK_HOOK(X, real_##X);
+
+#define REGISTER_PROCESSOR_INDEX_GLOBAL_MOCK_HOOK()     \
+    MU_FOR_EACH_1(R2,                                   \
+        processor_index_get_count,                      \
+        processor_index_get_current                     \
+    )
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+uint32_t real_processor_index_get_count(void);
+uint32_t real_processor_index_get_current(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REAL_PROCESSOR_INDEX_H
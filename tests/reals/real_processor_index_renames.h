@@ -0,0 +1,5 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define processor_index_get_count      real_processor_index_get_count
+#define processor_index_get_current    real_processor_index_get_current
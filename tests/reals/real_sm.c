@@ -5,6 +5,8 @@
 #include "real_interlocked_renames.h"
 #include "real_interlocked_hl_renames.h"
 #include "real_gballoc_hl_renames.h"
+#include "real_processor_index_renames.h"
+#include "real_log_ratelimit_renames.h"
 
 #include "real_sm_renames.h"
 
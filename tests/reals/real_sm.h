@@ -11,6 +11,7 @@
 #define REGISTER_SM_GLOBAL_MOCK_HOOK()                  \
     MU_FOR_EACH_1(R2,                                   \
         sm_create,                                      \
+        sm_create_with_options,                         \
         sm_destroy,                                     \
         sm_open_begin,                                  \
         sm_open_end,                                    \
@@ -18,8 +19,15 @@
         sm_close_end,                                   \
         sm_exec_begin,                                  \
         sm_exec_end,                                    \
+        sm_exec_begin_n,                                \
+        sm_exec_end_n,                                  \
         sm_barrier_begin,                               \
-        sm_barrier_end                                  \
+        sm_barrier_end,                                 \
+        sm_close_begin_async,                           \
+        sm_barrier_begin_async,                         \
+        sm_get_statistics,                              \
+        sm_trace_get,                                   \
+        sm_trace_dump                                   \
     )
 
 #include "azure_c_util/sm.h"
@@ -29,6 +37,7 @@ extern "C" {
 #endif
 
 SM_HANDLE real_sm_create(const char* name);
+SM_HANDLE real_sm_create_with_options(const char* name, const SM_OPTIONS* options);
 void real_sm_destroy(SM_HANDLE sm);
 
 SM_RESULT real_sm_open_begin(SM_HANDLE sm);
@@ -40,9 +49,20 @@ void real_sm_close_end(SM_HANDLE sm);
 SM_RESULT real_sm_exec_begin(SM_HANDLE sm);
 void real_sm_exec_end(SM_HANDLE sm);
 
+SM_RESULT real_sm_exec_begin_n(SM_HANDLE sm, uint32_t count);
+void real_sm_exec_end_n(SM_HANDLE sm, uint32_t count);
+
 SM_RESULT real_sm_barrier_begin(SM_HANDLE sm);
 void real_sm_barrier_end(SM_HANDLE sm);
 
+SM_RESULT real_sm_close_begin_async(SM_HANDLE sm, SM_ON_DRAINED_FUNC on_drained, void* context);
+SM_RESULT real_sm_barrier_begin_async(SM_HANDLE sm, SM_ON_DRAINED_FUNC on_drained, void* context);
+
+int real_sm_get_statistics(SM_HANDLE sm, SM_STATISTICS* statistics);
+
+int real_sm_trace_get(SM_HANDLE sm, SM_TRACE_RECORD* records, uint32_t* record_count);
+void real_sm_trace_dump(SM_HANDLE sm);
+
 #ifdef __cplusplus
 }
 #endif
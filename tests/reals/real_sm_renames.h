@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #define sm_create          real_sm_create
+#define sm_create_with_options real_sm_create_with_options
 #define sm_destroy         real_sm_destroy
 #define sm_open_begin      real_sm_open_begin
 #define sm_open_end        real_sm_open_end
@@ -9,8 +10,20 @@
 #define sm_close_end       real_sm_close_end
 #define sm_exec_begin      real_sm_exec_begin
 #define sm_exec_end        real_sm_exec_end
+#define sm_exec_begin_n    real_sm_exec_begin_n
+#define sm_exec_end_n      real_sm_exec_end_n
 #define sm_barrier_begin   real_sm_barrier_begin
 #define sm_barrier_end     real_sm_barrier_end
+#define sm_close_begin_async real_sm_close_begin_async
+#define sm_barrier_begin_async real_sm_barrier_begin_async
+#define sm_get_statistics  real_sm_get_statistics
+#define sm_trace_get       real_sm_trace_get
+#define sm_trace_dump      real_sm_trace_dump
 
 #define SM_RESULT real_SM_RESULT
 #define SM_STATE real_SM_STATE
+#define SM_OPTIONS real_SM_OPTIONS
+#define SM_ON_DRAINED_FUNC real_SM_ON_DRAINED_FUNC
+#define SM_STATISTICS real_SM_STATISTICS
+#define SM_API_STATISTICS real_SM_API_STATISTICS
+#define SM_TRACE_RECORD real_SM_TRACE_RECORD
@@ -0,0 +1,10 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+
+#include "real_interlocked_renames.h"
+#include "real_interlocked_hl_renames.h"
+
+#include "real_thandle_atomic_renames.h"
+
+#include "../../src/thandle_atomic.c"
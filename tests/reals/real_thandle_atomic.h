@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REAL_THANDLE_ATOMIC_H
+#define REAL_THANDLE_ATOMIC_H
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/thandle_atomic.h"
+
+#define R2(X) REGISTER_GLOBAL_MOCK_HOOK(X, real_##X);
+
+#define REGISTER_THANDLE_ATOMIC_GLOBAL_MOCK_HOOK()    \
+    MU_FOR_EACH_1(R2,                                 \
+        thandle_atomic_slot_init,                     \
+        thandle_atomic_slot_read_begin,               \
+        thandle_atomic_slot_read_end,                 \
+        thandle_atomic_slot_exchange                  \
+    )
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+int real_thandle_atomic_slot_init(THANDLE_ATOMIC_SLOT* slot, void* value);
+void* real_thandle_atomic_slot_read_begin(THANDLE_ATOMIC_SLOT* slot, int32_t* reader_index);
+void real_thandle_atomic_slot_read_end(THANDLE_ATOMIC_SLOT* slot, int32_t reader_index);
+int real_thandle_atomic_slot_exchange(THANDLE_ATOMIC_SLOT* slot, void* value, void** previous_value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REAL_THANDLE_ATOMIC_H
@@ -0,0 +1,7 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define thandle_atomic_slot_init        real_thandle_atomic_slot_init
+#define thandle_atomic_slot_read_begin  real_thandle_atomic_slot_read_begin
+#define thandle_atomic_slot_read_end    real_thandle_atomic_slot_read_end
+#define thandle_atomic_slot_exchange    real_thandle_atomic_slot_exchange
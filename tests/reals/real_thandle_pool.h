@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REAL_THANDLE_POOL_H
+#define REAL_THANDLE_POOL_H
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/thandle_pool.h"
+
+#define R2(X) REGISTER_GLOBAL_MOCK_HOOK(X, real_##X);
+
+#define REGISTER_THANDLE_POOL_GLOBAL_MOCK_HOOK()      \
+    MU_FOR_EACH_1(R2,                                 \
+        thandle_pool_create,                          \
+        thandle_pool_destroy,                         \
+        thandle_pool_malloc,                          \
+        thandle_pool_free,                            \
+        thandle_pool_get_statistics                   \
+    )
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+THANDLE_POOL_HANDLE real_thandle_pool_create(size_t item_size, uint32_t items_per_processor);
+void real_thandle_pool_destroy(THANDLE_POOL_HANDLE thandle_pool);
+void* real_thandle_pool_malloc(THANDLE_POOL_HANDLE thandle_pool, size_t size);
+bool real_thandle_pool_free(THANDLE_POOL_HANDLE thandle_pool, void* ptr);
+int real_thandle_pool_get_statistics(THANDLE_POOL_HANDLE thandle_pool, THANDLE_POOL_STATISTICS* statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REAL_THANDLE_POOL_H
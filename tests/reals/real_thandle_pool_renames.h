@@ -0,0 +1,8 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define thandle_pool_create         real_thandle_pool_create
+#define thandle_pool_destroy        real_thandle_pool_destroy
+#define thandle_pool_malloc         real_thandle_pool_malloc
+#define thandle_pool_free           real_thandle_pool_free
+#define thandle_pool_get_statistics real_thandle_pool_get_statistics
@@ -0,0 +1,46 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REAL_THANDLE_TELEMETRY_H
+#define REAL_THANDLE_TELEMETRY_H
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/thandle_telemetry.h"
+
+#define R2(X) REGISTER_GLOBAL_MOCK_HOOK(X, real_##X);
+
+#define REGISTER_THANDLE_TELEMETRY_GLOBAL_MOCK_HOOK()    \
+    MU_FOR_EACH_1(R2,                                    \
+        thandle_telemetry_register,                      \
+        thandle_telemetry_unregister,                    \
+        thandle_telemetry_on_create,                     \
+        thandle_telemetry_on_free,                       \
+        thandle_telemetry_get_statistics,                \
+        thandle_telemetry_enumerate,                     \
+        thandle_telemetry_log_all                        \
+    )
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+THANDLE_TELEMETRY_HANDLE real_thandle_telemetry_register(const char* type_name);
+void real_thandle_telemetry_unregister(THANDLE_TELEMETRY_HANDLE thandle_telemetry);
+
+void real_thandle_telemetry_on_create(THANDLE_TELEMETRY_HANDLE thandle_telemetry, size_t size);
+void real_thandle_telemetry_on_free(THANDLE_TELEMETRY_HANDLE thandle_telemetry, size_t size);
+
+int real_thandle_telemetry_get_statistics(THANDLE_TELEMETRY_HANDLE thandle_telemetry, THANDLE_TELEMETRY_STATISTICS* statistics);
+
+int real_thandle_telemetry_enumerate(THANDLE_TELEMETRY_ON_TYPE on_type, void* context);
+int real_thandle_telemetry_log_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REAL_THANDLE_TELEMETRY_H
@@ -0,0 +1,10 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define thandle_telemetry_register          real_thandle_telemetry_register
+#define thandle_telemetry_unregister        real_thandle_telemetry_unregister
+#define thandle_telemetry_on_create         real_thandle_telemetry_on_create
+#define thandle_telemetry_on_free           real_thandle_telemetry_on_free
+#define thandle_telemetry_get_statistics    real_thandle_telemetry_get_statistics
+#define thandle_telemetry_enumerate         real_thandle_telemetry_enumerate
+#define thandle_telemetry_log_all           real_thandle_telemetry_log_all
@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REAL_TOKEN_BUCKET_H
+#define REAL_TOKEN_BUCKET_H
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_util/token_bucket.h"
+
+#define R2(X) REGISTER_GLOBAL_MOCK_HOOK(X, real_##X);
+
+#define REGISTER_TOKEN_BUCKET_GLOBAL_MOCK_HOOK()      \
+    MU_FOR_EACH_1(R2,                                 \
+        token_bucket_create,                          \
+        token_bucket_destroy,                         \
+        token_bucket_try_acquire,                     \
+        token_bucket_acquire                          \
+    )
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+TOKEN_BUCKET_HANDLE real_token_bucket_create(int64_t capacity, int64_t tokens_per_second);
+void real_token_bucket_destroy(TOKEN_BUCKET_HANDLE token_bucket);
+TOKEN_BUCKET_RESULT real_token_bucket_try_acquire(TOKEN_BUCKET_HANDLE token_bucket, int64_t count);
+TOKEN_BUCKET_RESULT real_token_bucket_acquire(TOKEN_BUCKET_HANDLE token_bucket, int64_t count, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //REAL_TOKEN_BUCKET_H
@@ -0,0 +1,9 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define token_bucket_create         real_token_bucket_create
+#define token_bucket_destroy        real_token_bucket_destroy
+#define token_bucket_try_acquire    real_token_bucket_try_acquire
+#define token_bucket_acquire        real_token_bucket_acquire
+
+#define TOKEN_BUCKET_RESULT         real_TOKEN_BUCKET_RESULT
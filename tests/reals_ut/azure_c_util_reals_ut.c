@@ -11,9 +11,13 @@
 #include "../reals/real_constbuffer_array_batcher_nv.h"
 #include "../reals/real_doublylinkedlist.h"
 #include "../reals/real_interlocked_hl.h"
+#include "../reals/real_log_ratelimit.h"
+#include "../reals/real_memory_budget.h"
 #include "../reals/real_memory_data.h"
 #include "../reals/real_rc_string.h"
 #include "../reals/real_singlylinkedlist.h"
+#include "../reals/real_sm.h"
+#include "../reals/real_token_bucket.h"
 #include "../reals/real_uuid.h"
 
 #include "azure_c_util/constbuffer.h"
@@ -21,15 +25,14 @@
 #include "azure_c_util/constbuffer_array_batcher_nv.h"
 #include "azure_c_util/doublylinkedlist.h"
 #include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/log_ratelimit.h"
+#include "azure_c_util/memory_budget.h"
 #include "azure_c_util/memory_data.h"
 #include "azure_c_util/rc_string.h"
 #include "azure_c_util/singlylinkedlist.h"
-#include "azure_c_util/uuid.h"
-
-#if defined _MSC_VER
-#include "../reals/real_sm.h"
 #include "azure_c_util/sm.h"
-#endif
+#include "azure_c_util/token_bucket.h"
+#include "azure_c_util/uuid.h"
 
 BEGIN_TEST_SUITE(azure_c_util_reals_ut)
 
@@ -45,14 +48,14 @@ TEST_FUNCTION(check_all_c_util_reals)
     REGISTER_CONSTBUFFER_ARRAY_BATCHER_GLOBAL_MOCK_HOOK();
     REGISTER_DOUBLYLINKEDLIST_GLOBAL_MOCK_HOOKS();
     REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_LOG_RATELIMIT_GLOBAL_MOCK_HOOK();
+    REGISTER_MEMORY_BUDGET_GLOBAL_MOCK_HOOK();
     REGISTER_MEMORY_DATA_GLOBAL_MOCK_HOOK();
     REGISTER_RC_STRING_GLOBAL_MOCK_HOOKS();
     REGISTER_SINGLYLINKEDLIST_GLOBAL_MOCK_HOOKS();
-    REGISTER_UUID_GLOBAL_MOCK_HOOK();
-
-#if defined _MSC_VER
     REGISTER_SM_GLOBAL_MOCK_HOOK();
-#endif
+    REGISTER_TOKEN_BUCKET_GLOBAL_MOCK_HOOK();
+    REGISTER_UUID_GLOBAL_MOCK_HOOK();
 
     // assert
     // no explicit assert. if it builds, it works
@@ -0,0 +1,413 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_util/interlocked_hl.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+
+#include "azure_c_util/seqlock.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+typedef struct TEST_VALUE_TAG
+{
+    int32_t a;
+    int64_t b;
+    char c[16];
+} TEST_VALUE;
+
+SEQLOCK_TYPE_DECLARE(TEST_VALUE);
+SEQLOCK_TYPE_DEFINE(TEST_VALUE);
+
+static const TEST_VALUE g_value_1 = { 1, 2, "three" };
+static const TEST_VALUE g_value_2 = { 4, 5, "six" };
+
+static void TEST_SEQLOCK_INIT(SEQLOCK(TEST_VALUE)* seqlock, const TEST_VALUE* value)
+{
+    ASSERT_ARE_EQUAL(int, 0, SEQLOCK_INIT(TEST_VALUE)(seqlock, value));
+    umock_c_reset_all_calls();
+}
+
+BEGIN_TEST_SUITE(seqlock_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_bool_register_types());
+
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* SEQLOCK_INIT */
+
+/*Tests_SRS_SEQLOCK_02_001: [ If seqlock is NULL then SEQLOCK_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(SEQLOCK_INIT_with_seqlock_NULL_fails)
+{
+    ///arrange
+    int result;
+
+    ///act
+    result = SEQLOCK_INIT(TEST_VALUE)(NULL, &g_value_1);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_002: [ If value is NULL then SEQLOCK_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(SEQLOCK_INIT_with_value_NULL_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+
+    ///act
+    result = SEQLOCK_INIT(TEST_VALUE)(&seqlock, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_003: [ SEQLOCK_INIT shall call InterlockedHL_SeqLockInit. ]*/
+/*Tests_SRS_SEQLOCK_02_005: [ SEQLOCK_INIT shall copy value in seqlock, succeed and return 0. ]*/
+TEST_FUNCTION(SEQLOCK_INIT_succeeds)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockInit(&seqlock.seqlock));
+
+    ///act
+    result = SEQLOCK_INIT(TEST_VALUE)(&seqlock, &g_value_1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(&g_value_1, &seqlock.value, sizeof(TEST_VALUE)));
+    ASSERT_ARE_EQUAL(int32_t, 0, seqlock.seqlock.sequence);
+}
+
+/*Tests_SRS_SEQLOCK_02_004: [ If InterlockedHL_SeqLockInit fails then SEQLOCK_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_InterlockedHL_SeqLockInit_fails_SEQLOCK_INIT_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockInit(&seqlock.seqlock))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = SEQLOCK_INIT(TEST_VALUE)(&seqlock, &g_value_1);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* SEQLOCK_READ */
+
+/*Tests_SRS_SEQLOCK_02_006: [ If seqlock is NULL then SEQLOCK_READ shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(SEQLOCK_READ_with_seqlock_NULL_fails)
+{
+    ///arrange
+    int result;
+    TEST_VALUE value;
+
+    ///act
+    result = SEQLOCK_READ(TEST_VALUE)(NULL, &value);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_007: [ If value is NULL then SEQLOCK_READ shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(SEQLOCK_READ_with_value_NULL_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    ///act
+    result = SEQLOCK_READ(TEST_VALUE)(&seqlock, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_008: [ SEQLOCK_READ shall call InterlockedHL_SeqLockReadBegin. ]*/
+/*Tests_SRS_SEQLOCK_02_010: [ SEQLOCK_READ shall copy the value of seqlock in value. ]*/
+/*Tests_SRS_SEQLOCK_02_011: [ SEQLOCK_READ shall call InterlockedHL_SeqLockReadRetry. ]*/
+/*Tests_SRS_SEQLOCK_02_012: [ If InterlockedHL_SeqLockReadRetry returns INTERLOCKED_HL_OK then SEQLOCK_READ shall succeed and return 0. ]*/
+TEST_FUNCTION(SEQLOCK_READ_succeeds)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_VALUE value;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadBegin(&seqlock.seqlock, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadRetry(&seqlock.seqlock, 0));
+
+    ///act
+    result = SEQLOCK_READ(TEST_VALUE)(&seqlock, &value);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(&g_value_1, &value, sizeof(TEST_VALUE)));
+}
+
+/*Tests_SRS_SEQLOCK_02_013: [ If InterlockedHL_SeqLockReadRetry returns INTERLOCKED_HL_CHANGED then SEQLOCK_READ shall read the value again. ]*/
+TEST_FUNCTION(SEQLOCK_READ_reads_again_when_a_writer_changed_the_value)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_VALUE value;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadBegin(&seqlock.seqlock, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadRetry(&seqlock.seqlock, 0))
+        .SetReturn(INTERLOCKED_HL_CHANGED);
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadBegin(&seqlock.seqlock, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadRetry(&seqlock.seqlock, 0));
+
+    ///act
+    result = SEQLOCK_READ(TEST_VALUE)(&seqlock, &value);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(&g_value_1, &value, sizeof(TEST_VALUE)));
+}
+
+/*Tests_SRS_SEQLOCK_02_009: [ If InterlockedHL_SeqLockReadBegin fails then SEQLOCK_READ shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_InterlockedHL_SeqLockReadBegin_fails_SEQLOCK_READ_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_VALUE value;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadBegin(&seqlock.seqlock, IGNORED_ARG))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = SEQLOCK_READ(TEST_VALUE)(&seqlock, &value);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_014: [ If InterlockedHL_SeqLockReadRetry fails then SEQLOCK_READ shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_InterlockedHL_SeqLockReadRetry_fails_SEQLOCK_READ_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_VALUE value;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadBegin(&seqlock.seqlock, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadRetry(&seqlock.seqlock, 0))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = SEQLOCK_READ(TEST_VALUE)(&seqlock, &value);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* SEQLOCK_WRITE */
+
+/*Tests_SRS_SEQLOCK_02_015: [ If seqlock is NULL then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(SEQLOCK_WRITE_with_seqlock_NULL_fails)
+{
+    ///arrange
+    int result;
+
+    ///act
+    result = SEQLOCK_WRITE(TEST_VALUE)(NULL, &g_value_2);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_016: [ If value is NULL then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(SEQLOCK_WRITE_with_value_NULL_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    ///act
+    result = SEQLOCK_WRITE(TEST_VALUE)(&seqlock, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_017: [ SEQLOCK_WRITE shall call InterlockedHL_SeqLockWriteBegin. ]*/
+/*Tests_SRS_SEQLOCK_02_019: [ SEQLOCK_WRITE shall copy value in seqlock. ]*/
+/*Tests_SRS_SEQLOCK_02_020: [ SEQLOCK_WRITE shall call InterlockedHL_SeqLockWriteEnd. ]*/
+/*Tests_SRS_SEQLOCK_02_022: [ SEQLOCK_WRITE shall succeed and return 0. ]*/
+TEST_FUNCTION(SEQLOCK_WRITE_succeeds)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockWriteBegin(&seqlock.seqlock));
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockWriteEnd(&seqlock.seqlock));
+
+    ///act
+    result = SEQLOCK_WRITE(TEST_VALUE)(&seqlock, &g_value_2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(&g_value_2, &seqlock.value, sizeof(TEST_VALUE)));
+    ASSERT_ARE_EQUAL(int32_t, 2, seqlock.seqlock.sequence);
+}
+
+/*Tests_SRS_SEQLOCK_02_018: [ If InterlockedHL_SeqLockWriteBegin fails then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_InterlockedHL_SeqLockWriteBegin_fails_SEQLOCK_WRITE_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockWriteBegin(&seqlock.seqlock))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = SEQLOCK_WRITE(TEST_VALUE)(&seqlock, &g_value_2);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(&g_value_1, &seqlock.value, sizeof(TEST_VALUE)));
+}
+
+/*Tests_SRS_SEQLOCK_02_021: [ If InterlockedHL_SeqLockWriteEnd fails then SEQLOCK_WRITE shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_InterlockedHL_SeqLockWriteEnd_fails_SEQLOCK_WRITE_fails)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockWriteBegin(&seqlock.seqlock));
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockWriteEnd(&seqlock.seqlock))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = SEQLOCK_WRITE(TEST_VALUE)(&seqlock, &g_value_2);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SEQLOCK_02_010: [ SEQLOCK_READ shall copy the value of seqlock in value. ]*/
+TEST_FUNCTION(SEQLOCK_READ_after_SEQLOCK_WRITE_reads_the_written_value)
+{
+    ///arrange
+    int result;
+    SEQLOCK(TEST_VALUE) seqlock;
+    TEST_VALUE value;
+    TEST_SEQLOCK_INIT(&seqlock, &g_value_1);
+    ASSERT_ARE_EQUAL(int, 0, SEQLOCK_WRITE(TEST_VALUE)(&seqlock, &g_value_2));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadBegin(&seqlock.seqlock, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_SeqLockReadRetry(&seqlock.seqlock, 2));
+
+    ///act
+    result = SEQLOCK_READ(TEST_VALUE)(&seqlock, &value);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(&g_value_2, &value, sizeof(TEST_VALUE)));
+}
+
+END_TEST_SUITE(seqlock_unittests)
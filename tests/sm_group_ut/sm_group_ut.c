@@ -0,0 +1,725 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/sm.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+#include "real_gballoc_hl.h"
+
+#include "azure_c_util/sm_group.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(SM_RESULT, SM_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(SM_RESULT, SM_RESULT_VALUES);
+
+#define TEST_CHILD_COUNT 3
+
+#define TEST_SM_1 ((SM_HANDLE)0x4201)
+#define TEST_SM_2 ((SM_HANDLE)0x4202)
+#define TEST_SM_3 ((SM_HANDLE)0x4203)
+
+static SM_HANDLE g_children[TEST_CHILD_COUNT] = { TEST_SM_1, TEST_SM_2, TEST_SM_3 };
+
+static bool g_drain_immediately; /*when true the children drain from sm_close_begin_async/sm_barrier_begin_async (like a child that has no executing APIs), otherwise the drains are deferred*/
+static uint32_t g_deferred_drain_count;
+static SM_ON_DRAINED_FUNC g_deferred_on_drained[TEST_CHILD_COUNT];
+static void* g_deferred_on_drained_context[TEST_CHILD_COUNT];
+
+static SM_RESULT hook_sm_begin_async(SM_HANDLE sm, SM_ON_DRAINED_FUNC on_drained, void* context)
+{
+    (void)sm;
+    if (g_drain_immediately)
+    {
+        on_drained(context);
+    }
+    else
+    {
+        ASSERT_IS_TRUE(g_deferred_drain_count < TEST_CHILD_COUNT);
+        g_deferred_on_drained[g_deferred_drain_count] = on_drained;
+        g_deferred_on_drained_context[g_deferred_drain_count] = context;
+        g_deferred_drain_count++;
+    }
+    return SM_EXEC_GRANTED;
+}
+
+/*drains all the deferred children (like the threads calling the last sm_exec_end of every child would do) before waiting*/
+static INTERLOCKED_HL_RESULT hook_InterlockedHL_WaitForValue_drains_all(int32_t volatile_atomic* address, int32_t value, uint32_t milliseconds)
+{
+    for (uint32_t i = 0; i < g_deferred_drain_count; i++)
+    {
+        g_deferred_on_drained[i](g_deferred_on_drained_context[i]);
+    }
+    g_deferred_drain_count = 0;
+    return real_InterlockedHL_WaitForValue(address, value, milliseconds);
+}
+
+static SM_GROUP_HANDLE TEST_sm_group_create(void)
+{
+    SM_GROUP_HANDLE result;
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    result = sm_group_create(g_children, TEST_CHILD_COUNT);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static SM_GROUP_HANDLE TEST_sm_group_create_and_closed(void)
+{
+    SM_GROUP_HANDLE result = TEST_sm_group_create();
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_group_close_begin(result));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static SM_GROUP_HANDLE TEST_sm_group_create_and_barriered(void)
+{
+    SM_GROUP_HANDLE result = TEST_sm_group_create();
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_group_barrier_begin(result));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(sm_group_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    ASSERT_ARE_EQUAL(int, 0, real_gballoc_hl_init(NULL, NULL));
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    umocktypes_stdint_register_types();
+    umocktypes_bool_register_types();
+
+    REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_GLOBAL_MOCK_HOOK(sm_close_begin_async, hook_sm_begin_async);
+    REGISTER_GLOBAL_MOCK_HOOK(sm_barrier_begin_async, hook_sm_begin_async);
+    REGISTER_GLOBAL_MOCK_RETURNS(sm_open_begin, SM_EXEC_GRANTED, SM_EXEC_REFUSED);
+
+    REGISTER_UMOCK_ALIAS_TYPE(SM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SM_ON_DRAINED_FUNC, void*);
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+    REGISTER_TYPE(SM_RESULT, SM_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+
+    real_gballoc_hl_deinit();
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_drain_immediately = true;
+    g_deferred_drain_count = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForValue, real_InterlockedHL_WaitForValue);
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_SM_GROUP_02_001: [ If children is NULL then sm_group_create shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_group_create_with_children_NULL_fails)
+{
+    ///arrange
+
+    ///act
+    SM_GROUP_HANDLE group = sm_group_create(NULL, TEST_CHILD_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(group);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_002: [ If child_count is 0 then sm_group_create shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_group_create_with_child_count_0_fails)
+{
+    ///arrange
+
+    ///act
+    SM_GROUP_HANDLE group = sm_group_create(g_children, 0);
+
+    ///assert
+    ASSERT_IS_NULL(group);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_003: [ If any of the children is NULL then sm_group_create shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_group_create_with_a_NULL_child_fails)
+{
+    ///arrange
+    SM_HANDLE children[TEST_CHILD_COUNT] = { TEST_SM_1, NULL, TEST_SM_3 };
+
+    ///act
+    SM_GROUP_HANDLE group = sm_group_create(children, TEST_CHILD_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(group);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_004: [ sm_group_create shall allocate memory for the group and copy the children handles. ]*/
+TEST_FUNCTION(sm_group_create_succeeds)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    SM_GROUP_HANDLE group = sm_group_create(g_children, TEST_CHILD_COUNT);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(group);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_005: [ If there are any failures then sm_group_create shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_group_create_when_malloc_fails_it_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    SM_GROUP_HANDLE group = sm_group_create(g_children, TEST_CHILD_COUNT);
+
+    ///assert
+    ASSERT_IS_NULL(group);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_006: [ If group is NULL then sm_group_destroy shall return. ]*/
+TEST_FUNCTION(sm_group_destroy_with_group_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    sm_group_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_018: [ sm_group_destroy shall free the memory used by the group. The children are not destroyed. ]*/
+TEST_FUNCTION(sm_group_destroy_frees_the_group)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+
+    STRICT_EXPECTED_CALL(free(group));
+
+    ///act
+    sm_group_destroy(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_007: [ If group is NULL then sm_group_close_begin shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_group_close_begin_with_group_NULL_fails)
+{
+    ///arrange
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_009: [ sm_group_close_begin shall call sm_close_begin_async on every child. ]*/
+/*Tests_SRS_SM_GROUP_02_011: [ sm_group_close_begin shall return SM_EXEC_GRANTED. ]*/
+TEST_FUNCTION(sm_group_close_begin_when_all_children_are_drained_succeeds)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_3, IGNORED_ARG, group));
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_close_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_009: [ sm_group_close_begin shall call sm_close_begin_async on every child. ]*/
+/*Tests_SRS_SM_GROUP_02_010: [ sm_group_close_begin shall wait for all the children that granted to drain. ]*/
+/*Tests_SRS_SM_GROUP_02_012: [ When the last child drains, the thread waiting in sm_group_close_begin/sm_group_barrier_begin shall be woken up. ]*/
+/*Tests_SRS_SM_GROUP_02_011: [ sm_group_close_begin shall return SM_EXEC_GRANTED. ]*/
+TEST_FUNCTION(sm_group_close_begin_waits_for_all_the_children_to_drain)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+    g_drain_immediately = false;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForValue, hook_InterlockedHL_WaitForValue_drains_all);
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_3, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_deferred_drain_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_close_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_013: [ If waiting fails then sm_group_close_begin shall return SM_ERROR. ]*/
+TEST_FUNCTION(sm_group_close_begin_when_waiting_fails_it_fails)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+    g_drain_immediately = false;
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_3, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_024: [ If a previous group _begin returned SM_ERROR then sm_group_close_begin shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_group_close_begin_after_waiting_failed_refuses)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+    g_drain_immediately = false;
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_3, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, sm_group_close_begin(group));
+    umock_c_reset_all_calls();
+
+    ///act
+    SM_RESULT result1 = sm_group_close_begin(group);
+    SM_RESULT result2 = sm_group_barrier_begin(group);
+    sm_group_close_end(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result1);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_023: [ If a child refuses then sm_group_close_begin shall not call sm_close_begin_async on the remaining children. ]*/
+/*Tests_SRS_SM_GROUP_02_014: [ If any child refused then sm_group_close_begin shall call sm_close_end, sm_open_begin and sm_open_end (with success true) on the children that granted and return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_group_close_begin_when_a_child_refuses_it_reopens_the_others_and_refuses)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group))
+        .SetReturn(SM_EXEC_REFUSED);
+    STRICT_EXPECTED_CALL(sm_close_end(TEST_SM_1));
+    STRICT_EXPECTED_CALL(sm_open_begin(TEST_SM_1));
+    STRICT_EXPECTED_CALL(sm_open_end(TEST_SM_1, true));
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_014: [ If any child refused then sm_group_close_begin shall call sm_close_end, sm_open_begin and sm_open_end (with success true) on the children that granted and return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_group_close_begin_when_a_child_refuses_and_reopening_another_child_is_refused_it_refuses)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_3, IGNORED_ARG, group))
+        .SetReturn(SM_EXEC_REFUSED);
+    STRICT_EXPECTED_CALL(sm_close_end(TEST_SM_1));
+    STRICT_EXPECTED_CALL(sm_open_begin(TEST_SM_1))
+        .SetReturn(SM_EXEC_REFUSED); /*another thread opened it meanwhile*/
+    STRICT_EXPECTED_CALL(sm_close_end(TEST_SM_2));
+    STRICT_EXPECTED_CALL(sm_open_begin(TEST_SM_2));
+    STRICT_EXPECTED_CALL(sm_open_end(TEST_SM_2, true));
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_023: [ If a child refuses then sm_group_close_begin shall not call sm_close_begin_async on the remaining children. ]*/
+TEST_FUNCTION(sm_group_close_begin_after_a_refusal_can_be_called_again)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group))
+        .SetReturn(SM_EXEC_REFUSED);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_group_close_begin(group));
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_3, IGNORED_ARG, group));
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_close_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_008: [ If another group operation is in progress then sm_group_close_begin shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_group_close_begin_after_close_begin_refuses)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_closed();
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_close_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_008: [ If another group operation is in progress then sm_group_close_begin shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_group_close_begin_after_barrier_begin_refuses)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_barriered();
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_barrier_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_015: [ If group is NULL then sm_group_close_end shall return. ]*/
+TEST_FUNCTION(sm_group_close_end_with_group_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    sm_group_close_end(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_016: [ If sm_group_close_begin was not granted then sm_group_close_end shall return. ]*/
+TEST_FUNCTION(sm_group_close_end_without_close_begin_returns)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+
+    ///act
+    sm_group_close_end(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_016: [ If sm_group_close_begin was not granted then sm_group_close_end shall return. ]*/
+TEST_FUNCTION(sm_group_close_end_after_barrier_begin_returns)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_barriered();
+
+    ///act
+    sm_group_close_end(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_barrier_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_017: [ sm_group_close_end shall call sm_close_end on every child. ]*/
+TEST_FUNCTION(sm_group_close_end_ends_the_close_of_every_child)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_closed();
+
+    STRICT_EXPECTED_CALL(sm_close_end(TEST_SM_1));
+    STRICT_EXPECTED_CALL(sm_close_end(TEST_SM_2));
+    STRICT_EXPECTED_CALL(sm_close_end(TEST_SM_3));
+
+    ///act
+    sm_group_close_end(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_017: [ sm_group_close_end shall call sm_close_end on every child. ]*/
+TEST_FUNCTION(sm_group_close_begin_after_close_end_succeeds)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_closed();
+    sm_group_close_end(group);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_close_begin_async(TEST_SM_3, IGNORED_ARG, group));
+
+    ///act
+    SM_RESULT result = sm_group_close_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_close_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_019: [ If group is NULL then sm_group_barrier_begin shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_group_barrier_begin_with_group_NULL_fails)
+{
+    ///arrange
+
+    ///act
+    SM_RESULT result = sm_group_barrier_begin(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_020: [ sm_group_barrier_begin shall behave as sm_group_close_begin, except that it shall call sm_barrier_begin_async instead of sm_close_begin_async and, on the children that granted when another child refused, sm_barrier_end. ]*/
+TEST_FUNCTION(sm_group_barrier_begin_waits_for_all_the_children_to_drain)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+    g_drain_immediately = false;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForValue, hook_InterlockedHL_WaitForValue_drains_all);
+
+    STRICT_EXPECTED_CALL(sm_barrier_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_barrier_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_barrier_begin_async(TEST_SM_3, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
+
+    ///act
+    SM_RESULT result = sm_group_barrier_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_deferred_drain_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_barrier_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_020: [ sm_group_barrier_begin shall behave as sm_group_close_begin, except that it shall call sm_barrier_begin_async instead of sm_close_begin_async and, on the children that granted when another child refused, sm_barrier_end. ]*/
+TEST_FUNCTION(sm_group_barrier_begin_when_a_child_refuses_it_ends_the_others_and_refuses)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create();
+
+    STRICT_EXPECTED_CALL(sm_barrier_begin_async(TEST_SM_1, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_barrier_begin_async(TEST_SM_2, IGNORED_ARG, group));
+    STRICT_EXPECTED_CALL(sm_barrier_begin_async(TEST_SM_3, IGNORED_ARG, group))
+        .SetReturn(SM_EXEC_REFUSED);
+    STRICT_EXPECTED_CALL(sm_barrier_end(TEST_SM_1));
+    STRICT_EXPECTED_CALL(sm_barrier_end(TEST_SM_2));
+
+    ///act
+    SM_RESULT result = sm_group_barrier_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_020: [ sm_group_barrier_begin shall behave as sm_group_close_begin, except that it shall call sm_barrier_begin_async instead of sm_close_begin_async and, on the children that granted when another child refused, sm_barrier_end. ]*/
+TEST_FUNCTION(sm_group_barrier_begin_after_barrier_begin_refuses)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_barriered();
+
+    ///act
+    SM_RESULT result = sm_group_barrier_begin(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_barrier_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_021: [ If group is NULL then sm_group_barrier_end shall return. ]*/
+TEST_FUNCTION(sm_group_barrier_end_with_group_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    sm_group_barrier_end(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_GROUP_02_022: [ sm_group_barrier_end shall behave as sm_group_close_end, except that it shall call sm_barrier_end instead of sm_close_end. ]*/
+TEST_FUNCTION(sm_group_barrier_end_after_close_begin_returns)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_closed();
+
+    ///act
+    sm_group_barrier_end(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_close_end(group);
+    sm_group_destroy(group);
+}
+
+/*Tests_SRS_SM_GROUP_02_022: [ sm_group_barrier_end shall behave as sm_group_close_end, except that it shall call sm_barrier_end instead of sm_close_end. ]*/
+TEST_FUNCTION(sm_group_barrier_end_ends_the_barrier_of_every_child)
+{
+    ///arrange
+    SM_GROUP_HANDLE group = TEST_sm_group_create_and_barriered();
+
+    STRICT_EXPECTED_CALL(sm_barrier_end(TEST_SM_1));
+    STRICT_EXPECTED_CALL(sm_barrier_end(TEST_SM_2));
+    STRICT_EXPECTED_CALL(sm_barrier_end(TEST_SM_3));
+
+    ///act
+    sm_group_barrier_end(group);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_group_destroy(group);
+}
+
+END_TEST_SUITE(sm_group_unittests)
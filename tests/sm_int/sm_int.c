@@ -1074,4 +1074,251 @@ TEST_FUNCTION(STATE_and_API)
     }
 }
 
+#define DESTROY_AFTER_CLOSE_ITERATIONS 10000
+
+typedef struct EXEC_END_THREADS_TAG
+{
+    SM_HANDLE sm;
+    HANDLE threads[N_MAX_THREADS];
+    uint32_t n_threads;
+}EXEC_END_THREADS;
+
+static DWORD WINAPI callsExecEnd(
+    LPVOID lpThreadParameter
+)
+{
+    EXEC_END_THREADS* data = (EXEC_END_THREADS*)lpThreadParameter;
+    sm_exec_end(data->sm);
+    return 0;
+}
+
+static void closes_and_destroys(void* context)
+{
+    SM_HANDLE sm = (SM_HANDLE)context;
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*sm_destroy is called as soon as sm_close_begin returns (or from on_drained of sm_close_begin_async), while the sm_exec_end calls that let the drain finish might still be running. Neither sm_exec_end nor sm_close_begin_async are allowed to touch sm after that (a memory checker flags the test otherwise)*/
+static void destroy_right_after_sm_close_begin(const SM_OPTIONS* options, bool use_async)
+{
+    EXEC_END_THREADS* data = (EXEC_END_THREADS*)malloc(sizeof(EXEC_END_THREADS));
+    ASSERT_IS_NOT_NULL(data);
+    data->n_threads = dwNumberOfProcessors;
+
+    for (uint32_t iteration = 0; iteration < DESTROY_AFTER_CLOSE_ITERATIONS; iteration++)
+    {
+        data->sm = sm_create_with_options(NULL, options);
+        ASSERT_IS_NOT_NULL(data->sm);
+        ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(data->sm));
+        sm_open_end(data->sm, true);
+
+        for (uint32_t i = 0; i < data->n_threads; i++)
+        {
+            ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(data->sm));
+        }
+
+        for (uint32_t i = 0; i < data->n_threads; i++)
+        {
+            data->threads[i] = CreateThread(NULL, 0, callsExecEnd, data, 0, NULL);
+            ASSERT_IS_NOT_NULL(data->threads[i]);
+        }
+
+        if (use_async)
+        {
+            ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_close_begin_async(data->sm, closes_and_destroys, data->sm));
+        }
+        else
+        {
+            ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_close_begin(data->sm));
+            closes_and_destroys(data->sm);
+        }
+
+        DWORD dw = WaitForMultipleObjects(data->n_threads, data->threads, TRUE, INFINITE);
+        ASSERT_IS_TRUE((WAIT_OBJECT_0 <= dw) && (dw <= WAIT_OBJECT_0 + data->n_threads));
+
+        for (uint32_t i = 0; i < data->n_threads; i++)
+        {
+            (void)CloseHandle(data->threads[i]);
+        }
+    }
+
+    free(data);
+}
+
+TEST_FUNCTION(sm_destroy_right_after_sm_close_begin_while_execs_end)
+{
+    SM_OPTIONS options = { false, 0 };
+    destroy_right_after_sm_close_begin(&options, false);
+}
+
+TEST_FUNCTION(sm_destroy_from_on_drained_of_sm_close_begin_async_while_execs_end)
+{
+    SM_OPTIONS options = { false, 0 };
+    destroy_right_after_sm_close_begin(&options, true);
+}
+
+TEST_FUNCTION(sm_sharded_destroy_right_after_sm_close_begin_while_execs_end)
+{
+    SM_OPTIONS options = { true, 0 };
+    destroy_right_after_sm_close_begin(&options, false);
+}
+
+TEST_FUNCTION(sm_sharded_destroy_from_on_drained_of_sm_close_begin_async_while_execs_end)
+{
+    SM_OPTIONS options = { true, 0 };
+    destroy_right_after_sm_close_begin(&options, true);
+}
+
+TEST_FUNCTION(sm_capped_destroy_right_after_sm_close_begin_while_execs_end)
+{
+    SM_OPTIONS options = { false, 0, dwNumberOfProcessors, true }; /*every execution held by destroy_right_after_sm_close_begin fits*/
+    destroy_right_after_sm_close_begin(&options, false);
+}
+
+TEST_FUNCTION(sm_capped_destroy_from_on_drained_of_sm_close_begin_async_while_execs_end)
+{
+    SM_OPTIONS options = { false, 0, dwNumberOfProcessors, true }; /*every execution held by destroy_right_after_sm_close_begin fits*/
+    destroy_right_after_sm_close_begin(&options, true);
+}
+
+#define LATENCY_TEST_ITERATIONS 10000000
+
+/*the protocol used by sm_exec_begin/sm_exec_end before state and n were packed in the same 64 bit word, kept here only as a reference for the latency test*/
+typedef struct TWO_WORDS_SM_TAG
+{
+    volatile LONG state;
+    volatile LONG n;
+}TWO_WORDS_SM;
+
+static bool two_words_exec_begin(TWO_WORDS_SM* sm)
+{
+    bool result;
+    LONG state1 = InterlockedAdd(&sm->state, 0);
+    (void)InterlockedIncrement(&sm->n);
+    LONG state2 = InterlockedAdd(&sm->state, 0);
+    if (state1 != state2)
+    {
+        if (InterlockedDecrement(&sm->n) == 0)
+        {
+            WakeByAddressSingle((void*)&sm->n);
+        }
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
+    return result;
+}
+
+static void two_words_exec_end(TWO_WORDS_SM* sm)
+{
+    (void)InterlockedAdd(&sm->state, 0);
+    do
+    {
+        LONG n = InterlockedAdd(&sm->n, 0);
+        if (n <= 0)
+        {
+            break;
+        }
+        if (InterlockedCompareExchange(&sm->n, n - 1, n) == n)
+        {
+            break;
+        }
+    } while (1);
+}
+
+/*measures the uncontended latency of a sm_exec_begin/sm_exec_end pair. The numbers are only logged.*/
+TEST_FUNCTION(sm_exec_uncontended_latency)
+{
+    ///arrange
+    SM_OPTIONS sharded_options = { true, 0 };
+    SM_HANDLE sm_packed = sm_create(NULL);
+    ASSERT_IS_NOT_NULL(sm_packed);
+    SM_HANDLE sm_sharded = sm_create_with_options(NULL, &sharded_options);
+    ASSERT_IS_NOT_NULL(sm_sharded);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(sm_packed));
+    sm_open_end(sm_packed, true);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(sm_sharded));
+    sm_open_end(sm_sharded, true);
+    TWO_WORDS_SM two_words = { 0, 0 };
+
+    ///act
+    double start = timer_global_get_elapsed_ms();
+    for (uint32_t i = 0; i < LATENCY_TEST_ITERATIONS; i++)
+    {
+        ASSERT_IS_TRUE(two_words_exec_begin(&two_words));
+        two_words_exec_end(&two_words);
+    }
+    double two_words_ms = timer_global_get_elapsed_ms() - start;
+
+    start = timer_global_get_elapsed_ms();
+    for (uint32_t i = 0; i < LATENCY_TEST_ITERATIONS; i++)
+    {
+        ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm_packed));
+        sm_exec_end(sm_packed);
+    }
+    double packed_ms = timer_global_get_elapsed_ms() - start;
+
+    start = timer_global_get_elapsed_ms();
+    for (uint32_t i = 0; i < LATENCY_TEST_ITERATIONS; i++)
+    {
+        ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm_sharded));
+        sm_exec_end(sm_sharded);
+    }
+    double sharded_ms = timer_global_get_elapsed_ms() - start;
+
+    ///assert
+    LogInfo("uncontended sm_exec_begin/sm_exec_end: state and n in 2 words (previous protocol) %.2f ns, state and n in 1 word %.2f ns, sharded n %.2f ns",
+        two_words_ms * 1000000 / LATENCY_TEST_ITERATIONS,
+        packed_ms * 1000000 / LATENCY_TEST_ITERATIONS,
+        sharded_ms * 1000000 / LATENCY_TEST_ITERATIONS);
+
+    ///clean
+    sm_destroy(sm_sharded);
+    sm_destroy(sm_packed);
+}
+
+#define BATCH_SIZE 256
+
+/*measures the per-item cost of bracketing BATCH_SIZE items with 1 sm_exec_begin_n/sm_exec_end_n pair compared to 1 sm_exec_begin/sm_exec_end pair per item. The numbers are only logged.*/
+TEST_FUNCTION(sm_exec_begin_n_amortized_latency)
+{
+    ///arrange
+    SM_HANDLE sm = sm_create(NULL);
+    ASSERT_IS_NOT_NULL(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(sm));
+    sm_open_end(sm, true);
+
+    ///act
+    double start = timer_global_get_elapsed_ms();
+    for (uint32_t i = 0; i < LATENCY_TEST_ITERATIONS; i++)
+    {
+        ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+        sm_exec_end(sm);
+    }
+    double per_item_ms = timer_global_get_elapsed_ms() - start;
+
+    start = timer_global_get_elapsed_ms();
+    for (uint32_t i = 0; i < LATENCY_TEST_ITERATIONS / BATCH_SIZE; i++)
+    {
+        ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin_n(sm, BATCH_SIZE));
+        sm_exec_end_n(sm, BATCH_SIZE);
+    }
+    double batched_ms = timer_global_get_elapsed_ms() - start;
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_close_begin(sm)); /*all granted executions have been ended*/
+    sm_close_end(sm);
+
+    LogInfo("per item cost: sm_exec_begin/sm_exec_end %.2f ns, sm_exec_begin_n/sm_exec_end_n with %d items %.2f ns",
+        per_item_ms * 1000000 / LATENCY_TEST_ITERATIONS,
+        BATCH_SIZE,
+        batched_ms * 1000000 / ((LATENCY_TEST_ITERATIONS / BATCH_SIZE) * BATCH_SIZE));
+
+    ///clean
+    sm_destroy(sm);
+}
+
 END_TEST_SUITE(sm_int_tests)
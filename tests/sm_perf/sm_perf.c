@@ -0,0 +1,286 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#else
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#include "testrunnerswitcher.h"
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_pal/threadapi.h"
+#include "azure_c_pal/timer.h"
+
+#include "azure_c_util/processor_index.h"
+#include "azure_c_util/sm.h"
+
+/*sm_perf measures how sm scales with the number of threads. It does not assert on the numbers (the machines running the tests are too different),
+it prints one CSV line per measurement on stdout so that the results of different builds can be compared by scripts:
+scenario,mode,threads,operations,elapsed_ms,operations_per_second,avg_latency_us,max_latency_us*/
+
+TEST_DEFINE_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(SM_RESULT, SM_RESULT_VALUES);
+
+#define SM_PERF_MAX_THREADS 64
+#define SM_PERF_MEASUREMENT_TIME_MS 1000 /*how long every throughput measurement runs*/
+#define SM_PERF_CLOSE_ITERATIONS 20 /*how many sm_close_begin are measured for every number of threads*/
+#define SM_PERF_TIME_BEFORE_CLOSE_MS 10 /*how long the exec threads run before sm_close_begin is called*/
+
+static uint32_t max_thread_count;
+
+typedef struct EXEC_THREAD_CONTEXT_TAG
+{
+    SM_HANDLE sm;
+    volatile_atomic int32_t* start; /*exec threads spin until this is 1, so they all start at the same time*/
+    volatile_atomic int32_t* stop; /*exec threads run until this is 1*/
+    bool stop_when_refused; /*when true, the thread also stops at the first refused sm_exec_begin*/
+    int64_t operations; /*number of granted sm_exec_begin/sm_exec_end pairs, read only after the thread was joined*/
+}EXEC_THREAD_CONTEXT;
+
+typedef struct EXEC_THREADS_TAG
+{
+    uint32_t thread_count;
+    THREAD_HANDLE threads[SM_PERF_MAX_THREADS];
+    EXEC_THREAD_CONTEXT contexts[SM_PERF_MAX_THREADS];
+    volatile_atomic int32_t start;
+    volatile_atomic int32_t stop;
+}EXEC_THREADS;
+
+static int exec_thread(void* arg)
+{
+    EXEC_THREAD_CONTEXT* context = (EXEC_THREAD_CONTEXT*)arg;
+    int64_t operations = 0;
+
+    while (interlocked_add(context->start, 0) == 0)
+    {
+        /*spin*/
+    }
+
+    while (interlocked_add(context->stop, 0) == 0)
+    {
+        if (sm_exec_begin(context->sm) == SM_EXEC_GRANTED)
+        {
+            sm_exec_end(context->sm);
+            operations++;
+        }
+        else if (context->stop_when_refused)
+        {
+            break;
+        }
+        else
+        {
+            /*keep trying*/
+        }
+    }
+
+    context->operations = operations;
+    return 0;
+}
+
+static void start_exec_threads(EXEC_THREADS* exec_threads, SM_HANDLE sm, uint32_t thread_count, bool stop_when_refused)
+{
+    exec_threads->thread_count = thread_count;
+    (void)interlocked_exchange(&exec_threads->start, 0);
+    (void)interlocked_exchange(&exec_threads->stop, 0);
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        exec_threads->contexts[i].sm = sm;
+        exec_threads->contexts[i].start = &exec_threads->start;
+        exec_threads->contexts[i].stop = &exec_threads->stop;
+        exec_threads->contexts[i].stop_when_refused = stop_when_refused;
+        exec_threads->contexts[i].operations = 0;
+        ASSERT_ARE_EQUAL(THREADAPI_RESULT, THREADAPI_OK, ThreadAPI_Create(&exec_threads->threads[i], exec_thread, &exec_threads->contexts[i]));
+    }
+    (void)interlocked_exchange(&exec_threads->start, 1);
+}
+
+/*returns the total number of granted sm_exec_begin/sm_exec_end pairs*/
+static int64_t stop_exec_threads(EXEC_THREADS* exec_threads)
+{
+    int64_t result = 0;
+    (void)interlocked_exchange(&exec_threads->stop, 1);
+    for (uint32_t i = 0; i < exec_threads->thread_count; i++)
+    {
+        int dont_care;
+        ASSERT_ARE_EQUAL(THREADAPI_RESULT, THREADAPI_OK, ThreadAPI_Join(exec_threads->threads[i], &dont_care));
+        result += exec_threads->contexts[i].operations;
+    }
+    return result;
+}
+
+static SM_HANDLE create_opened_sm(const SM_OPTIONS* options)
+{
+    SM_HANDLE result = sm_create_with_options("sm_perf", options);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(result));
+    sm_open_end(result, true);
+    return result;
+}
+
+static void print_csv_line(const char* scenario, const char* mode, uint32_t thread_count, int64_t operations, double elapsed_ms, double avg_latency_us, double max_latency_us)
+{
+    (void)printf("%s,%s,%" PRIu32 ",%" PRId64 ",%.3f,%.0f,%.3f,%.3f\n",
+        scenario, mode, thread_count, operations, elapsed_ms, (elapsed_ms > 0) ? (double)operations / elapsed_ms * 1000 : 0, avg_latency_us, max_latency_us);
+    (void)fflush(stdout);
+}
+
+/*thread counts are 1, 2, 4 ... up to twice the number of processors*/
+static uint32_t next_thread_count(uint32_t thread_count)
+{
+    return thread_count * 2;
+}
+
+static EXEC_THREADS exec_threads;
+
+BEGIN_TEST_SUITE(sm_perf)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    ASSERT_ARE_EQUAL(int, 0, gballoc_hl_init(NULL, NULL));
+
+    max_thread_count = processor_index_get_count() * 2;
+    if (max_thread_count > SM_PERF_MAX_THREADS)
+    {
+        LogInfo("limiting the number of threads to SM_PERF_MAX_THREADS=%d (processors=%" PRIu32 ")", SM_PERF_MAX_THREADS, processor_index_get_count());
+        max_thread_count = SM_PERF_MAX_THREADS;
+    }
+
+    (void)printf("scenario,mode,threads,operations,elapsed_ms,operations_per_second,avg_latency_us,max_latency_us\n");
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    gballoc_hl_deinit();
+}
+
+/*every thread calls sm_exec_begin/sm_exec_end in a loop for SM_PERF_MEASUREMENT_TIME_MS*/
+TEST_FUNCTION(sm_perf_exec_throughput)
+{
+    SM_OPTIONS options[] = { { false, 0 }, { true, 0 } };
+    const char* modes[] = { "shared", "sharded" };
+
+    for (uint32_t mode = 0; mode < sizeof(options) / sizeof(options[0]); mode++)
+    {
+        for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count = next_thread_count(thread_count))
+        {
+            ///arrange
+            SM_HANDLE sm = create_opened_sm(&options[mode]);
+
+            ///act
+            double start = timer_global_get_elapsed_ms();
+            start_exec_threads(&exec_threads, sm, thread_count, false);
+            ThreadAPI_Sleep(SM_PERF_MEASUREMENT_TIME_MS);
+            int64_t operations = stop_exec_threads(&exec_threads);
+            double elapsed_ms = timer_global_get_elapsed_ms() - start;
+
+            ///assert
+            print_csv_line("exec_throughput", modes[mode], thread_count, operations, elapsed_ms, 0, 0);
+
+            ///clean
+            sm_destroy(sm);
+        }
+    }
+}
+
+/*the exec threads call sm_exec_begin/sm_exec_end in a loop while the test thread calls sm_barrier_begin/sm_barrier_end in a loop. The latency is the time spent in sm_barrier_begin*/
+TEST_FUNCTION(sm_perf_barrier_latency)
+{
+    SM_OPTIONS options[] = { { false, 0 }, { true, 0 } };
+    const char* modes[] = { "shared", "sharded" };
+
+    for (uint32_t mode = 0; mode < sizeof(options) / sizeof(options[0]); mode++)
+    {
+        for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count = next_thread_count(thread_count))
+        {
+            ///arrange
+            SM_HANDLE sm = create_opened_sm(&options[mode]);
+            int64_t barriers = 0;
+            double total_latency_ms = 0;
+            double max_latency_ms = 0;
+
+            ///act
+            start_exec_threads(&exec_threads, sm, thread_count, false);
+            double start = timer_global_get_elapsed_ms();
+            double now = start;
+            while (now - start < SM_PERF_MEASUREMENT_TIME_MS)
+            {
+                double before = timer_global_get_elapsed_ms();
+                ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_barrier_begin(sm));
+                now = timer_global_get_elapsed_ms();
+                sm_barrier_end(sm);
+
+                total_latency_ms += now - before;
+                if (now - before > max_latency_ms)
+                {
+                    max_latency_ms = now - before;
+                }
+                barriers++;
+            }
+            double elapsed_ms = now - start;
+            (void)stop_exec_threads(&exec_threads);
+
+            ///assert
+            print_csv_line("barrier_latency", modes[mode], thread_count, barriers, elapsed_ms, (barriers > 0) ? total_latency_ms * 1000 / barriers : 0, max_latency_ms * 1000);
+
+            ///clean
+            sm_destroy(sm);
+        }
+    }
+}
+
+/*the exec threads call sm_exec_begin/sm_exec_end in a loop, then the test thread calls sm_close_begin. The latency is the time spent in sm_close_begin*/
+TEST_FUNCTION(sm_perf_close_latency)
+{
+    SM_OPTIONS options[] = { { false, 0 }, { true, 0 } };
+    const char* modes[] = { "shared", "sharded" };
+
+    for (uint32_t mode = 0; mode < sizeof(options) / sizeof(options[0]); mode++)
+    {
+        for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count = next_thread_count(thread_count))
+        {
+            double total_latency_ms = 0;
+            double max_latency_ms = 0;
+
+            for (uint32_t i = 0; i < SM_PERF_CLOSE_ITERATIONS; i++)
+            {
+                ///arrange
+                SM_HANDLE sm = create_opened_sm(&options[mode]);
+                start_exec_threads(&exec_threads, sm, thread_count, true); /*once close started, there is nothing left to do for the exec threads*/
+                ThreadAPI_Sleep(SM_PERF_TIME_BEFORE_CLOSE_MS);
+
+                ///act
+                double before = timer_global_get_elapsed_ms();
+                ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_close_begin(sm));
+                double latency_ms = timer_global_get_elapsed_ms() - before;
+
+                ///assert
+                total_latency_ms += latency_ms;
+                if (latency_ms > max_latency_ms)
+                {
+                    max_latency_ms = latency_ms;
+                }
+
+                ///clean
+                (void)stop_exec_threads(&exec_threads);
+                sm_close_end(sm);
+                sm_destroy(sm);
+            }
+
+            print_csv_line("close_latency", modes[mode], thread_count, SM_PERF_CLOSE_ITERATIONS, total_latency_ms, total_latency_ms * 1000 / SM_PERF_CLOSE_ITERATIONS, max_latency_ms * 1000);
+        }
+    }
+}
+
+END_TEST_SUITE(sm_perf)
@@ -0,0 +1,317 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/processor_index.h"
+#include "azure_c_pal/timer.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+#include "real_gballoc_hl.h"
+
+#include "azure_c_util/sm.h"
+
+/*sm_trace_ut runs with sm.c compiled with SM_TRACE. The calls sm.c makes are verified by sm_ut, here only the trace records are verified*/
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(SM_RESULT, SM_RESULT_VALUES);
+
+/*the states as sm.c keeps them (SM_STATE is not exported)*/
+#define TEST_SM_STATE_MASK                      0x7F
+#define TEST_SM_CREATED                         0
+#define TEST_SM_OPENING                         1
+#define TEST_SM_OPENED                          2
+#define TEST_SM_OPENED_DRAINING_TO_BARRIER      3
+#define TEST_SM_OPENED_DRAINING_TO_CLOSE        4
+#define TEST_SM_OPENED_BARRIER                  5
+#define TEST_SM_CLOSING                         6
+
+static double g_now_ms;
+
+static double hook_timer_global_get_elapsed_ms(void)
+{
+    g_now_ms += 1;
+    return g_now_ms;
+}
+
+static SM_HANDLE TEST_sm_create_and_opened(void)
+{
+    SM_HANDLE result = sm_create("a");
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(result));
+    sm_open_end(result, true);
+    return result;
+}
+
+static void ASSERT_TRACE_RECORD(const SM_TRACE_RECORD* record, int64_t sequence, int32_t old_state, int32_t new_state)
+{
+    ASSERT_ARE_EQUAL(int64_t, sequence, record->sequence);
+    ASSERT_ARE_EQUAL(int32_t, old_state, record->old_state & TEST_SM_STATE_MASK);
+    ASSERT_ARE_EQUAL(int32_t, new_state, record->new_state & TEST_SM_STATE_MASK);
+}
+
+BEGIN_TEST_SUITE(sm_trace_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    ASSERT_ARE_EQUAL(int, 0, real_gballoc_hl_init(NULL, NULL));
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    umocktypes_stdint_register_types();
+
+    REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_count, 1, 0);
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_current, 0, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(timer_global_get_elapsed_ms, hook_timer_global_get_elapsed_ms);
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+
+    real_gballoc_hl_deinit();
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    g_now_ms = 0;
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_SM_02_138: [ If sm.c is compiled with SM_TRACE then sm_create and sm_create_with_options shall initialize an empty trace of SM_TRACE_RECORD_COUNT records. ]*/
+/*Tests_SRS_SM_02_147: [ sm_trace_get shall succeed and return 0. ]*/
+TEST_FUNCTION(sm_trace_get_after_create_returns_0_records)
+{
+    ///arrange
+    SM_HANDLE sm = sm_create("a");
+    ASSERT_IS_NOT_NULL(sm);
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count = 42;
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, record_count);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_139: [ If sm.c is compiled with SM_TRACE then every state transition shall be recorded in the trace with the time, the state before and the state after. ]*/
+/*Tests_SRS_SM_02_145: [ sm_trace_get shall copy the most recent records of the trace in records, oldest first, and set record_count to the number of records copied. ]*/
+TEST_FUNCTION(sm_trace_get_returns_the_transitions_of_open)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_and_opened();
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint32_t, 2, record_count);
+    ASSERT_TRACE_RECORD(&records[0], 0, TEST_SM_CREATED, TEST_SM_OPENING);
+    ASSERT_TRACE_RECORD(&records[1], 1, TEST_SM_OPENING, TEST_SM_OPENED);
+    ASSERT_IS_TRUE(records[0].timestamp_ms < records[1].timestamp_ms);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_139: [ If sm.c is compiled with SM_TRACE then every state transition shall be recorded in the trace with the time, the state before and the state after. ]*/
+TEST_FUNCTION(sm_trace_get_returns_the_transitions_of_a_barrier)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_and_opened();
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_barrier_begin(sm));
+    sm_barrier_end(sm);
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint32_t, 5, record_count);
+    ASSERT_TRACE_RECORD(&records[2], 2, TEST_SM_OPENED, TEST_SM_OPENED_DRAINING_TO_BARRIER);
+    ASSERT_TRACE_RECORD(&records[3], 3, TEST_SM_OPENED_DRAINING_TO_BARRIER, TEST_SM_OPENED_BARRIER);
+    ASSERT_TRACE_RECORD(&records[4], 4, TEST_SM_OPENED_BARRIER, TEST_SM_OPENED);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_139: [ If sm.c is compiled with SM_TRACE then every state transition shall be recorded in the trace with the time, the state before and the state after. ]*/
+TEST_FUNCTION(sm_trace_get_returns_the_transitions_of_close)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_and_opened();
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_close_begin(sm));
+    sm_close_end(sm);
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint32_t, 5, record_count);
+    ASSERT_TRACE_RECORD(&records[2], 2, TEST_SM_OPENED, TEST_SM_OPENED_DRAINING_TO_CLOSE);
+    ASSERT_TRACE_RECORD(&records[3], 3, TEST_SM_OPENED_DRAINING_TO_CLOSE, TEST_SM_CLOSING);
+    ASSERT_TRACE_RECORD(&records[4], 4, TEST_SM_CLOSING, TEST_SM_CREATED);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_140: [ If sm.c is compiled with SM_TRACE then every sm_exec_begin/sm_exec_begin_n refused because of the state shall be recorded in the trace as a transition from the state to itself. ]*/
+TEST_FUNCTION(sm_trace_get_returns_the_refused_exec_begin)
+{
+    ///arrange
+    SM_HANDLE sm = sm_create("a");
+    ASSERT_IS_NOT_NULL(sm);
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_exec_begin(sm));
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint32_t, 1, record_count);
+    ASSERT_TRACE_RECORD(&records[0], 0, TEST_SM_CREATED, TEST_SM_CREATED);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_140: [ If sm.c is compiled with SM_TRACE then every sm_exec_begin/sm_exec_begin_n refused because of the state shall be recorded in the trace as a transition from the state to itself. ]*/
+TEST_FUNCTION(sm_trace_get_does_not_return_the_granted_exec_begin)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_and_opened();
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    sm_exec_end(sm);
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint32_t, 2, record_count);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_145: [ sm_trace_get shall copy the most recent records of the trace in records, oldest first, and set record_count to the number of records copied. ]*/
+TEST_FUNCTION(sm_trace_get_after_the_trace_wraps_around_returns_the_most_recent_records)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_and_opened();
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+    for (uint32_t i = 0; i < SM_TRACE_RECORD_COUNT; i++) /*3 records per barrier*/
+    {
+        ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_barrier_begin(sm));
+        sm_barrier_end(sm);
+    }
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint32_t, SM_TRACE_RECORD_COUNT, record_count);
+    int64_t first = 2 + 3 * SM_TRACE_RECORD_COUNT - SM_TRACE_RECORD_COUNT;
+    for (uint32_t i = 0; i < SM_TRACE_RECORD_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(int64_t, first + i, records[i].sequence);
+    }
+    ASSERT_TRACE_RECORD(&records[SM_TRACE_RECORD_COUNT - 1], first + SM_TRACE_RECORD_COUNT - 1, TEST_SM_OPENED_BARRIER, TEST_SM_OPENED);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_149: [ sm_trace_dump shall get the trace records as sm_trace_get does. ]*/
+/*Tests_SRS_SM_02_151: [ sm_trace_dump shall log every record, oldest first. ]*/
+TEST_FUNCTION(sm_trace_dump_succeeds)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_and_opened();
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_barrier_begin(sm));
+    sm_barrier_end(sm);
+
+    ///act
+    sm_trace_dump(sm);
+
+    ///assert
+    /*nothing to assert, the records are logged*/
+
+    ///clean
+    sm_destroy(sm);
+}
+
+END_TEST_SUITE(sm_trace_unittests)
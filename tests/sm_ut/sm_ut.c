@@ -22,6 +22,8 @@
 #include "azure_c_pal/gballoc_hl.h"
 #include "azure_c_pal/gballoc_hl_redirect.h"
 #include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/processor_index.h"
+#include "azure_c_pal/timer.h"
 #undef ENABLE_MOCKS
 
 #include "real_interlocked_hl.h"
@@ -56,6 +58,97 @@ static SM_HANDLE TEST_sm_create(void)
     return result;
 }
 
+#define TEST_SHARD_COUNT 4
+
+static SM_HANDLE g_sm_to_end_barrier; /*when InterlockedHL_WaitForNotValue is called, the barrier of this sm is ended (like another thread would do)*/
+
+static SM_HANDLE g_sm_to_end_exec; /*when InterlockedHL_WaitForNotValue64 is called, 1 execution of this sm is ended (like another thread would do)*/
+
+static INTERLOCKED_HL_RESULT hook_InterlockedHL_WaitForNotValue64_ends_exec(int64_t volatile_atomic* address, int64_t value, uint32_t milliseconds)
+{
+    sm_exec_end(g_sm_to_end_exec);
+    return real_InterlockedHL_WaitForNotValue64(address, value, milliseconds); /*the subtraction changed the word, so this returns without waiting*/
+}
+
+static uint32_t hook_processor_index_get_current_ends_exec(void)
+{
+    sm_exec_end(g_sm_to_end_exec);
+    return 0;
+}
+
+static SM_HANDLE g_sm_to_begin_barrier; /*when processor_index_get_current is called, sm_barrier_begin_async is called on this sm (like another thread would do)*/
+
+static void test_on_drained(void* context);
+
+static uint32_t hook_processor_index_get_current_begins_barrier_async(void)
+{
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_barrier_begin_async(g_sm_to_begin_barrier, test_on_drained, (void*)0x42));
+    return 0;
+}
+
+static INTERLOCKED_HL_RESULT hook_InterlockedHL_WaitForNotValue_ends_barrier(int32_t volatile_atomic* address, int32_t value, uint32_t milliseconds)
+{
+    sm_barrier_end(g_sm_to_end_barrier);
+    return real_InterlockedHL_WaitForNotValue(address, value, milliseconds);
+}
+
+static SM_HANDLE TEST_sm_create_sharded(void)
+{
+    SM_HANDLE result;
+    SM_OPTIONS options = { true, TEST_SHARD_COUNT };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    result = sm_create_with_options("a", &options);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static SM_HANDLE TEST_sm_create_capped_and_opened(uint32_t max_exec_count, bool wait_when_throttled)
+{
+    SM_HANDLE result;
+    SM_OPTIONS options = { false, 0, max_exec_count, wait_when_throttled };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    result = sm_create_with_options("a", &options);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(result));
+    sm_open_end(result, true);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static SM_HANDLE TEST_sm_create_with_statistics(void)
+{
+    SM_HANDLE result;
+    SM_OPTIONS options = { false, 0, 0, false, true };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    result = sm_create_with_options("a", &options);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static uint32_t g_on_drained_call_count;
+static void* g_on_drained_context;
+
+static void test_on_drained(void* context)
+{
+    g_on_drained_call_count++;
+    g_on_drained_context = context;
+}
+
+/*ends the barrier from the callback, as users are allowed to do*/
+static void test_on_drained_ends_barrier(void* context)
+{
+    test_on_drained(context);
+    sm_barrier_end((SM_HANDLE)context);
+}
+
 BEGIN_TEST_SUITE(sm_unittests)
 
 TEST_SUITE_INITIALIZE(setsBufferTempSize)
@@ -72,6 +165,9 @@ TEST_SUITE_INITIALIZE(setsBufferTempSize)
     REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
     REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
 
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_count, TEST_SHARD_COUNT, 0);
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_current, 0, 0);
+
     REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
     REGISTER_TYPE(SM_RESULT, SM_RESULT);
 }
@@ -93,6 +189,9 @@ TEST_FUNCTION_INITIALIZE(f)
     }
 
     umock_c_reset_all_calls();
+
+    g_on_drained_call_count = 0;
+    g_on_drained_context = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(cleans)
@@ -347,8 +446,6 @@ TEST_FUNCTION(sm_close_begin_in_SM_OPENED_succeeds)
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
-
     ///act
     result = sm_close_begin(sm);
 
@@ -373,7 +470,6 @@ TEST_FUNCTION(sm_close_begin_with_SM_CLOSE_BIT_refuses)
     sm_open_end(sm, true);
 
     /*sets SM_CLOSE_BIT to 1*/
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
     result = sm_close_begin(sm);
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
 
@@ -419,32 +515,95 @@ TEST_FUNCTION(sm_close_begin_after_close_begin_close_end_open_begin_open_end_suc
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
+    result = sm_close_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_close_end(sm);
+
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    umock_c_reset_all_calls();
 
+    ///act
     result = sm_close_begin(sm);
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
     sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_050: [ If the state is SM_OPENED_BARRIER then sm_close_begin shall re-evaluate the state. ]*/
+/*Tests_SRS_SM_02_090: [ If the state is SM_OPENED_BARRIER or SM_OPENED_DRAINING_TO_BARRIER then sm_close_begin shall wait for the state to change before re-evaluating it. ]*/
+/*Tests_SRS_SM_02_092: [ sm_barrier_end shall signal the state change and wake all the threads waiting for it. ]*/
+TEST_FUNCTION(sm_close_begin_in_SM_OPENED_BARRIER_waits_for_sm_barrier_end)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
 
     result = sm_open_begin(sm);
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
+    result = sm_barrier_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
+    g_sm_to_end_barrier = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue, hook_InterlockedHL_WaitForNotValue_ends_barrier);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue(IGNORED_ARG, IGNORED_ARG, UINT32_MAX));
 
     ///act
     result = sm_close_begin(sm);
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
 
     ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue, real_InterlockedHL_WaitForNotValue);
     sm_close_end(sm);
     sm_destroy(sm);
 }
 
+/*Tests_SRS_SM_02_071: [ If there are any failures then sm_close_begin shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_close_begin_in_SM_OPENED_BARRIER_fails_when_waiting_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    result = sm_barrier_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue(IGNORED_ARG, IGNORED_ARG, UINT32_MAX))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = sm_close_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_barrier_end(sm);
+    sm_destroy(sm);
+}
+
 /*Tests_SRS_SM_02_071: [ If there are any failures then sm_close_begin shall fail and return SM_ERROR. ]*/
 TEST_FUNCTION(sm_close_unhappy_path)
 {
@@ -456,9 +615,12 @@ TEST_FUNCTION(sm_close_unhappy_path)
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
+    result = sm_exec_begin(sm); /*so that n is not 0 and close has to wait*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX))
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX))
         .SetReturn(INTERLOCKED_HL_ERROR);
 
     ///act
@@ -469,6 +631,7 @@ TEST_FUNCTION(sm_close_unhappy_path)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///clean
+    sm_exec_end(sm);
     sm_destroy(sm);
 }
 
@@ -511,8 +674,6 @@ TEST_FUNCTION(sm_close_end_switches_state_to_SM_CREATED) /*allows sm_open_begin
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
-
     result = sm_close_begin(sm);
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
 
@@ -568,9 +729,11 @@ TEST_FUNCTION(sm_exec_begin_in_SM_CREATED_returns_SM_EXEC_REFUSED)
 }
 
 /*Tests_SRS_SM_02_055: [ If SM_CLOSE_BIT is 1 then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/ /*left to int tests, SM_CLOSE_BIT is set WHILE sm_close_begin is called*/
-/*Tests_SRS_SM_02_057: [ If the state changed after incrementing n then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/ /*left to int tests, SM_CLOSE_BIT is set WHILE sm_close_begin is called*/
+/*Tests_SRS_SM_02_057: [ If n is sharded and the state changed after incrementing n then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/ /*left to int tests, SM_CLOSE_BIT is set WHILE sm_close_begin is called*/
+/*Tests_SRS_SM_02_087: [ If the state or n changed meanwhile then sm_exec_begin shall re-evaluate the state. ]*/ /*left to int tests*/
 
 /*Tests_SRS_SM_02_056: [ sm_exec_begin shall increment n. ]*/
+/*Tests_SRS_SM_02_086: [ If n is not sharded then sm_exec_begin shall increment n only if the state did not change, in the same atomic operation. ]*/
 /*Tests_SRS_SM_02_058: [ sm_exec_begin shall return SM_EXEC_GRANTED. ]*/
 TEST_FUNCTION(sm_exec_begin_succeeds)
 {
@@ -629,6 +792,7 @@ TEST_FUNCTION(sm_exec_end_in_SM_CREATED_returns)
 
 /*Tests_SRS_SM_02_063: [ If n reaches 0 then sm_exec_end shall signal that. ]*/ /*left to int tests...*/
 /*Tests_SRS_SM_02_062: [ sm_exec_end shall decrement n with saturation at 0. ]*/
+/*Tests_SRS_SM_02_088: [ If n is not sharded then sm_exec_end shall decrement n with one atomic subtraction. ]*/
 TEST_FUNCTION(sm_exec_end_signals)
 {
     ///arrange
@@ -658,40 +822,84 @@ TEST_FUNCTION(sm_exec_end_signals)
     sm_destroy(sm);
 }
 
-/*Tests_SRS_SM_02_027: [ If sm is NULL then sm_barrier_begin shall fail and return SM_ERROR. ]*/
-TEST_FUNCTION(sm_barrier_begin_with_sm_NULL_returns_SM_ERROR)
+/*Tests_SRS_SM_02_063: [ If n reaches 0 then sm_exec_end shall signal that. ]*/
+/*Tests_SRS_SM_02_088: [ If n is not sharded then sm_exec_end shall decrement n with one atomic subtraction. ]*/
+/*Tests_SRS_SM_02_155: [ If n reaches 0 in the state word while draining for sm_close_begin or sm_barrier_begin then sm_exec_end shall call InterlockedHL_WakeAll64 on the state word and shall not access sm after decrementing n. ]*/
+TEST_FUNCTION(sm_exec_end_signals_the_drain_only_when_n_reaches_0)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
+
+    g_sm_to_end_exec = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, hook_InterlockedHL_WaitForNotValue64_ends_exec);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX)); /*ends the first execution, n is 1*/
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX)); /*ends the second execution, n is 0*/
+    STRICT_EXPECTED_CALL(InterlockedHL_WakeAll64(IGNORED_ARG)); /*only when n reaches 0*/
+
+    ///act
+    result = sm_close_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, real_InterlockedHL_WaitForNotValue64);
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_093: [ If sm is NULL then sm_exec_begin_n shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_exec_begin_n_with_sm_NULL_returns_SM_ERROR)
 {
     ///arrange
     SM_RESULT result;
 
     ///act
-    result = sm_barrier_begin(NULL);
+    result = sm_exec_begin_n(NULL, 2);
 
     ///assert
     ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/*Tests_SRS_SM_02_064: [ If state is not SM_OPENED then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
-TEST_FUNCTION(sm_barrier_begin_in_SM_CREATED_returns_SM_EXEC_REFUSED)
+/*Tests_SRS_SM_02_094: [ If count is 0 or greater than INT32_MAX then sm_exec_begin_n shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_exec_begin_n_with_count_0_returns_SM_ERROR)
 {
     ///arrange
     SM_HANDLE sm = TEST_sm_create();
     SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    umock_c_reset_all_calls();
 
     ///act
-    result = sm_barrier_begin(sm);
+    result = sm_exec_begin_n(sm, 0);
 
     ///assert
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///clean
     sm_destroy(sm);
 }
 
-/*Tests_SRS_SM_02_065: [ If SM_CLOSE_BIT is set to 1 then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
-TEST_FUNCTION(sm_barrier_begin_with_SM_CLOSE_BIT_set_refuses)
+/*Tests_SRS_SM_02_094: [ If count is 0 or greater than INT32_MAX then sm_exec_begin_n shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_exec_begin_n_with_count_greater_than_INT32_MAX_returns_SM_ERROR)
 {
     ///arrange
     SM_HANDLE sm = TEST_sm_create();
@@ -700,55 +908,67 @@ TEST_FUNCTION(sm_barrier_begin_with_SM_CLOSE_BIT_set_refuses)
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
-    result = sm_close_begin(sm);
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
-
     umock_c_reset_all_calls();
 
     ///act
-    result = sm_barrier_begin(sm);
+    result = sm_exec_begin_n(sm, (uint32_t)INT32_MAX + 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_095: [ sm_exec_begin_n shall behave as sm_exec_begin, except that it shall increment n by count in the same atomic operation. ]*/
+TEST_FUNCTION(sm_exec_begin_n_in_SM_CREATED_returns_SM_EXEC_REFUSED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+
+    ///act
+    result = sm_exec_begin_n(sm, 2);
 
     ///assert
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///clean
-    sm_close_end(sm);
     sm_destroy(sm);
 }
 
-/*Tests_SRS_SM_02_066: [ sm_barrier_begin shall switch the state to SM_OPENED_DRAINING_TO_BARRIER. ]*/
-/*Tests_SRS_SM_02_069: [ sm_barrier_begin shall switch the state to SM_OPENED_BARRIER and return SM_EXEC_GRANTED. ]*/
-TEST_FUNCTION(sm_barrier_begin_returns_SM_EXEC_GRANTED)
+/*Tests_SRS_SM_02_096: [ If n + count would overflow then sm_exec_begin_n shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_exec_begin_n_when_n_would_overflow_returns_SM_EXEC_REFUSED)
 {
     ///arrange
     SM_HANDLE sm = TEST_sm_create();
-    SM_RESULT result, result1, result2;
+    SM_RESULT result;
     result = sm_open_begin(sm);
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
+    result = sm_exec_begin_n(sm, INT32_MAX);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
 
     ///act
-    result1 = sm_barrier_begin(sm);
-    result2 = sm_exec_begin(sm);
+    result = sm_exec_begin_n(sm, 1);
 
     ///assert
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result1);
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result2);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///clean
-    sm_barrier_end(sm);
+    sm_exec_end_n(sm, INT32_MAX);
     sm_destroy(sm);
 }
 
-/*Tests_SRS_SM_02_067: [ If the state changed meanwhile then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/ /*left to int tests*/
-/*Tests_SRS_SM_02_068: [ sm_barrier_begin shall wait for n to reach 0. ]*/ /*fixeable maybe by interlcoked mocking*/
-
-/*Tests_SRS_SM_02_070: [ If there are any failures then sm_barrier_begin shall return SM_ERROR. ]*/
-TEST_FUNCTION(sm_barrier_begin_fails_when_interlocked_fails)
+/*Tests_SRS_SM_02_095: [ sm_exec_begin_n shall behave as sm_exec_begin, except that it shall increment n by count in the same atomic operation. ]*/
+/*Tests_SRS_SM_02_099: [ sm_exec_end_n shall behave as sm_exec_end, except that it shall decrement n by count in the same atomic operation. ]*/
+TEST_FUNCTION(sm_exec_begin_n_then_partial_sm_exec_end_n_makes_barrier_wait_for_the_rest)
 {
     ///arrange
     SM_HANDLE sm = TEST_sm_create();
@@ -757,72 +977,103 @@ TEST_FUNCTION(sm_barrier_begin_fails_when_interlocked_fails)
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
 
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX))
-        .SetReturn(INTERLOCKED_HL_ERROR);
+    result = sm_exec_begin_n(sm, 3);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_exec_end_n(sm, 2);
+
+    umock_c_reset_all_calls();
+
+    g_sm_to_end_exec = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, hook_InterlockedHL_WaitForNotValue64_ends_exec);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX)); /*only 1 wait: the hook ends the last execution*/
+    STRICT_EXPECTED_CALL(InterlockedHL_WakeAll64(IGNORED_ARG));
 
     ///act
     result = sm_barrier_begin(sm);
 
     ///assert
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, real_InterlockedHL_WaitForNotValue64);
+    sm_barrier_end(sm);
     sm_destroy(sm);
 }
 
-/*Tests_SRS_SM_02_032: [ If sm is NULL then sm_barrier_end shall return. ]*/
-TEST_FUNCTION(sm_barrier_end_with_sm_NULL_returns)
+/*Tests_SRS_SM_02_095: [ sm_exec_begin_n shall behave as sm_exec_begin, except that it shall increment n by count in the same atomic operation. ]*/
+/*Tests_SRS_SM_02_099: [ sm_exec_end_n shall behave as sm_exec_end, except that it shall decrement n by count in the same atomic operation. ]*/
+TEST_FUNCTION(sm_exec_begin_n_sharded_can_be_ended_piecemeal)
 {
     ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(2);
 
     ///act
-    sm_barrier_end(NULL);
+    result = sm_exec_begin_n(sm, 3);
+    sm_exec_end(sm);
+    sm_exec_end_n(sm, 2);
 
     ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    result = sm_close_begin(sm); /*would wait forever if the shards did not sum up to 0*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
 }
 
-/*Tests_SRS_SM_02_072: [ If state is not SM_OPENED_BARRIER then sm_barrier_end shall return. ]*/
-TEST_FUNCTION(sm_barrier_end_in_SM_CREATED_returns)
+/*Tests_SRS_SM_02_097: [ If sm is NULL then sm_exec_end_n shall return. ]*/
+TEST_FUNCTION(sm_exec_end_n_with_sm_NULL_returns)
 {
     ///arrange
-    SM_HANDLE sm = TEST_sm_create();
-    
+
     ///act
-    sm_barrier_end(sm);
+    sm_exec_end_n(NULL, 2);
 
     ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///clean
-    sm_destroy(sm);
 }
 
-/*Tests_SRS_SM_02_073: [ sm_barrier_end shall switch the state to SM_OPENED. ]*/
-TEST_FUNCTION(sm_barrier_begin_switched_to_SM_OPENED)
+/*Tests_SRS_SM_02_098: [ If count is 0 or greater than INT32_MAX then sm_exec_end_n shall return. ]*/
+TEST_FUNCTION(sm_exec_end_n_with_count_0_returns)
 {
     ///arrange
     SM_HANDLE sm = TEST_sm_create();
-    SM_RESULT result, result1, result2;
+    SM_RESULT result;
     result = sm_open_begin(sm);
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
     sm_open_end(sm, true);
-
-    STRICT_EXPECTED_CALL(InterlockedHL_WaitForValue(IGNORED_ARG, 0, UINT32_MAX));
-    result = sm_barrier_begin(sm);
+    result = sm_exec_begin(sm);
     ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
 
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
     ///act
-    result1 = sm_exec_begin(sm);
-    sm_barrier_end(sm);
-    result2 = sm_exec_begin(sm);
+    sm_exec_end_n(sm, 0);
+    result = sm_barrier_begin(sm); /*n is still 1 so barrier has to wait*/
 
     ///assert
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result1);
-    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result2);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///clean
@@ -830,6 +1081,1446 @@ TEST_FUNCTION(sm_barrier_begin_switched_to_SM_OPENED)
     sm_destroy(sm);
 }
 
+/*Tests_SRS_SM_02_027: [ If sm is NULL then sm_barrier_begin shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_barrier_begin_with_sm_NULL_returns_SM_ERROR)
+{
+    ///arrange
+    SM_RESULT result;
+
+    ///act
+    result = sm_barrier_begin(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_064: [ If state is not SM_OPENED then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_barrier_begin_in_SM_CREATED_returns_SM_EXEC_REFUSED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+
+    ///act
+    result = sm_barrier_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_065: [ If SM_CLOSE_BIT is set to 1 then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_barrier_begin_with_SM_CLOSE_BIT_set_refuses)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    result = sm_close_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_barrier_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_066: [ sm_barrier_begin shall switch the state to SM_OPENED_DRAINING_TO_BARRIER. ]*/
+/*Tests_SRS_SM_02_069: [ sm_barrier_begin shall switch the state to SM_OPENED_BARRIER and return SM_EXEC_GRANTED. ]*/
+TEST_FUNCTION(sm_barrier_begin_returns_SM_EXEC_GRANTED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result, result1, result2;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    ///act
+    result1 = sm_barrier_begin(sm);
+    result2 = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result1);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_barrier_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_067: [ If the state changed meanwhile then sm_barrier_begin shall return SM_EXEC_REFUSED. ]*/ /*left to int tests*/
+/*Tests_SRS_SM_02_068: [ sm_barrier_begin shall wait for n to reach 0. ]*/ /*fixeable maybe by interlcoked mocking*/
+
+/*Tests_SRS_SM_02_070: [ If there are any failures then sm_barrier_begin shall return SM_ERROR. ]*/
+TEST_FUNCTION(sm_barrier_begin_fails_when_interlocked_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    result = sm_exec_begin(sm); /*so that n is not 0 and barrier has to wait*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = sm_barrier_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_032: [ If sm is NULL then sm_barrier_end shall return. ]*/
+TEST_FUNCTION(sm_barrier_end_with_sm_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    sm_barrier_end(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_072: [ If state is not SM_OPENED_BARRIER then sm_barrier_end shall return. ]*/
+TEST_FUNCTION(sm_barrier_end_in_SM_CREATED_returns)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    
+    ///act
+    sm_barrier_end(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_073: [ sm_barrier_end shall switch the state to SM_OPENED. ]*/
+TEST_FUNCTION(sm_barrier_begin_switched_to_SM_OPENED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result, result1, result2;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    result = sm_barrier_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
+
+    ///act
+    result1 = sm_exec_begin(sm);
+    sm_barrier_end(sm);
+    result2 = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result1);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_076: [ If options is NULL then sm_create_with_options shall behave as sm_create. ]*/
+TEST_FUNCTION(sm_create_with_options_with_options_NULL_succeeds)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("bleeding edge", NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_078: [ If options->use_sharded_exec_count is true then sm_create_with_options shall allocate memory for the shards of n, each shard in its own cache line. ]*/
+/*Tests_SRS_SM_02_083: [ sm_create_with_options shall set state to SM_CREATED and all the shards of n to 0. ]*/
+TEST_FUNCTION(sm_create_with_options_sharded_succeeds)
+{
+    ///arrange
+    SM_OPTIONS options = { true, 3 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("bleeding edge", &options);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_077: [ If options->use_sharded_exec_count is true and options->shard_count is 0 then sm_create_with_options shall use as many shards as processor_index_get_count returns. ]*/
+TEST_FUNCTION(sm_create_with_options_sharded_with_shard_count_0_uses_processor_count)
+{
+    ///arrange
+    SM_OPTIONS options = { true, 0 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("bleeding edge", &options);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_079: [ If there are any failures then sm_create_with_options shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_create_with_options_sharded_when_malloc_fails_it_fails)
+{
+    ///arrange
+    SM_OPTIONS options = { true, 3 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("bleeding edge", &options);
+
+    ///assert
+    ASSERT_IS_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_SM_02_006: [ sm_destroy shall free all used resources. ]*/
+TEST_FUNCTION(sm_destroy_sharded_frees_shards)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(sm));
+
+    ///act
+    sm_destroy(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+}
+
+/*Tests_SRS_SM_02_080: [ If n is sharded then sm_exec_begin shall increment the shard of n of the current processor. ]*/
+TEST_FUNCTION(sm_exec_begin_sharded_succeeds)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    result = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_081: [ If n is sharded and the shard of n of the current processor is not frozen then sm_exec_end shall decrement the shard. ]*/
+/*Tests_SRS_SM_02_084: [ If n is sharded then sm_close_begin shall wait for n in the state word to reach 0 after freezing the shards of n. ]*/
+TEST_FUNCTION(sm_exec_end_sharded_on_another_processor_allows_close)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(0);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(TEST_SHARD_COUNT + 1); /*wraps around to another shard*/
+
+    ///act
+    sm_exec_end(sm);
+    result = sm_close_begin(sm); /*would wait forever if the shards did not sum up to 0*/
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_085: [ If n is sharded then sm_barrier_begin shall wait for n in the state word to reach 0 after freezing the shards of n. ]*/
+TEST_FUNCTION(sm_barrier_begin_sharded_returns_SM_EXEC_GRANTED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result, result1, result2;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    umock_c_reset_all_calls();
+
+    ///act
+    result1 = sm_barrier_begin(sm);
+    result2 = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result1);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_barrier_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_157: [ If n is sharded then sm_close_begin, sm_barrier_begin, sm_close_begin_async and sm_barrier_begin_async shall, after switching the state to draining, freeze every shard of n and add the values of the shards to n in the state word. ]*/
+/*Tests_SRS_SM_02_082: [ If n is sharded and the shard of n of the current processor is frozen then sm_exec_end shall decrement n in the state word with one atomic subtraction. ]*/
+/*Tests_SRS_SM_02_155: [ If n reaches 0 in the state word while draining for sm_close_begin or sm_barrier_begin then sm_exec_end shall call InterlockedHL_WakeAll64 on the state word and shall not access sm after decrementing n. ]*/
+TEST_FUNCTION(sm_exec_end_sharded_after_sm_close_begin_froze_the_shards_signals_n_reaching_0)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(0);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    umock_c_reset_all_calls();
+
+    g_sm_to_end_exec = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, hook_InterlockedHL_WaitForNotValue64_ends_exec);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX)); /*n was folded into the state word, the hook ends the execution*/
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(InterlockedHL_WakeAll64(IGNORED_ARG));
+
+    ///act
+    result = sm_close_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, real_InterlockedHL_WaitForNotValue64);
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_158: [ If n is sharded and the shard of n of the current processor is frozen then sm_exec_begin shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_exec_begin_sharded_refuses_when_the_shards_were_frozen_meanwhile)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+
+    umock_c_reset_all_calls();
+
+    g_sm_to_begin_barrier = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(processor_index_get_current, hook_processor_index_get_current_begins_barrier_async);
+
+    STRICT_EXPECTED_CALL(processor_index_get_current()); /*the hook starts a barrier after sm_exec_begin checked the state, like another thread would*/
+
+    ///act
+    result = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(processor_index_get_current, NULL);
+    sm_barrier_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_159: [ If n is sharded then sm_barrier_end shall set all the shards of n to 0 before switching the state to SM_OPENED. ]*/
+TEST_FUNCTION(sm_barrier_end_sharded_gives_the_shards_back_to_sm_exec_begin)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_barrier_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(3);
+
+    ///act
+    sm_barrier_end(sm);
+    result = sm_exec_begin(sm);
+    sm_exec_end(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_close_begin(sm)); /*would wait forever if n was not back to 0*/
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_160: [ If n is sharded then sm_close_end shall set all the shards of n to 0 before switching the state to SM_CREATED. ]*/
+TEST_FUNCTION(sm_close_end_sharded_gives_the_shards_back_to_sm_exec_begin)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_close_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    sm_close_end(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(sm));
+    sm_open_end(sm, true);
+    result = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+
+/*Tests_SRS_SM_02_100: [ If sm is NULL then sm_close_begin_async shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_close_begin_async_with_sm_NULL_fails)
+{
+    ///arrange
+    SM_RESULT result;
+
+    ///act
+    result = sm_close_begin_async(NULL, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_101: [ If on_drained is NULL then sm_close_begin_async shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_close_begin_async_with_on_drained_NULL_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_close_begin_async(sm, NULL, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_103: [ If the state is not SM_OPENED then sm_close_begin_async shall set SM_CLOSE_BIT to 0 and return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_close_begin_async_in_SM_CREATED_refuses)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+
+    ///act
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    result = sm_open_begin(sm); /*SM_CLOSE_BIT was reset*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_103: [ If the state is not SM_OPENED then sm_close_begin_async shall set SM_CLOSE_BIT to 0 and return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_close_begin_async_in_SM_OPENED_BARRIER_refuses)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_barrier_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_barrier_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_105: [ sm_close_begin_async shall set SM_CLOSE_BIT to 1. ]*/
+/*Tests_SRS_SM_02_119: [ If the state is SM_OPENED then sm_close_begin_async shall switch it to SM_OPENED_DRAINING_TO_CLOSE. ]*/
+/*Tests_SRS_SM_02_104: [ sm_close_begin_async shall return SM_EXEC_GRANTED and call on_drained (possibly before returning, from the calling thread) when n reaches 0. ]*/
+/*Tests_SRS_SM_02_108: [ If the pending operation is sm_close_begin_async then the state shall be switched to SM_CLOSING and SM_CLOSE_BIT shall be set to 0. ]*/
+/*Tests_SRS_SM_02_110: [ The callback shall be called exactly once, with the context passed to sm_close_begin_async or sm_barrier_begin_async. ]*/
+TEST_FUNCTION(sm_close_begin_async_with_no_executions_calls_on_drained_before_returning)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_on_drained_context);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    sm_close_end(sm); /*state is SM_CLOSING*/
+    result = sm_open_begin(sm); /*state is SM_CREATED and SM_CLOSE_BIT is 0*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    ///clean
+    sm_open_end(sm, false);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_107: [ When n reaches 0 while draining, the thread that observes it shall call the callback of the pending sm_close_begin_async or sm_barrier_begin_async. ]*/
+/*Tests_SRS_SM_02_104: [ sm_close_begin_async shall return SM_EXEC_GRANTED and call on_drained (possibly before returning, from the calling thread) when n reaches 0. ]*/
+TEST_FUNCTION(sm_close_begin_async_calls_on_drained_from_the_last_sm_exec_end)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_exec_begin_n(sm, 2);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_exec_begin(sm)); /*draining*/
+
+    ///act
+    sm_exec_end(sm);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    sm_exec_end(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_on_drained_context);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_156: [ sm_close_begin_async and sm_barrier_begin_async shall set SM_ASYNC_BIT in the same atomic operation that switches the state to draining. ]*/
+/*Tests_SRS_SM_02_110: [ The callback shall be called exactly once, with the context passed to sm_close_begin_async or sm_barrier_begin_async. ]*/
+TEST_FUNCTION(sm_close_begin_async_calls_on_drained_when_n_reaches_0_before_the_callback_is_published)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_with_statistics();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    g_sm_to_end_exec = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(processor_index_get_current, hook_processor_index_get_current_ends_exec);
+
+    STRICT_EXPECTED_CALL(processor_index_get_current()); /*counting the grant happens after the state was switched to draining, the hook ends the last execution, like another thread would*/
+
+    ///act
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_on_drained_context);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(processor_index_get_current, NULL);
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_102: [ If another sm_close_begin_async or sm_barrier_begin_async is pending then sm_close_begin_async shall set SM_CLOSE_BIT to 0 and return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_close_begin_async_while_sm_barrier_begin_async_is_pending_refuses)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    result = sm_barrier_begin_async(sm, test_on_drained, (void*)0x42);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x43);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    sm_exec_end(sm);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_on_drained_context);
+    sm_barrier_end(sm);
+
+    result = sm_close_begin(sm); /*SM_CLOSE_BIT was reset*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_106: [ If SM_CLOSE_BIT was already 1 then sm_close_begin_async shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_close_begin_async_while_sm_close_begin_async_is_pending_refuses)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x43);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    sm_exec_end(sm);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_on_drained_context);
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_107: [ When n reaches 0 while draining, the thread that observes it shall call the callback of the pending sm_close_begin_async or sm_barrier_begin_async. ]*/
+TEST_FUNCTION(sm_close_begin_async_sharded_calls_on_drained_from_sm_exec_end_on_another_processor)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_sharded();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(0);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(2);
+
+    ///act
+    sm_exec_end(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_111: [ If sm is NULL then sm_barrier_begin_async shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_barrier_begin_async_with_sm_NULL_fails)
+{
+    ///arrange
+    SM_RESULT result;
+
+    ///act
+    result = sm_barrier_begin_async(NULL, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_112: [ If on_drained is NULL then sm_barrier_begin_async shall fail and return SM_ERROR. ]*/
+TEST_FUNCTION(sm_barrier_begin_async_with_on_drained_NULL_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_barrier_begin_async(sm, NULL, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_113: [ If state is not SM_OPENED then sm_barrier_begin_async shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_barrier_begin_async_in_SM_CREATED_refuses)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+
+    ///act
+    result = sm_barrier_begin_async(sm, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_114: [ If SM_CLOSE_BIT is set to 1 then sm_barrier_begin_async shall return SM_EXEC_REFUSED. ]*/
+/*Tests_SRS_SM_02_115: [ If another sm_close_begin_async or sm_barrier_begin_async is pending then sm_barrier_begin_async shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_barrier_begin_async_while_sm_close_begin_async_is_pending_refuses)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    result = sm_close_begin_async(sm, test_on_drained, (void*)0x42);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_barrier_begin_async(sm, test_on_drained, (void*)0x43);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_close_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_116: [ sm_barrier_begin_async shall switch the state to SM_OPENED_DRAINING_TO_BARRIER. ]*/
+/*Tests_SRS_SM_02_118: [ sm_barrier_begin_async shall return SM_EXEC_GRANTED and call on_drained (possibly before returning, from the calling thread) when n reaches 0. ]*/
+/*Tests_SRS_SM_02_109: [ If the pending operation is sm_barrier_begin_async then the state shall be switched to SM_OPENED_BARRIER. ]*/
+TEST_FUNCTION(sm_barrier_begin_async_with_no_executions_calls_on_drained_before_returning)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = sm_barrier_begin_async(sm, test_on_drained, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_on_drained_context);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_exec_begin(sm)); /*state is SM_OPENED_BARRIER*/
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    sm_barrier_end(sm);
+    result = sm_exec_begin(sm); /*state is SM_OPENED*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_107: [ When n reaches 0 while draining, the thread that observes it shall call the callback of the pending sm_close_begin_async or sm_barrier_begin_async. ]*/
+/*Tests_SRS_SM_02_110: [ The callback shall be called exactly once, with the context passed to sm_close_begin_async or sm_barrier_begin_async. ]*/
+TEST_FUNCTION(sm_barrier_begin_async_calls_on_drained_from_the_last_sm_exec_end_and_callback_can_end_the_barrier)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_RESULT result;
+    result = sm_open_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    sm_open_end(sm, true);
+    result = sm_exec_begin(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    result = sm_barrier_begin_async(sm, test_on_drained_ends_barrier, sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 0, g_on_drained_call_count);
+    umock_c_reset_all_calls();
+
+    ///act
+    sm_exec_end(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_on_drained_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, sm, g_on_drained_context);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    result = sm_barrier_begin_async(sm, test_on_drained, (void*)0x42); /*the slot was released before calling the callback*/
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(uint32_t, 2, g_on_drained_call_count);
+
+    ///clean
+    sm_barrier_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_120: [ If options->max_exec_count is greater than INT32_MAX then sm_create_with_options shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_create_with_options_with_max_exec_count_greater_than_INT32_MAX_fails)
+{
+    ///arrange
+    SM_OPTIONS options = { false, 0, (uint32_t)INT32_MAX + 1, false };
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("capped", &options);
+
+    ///assert
+    ASSERT_IS_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_121: [ If options->max_exec_count is not 0 and options->use_sharded_exec_count is true then sm_create_with_options shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_create_with_options_with_max_exec_count_and_sharded_fails)
+{
+    ///arrange
+    SM_OPTIONS options = { true, 0, 10, false };
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("capped", &options);
+
+    ///assert
+    ASSERT_IS_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_122: [ sm_create_with_options shall cap n to options->max_exec_count (0 meaning no cap). ]*/
+/*Tests_SRS_SM_02_124: [ If n + count would be greater than max_exec_count and wait_when_throttled is false then sm_exec_begin shall return SM_EXEC_THROTTLED. ]*/
+TEST_FUNCTION(sm_exec_begin_above_max_exec_count_returns_SM_EXEC_THROTTLED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_capped_and_opened(2, false);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    umock_c_reset_all_calls();
+
+    ///act
+    SM_RESULT result = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_THROTTLED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_124: [ If n + count would be greater than max_exec_count and wait_when_throttled is false then sm_exec_begin shall return SM_EXEC_THROTTLED. ]*/
+TEST_FUNCTION(sm_exec_begin_after_sm_exec_end_below_max_exec_count_succeeds)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_capped_and_opened(2, false);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_THROTTLED, sm_exec_begin(sm));
+    sm_exec_end(sm);
+    umock_c_reset_all_calls();
+
+    ///act
+    SM_RESULT result = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_124: [ If n + count would be greater than max_exec_count and wait_when_throttled is false then sm_exec_begin shall return SM_EXEC_THROTTLED. ]*/
+TEST_FUNCTION(sm_exec_begin_n_above_max_exec_count_returns_SM_EXEC_THROTTLED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_capped_and_opened(4, false);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin_n(sm, 2));
+    umock_c_reset_all_calls();
+
+    ///act
+    SM_RESULT result1 = sm_exec_begin_n(sm, 3);
+    SM_RESULT result2 = sm_exec_begin_n(sm, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_THROTTLED, result1);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end_n(sm, 4);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_123: [ If count is greater than max_exec_count then sm_exec_begin_n shall return SM_EXEC_REFUSED. ]*/
+TEST_FUNCTION(sm_exec_begin_n_with_count_greater_than_max_exec_count_returns_SM_EXEC_REFUSED)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_capped_and_opened(4, true);
+
+    ///act
+    SM_RESULT result = sm_exec_begin_n(sm, 5);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_125: [ If n + count would be greater than max_exec_count and wait_when_throttled is true then sm_exec_begin shall wait for n or the state to change and re-evaluate the state. ]*/
+/*Tests_SRS_SM_02_161: [ If n + count would be greater than max_exec_count and wait_when_throttled is true then sm_exec_begin shall set SM_THROTTLE_BIT in the state word if the state word did not change and wait for the state word to change. ]*/
+/*Tests_SRS_SM_02_162: [ If n is capped then sm_exec_end shall decrement n and set SM_THROTTLE_BIT to 0 in the same atomic operation. ]*/
+/*Tests_SRS_SM_02_127: [ If SM_THROTTLE_BIT was 1 then sm_exec_end shall call InterlockedHL_WakeAll64 on the state word and shall not access sm after decrementing n. ]*/
+TEST_FUNCTION(sm_exec_begin_above_max_exec_count_with_wait_when_throttled_waits_for_sm_exec_end)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_capped_and_opened(1, true);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    umock_c_reset_all_calls();
+
+    g_sm_to_end_exec = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, hook_InterlockedHL_WaitForNotValue64_ends_exec);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX)); /*the hook ends the execution, like another thread would*/
+    STRICT_EXPECTED_CALL(InterlockedHL_WakeAll64(IGNORED_ARG)); /*the ending execution sees SM_THROTTLE_BIT*/
+
+    ///act
+    SM_RESULT result = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, real_InterlockedHL_WaitForNotValue64);
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_162: [ If n is capped then sm_exec_end shall decrement n and set SM_THROTTLE_BIT to 0 in the same atomic operation. ]*/
+TEST_FUNCTION(sm_exec_end_capped_without_throttled_sm_exec_begin_does_not_wake)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_capped_and_opened(1, true);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    umock_c_reset_all_calls();
+
+    ///act
+    sm_exec_end(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm)); /*n is back to 0*/
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_126: [ If waiting fails then sm_exec_begin shall return SM_ERROR. ]*/
+TEST_FUNCTION(sm_exec_begin_above_max_exec_count_with_wait_when_throttled_fails_when_waiting_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_capped_and_opened(1, true);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_WaitForNotValue64(IGNORED_ARG, IGNORED_ARG, UINT32_MAX))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    SM_RESULT result = sm_exec_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_128: [ If options->collect_statistics is true then sm_create_with_options shall allocate one block of statistics counters for every processor, each block starting in its own cache line. ]*/
+/*Tests_SRS_SM_02_129: [ sm_create_with_options shall set all the statistics counters to 0. ]*/
+TEST_FUNCTION(sm_create_with_options_with_statistics_succeeds)
+{
+    ///arrange
+    SM_OPTIONS options = { false, 0, 0, false, true };
+    SM_STATISTICS statistics;
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("counted", &options);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, sm_get_statistics(sm, &statistics));
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.open_begin.granted);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.exec_begin.granted);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.drain_wait_us[0]);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_079: [ If there are any failures then sm_create_with_options shall fail and return NULL. ]*/
+TEST_FUNCTION(sm_create_with_options_with_statistics_when_malloc_fails_it_fails)
+{
+    ///arrange
+    SM_OPTIONS options = { false, 0, 0, false, true };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    SM_HANDLE sm = sm_create_with_options("counted", &options);
+
+    ///assert
+    ASSERT_IS_NULL(sm);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_006: [ sm_destroy shall free all used resources. ]*/
+TEST_FUNCTION(sm_destroy_with_statistics_frees_the_counters)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_with_statistics();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(sm));
+
+    ///act
+    sm_destroy(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_133: [ If sm is NULL then sm_get_statistics shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(sm_get_statistics_with_sm_NULL_fails)
+{
+    ///arrange
+    SM_STATISTICS statistics;
+
+    ///act
+    int result = sm_get_statistics(NULL, &statistics);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_134: [ If statistics is NULL then sm_get_statistics shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(sm_get_statistics_with_statistics_NULL_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_with_statistics();
+
+    ///act
+    int result = sm_get_statistics(sm, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_135: [ If sm was not created with collect_statistics set to true then sm_get_statistics shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(sm_get_statistics_without_collect_statistics_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_STATISTICS statistics;
+
+    ///act
+    int result = sm_get_statistics(sm, &statistics);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_131: [ If statistics are collected then sm_open_begin, sm_close_begin, sm_close_begin_async, sm_exec_begin, sm_exec_begin_n, sm_barrier_begin and sm_barrier_begin_async shall count the calls that returned SM_EXEC_GRANTED and SM_EXEC_REFUSED. ]*/
+/*Tests_SRS_SM_02_136: [ sm_get_statistics shall fill statistics with the sum of the counters of all the processors. ]*/
+/*Tests_SRS_SM_02_137: [ sm_get_statistics shall succeed and return 0. ]*/
+TEST_FUNCTION(sm_get_statistics_counts_grants_and_refusals_across_processors)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_with_statistics();
+    SM_STATISTICS statistics;
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(0);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(sm));
+    sm_open_end(sm, true);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_open_begin(sm));
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(2);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin_n(sm, 2));
+    sm_exec_end_n(sm, 3);
+
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_barrier_begin(sm));
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_exec_begin(sm));
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_barrier_begin(sm));
+    sm_barrier_end(sm);
+
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_close_begin(sm));
+    sm_close_end(sm);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_REFUSED, sm_close_begin(sm));
+
+    ///act
+    int result = sm_get_statistics(sm, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.open_begin.granted);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.open_begin.refused);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.exec_begin.granted); /*sm_exec_begin_n counts as 1 call*/
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.exec_begin.refused);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.barrier_begin.granted);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.barrier_begin.refused);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.close_begin.granted);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.close_begin.refused);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.exec_begin_throttled);
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_132: [ If statistics are collected then sm_exec_begin and sm_exec_begin_n shall count the calls that returned SM_EXEC_THROTTLED. ]*/
+TEST_FUNCTION(sm_get_statistics_counts_throttled_sm_exec_begin)
+{
+    ///arrange
+    SM_OPTIONS options = { false, 0, 1, false, true };
+    SM_HANDLE sm = sm_create_with_options("counted", &options);
+    ASSERT_IS_NOT_NULL(sm);
+    SM_STATISTICS statistics;
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(sm));
+    sm_open_end(sm, true);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_THROTTLED, sm_exec_begin(sm));
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_THROTTLED, sm_exec_begin_n(sm, 1));
+
+    ///act
+    int result = sm_get_statistics(sm, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.exec_begin.granted);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.exec_begin.refused);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.exec_begin_throttled);
+
+    ///clean
+    sm_exec_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_130: [ If statistics are collected then sm_barrier_begin and sm_close_begin shall add the time spent waiting for n to reach 0 to a histogram with logarithmic buckets. ]*/
+TEST_FUNCTION(sm_barrier_begin_with_statistics_records_the_drain_wait_in_the_histogram)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create_with_statistics();
+    SM_STATISTICS statistics;
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_open_begin(sm));
+    sm_open_end(sm, true);
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, sm_exec_begin(sm));
+    umock_c_reset_all_calls();
+
+    g_sm_to_end_exec = sm;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, hook_InterlockedHL_WaitForNotValue64_ends_exec);
+
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms())
+        .SetReturn(10.0);
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms())
+        .SetReturn(10.005); /*5 microseconds later, that is bucket [4, 8)*/
+
+    ///act
+    SM_RESULT result = sm_barrier_begin(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(SM_RESULT, SM_EXEC_GRANTED, result);
+    ASSERT_ARE_EQUAL(int, 0, sm_get_statistics(sm, &statistics));
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.drain_wait_us[2]);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.drain_wait_us[3]);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.drain_wait_us[4]);
+
+    ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_WaitForNotValue64, real_InterlockedHL_WaitForNotValue64);
+    sm_barrier_end(sm);
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_141: [ If sm is NULL then sm_trace_get shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(sm_trace_get_with_sm_NULL_fails)
+{
+    ///arrange
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+
+    ///act
+    int result = sm_trace_get(NULL, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_142: [ If records is NULL then sm_trace_get shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(sm_trace_get_with_records_NULL_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    uint32_t record_count;
+
+    ///act
+    int result = sm_trace_get(sm, NULL, &record_count);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_143: [ If record_count is NULL then sm_trace_get shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(sm_trace_get_with_record_count_NULL_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+
+    ///act
+    int result = sm_trace_get(sm, records, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_144: [ If sm.c is not compiled with SM_TRACE then sm_trace_get shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(sm_trace_get_without_SM_TRACE_fails)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+    SM_TRACE_RECORD records[SM_TRACE_RECORD_COUNT];
+    uint32_t record_count;
+
+    ///act
+    int result = sm_trace_get(sm, records, &record_count);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
+/*Tests_SRS_SM_02_148: [ If sm is NULL then sm_trace_dump shall return. ]*/
+TEST_FUNCTION(sm_trace_dump_with_sm_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    sm_trace_dump(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_SM_02_150: [ If getting the records fails then sm_trace_dump shall return. ]*/
+TEST_FUNCTION(sm_trace_dump_without_SM_TRACE_returns)
+{
+    ///arrange
+    SM_HANDLE sm = TEST_sm_create();
+
+    ///act
+    sm_trace_dump(sm);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    sm_destroy(sm);
+}
+
 END_TEST_SUITE(sm_unittests)
 
 
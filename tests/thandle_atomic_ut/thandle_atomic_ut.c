@@ -0,0 +1,722 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_util/interlocked_hl.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+#include "real_gballoc_hl.h"
+
+#include "azure_c_util/thandle_atomic.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+/*a type that is held in THANDLE_ATOMIC slots*/
+#define TEST_ITEM_FIELDS    \
+    int, a                  \
+
+MU_DEFINE_STRUCT(TEST_ITEM, TEST_ITEM_FIELDS);
+
+THANDLE_TYPE_DECLARE(TEST_ITEM);
+THANDLE_ATOMIC_TYPE_DECLARE(TEST_ITEM);
+
+#define THANDLE_MALLOC_FUNCTION malloc
+#define THANDLE_FREE_FUNCTION free
+THANDLE_TYPE_DEFINE(TEST_ITEM);
+#undef THANDLE_MALLOC_FUNCTION
+#undef THANDLE_FREE_FUNCTION
+
+THANDLE_ATOMIC_TYPE_DEFINE(TEST_ITEM);
+
+static THANDLE(TEST_ITEM) TEST_ITEM_create(int a)
+{
+    TEST_ITEM source;
+    source.a = a;
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(TEST_ITEM) result = THANDLE_CREATE_FROM_CONTENT(TEST_ITEM)(&source, NULL, NULL);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/*plays the part of the readers that leave the slot while the writer waits for them*/
+static THANDLE_ATOMIC_SLOT* g_slot_with_readers;
+static INTERLOCKED_HL_RESULT hook_InterlockedHL_Backoff_readers_leave(INTERLOCKED_HL_BACKOFF* backoff)
+{
+    (void)backoff;
+    if (interlocked_add(&g_slot_with_readers->readers[0], 0) != 0)
+    {
+        (void)interlocked_decrement(&g_slot_with_readers->readers[0]);
+    }
+    else
+    {
+        (void)interlocked_decrement(&g_slot_with_readers->readers[1]);
+    }
+    return INTERLOCKED_HL_OK;
+}
+
+BEGIN_TEST_SUITE(thandle_atomic_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    ASSERT_ARE_EQUAL(int, 0, real_gballoc_hl_init(NULL, NULL));
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
+
+    REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+
+    real_gballoc_hl_deinit();
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* thandle_atomic_slot_init */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_001: [ If slot is NULL then thandle_atomic_slot_init shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_atomic_slot_init_with_slot_NULL_fails)
+{
+    ///arrange
+    int result;
+
+    ///act
+    result = thandle_atomic_slot_init(NULL, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_002: [ thandle_atomic_slot_init shall store value in the slot, set both reader counts and the reader index to 0 and unlock the writer mutex. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_003: [ thandle_atomic_slot_init shall succeed and return 0. ]*/
+TEST_FUNCTION(thandle_atomic_slot_init_succeeds)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    (void)memset(&slot, 0xFF, sizeof(slot));
+    int result;
+
+    ///act
+    result = thandle_atomic_slot_init(&slot, (void*)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, slot.value);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[0]);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[1]);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.reader_index);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.writer_mutex);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* thandle_atomic_slot_read_begin */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_004: [ If slot is NULL then thandle_atomic_slot_read_begin shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_atomic_slot_read_begin_with_slot_NULL_fails)
+{
+    ///arrange
+    int32_t reader_index;
+    void* result;
+
+    ///act
+    result = thandle_atomic_slot_read_begin(NULL, &reader_index);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_005: [ If reader_index is NULL then thandle_atomic_slot_read_begin shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_atomic_slot_read_begin_with_reader_index_NULL_fails)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    void* result;
+
+    ///act
+    result = thandle_atomic_slot_read_begin(&slot, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[0]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_006: [ thandle_atomic_slot_read_begin shall read the reader index and increment the readers count at that index. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_007: [ thandle_atomic_slot_read_begin shall return the value in the slot (read after the increment of the readers count). ]*/
+TEST_FUNCTION(thandle_atomic_slot_read_begin_succeeds)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    int32_t reader_index = -1;
+    void* result;
+
+    ///act
+    result = thandle_atomic_slot_read_begin(&slot, &reader_index);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, result);
+    ASSERT_ARE_EQUAL(int32_t, 0, reader_index);
+    ASSERT_ARE_EQUAL(int32_t, 1, slot.readers[0]);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[1]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_006: [ thandle_atomic_slot_read_begin shall read the reader index and increment the readers count at that index. ]*/
+TEST_FUNCTION(thandle_atomic_slot_read_begin_while_a_writer_waits_uses_the_other_count)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    (void)interlocked_exchange(&slot.reader_index, 1); /*as a writer waiting for the readers of count 0 would set it*/
+    int32_t reader_index = -1;
+    void* result;
+
+    ///act
+    result = thandle_atomic_slot_read_begin(&slot, &reader_index);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, result);
+    ASSERT_ARE_EQUAL(int32_t, 1, reader_index);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[0]);
+    ASSERT_ARE_EQUAL(int32_t, 1, slot.readers[1]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* thandle_atomic_slot_read_end */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_008: [ If slot is NULL then thandle_atomic_slot_read_end shall return. ]*/
+TEST_FUNCTION(thandle_atomic_slot_read_end_with_slot_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    thandle_atomic_slot_read_end(NULL, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_009: [ If reader_index is not 0 or 1 then thandle_atomic_slot_read_end shall return. ]*/
+TEST_FUNCTION(thandle_atomic_slot_read_end_with_reader_index_2_returns)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    int32_t reader_index;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    (void)thandle_atomic_slot_read_begin(&slot, &reader_index);
+
+    ///act
+    thandle_atomic_slot_read_end(&slot, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 1, slot.readers[0]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_010: [ thandle_atomic_slot_read_end shall decrement the readers count at reader_index. ]*/
+TEST_FUNCTION(thandle_atomic_slot_read_end_decrements_the_readers_count)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    int32_t reader_index;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    (void)thandle_atomic_slot_read_begin(&slot, &reader_index);
+
+    ///act
+    thandle_atomic_slot_read_end(&slot, reader_index);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[0]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* thandle_atomic_slot_exchange */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_011: [ If slot is NULL then thandle_atomic_slot_exchange shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_atomic_slot_exchange_with_slot_NULL_fails)
+{
+    ///arrange
+    void* previous_value;
+    int result;
+
+    ///act
+    result = thandle_atomic_slot_exchange(NULL, (void*)0x43, &previous_value);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_012: [ If previous_value is NULL then thandle_atomic_slot_exchange shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_atomic_slot_exchange_with_previous_value_NULL_fails)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    int result;
+
+    ///act
+    result = thandle_atomic_slot_exchange(&slot, (void*)0x43, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, slot.value);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_014: [ If InterlockedHL_MutexLock fails then thandle_atomic_slot_exchange shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_InterlockedHL_MutexLock_fails_thandle_atomic_slot_exchange_fails)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    void* previous_value;
+    int result;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(&slot.writer_mutex))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = thandle_atomic_slot_exchange(&slot, (void*)0x43, &previous_value);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, slot.value);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_013: [ thandle_atomic_slot_exchange shall lock the writer mutex by calling InterlockedHL_MutexLock. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_015: [ thandle_atomic_slot_exchange shall exchange the value in the slot with value. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_016: [ thandle_atomic_slot_exchange shall set the reader index to 1 and wait for the readers count 0 to reach 0. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_017: [ thandle_atomic_slot_exchange shall set the reader index to 0 and wait for the readers count 1 to reach 0. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_019: [ thandle_atomic_slot_exchange shall unlock the writer mutex by calling InterlockedHL_MutexUnlock. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_020: [ thandle_atomic_slot_exchange shall store the previous value of the slot in *previous_value, succeed and return 0. ]*/
+TEST_FUNCTION(thandle_atomic_slot_exchange_without_readers_succeeds)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    void* previous_value;
+    int result;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(&slot.writer_mutex));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(&slot.writer_mutex));
+
+    ///act
+    result = thandle_atomic_slot_exchange(&slot, (void*)0x43, &previous_value);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, previous_value);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x43, slot.value);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.reader_index);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.writer_mutex);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_016: [ thandle_atomic_slot_exchange shall set the reader index to 1 and wait for the readers count 0 to reach 0. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_017: [ thandle_atomic_slot_exchange shall set the reader index to 0 and wait for the readers count 1 to reach 0. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_018: [ thandle_atomic_slot_exchange shall wait for the readers count to reach 0 by calling InterlockedHL_Backoff between the reads. ]*/
+TEST_FUNCTION(thandle_atomic_slot_exchange_waits_for_the_readers_of_both_counts)
+{
+    ///arrange
+    THANDLE_ATOMIC_SLOT slot;
+    ASSERT_ARE_EQUAL(int, 0, thandle_atomic_slot_init(&slot, (void*)0x42));
+    (void)interlocked_exchange(&slot.readers[0], 2); /*2 readers are loading the value*/
+    (void)interlocked_exchange(&slot.readers[1], 1); /*a reader that read the reader index while a previous writer was waiting*/
+    void* previous_value;
+    int result;
+
+    g_slot_with_readers = &slot;
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_Backoff, hook_InterlockedHL_Backoff_readers_leave);
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(&slot.writer_mutex));
+    STRICT_EXPECTED_CALL(InterlockedHL_Backoff(IGNORED_ARG)); /*a reader of count 0 leaves*/
+    STRICT_EXPECTED_CALL(InterlockedHL_Backoff(IGNORED_ARG)); /*the other reader of count 0 leaves*/
+    STRICT_EXPECTED_CALL(InterlockedHL_Backoff(IGNORED_ARG)); /*the reader of count 1 leaves*/
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(&slot.writer_mutex));
+
+    ///act
+    result = thandle_atomic_slot_exchange(&slot, (void*)0x43, &previous_value);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, previous_value);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[0]);
+    ASSERT_ARE_EQUAL(int32_t, 0, slot.readers[1]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    REGISTER_GLOBAL_MOCK_HOOK(InterlockedHL_Backoff, real_InterlockedHL_Backoff);
+}
+
+/* THANDLE_ATOMIC_INIT */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_021: [ If atomic is NULL then THANDLE_ATOMIC_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_INIT_with_atomic_NULL_fails)
+{
+    ///arrange
+    int result;
+
+    ///act
+    result = THANDLE_ATOMIC_INIT(TEST_ITEM)(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_023: [ THANDLE_ATOMIC_INIT shall call thandle_atomic_slot_init with value. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_025: [ THANDLE_ATOMIC_INIT shall succeed and return 0. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_INIT_with_value_NULL_succeeds)
+{
+    ///arrange
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    THANDLE(TEST_ITEM) loaded = NULL;
+    int result;
+
+    ///act
+    result = THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    THANDLE_ATOMIC_LOAD(TEST_ITEM)(&atomic, &loaded);
+    ASSERT_IS_NULL(loaded);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_022: [ THANDLE_ATOMIC_INIT shall call THANDLE_INC_REF on value (if not NULL). ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_023: [ THANDLE_ATOMIC_INIT shall call thandle_atomic_slot_init with value. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_025: [ THANDLE_ATOMIC_INIT shall succeed and return 0. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_INIT_keeps_a_reference_of_value)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) item = TEST_ITEM_create(1);
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    int result;
+
+    ///act
+    result = THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, item);
+    THANDLE_ASSIGN(TEST_ITEM)(&item, NULL); /*the slot keeps the item alive*/
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_ATOMIC_DEINIT(TEST_ITEM)(&atomic);
+}
+
+/* THANDLE_ATOMIC_DEINIT */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_026: [ If atomic is NULL then THANDLE_ATOMIC_DEINIT shall return. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_DEINIT_with_atomic_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_ATOMIC_DEINIT(TEST_ITEM)(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_027: [ THANDLE_ATOMIC_DEINIT shall call THANDLE_ATOMIC_STORE with NULL. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_DEINIT_releases_the_value)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) item = TEST_ITEM_create(1);
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, item));
+    THANDLE_ASSIGN(TEST_ITEM)(&item, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    THANDLE_ATOMIC_DEINIT(TEST_ITEM)(&atomic);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* THANDLE_ATOMIC_LOAD */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_028: [ If atomic is NULL then THANDLE_ATOMIC_LOAD shall return. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_LOAD_with_atomic_NULL_returns)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) loaded = NULL;
+
+    ///act
+    THANDLE_ATOMIC_LOAD(TEST_ITEM)(NULL, &loaded);
+
+    ///assert
+    ASSERT_IS_NULL(loaded);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_029: [ If lvalue is NULL then THANDLE_ATOMIC_LOAD shall return. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_LOAD_with_lvalue_NULL_returns)
+{
+    ///arrange
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, NULL));
+
+    ///act
+    THANDLE_ATOMIC_LOAD(TEST_ITEM)(&atomic, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int32_t, 0, atomic.slot.readers[0]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_030: [ THANDLE_ATOMIC_LOAD shall call thandle_atomic_slot_read_begin. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_031: [ THANDLE_ATOMIC_LOAD shall call THANDLE_INC_REF on the value returned by thandle_atomic_slot_read_begin (if not NULL). ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_032: [ THANDLE_ATOMIC_LOAD shall call thandle_atomic_slot_read_end. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_033: [ THANDLE_ATOMIC_LOAD shall store the value in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_LOAD_takes_a_reference_of_the_value)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) item = TEST_ITEM_create(1);
+    THANDLE(TEST_ITEM) loaded = NULL;
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, item));
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_ATOMIC_LOAD(TEST_ITEM)(&atomic, &loaded);
+
+    ///assert
+    ASSERT_IS_TRUE(loaded == item);
+    ASSERT_ARE_EQUAL(int32_t, 0, atomic.slot.readers[0]);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    THANDLE_ATOMIC_DEINIT(TEST_ITEM)(&atomic);
+    THANDLE_ASSIGN(TEST_ITEM)(&item, NULL);
+    umock_c_reset_all_calls();
+    ASSERT_ARE_EQUAL(int, 1, loaded->a); /*loaded still keeps the item alive*/
+
+    ///clean
+    THANDLE_ASSIGN(TEST_ITEM)(&loaded, NULL);
+}
+
+/* THANDLE_ATOMIC_EXCHANGE */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_034: [ If atomic is NULL then THANDLE_ATOMIC_EXCHANGE shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_EXCHANGE_with_atomic_NULL_fails)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) previous = NULL;
+    int result;
+
+    ///act
+    result = THANDLE_ATOMIC_EXCHANGE(TEST_ITEM)(NULL, NULL, &previous);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_035: [ If previous is NULL then THANDLE_ATOMIC_EXCHANGE shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_EXCHANGE_with_previous_NULL_fails)
+{
+    ///arrange
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, NULL));
+    int result;
+
+    ///act
+    result = THANDLE_ATOMIC_EXCHANGE(TEST_ITEM)(&atomic, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_036: [ THANDLE_ATOMIC_EXCHANGE shall call THANDLE_INC_REF on value (if not NULL). ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_037: [ THANDLE_ATOMIC_EXCHANGE shall call thandle_atomic_slot_exchange with value. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_039: [ THANDLE_ATOMIC_EXCHANGE shall move the reference of the previous value under *previous, succeed and return 0. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_EXCHANGE_succeeds)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) item1 = TEST_ITEM_create(1);
+    THANDLE(TEST_ITEM) item2 = TEST_ITEM_create(2);
+    THANDLE(TEST_ITEM) previous = NULL;
+    THANDLE(TEST_ITEM) loaded = NULL;
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, item1));
+    THANDLE_ASSIGN(TEST_ITEM)(&item1, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+
+    ///act
+    int result = THANDLE_ATOMIC_EXCHANGE(TEST_ITEM)(&atomic, item2, &previous);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(previous);
+    ASSERT_ARE_EQUAL(int, 1, previous->a);
+    THANDLE_ATOMIC_LOAD(TEST_ITEM)(&atomic, &loaded);
+    ASSERT_IS_TRUE(loaded == item2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_ASSIGN(TEST_ITEM)(&previous, NULL);
+    THANDLE_ASSIGN(TEST_ITEM)(&loaded, NULL);
+    THANDLE_ASSIGN(TEST_ITEM)(&item2, NULL);
+    THANDLE_ATOMIC_DEINIT(TEST_ITEM)(&atomic);
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_038: [ If thandle_atomic_slot_exchange fails then THANDLE_ATOMIC_EXCHANGE shall call THANDLE_DEC_REF on value (if not NULL), fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_thandle_atomic_slot_exchange_fails_THANDLE_ATOMIC_EXCHANGE_fails)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) item1 = TEST_ITEM_create(1);
+    THANDLE(TEST_ITEM) item2 = TEST_ITEM_create(2);
+    THANDLE(TEST_ITEM) previous = NULL;
+    THANDLE(TEST_ITEM) loaded = NULL;
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, item1));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    int result = THANDLE_ATOMIC_EXCHANGE(TEST_ITEM)(&atomic, item2, &previous);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    THANDLE_ATOMIC_LOAD(TEST_ITEM)(&atomic, &loaded);
+    ASSERT_IS_TRUE(loaded == item1);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG)); /*item2 was given back the reference that THANDLE_ATOMIC_EXCHANGE took*/
+    THANDLE_ASSIGN(TEST_ITEM)(&item2, NULL);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_ASSIGN(TEST_ITEM)(&loaded, NULL);
+    THANDLE_ASSIGN(TEST_ITEM)(&item1, NULL);
+    THANDLE_ATOMIC_DEINIT(TEST_ITEM)(&atomic);
+}
+
+/* THANDLE_ATOMIC_STORE */
+
+/*Tests_SRS_THANDLE_ATOMIC_02_040: [ THANDLE_ATOMIC_STORE shall call THANDLE_ATOMIC_EXCHANGE. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_041: [ If THANDLE_ATOMIC_EXCHANGE fails then THANDLE_ATOMIC_STORE shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_STORE_with_atomic_NULL_fails)
+{
+    ///arrange
+    int result;
+
+    ///act
+    result = THANDLE_ATOMIC_STORE(TEST_ITEM)(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_ATOMIC_02_040: [ THANDLE_ATOMIC_STORE shall call THANDLE_ATOMIC_EXCHANGE. ]*/
+/*Tests_SRS_THANDLE_ATOMIC_02_042: [ THANDLE_ATOMIC_STORE shall release the previous value with THANDLE_ASSIGN, succeed and return 0. ]*/
+TEST_FUNCTION(THANDLE_ATOMIC_STORE_releases_the_previous_value)
+{
+    ///arrange
+    THANDLE(TEST_ITEM) item1 = TEST_ITEM_create(1);
+    THANDLE(TEST_ITEM) item2 = TEST_ITEM_create(2);
+    THANDLE(TEST_ITEM) loaded = NULL;
+    THANDLE_ATOMIC(TEST_ITEM) atomic;
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_ATOMIC_INIT(TEST_ITEM)(&atomic, item1));
+    THANDLE_ASSIGN(TEST_ITEM)(&item1, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG)); /*item1 goes away*/
+
+    ///act
+    int result = THANDLE_ATOMIC_STORE(TEST_ITEM)(&atomic, item2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    THANDLE_ATOMIC_LOAD(TEST_ITEM)(&atomic, &loaded);
+    ASSERT_IS_TRUE(loaded == item2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_ASSIGN(TEST_ITEM)(&loaded, NULL);
+    THANDLE_ASSIGN(TEST_ITEM)(&item2, NULL);
+    THANDLE_ATOMIC_DEINIT(TEST_ITEM)(&atomic);
+}
+
+END_TEST_SUITE(thandle_atomic_unittests)
@@ -0,0 +1,177 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#else
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#include "testrunnerswitcher.h"
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "azure_c_logging/xlogging.h"
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/interlocked.h"
+#include "azure_c_pal/threadapi.h"
+#include "azure_c_pal/timer.h"
+
+#include "azure_c_util/thandle.h"
+
+/*thandle_perf measures the cost of copying and releasing a handle with THANDLE(T) (interlocked ref count) and with THANDLE_LOCAL(T) (plain local ref count),
+while 0 or more background threads copy and release THANDLE(T)s of the same object. It does not assert on the numbers (the machines running the tests are too different),
+it prints one CSV line per measurement on stdout so that the results of different builds can be compared by scripts:
+scenario,background_threads,copies,elapsed_ms,avg_copy_ns*/
+
+TEST_DEFINE_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+
+#define THANDLE_PERF_COPIES 10000000 /*how many copy + release are measured for every scenario*/
+#define THANDLE_PERF_MAX_BACKGROUND_THREADS 3
+
+#define PERF_ITEM_FIELDS    \
+    int64_t, value,         \
+    int64_t, unused
+
+MU_DEFINE_STRUCT(PERF_ITEM, PERF_ITEM_FIELDS);
+
+#define THANDLE_MALLOC_FUNCTION gballoc_hl_malloc
+#define THANDLE_FREE_FUNCTION gballoc_hl_free
+#ifdef __cplusplus
+extern "C" {
+#endif
+    THANDLE_LOCAL_TYPE_DECLARE(PERF_ITEM);
+    THANDLE_LOCAL_TYPE_DEFINE(PERF_ITEM);
+#ifdef __cplusplus
+}
+#endif
+#undef THANDLE_MALLOC_FUNCTION
+#undef THANDLE_FREE_FUNCTION
+
+typedef struct BACKGROUND_CONTEXT_TAG
+{
+    volatile_atomic int32_t stop;
+    PERF_ITEM* item; /*the main thread keeps the item alive until all background threads are joined*/
+}BACKGROUND_CONTEXT;
+
+/*copies and releases THANDLE(PERF_ITEM)s of the item until told to stop, this keeps the cache line of the ref count moving between processors*/
+static int background_thread(void* arg)
+{
+    BACKGROUND_CONTEXT* context = (BACKGROUND_CONTEXT*)arg;
+
+    while (interlocked_add(&context->stop, 0) == 0)
+    {
+        THANDLE(PERF_ITEM) copy = NULL;
+        THANDLE_INITIALIZE(PERF_ITEM)(&copy, context->item);
+        THANDLE_ASSIGN(PERF_ITEM)(&copy, NULL);
+    }
+
+    return 0;
+}
+
+static void print_csv_line(const char* scenario, uint32_t background_threads, int64_t copies, double elapsed_ms)
+{
+    (void)printf("%s,%" PRIu32 ",%" PRId64 ",%.3f,%.3f\n",
+        scenario, background_threads, copies, elapsed_ms, (copies > 0) ? elapsed_ms * 1000000 / copies : 0);
+    (void)fflush(stdout);
+}
+
+static double measure_thandle_copies(THANDLE(PERF_ITEM) item)
+{
+    int64_t sum = 0;
+    double start = timer_global_get_elapsed_ms();
+    for (int64_t i = 0; i < THANDLE_PERF_COPIES; i++)
+    {
+        THANDLE(PERF_ITEM) copy = NULL;
+        THANDLE_INITIALIZE(PERF_ITEM)(&copy, item);
+        sum += copy->value;
+        THANDLE_ASSIGN(PERF_ITEM)(&copy, NULL);
+    }
+    double elapsed_ms = timer_global_get_elapsed_ms() - start;
+    ASSERT_ARE_EQUAL(int64_t, THANDLE_PERF_COPIES, sum);
+    return elapsed_ms;
+}
+
+static double measure_thandle_local_copies(THANDLE_LOCAL(PERF_ITEM) local)
+{
+    int64_t sum = 0;
+    double start = timer_global_get_elapsed_ms();
+    for (int64_t i = 0; i < THANDLE_PERF_COPIES; i++)
+    {
+        THANDLE_LOCAL(PERF_ITEM) copy = NULL;
+        THANDLE_LOCAL_INITIALIZE(PERF_ITEM)(&copy, local);
+        sum += THANDLE_LOCAL_GET_T(PERF_ITEM)(copy)->value;
+        THANDLE_LOCAL_ASSIGN(PERF_ITEM)(&copy, NULL);
+    }
+    double elapsed_ms = timer_global_get_elapsed_ms() - start;
+    ASSERT_ARE_EQUAL(int64_t, THANDLE_PERF_COPIES, sum);
+    return elapsed_ms;
+}
+
+BEGIN_TEST_SUITE(thandle_perf)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    ASSERT_ARE_EQUAL(int, 0, gballoc_hl_init(NULL, NULL));
+
+    (void)printf("scenario,background_threads,copies,elapsed_ms,avg_copy_ns\n");
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    gballoc_hl_deinit();
+}
+
+/*the main thread copies and releases the same object THANDLE_PERF_COPIES times with THANDLE(T) and then with THANDLE_LOCAL(T),
+while background threads copy and release THANDLE(T)s of that object*/
+TEST_FUNCTION(thandle_perf_copy_and_release)
+{
+    uint32_t background_threads[] = { 0, 1, THANDLE_PERF_MAX_BACKGROUND_THREADS };
+
+    for (uint32_t i = 0; i < sizeof(background_threads) / sizeof(background_threads[0]); i++)
+    {
+        ///arrange
+        PERF_ITEM source = { 1, 0 };
+        THANDLE(PERF_ITEM) item = THANDLE_CREATE_FROM_CONTENT(PERF_ITEM)(&source, NULL, NULL);
+        ASSERT_IS_NOT_NULL(item);
+        THANDLE(PERF_ITEM) shared = NULL;
+        THANDLE_INITIALIZE(PERF_ITEM)(&shared, item);
+        THANDLE_LOCAL(PERF_ITEM) local = NULL;
+        THANDLE_LOCAL_INITIALIZE_MOVE(PERF_ITEM)(&local, &shared);
+
+        BACKGROUND_CONTEXT context;
+        THREAD_HANDLE threads[THANDLE_PERF_MAX_BACKGROUND_THREADS];
+        (void)interlocked_exchange(&context.stop, 0);
+        context.item = THANDLE_GET_T(PERF_ITEM)(item);
+        for (uint32_t j = 0; j < background_threads[i]; j++)
+        {
+            ASSERT_ARE_EQUAL(THREADAPI_RESULT, THREADAPI_OK, ThreadAPI_Create(&threads[j], background_thread, &context));
+        }
+
+        ///act
+        double thandle_elapsed_ms = measure_thandle_copies(item);
+        double thandle_local_elapsed_ms = measure_thandle_local_copies(local);
+
+        ///assert
+        print_csv_line("thandle_copy", background_threads[i], THANDLE_PERF_COPIES, thandle_elapsed_ms);
+        print_csv_line("thandle_local_copy", background_threads[i], THANDLE_PERF_COPIES, thandle_local_elapsed_ms);
+
+        ///clean
+        (void)interlocked_exchange(&context.stop, 1);
+        for (uint32_t j = 0; j < background_threads[i]; j++)
+        {
+            int dont_care;
+            ASSERT_ARE_EQUAL(THREADAPI_RESULT, THREADAPI_OK, ThreadAPI_Join(threads[j], &dont_care));
+        }
+        THANDLE_LOCAL_ASSIGN(PERF_ITEM)(&local, NULL);
+        THANDLE_ASSIGN(PERF_ITEM)(&item, NULL);
+    }
+}
+
+END_TEST_SUITE(thandle_perf)
@@ -0,0 +1,895 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/processor_index.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+#include "real_gballoc_hl.h"
+
+#include "azure_c_util/thandle_pool.h"
+
+#define TEST_PROCESSOR_COUNT 2
+#define TEST_ITEMS_PER_PROCESSOR 2
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+/*a type whose wrappers are pooled*/
+#define TEST_POOLED_FIELDS  \
+    int, a                  \
+
+MU_DEFINE_STRUCT(TEST_POOLED, TEST_POOLED_FIELDS);
+
+THANDLE_TYPE_DECLARE(TEST_POOLED);
+
+#define THANDLE_MALLOC_FUNCTION malloc
+#define THANDLE_FREE_FUNCTION free
+THANDLE_TYPE_DEFINE_WITH_POOL(TEST_POOLED);
+#undef THANDLE_MALLOC_FUNCTION
+#undef THANDLE_FREE_FUNCTION
+
+static THANDLE_POOL_HANDLE TEST_thandle_pool_create(size_t item_size)
+{
+    THANDLE_POOL_HANDLE result;
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    result = thandle_pool_create(item_size, TEST_ITEMS_PER_PROCESSOR);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void TEST_POOLED_pool_init(size_t extra_size)
+{
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_POOL_INIT(TEST_POOLED)(extra_size, TEST_ITEMS_PER_PROCESSOR));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+}
+
+static void ASSERT_STATISTICS(THANDLE_POOL_HANDLE thandle_pool, uint64_t hits, uint64_t misses, uint64_t returns, uint64_t foreign_frees, uint32_t free_item_count)
+{
+    THANDLE_POOL_STATISTICS statistics;
+    ASSERT_ARE_EQUAL(int, 0, thandle_pool_get_statistics(thandle_pool, &statistics));
+    ASSERT_ARE_EQUAL(uint64_t, hits, statistics.hits);
+    ASSERT_ARE_EQUAL(uint64_t, misses, statistics.misses);
+    ASSERT_ARE_EQUAL(uint64_t, returns, statistics.returns);
+    ASSERT_ARE_EQUAL(uint64_t, foreign_frees, statistics.foreign_frees);
+    ASSERT_ARE_EQUAL(uint32_t, TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR, statistics.item_count);
+    ASSERT_ARE_EQUAL(uint32_t, free_item_count, statistics.free_item_count);
+}
+
+BEGIN_TEST_SUITE(thandle_pool_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    ASSERT_ARE_EQUAL(int, 0, real_gballoc_hl_init(NULL, NULL));
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_bool_register_types());
+
+    REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_count, TEST_PROCESSOR_COUNT, 0);
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_current, 0, 0);
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+
+    real_gballoc_hl_deinit();
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_001: [ If item_size is 0 or greater than SIZE_MAX - THANDLE_POOL_ITEM_ALIGNMENT then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_pool_create_with_item_size_0_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    ///act
+    thandle_pool = thandle_pool_create(0, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_001: [ If item_size is 0 or greater than SIZE_MAX - THANDLE_POOL_ITEM_ALIGNMENT then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_pool_create_with_item_size_SIZE_MAX_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    ///act
+    thandle_pool = thandle_pool_create(SIZE_MAX, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_002: [ If items_per_processor is 0 or greater than THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_pool_create_with_items_per_processor_0_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    ///act
+    thandle_pool = thandle_pool_create(16, 0);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_002: [ If items_per_processor is 0 or greater than THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_pool_create_with_too_many_items_per_processor_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    ///act
+    thandle_pool = thandle_pool_create(16, THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR + 1);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_003: [ thandle_pool_create shall allocate memory for the pool. ]*/
+/*Tests_SRS_THANDLE_POOL_02_004: [ thandle_pool_create shall allocate one cache line aligned partition for every processor returned by processor_index_get_count. ]*/
+/*Tests_SRS_THANDLE_POOL_02_005: [ thandle_pool_create shall allocate a slab of items_per_processor items of item_size bytes for every partition. ]*/
+/*Tests_SRS_THANDLE_POOL_02_007: [ thandle_pool_create shall put all the items in the pool, set all the statistics to 0, succeed and return a non-NULL value. ]*/
+TEST_FUNCTION(thandle_pool_create_succeeds)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    thandle_pool = thandle_pool_create(16, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_pool, 0, 0, 0, 0, TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR);
+
+    ///clean
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_007: [ thandle_pool_create shall put all the items in the pool, set all the statistics to 0, succeed and return a non-NULL value. ]*/
+TEST_FUNCTION(thandle_pool_create_with_THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR_succeeds)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+    THANDLE_POOL_STATISTICS statistics;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+
+    ///act
+    thandle_pool = thandle_pool_create(1, THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, thandle_pool_get_statistics(thandle_pool, &statistics));
+    ASSERT_ARE_EQUAL(uint32_t, TEST_PROCESSOR_COUNT * THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR, statistics.item_count);
+    ASSERT_ARE_EQUAL(uint32_t, TEST_PROCESSOR_COUNT * THANDLE_POOL_MAX_ITEMS_PER_PROCESSOR, statistics.free_item_count);
+
+    ///clean
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_thandle_pool_create_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    thandle_pool = thandle_pool_create(16, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(when_processor_index_get_count_returns_0_thandle_pool_create_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count())
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_pool = thandle_pool_create(16, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_for_the_partitions_fails_thandle_pool_create_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_pool = thandle_pool_create(16, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_006: [ If there are any failures then thandle_pool_create shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_for_the_slab_fails_thandle_pool_create_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_pool = thandle_pool_create(16, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_008: [ If thandle_pool is NULL then thandle_pool_destroy shall return. ]*/
+TEST_FUNCTION(thandle_pool_destroy_with_thandle_pool_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    thandle_pool_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_009: [ thandle_pool_destroy shall free the slab, the partitions and the pool. ]*/
+TEST_FUNCTION(thandle_pool_destroy_frees)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_pool_destroy(thandle_pool);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_010: [ If thandle_pool is NULL then thandle_pool_malloc shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_pool_malloc_with_thandle_pool_NULL_fails)
+{
+    ///arrange
+    void* item;
+
+    ///act
+    item = thandle_pool_malloc(NULL, 16);
+
+    ///assert
+    ASSERT_IS_NULL(item);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_011: [ If size is greater than the size of the items then thandle_pool_malloc shall count a miss and return NULL. ]*/
+TEST_FUNCTION(thandle_pool_malloc_with_size_greater_than_the_items_returns_NULL)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+    void* item;
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    item = thandle_pool_malloc(thandle_pool, 17);
+
+    ///assert
+    ASSERT_IS_NULL(item);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_pool, 0, 1, 0, 0, TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR);
+
+    ///clean
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_012: [ thandle_pool_malloc shall look for a free item in the partition of the current processor (as returned by processor_index_get_current) and then in the partitions of the other processors. ]*/
+/*Tests_SRS_THANDLE_POOL_02_013: [ thandle_pool_malloc shall take the free item by clearing its bit in the free items of the partition with interlocked_compare_exchange_64. ]*/
+/*Tests_SRS_THANDLE_POOL_02_014: [ thandle_pool_malloc shall count a hit and return the item. ]*/
+TEST_FUNCTION(thandle_pool_malloc_takes_the_items_of_the_current_processor_first)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+    unsigned char* item1;
+    unsigned char* item2;
+    unsigned char* item3;
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+
+    ///act
+    item1 = thandle_pool_malloc(thandle_pool, 16);
+    item2 = thandle_pool_malloc(thandle_pool, 16);
+    item3 = thandle_pool_malloc(thandle_pool, 16); /*partition 1 is empty, this one comes from partition 0*/
+
+    ///assert
+    ASSERT_IS_NOT_NULL(item1);
+    ASSERT_IS_NOT_NULL(item2);
+    ASSERT_IS_NOT_NULL(item3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(item2 == item1 + 16);
+    ASSERT_IS_TRUE(item3 == item1 - TEST_ITEMS_PER_PROCESSOR * 16);
+    ASSERT_STATISTICS(thandle_pool, 3, 0, 0, 0, TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR - 3);
+
+    ///clean
+    ASSERT_IS_TRUE(thandle_pool_free(thandle_pool, item1));
+    ASSERT_IS_TRUE(thandle_pool_free(thandle_pool, item2));
+    ASSERT_IS_TRUE(thandle_pool_free(thandle_pool, item3));
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_016: [ If there are no free items then thandle_pool_malloc shall count a miss and return NULL. ]*/
+TEST_FUNCTION(thandle_pool_malloc_when_the_pool_is_empty_returns_NULL)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+    void* items[TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR];
+    void* item;
+    uint32_t i;
+    for (i = 0; i < TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR; i++)
+    {
+        items[i] = thandle_pool_malloc(thandle_pool, 16);
+        ASSERT_IS_NOT_NULL(items[i]);
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    item = thandle_pool_malloc(thandle_pool, 16);
+
+    ///assert
+    ASSERT_IS_NULL(item);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_pool, TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR, 1, 0, 0, 0);
+
+    ///clean
+    for (i = 0; i < TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR; i++)
+    {
+        ASSERT_IS_TRUE(thandle_pool_free(thandle_pool, items[i]));
+    }
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_017: [ If thandle_pool is NULL then thandle_pool_free shall fail and return false. ]*/
+TEST_FUNCTION(thandle_pool_free_with_thandle_pool_NULL_fails)
+{
+    ///arrange
+    int a;
+
+    ///act
+    bool result = thandle_pool_free(NULL, &a);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_018: [ If ptr is NULL then thandle_pool_free shall fail and return false. ]*/
+TEST_FUNCTION(thandle_pool_free_with_ptr_NULL_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+
+    ///act
+    bool result = thandle_pool_free(thandle_pool, NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_019: [ If ptr is not an item of the slab then thandle_pool_free shall count a foreign free and return false. ]*/
+TEST_FUNCTION(thandle_pool_free_with_foreign_ptr_returns_false)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+    int a;
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    bool result = thandle_pool_free(thandle_pool, &a);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_pool, 0, 0, 0, 1, TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR);
+
+    ///clean
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_020: [ thandle_pool_free shall put the item back in the partition that owns it by setting its bit with interlocked_or_64. ]*/
+/*Tests_SRS_THANDLE_POOL_02_021: [ thandle_pool_free shall count a return and return true. ]*/
+TEST_FUNCTION(thandle_pool_free_gives_the_item_back)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+    void* item = thandle_pool_malloc(thandle_pool, 16);
+    void* item_again;
+    ASSERT_IS_NOT_NULL(item);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    bool result = thandle_pool_free(thandle_pool, item);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_pool, 1, 0, 1, 0, TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR);
+    item_again = thandle_pool_malloc(thandle_pool, 16);
+    ASSERT_ARE_EQUAL(void_ptr, item, item_again);
+
+    ///clean
+    ASSERT_IS_TRUE(thandle_pool_free(thandle_pool, item_again));
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_020: [ thandle_pool_free shall put the item back in the partition that owns it by setting its bit with interlocked_or_64. ]*/
+TEST_FUNCTION(thandle_pool_free_on_another_processor_gives_the_item_back_to_its_partition)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+    void* item = thandle_pool_malloc(thandle_pool, 16); /*taken on processor 0*/
+    void* item_again;
+    ASSERT_IS_NOT_NULL(item);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+
+    ///act
+    bool result = thandle_pool_free(thandle_pool, item);
+
+    ///assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    item_again = thandle_pool_malloc(thandle_pool, 16); /*taken on processor 0 again*/
+    ASSERT_ARE_EQUAL(void_ptr, item, item_again);
+
+    ///clean
+    ASSERT_IS_TRUE(thandle_pool_free(thandle_pool, item_again));
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_022: [ If thandle_pool is NULL then thandle_pool_get_statistics shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_pool_get_statistics_with_thandle_pool_NULL_fails)
+{
+    ///arrange
+    THANDLE_POOL_STATISTICS statistics;
+
+    ///act
+    int result = thandle_pool_get_statistics(NULL, &statistics);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_023: [ If statistics is NULL then thandle_pool_get_statistics shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_pool_get_statistics_with_statistics_NULL_fails)
+{
+    ///arrange
+    THANDLE_POOL_HANDLE thandle_pool = TEST_thandle_pool_create(16);
+
+    ///act
+    int result = thandle_pool_get_statistics(thandle_pool, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    thandle_pool_destroy(thandle_pool);
+}
+
+/*Tests_SRS_THANDLE_POOL_02_035: [ If the pool of T does not exist or it is empty then THANDLE_MALLOC shall allocate memory. ]*/
+/*Tests_SRS_THANDLE_POOL_02_037: [ THANDLE_MALLOC shall initialize the reference count to 1, store dispose and return a T*. ]*/
+/*Tests_SRS_THANDLE_POOL_02_045: [ If the pool of T does not exist or the wrapper is not an item of the pool then THANDLE_FREE shall free the memory. ]*/
+TEST_FUNCTION(THANDLE_MALLOC_without_pool_allocates_memory)
+{
+    ///arrange
+    TEST_POOLED* t;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    t = THANDLE_MALLOC(TEST_POOLED)(NULL);
+    ASSERT_IS_NOT_NULL(t);
+    THANDLE_DEC_REF(TEST_POOLED)(t);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_036: [ If allocating memory fails then THANDLE_MALLOC shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_THANDLE_MALLOC_fails)
+{
+    ///arrange
+    TEST_POOLED* t;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    t = THANDLE_MALLOC(TEST_POOLED)(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(t);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_027: [ THANDLE_POOL_INIT shall call thandle_pool_create with sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) + extra_size as item size and items_per_processor. ]*/
+/*Tests_SRS_THANDLE_POOL_02_029: [ THANDLE_POOL_INIT shall succeed and return 0. ]*/
+/*Tests_SRS_THANDLE_POOL_02_031: [ THANDLE_POOL_DEINIT shall call thandle_pool_destroy and forget the pool of T. ]*/
+TEST_FUNCTION(THANDLE_POOL_INIT_and_THANDLE_POOL_DEINIT_succeed)
+{
+    ///arrange
+    int result;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    result = THANDLE_POOL_INIT(TEST_POOLED)(0, TEST_ITEMS_PER_PROCESSOR);
+    THANDLE_POOL_DEINIT(TEST_POOLED)();
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_025: [ If the pool of T already exists then THANDLE_POOL_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_POOL_INIT_twice_fails)
+{
+    ///arrange
+    int result;
+    TEST_POOLED_pool_init(0);
+
+    ///act
+    result = THANDLE_POOL_INIT(TEST_POOLED)(0, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_POOL_DEINIT(TEST_POOLED)();
+}
+
+/*Tests_SRS_THANDLE_POOL_02_026: [ If extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) would exceed SIZE_MAX then THANDLE_POOL_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_POOL_INIT_with_extra_size_SIZE_MAX_fails)
+{
+    ///arrange
+    int result;
+
+    ///act
+    result = THANDLE_POOL_INIT(TEST_POOLED)(SIZE_MAX, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_028: [ If thandle_pool_create fails then THANDLE_POOL_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_thandle_pool_create_fails_THANDLE_POOL_INIT_fails)
+{
+    ///arrange
+    int result;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    result = THANDLE_POOL_INIT(TEST_POOLED)(0, TEST_ITEMS_PER_PROCESSOR);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_030: [ If the pool of T does not exist then THANDLE_POOL_DEINIT shall return. ]*/
+TEST_FUNCTION(THANDLE_POOL_DEINIT_without_pool_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_POOL_DEINIT(TEST_POOLED)();
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_032: [ If the pool of T does not exist then THANDLE_POOL_GET_STATISTICS shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_POOL_GET_STATISTICS_without_pool_fails)
+{
+    ///arrange
+    THANDLE_POOL_STATISTICS statistics;
+
+    ///act
+    int result = THANDLE_POOL_GET_STATISTICS(TEST_POOLED)(&statistics);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_034: [ If the pool of T exists then THANDLE_MALLOC shall take a wrapper from the pool by calling thandle_pool_malloc. ]*/
+/*Tests_SRS_THANDLE_POOL_02_044: [ If the pool of T exists then THANDLE_FREE shall give the wrapper back to the pool by calling thandle_pool_free. ]*/
+/*Tests_SRS_THANDLE_POOL_02_033: [ THANDLE_POOL_GET_STATISTICS shall return what thandle_pool_get_statistics returns. ]*/
+TEST_FUNCTION(THANDLE_MALLOC_with_pool_recycles_the_wrappers)
+{
+    ///arrange
+    TEST_POOLED* t1;
+    TEST_POOLED* t2;
+    THANDLE_POOL_STATISTICS statistics;
+    TEST_POOLED_pool_init(0);
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    t1 = THANDLE_MALLOC(TEST_POOLED)(NULL);
+    ASSERT_IS_NOT_NULL(t1);
+    THANDLE_DEC_REF(TEST_POOLED)(t1); /*no free, the wrapper goes back to the pool*/
+    t2 = THANDLE_MALLOC(TEST_POOLED)(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, t1, t2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_POOL_GET_STATISTICS(TEST_POOLED)(&statistics));
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.hits);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.returns);
+
+    ///clean
+    THANDLE_DEC_REF(TEST_POOLED)(t2);
+    THANDLE_POOL_DEINIT(TEST_POOLED)();
+}
+
+/*Tests_SRS_THANDLE_POOL_02_035: [ If the pool of T does not exist or it is empty then THANDLE_MALLOC shall allocate memory. ]*/
+/*Tests_SRS_THANDLE_POOL_02_045: [ If the pool of T does not exist or the wrapper is not an item of the pool then THANDLE_FREE shall free the memory. ]*/
+TEST_FUNCTION(THANDLE_MALLOC_with_empty_pool_allocates_memory)
+{
+    ///arrange
+    TEST_POOLED* ts[TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR];
+    TEST_POOLED* t;
+    uint32_t i;
+    TEST_POOLED_pool_init(0);
+    for (i = 0; i < TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR; i++)
+    {
+        ts[i] = THANDLE_MALLOC(TEST_POOLED)(NULL);
+        ASSERT_IS_NOT_NULL(ts[i]);
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    t = THANDLE_MALLOC(TEST_POOLED)(NULL);
+    ASSERT_IS_NOT_NULL(t);
+    THANDLE_DEC_REF(TEST_POOLED)(t);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    for (i = 0; i < TEST_PROCESSOR_COUNT * TEST_ITEMS_PER_PROCESSOR; i++)
+    {
+        THANDLE_DEC_REF(TEST_POOLED)(ts[i]);
+    }
+    THANDLE_POOL_DEINIT(TEST_POOLED)();
+}
+
+/*Tests_SRS_THANDLE_POOL_02_039: [ If the pool of T exists then THANDLE_MALLOC_WITH_EXTRA_SIZE shall take a wrapper from the pool by calling thandle_pool_malloc with extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)). ]*/
+/*Tests_SRS_THANDLE_POOL_02_042: [ THANDLE_MALLOC_WITH_EXTRA_SIZE shall initialize the reference count to 1, store dispose and return a T*. ]*/
+TEST_FUNCTION(THANDLE_MALLOC_WITH_EXTRA_SIZE_with_pool_takes_the_wrapper_from_the_pool)
+{
+    ///arrange
+    TEST_POOLED* t;
+    TEST_POOLED_pool_init(8);
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    t = THANDLE_MALLOC_WITH_EXTRA_SIZE(TEST_POOLED)(NULL, 8);
+    ASSERT_IS_NOT_NULL(t);
+    THANDLE_DEC_REF(TEST_POOLED)(t);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_POOL_DEINIT(TEST_POOLED)();
+}
+
+/*Tests_SRS_THANDLE_POOL_02_040: [ If the pool of T does not exist, it is empty or its items are too small then THANDLE_MALLOC_WITH_EXTRA_SIZE shall allocate memory enough to hold T and extra_size. ]*/
+TEST_FUNCTION(THANDLE_MALLOC_WITH_EXTRA_SIZE_with_items_too_small_allocates_memory)
+{
+    ///arrange
+    TEST_POOLED* t;
+    TEST_POOLED_pool_init(0);
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    t = THANDLE_MALLOC_WITH_EXTRA_SIZE(TEST_POOLED)(NULL, 1000);
+    ASSERT_IS_NOT_NULL(t);
+    THANDLE_DEC_REF(TEST_POOLED)(t);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_POOL_DEINIT(TEST_POOLED)();
+}
+
+/*Tests_SRS_THANDLE_POOL_02_038: [ If extra_size + sizeof(THANDLE_WRAPPER_TYPE_NAME(T)) would exceed SIZE_MAX then THANDLE_MALLOC_WITH_EXTRA_SIZE shall fail and return NULL. ]*/
+TEST_FUNCTION(THANDLE_MALLOC_WITH_EXTRA_SIZE_with_extra_size_SIZE_MAX_fails)
+{
+    ///arrange
+    TEST_POOLED* t;
+
+    ///act
+    t = THANDLE_MALLOC_WITH_EXTRA_SIZE(TEST_POOLED)(NULL, SIZE_MAX);
+
+    ///assert
+    ASSERT_IS_NULL(t);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_POOL_02_041: [ If allocating memory fails then THANDLE_MALLOC_WITH_EXTRA_SIZE shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_THANDLE_MALLOC_WITH_EXTRA_SIZE_fails)
+{
+    ///arrange
+    TEST_POOLED* t;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    t = THANDLE_MALLOC_WITH_EXTRA_SIZE(TEST_POOLED)(NULL, 8);
+
+    ///assert
+    ASSERT_IS_NULL(t);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(thandle_pool_unittests)
@@ -0,0 +1,898 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_util/interlocked_hl.h"
+#include "azure_c_util/processor_index.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+#include "real_gballoc_hl.h"
+
+#include "azure_c_util/thandle.h"
+#include "azure_c_util/thandle_telemetry.h"
+
+#define TEST_PROCESSOR_COUNT 2
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+/*a type whose wrappers are counted (this file is compiled with THANDLE_TELEMETRY)*/
+#define TEST_COUNTED_FIELDS     \
+    int, a                      \
+
+MU_DEFINE_STRUCT(TEST_COUNTED, TEST_COUNTED_FIELDS);
+
+THANDLE_TYPE_DECLARE(TEST_COUNTED);
+
+#define THANDLE_MALLOC_FUNCTION malloc
+#define THANDLE_FREE_FUNCTION free
+THANDLE_TYPE_DEFINE(TEST_COUNTED);
+#undef THANDLE_MALLOC_FUNCTION
+#undef THANDLE_FREE_FUNCTION
+
+#define TEST_MAX_TYPES 4
+
+typedef struct TEST_ENUMERATE_CONTEXT_TAG
+{
+    uint32_t count;
+    THANDLE_TELEMETRY_STATISTICS statistics[TEST_MAX_TYPES];
+}TEST_ENUMERATE_CONTEXT;
+
+static void test_on_type(void* context, const THANDLE_TELEMETRY_STATISTICS* statistics)
+{
+    TEST_ENUMERATE_CONTEXT* enumerate_context = (TEST_ENUMERATE_CONTEXT*)context;
+    ASSERT_IS_TRUE(enumerate_context->count < TEST_MAX_TYPES);
+    enumerate_context->statistics[enumerate_context->count] = *statistics;
+    enumerate_context->count++;
+}
+
+static THANDLE_TELEMETRY_HANDLE TEST_thandle_telemetry_register(const char* type_name)
+{
+    THANDLE_TELEMETRY_HANDLE result;
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+    result = thandle_telemetry_register(type_name);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void TEST_COUNTED_telemetry_init(void)
+{
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+    ASSERT_ARE_EQUAL(int, 0, THANDLE_TELEMETRY_INIT(TEST_COUNTED)());
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+}
+
+static void ASSERT_STATISTICS(THANDLE_TELEMETRY_HANDLE thandle_telemetry, uint64_t created_count, int64_t live_count, int64_t live_bytes, int64_t peak_count)
+{
+    THANDLE_TELEMETRY_STATISTICS statistics;
+    ASSERT_ARE_EQUAL(int, 0, thandle_telemetry_get_statistics(thandle_telemetry, &statistics));
+    ASSERT_ARE_EQUAL(uint64_t, created_count, statistics.created_count);
+    ASSERT_ARE_EQUAL(int64_t, live_count, statistics.live_count);
+    ASSERT_ARE_EQUAL(int64_t, live_bytes, statistics.live_bytes);
+    ASSERT_ARE_EQUAL(int64_t, peak_count, statistics.peak_count);
+}
+
+BEGIN_TEST_SUITE(thandle_telemetry_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    ASSERT_ARE_EQUAL(int, 0, real_gballoc_hl_init(NULL, NULL));
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
+
+    REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_count, TEST_PROCESSOR_COUNT, 0);
+    REGISTER_GLOBAL_MOCK_RETURNS(processor_index_get_current, 0, 0);
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+
+    real_gballoc_hl_deinit();
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* thandle_telemetry_register */
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_001: [ If type_name is NULL then thandle_telemetry_register shall fail and return NULL. ]*/
+TEST_FUNCTION(thandle_telemetry_register_with_type_name_NULL_fails)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry;
+
+    ///act
+    thandle_telemetry = thandle_telemetry_register(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(thandle_telemetry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_002: [ thandle_telemetry_register shall allocate memory for the telemetry of type_name. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_003: [ thandle_telemetry_register shall allocate one cache line aligned partition for every processor returned by processor_index_get_count. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_004: [ thandle_telemetry_register shall lock the registry by calling InterlockedHL_MutexLock. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_005: [ thandle_telemetry_register shall set all the counters to 0, add the telemetry to the registry, unlock the registry, succeed and return a non-NULL value. ]*/
+TEST_FUNCTION(thandle_telemetry_register_succeeds)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry;
+    THANDLE_TELEMETRY_STATISTICS statistics;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+
+    ///act
+    thandle_telemetry = thandle_telemetry_register("TEST_TYPE");
+
+    ///assert
+    ASSERT_IS_NOT_NULL(thandle_telemetry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, thandle_telemetry_get_statistics(thandle_telemetry, &statistics));
+    ASSERT_ARE_EQUAL(char_ptr, "TEST_TYPE", statistics.type_name);
+    ASSERT_STATISTICS(thandle_telemetry, 0, 0, 0, 0);
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_thandle_telemetry_register_fails)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    thandle_telemetry = thandle_telemetry_register("TEST_TYPE");
+
+    ///assert
+    ASSERT_IS_NULL(thandle_telemetry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+TEST_FUNCTION(when_processor_index_get_count_returns_0_thandle_telemetry_register_fails)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count())
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_telemetry = thandle_telemetry_register("TEST_TYPE");
+
+    ///assert
+    ASSERT_IS_NULL(thandle_telemetry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_for_the_partitions_fails_thandle_telemetry_register_fails)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_telemetry = thandle_telemetry_register("TEST_TYPE");
+
+    ///assert
+    ASSERT_IS_NULL(thandle_telemetry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_006: [ If there are any failures then thandle_telemetry_register shall fail and return NULL. ]*/
+TEST_FUNCTION(when_InterlockedHL_MutexLock_fails_thandle_telemetry_register_fails)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_telemetry = thandle_telemetry_register("TEST_TYPE");
+
+    ///assert
+    ASSERT_IS_NULL(thandle_telemetry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* thandle_telemetry_unregister */
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_007: [ If thandle_telemetry is NULL then thandle_telemetry_unregister shall return. ]*/
+TEST_FUNCTION(thandle_telemetry_unregister_with_thandle_telemetry_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    thandle_telemetry_unregister(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_008: [ thandle_telemetry_unregister shall lock the registry by calling InterlockedHL_MutexLock. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_010: [ thandle_telemetry_unregister shall remove the telemetry from the registry and unlock the registry. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_011: [ thandle_telemetry_unregister shall free the partitions and the telemetry. ]*/
+TEST_FUNCTION(thandle_telemetry_unregister_removes_the_type_from_the_registry)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE one = TEST_thandle_telemetry_register("ONE");
+    THANDLE_TELEMETRY_HANDLE two = TEST_thandle_telemetry_register("TWO");
+    TEST_ENUMERATE_CONTEXT context;
+    context.count = 0;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    thandle_telemetry_unregister(one);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, thandle_telemetry_enumerate(test_on_type, &context));
+    ASSERT_ARE_EQUAL(uint32_t, 1, context.count);
+    ASSERT_ARE_EQUAL(char_ptr, "TWO", context.statistics[0].type_name);
+
+    ///clean
+    thandle_telemetry_unregister(two);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_009: [ If InterlockedHL_MutexLock fails then thandle_telemetry_unregister shall return. ]*/
+TEST_FUNCTION(when_InterlockedHL_MutexLock_fails_thandle_telemetry_unregister_returns)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    thandle_telemetry_unregister(thandle_telemetry);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/* thandle_telemetry_on_create */
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_012: [ If thandle_telemetry is NULL then thandle_telemetry_on_create shall return. ]*/
+TEST_FUNCTION(thandle_telemetry_on_create_with_thandle_telemetry_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    thandle_telemetry_on_create(NULL, 16);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_013: [ thandle_telemetry_on_create shall add 1 to the created count, 1 to the pending count and size to the live bytes of the partition of the current processor (as returned by processor_index_get_current). ]*/
+TEST_FUNCTION(thandle_telemetry_on_create_counts_the_instance)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+
+    ///act
+    thandle_telemetry_on_create(thandle_telemetry, 16);
+    thandle_telemetry_on_create(thandle_telemetry, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_telemetry, 2, 2, 116, 2);
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_014: [ If the pending count of the partition reaches THANDLE_TELEMETRY_BATCH then thandle_telemetry_on_create shall move it to the live count and raise the peak count to the live count. ]*/
+TEST_FUNCTION(thandle_telemetry_on_create_raises_the_peak_count_every_THANDLE_TELEMETRY_BATCH_instances)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+    uint32_t i;
+
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        STRICT_EXPECTED_CALL(processor_index_get_current());
+    }
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        STRICT_EXPECTED_CALL(processor_index_get_current())
+            .SetReturn(1);
+    }
+
+    ///act
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        thandle_telemetry_on_create(thandle_telemetry, 1);
+    }
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        thandle_telemetry_on_free(thandle_telemetry, 1);
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_telemetry, THANDLE_TELEMETRY_BATCH, 0, 0, THANDLE_TELEMETRY_BATCH); /*the peak was only seen by thandle_telemetry_on_create*/
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/* thandle_telemetry_on_free */
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_015: [ If thandle_telemetry is NULL then thandle_telemetry_on_free shall return. ]*/
+TEST_FUNCTION(thandle_telemetry_on_free_with_thandle_telemetry_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    thandle_telemetry_on_free(NULL, 16);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_016: [ thandle_telemetry_on_free shall subtract 1 from the pending count and size from the live bytes of the partition of the current processor (as returned by processor_index_get_current). ]*/
+TEST_FUNCTION(thandle_telemetry_on_free_on_another_processor_counts_the_instance)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    thandle_telemetry_on_create(thandle_telemetry, 16);
+    thandle_telemetry_on_create(thandle_telemetry, 100);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+
+    ///act
+    thandle_telemetry_on_free(thandle_telemetry, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(thandle_telemetry, 2, 1, 16, 1); /*2 instances were never folded in the live count, so the peak count only sees 1*/
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_017: [ If the pending count of the partition reaches -THANDLE_TELEMETRY_BATCH then thandle_telemetry_on_free shall move it to the live count. ]*/
+TEST_FUNCTION(thandle_telemetry_on_free_moves_the_pending_count_every_THANDLE_TELEMETRY_BATCH_instances)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+    uint32_t i;
+
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        STRICT_EXPECTED_CALL(processor_index_get_current());
+        thandle_telemetry_on_create(thandle_telemetry, 1);
+    }
+    umock_c_reset_all_calls();
+
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        STRICT_EXPECTED_CALL(processor_index_get_current())
+            .SetReturn(1);
+    }
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        STRICT_EXPECTED_CALL(processor_index_get_current());
+    }
+
+    ///act
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        thandle_telemetry_on_free(thandle_telemetry, 1);
+    }
+    for (i = 0; i < THANDLE_TELEMETRY_BATCH; i++)
+    {
+        thandle_telemetry_on_create(thandle_telemetry, 1);
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    /*the frees were moved to the live count, so the second batch of instances does not raise the peak count*/
+    ASSERT_STATISTICS(thandle_telemetry, 2 * THANDLE_TELEMETRY_BATCH, THANDLE_TELEMETRY_BATCH, THANDLE_TELEMETRY_BATCH, THANDLE_TELEMETRY_BATCH);
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/* thandle_telemetry_get_statistics */
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_018: [ If thandle_telemetry is NULL then thandle_telemetry_get_statistics shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_telemetry_get_statistics_with_thandle_telemetry_NULL_fails)
+{
+    ///arrange
+    THANDLE_TELEMETRY_STATISTICS statistics;
+    int result;
+
+    ///act
+    result = thandle_telemetry_get_statistics(NULL, &statistics);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_019: [ If statistics is NULL then thandle_telemetry_get_statistics shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_telemetry_get_statistics_with_statistics_NULL_fails)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+    int result;
+
+    ///act
+    result = thandle_telemetry_get_statistics(thandle_telemetry, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_020: [ thandle_telemetry_get_statistics shall add the pending counts of all the partitions to the live count and sum the created counts and the live bytes of all the partitions. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_021: [ thandle_telemetry_get_statistics shall raise the peak count to the live count, succeed and return 0. ]*/
+TEST_FUNCTION(thandle_telemetry_get_statistics_sums_the_partitions_and_raises_the_peak_count)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+    THANDLE_TELEMETRY_STATISTICS statistics;
+    int result;
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(processor_index_get_current())
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    thandle_telemetry_on_create(thandle_telemetry, 10);
+    thandle_telemetry_on_create(thandle_telemetry, 20);
+    thandle_telemetry_on_create(thandle_telemetry, 30);
+    thandle_telemetry_on_free(thandle_telemetry, 20);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = thandle_telemetry_get_statistics(thandle_telemetry, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "TEST_TYPE", statistics.type_name);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics.created_count);
+    ASSERT_ARE_EQUAL(int64_t, 2, statistics.live_count);
+    ASSERT_ARE_EQUAL(int64_t, 40, statistics.live_bytes);
+    ASSERT_ARE_EQUAL(int64_t, 2, statistics.peak_count);
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/* thandle_telemetry_enumerate */
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_022: [ If on_type is NULL then thandle_telemetry_enumerate shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(thandle_telemetry_enumerate_with_on_type_NULL_fails)
+{
+    ///arrange
+    int result;
+
+    ///act
+    result = thandle_telemetry_enumerate(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_023: [ thandle_telemetry_enumerate shall lock the registry by calling InterlockedHL_MutexLock. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_025: [ For every registered type thandle_telemetry_enumerate shall call on_type with context and the statistics of the type (as thandle_telemetry_get_statistics would return them). ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_026: [ thandle_telemetry_enumerate shall unlock the registry, succeed and return 0. ]*/
+TEST_FUNCTION(thandle_telemetry_enumerate_calls_on_type_for_every_registered_type)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE one = TEST_thandle_telemetry_register("ONE");
+    THANDLE_TELEMETRY_HANDLE two = TEST_thandle_telemetry_register("TWO");
+    TEST_ENUMERATE_CONTEXT context;
+    int result;
+    context.count = 0;
+
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    thandle_telemetry_on_create(two, 64);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+
+    ///act
+    result = thandle_telemetry_enumerate(test_on_type, &context);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint32_t, 2, context.count);
+    ASSERT_ARE_EQUAL(char_ptr, "TWO", context.statistics[0].type_name);
+    ASSERT_ARE_EQUAL(uint64_t, 1, context.statistics[0].created_count);
+    ASSERT_ARE_EQUAL(int64_t, 1, context.statistics[0].live_count);
+    ASSERT_ARE_EQUAL(int64_t, 64, context.statistics[0].live_bytes);
+    ASSERT_ARE_EQUAL(int64_t, 1, context.statistics[0].peak_count);
+    ASSERT_ARE_EQUAL(char_ptr, "ONE", context.statistics[1].type_name);
+    ASSERT_ARE_EQUAL(int64_t, 0, context.statistics[1].live_count);
+
+    ///clean
+    thandle_telemetry_unregister(one);
+    thandle_telemetry_unregister(two);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_026: [ thandle_telemetry_enumerate shall unlock the registry, succeed and return 0. ]*/
+TEST_FUNCTION(thandle_telemetry_enumerate_without_registered_types_succeeds)
+{
+    ///arrange
+    TEST_ENUMERATE_CONTEXT context;
+    int result;
+    context.count = 0;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+
+    ///act
+    result = thandle_telemetry_enumerate(test_on_type, &context);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint32_t, 0, context.count);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_024: [ If InterlockedHL_MutexLock fails then thandle_telemetry_enumerate shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_InterlockedHL_MutexLock_fails_thandle_telemetry_enumerate_fails)
+{
+    ///arrange
+    TEST_ENUMERATE_CONTEXT context;
+    int result;
+    context.count = 0;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = thandle_telemetry_enumerate(test_on_type, &context);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint32_t, 0, context.count);
+}
+
+/* thandle_telemetry_log_all */
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_027: [ thandle_telemetry_log_all shall call thandle_telemetry_enumerate with a callback that logs the statistics of every type. ]*/
+/*Tests_SRS_THANDLE_TELEMETRY_02_029: [ thandle_telemetry_log_all shall succeed and return 0. ]*/
+TEST_FUNCTION(thandle_telemetry_log_all_succeeds)
+{
+    ///arrange
+    THANDLE_TELEMETRY_HANDLE thandle_telemetry = TEST_thandle_telemetry_register("TEST_TYPE");
+    int result;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+
+    ///act
+    result = thandle_telemetry_log_all();
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    thandle_telemetry_unregister(thandle_telemetry);
+}
+
+/*Tests_SRS_THANDLE_TELEMETRY_02_028: [ If thandle_telemetry_enumerate fails then thandle_telemetry_log_all shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_thandle_telemetry_enumerate_fails_thandle_telemetry_log_all_fails)
+{
+    ///arrange
+    int result;
+
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG))
+        .SetReturn(INTERLOCKED_HL_ERROR);
+
+    ///act
+    result = thandle_telemetry_log_all();
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* THANDLE_TELEMETRY_INIT(T) and THANDLE_TELEMETRY_DEINIT(T) */
+
+/*Tests_SRS_THANDLE_02_068: [ THANDLE_TELEMETRY_INIT shall call thandle_telemetry_register with the name of T. ]*/
+/*Tests_SRS_THANDLE_02_070: [ THANDLE_TELEMETRY_INIT shall succeed and return 0. ]*/
+/*Tests_SRS_THANDLE_02_072: [ THANDLE_TELEMETRY_DEINIT shall call thandle_telemetry_unregister and forget the telemetry of T. ]*/
+TEST_FUNCTION(THANDLE_TELEMETRY_INIT_and_THANDLE_TELEMETRY_DEINIT_succeed)
+{
+    ///arrange
+    int result;
+    TEST_ENUMERATE_CONTEXT context;
+    context.count = 0;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_count());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+
+    ///act
+    result = THANDLE_TELEMETRY_INIT(TEST_COUNTED)();
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, thandle_telemetry_enumerate(test_on_type, &context));
+    ASSERT_ARE_EQUAL(uint32_t, 1, context.count);
+    ASSERT_ARE_EQUAL(char_ptr, "TEST_COUNTED", context.statistics[0].type_name);
+
+    ///act
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexLock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(InterlockedHL_MutexUnlock(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    THANDLE_TELEMETRY_DEINIT(TEST_COUNTED)();
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(THANDLE_TELEMETRY_VARIABLE(TEST_COUNTED));
+}
+
+/*Tests_SRS_THANDLE_02_067: [ If T is already registered then THANDLE_TELEMETRY_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(THANDLE_TELEMETRY_INIT_twice_fails)
+{
+    ///arrange
+    int result;
+    TEST_COUNTED_telemetry_init();
+
+    ///act
+    result = THANDLE_TELEMETRY_INIT(TEST_COUNTED)();
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_TELEMETRY_DEINIT(TEST_COUNTED)();
+}
+
+/*Tests_SRS_THANDLE_02_069: [ If thandle_telemetry_register fails then THANDLE_TELEMETRY_INIT shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(when_thandle_telemetry_register_fails_THANDLE_TELEMETRY_INIT_fails)
+{
+    ///arrange
+    int result;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    result = THANDLE_TELEMETRY_INIT(TEST_COUNTED)();
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(THANDLE_TELEMETRY_VARIABLE(TEST_COUNTED));
+}
+
+/*Tests_SRS_THANDLE_02_071: [ If T is not registered then THANDLE_TELEMETRY_DEINIT shall return. ]*/
+TEST_FUNCTION(THANDLE_TELEMETRY_DEINIT_without_telemetry_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_TELEMETRY_DEINIT(TEST_COUNTED)();
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* counting the wrappers of T */
+
+/*Tests_SRS_THANDLE_02_074: [ If T is registered then the functions that create a THANDLE(T) shall remember the size of the wrapper and call thandle_telemetry_on_create with it. ]*/
+/*Tests_SRS_THANDLE_02_075: [ If T is registered and the wrapper was counted then THANDLE_FREE shall call thandle_telemetry_on_free with the size of the wrapper. ]*/
+TEST_FUNCTION(THANDLE_CREATE_FROM_CONTENT_and_THANDLE_FREE_count_the_wrapper)
+{
+    ///arrange
+    TEST_COUNTED source;
+    source.a = 42;
+    TEST_COUNTED_telemetry_init();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    THANDLE(TEST_COUNTED) counted = THANDLE_CREATE_FROM_CONTENT(TEST_COUNTED)(&source, NULL, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(counted);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(THANDLE_TELEMETRY_VARIABLE(TEST_COUNTED), 1, 1, sizeof(THANDLE_WRAPPER_TYPE_NAME(TEST_COUNTED)), 1);
+
+    ///act
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    THANDLE_ASSIGN(TEST_COUNTED)(&counted, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(THANDLE_TELEMETRY_VARIABLE(TEST_COUNTED), 1, 0, 0, 1);
+
+    ///clean
+    THANDLE_TELEMETRY_DEINIT(TEST_COUNTED)();
+}
+
+/*Tests_SRS_THANDLE_02_074: [ If T is registered then the functions that create a THANDLE(T) shall remember the size of the wrapper and call thandle_telemetry_on_create with it. ]*/
+/*Tests_SRS_THANDLE_02_075: [ If T is registered and the wrapper was counted then THANDLE_FREE shall call thandle_telemetry_on_free with the size of the wrapper. ]*/
+TEST_FUNCTION(THANDLE_MALLOC_WITH_EXTRA_SIZE_counts_the_extra_size)
+{
+    ///arrange
+    TEST_COUNTED_telemetry_init();
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+
+    ///act
+    THANDLE(TEST_COUNTED) counted = THANDLE_MALLOC_WITH_EXTRA_SIZE(TEST_COUNTED)(NULL, 100);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(counted);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(THANDLE_TELEMETRY_VARIABLE(TEST_COUNTED), 1, 1, sizeof(THANDLE_WRAPPER_TYPE_NAME(TEST_COUNTED)) + 100, 1);
+
+    ///act
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(processor_index_get_current());
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    THANDLE_ASSIGN(TEST_COUNTED)(&counted, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(THANDLE_TELEMETRY_VARIABLE(TEST_COUNTED), 1, 0, 0, 1);
+
+    ///clean
+    THANDLE_TELEMETRY_DEINIT(TEST_COUNTED)();
+}
+
+/*Tests_SRS_THANDLE_02_073: [ If T is not registered then the functions that create a THANDLE(T) shall remember that the wrapper is not counted. ]*/
+/*Tests_SRS_THANDLE_02_075: [ If T is registered and the wrapper was counted then THANDLE_FREE shall call thandle_telemetry_on_free with the size of the wrapper. ]*/
+TEST_FUNCTION(a_wrapper_created_before_THANDLE_TELEMETRY_INIT_is_not_counted)
+{
+    ///arrange
+    TEST_COUNTED source;
+    source.a = 42;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(TEST_COUNTED) counted = THANDLE_CREATE_FROM_CONTENT(TEST_COUNTED)(&source, NULL, NULL);
+    ASSERT_IS_NOT_NULL(counted);
+    umock_c_reset_all_calls();
+
+    TEST_COUNTED_telemetry_init();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+
+    ///act
+    THANDLE_ASSIGN(TEST_COUNTED)(&counted, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_STATISTICS(THANDLE_TELEMETRY_VARIABLE(TEST_COUNTED), 0, 0, 0, 0);
+
+    ///clean
+    THANDLE_TELEMETRY_DEINIT(TEST_COUNTED)();
+}
+
+END_TEST_SUITE(thandle_telemetry_unittests)
@@ -199,6 +199,26 @@ extern "C" {
 #undef THANDLE_MALLOC_FUNCTION
 #undef THANDLE_FREE_FUNCTION
 
+/*A_L is a type that also has THANDLE_LOCAL(A_L)*/
+#define A_L_FIELDS          \
+    int, a,                 \
+    int, b
+
+MU_DEFINE_STRUCT(A_L, A_L_FIELDS);
+
+#define THANDLE_MALLOC_FUNCTION gballoc_hl_malloc
+#define THANDLE_FREE_FUNCTION gballoc_hl_free
+#ifdef __cplusplus
+extern "C" {
+#endif
+    THANDLE_LOCAL_TYPE_DECLARE(A_L);
+    THANDLE_LOCAL_TYPE_DEFINE(A_L);
+#ifdef __cplusplus
+}
+#endif
+#undef THANDLE_MALLOC_FUNCTION
+#undef THANDLE_FREE_FUNCTION
+
 BEGIN_TEST_SUITE(thandle_unittests)
 
 TEST_SUITE_INITIALIZE(it_does_something)
@@ -1144,5 +1164,479 @@ TEST_FUNCTION(THANDLE_INITIALIZE_MOVE_with_star_t1_not_NULL_and_star_t2_not_NULL
     THANDLE_DEC_REF(LL)(ll1);
 }
 
+/* THANDLE_WEAK_INITIALIZE */
+
+/*Tests_SRS_THANDLE_02_040: [ If lvalue is NULL then THANDLE_WEAK_INITIALIZE shall return. ]*/
+TEST_FUNCTION(THANDLE_WEAK_INITIALIZE_with_lvalue_NULL_returns)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(LL) ll = ll_create(1, "1");
+    ASSERT_IS_NOT_NULL(ll);
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_WEAK_INITIALIZE(LL)(NULL, ll);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_DEC_REF(LL)(ll);
+}
+
+/*Tests_SRS_THANDLE_02_041: [ If rvalue is NULL then THANDLE_WEAK_INITIALIZE shall store NULL in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_WEAK_INITIALIZE_with_rvalue_NULL_succeeds)
+{
+    ///arrange
+    THANDLE_WEAK(LL) weak = (const struct THANDLE_WEAK_STRUCT(LL)*)0x42; /*uninitialized memory*/
+
+    ///act
+    THANDLE_WEAK_INITIALIZE(LL)(&weak, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(weak);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_042: [ THANDLE_WEAK_INITIALIZE shall increment the weak ref count of rvalue and store it in *lvalue. ]*/
+/*Tests_SRS_THANDLE_02_039: [ If the ref count of t reaches 0 then THANDLE_DEC_REF shall decrement the weak ref count of t and free the used memory only when the weak ref count reaches 0. ]*/
+TEST_FUNCTION(THANDLE_WEAK_INITIALIZE_keeps_the_memory_after_the_last_THANDLE_DEC_REF)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(LL) ll = ll_create(1, "1");
+    THANDLE_WEAK(LL) weak = NULL;
+    ASSERT_IS_NOT_NULL(ll);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG)); /*only the string is freed by dispose*/
+
+    ///act
+    THANDLE_WEAK_INITIALIZE(LL)(&weak, ll);
+    THANDLE_DEC_REF(LL)(ll);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(weak);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_WEAK_ASSIGN(LL)(&weak, NULL);
+}
+
+/* THANDLE_WEAK_ASSIGN */
+
+/*Tests_SRS_THANDLE_02_043: [ If t1 is NULL then THANDLE_WEAK_ASSIGN shall return. ]*/
+TEST_FUNCTION(THANDLE_WEAK_ASSIGN_with_t1_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_WEAK_ASSIGN(LL)(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_044: [ THANDLE_WEAK_ASSIGN shall increment the weak ref count of t2 (if not NULL), decrement the weak ref count of *t1 (if not NULL) and store t2 in *t1. ]*/
+/*Tests_SRS_THANDLE_02_045: [ If the weak ref count reaches 0 then the memory used by the wrapper shall be freed. ]*/
+TEST_FUNCTION(THANDLE_WEAK_ASSIGN_NULL_after_the_last_THANDLE_DEC_REF_frees_the_memory)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(LL) ll = ll_create(1, "1");
+    THANDLE_WEAK(LL) weak = NULL;
+    ASSERT_IS_NOT_NULL(ll);
+    THANDLE_WEAK_ASSIGN(LL)(&weak, ll);
+    ASSERT_IS_NOT_NULL(weak);
+    THANDLE_DEC_REF(LL)(ll);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG)); /*THANDLE_MALLOC's memory*/
+
+    ///act
+    THANDLE_WEAK_ASSIGN(LL)(&weak, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(weak);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_044: [ THANDLE_WEAK_ASSIGN shall increment the weak ref count of t2 (if not NULL), decrement the weak ref count of *t1 (if not NULL) and store t2 in *t1. ]*/
+TEST_FUNCTION(THANDLE_WEAK_ASSIGN_with_star_t1_not_NULL_and_t2_not_NULL)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(LL) ll1 = ll_create(1, "1");
+    ASSERT_IS_NOT_NULL(ll1);
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(LL) ll2 = ll_create(2, "2");
+    ASSERT_IS_NOT_NULL(ll2);
+
+    THANDLE_WEAK(LL) weak = NULL;
+    THANDLE_WEAK_INITIALIZE(LL)(&weak, ll1);
+    THANDLE_DEC_REF(LL)(ll1); /*only weak keeps the memory of ll1*/
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG)); /*ll1's THANDLE_MALLOC memory*/
+
+    ///act
+    THANDLE_WEAK_ASSIGN(LL)(&weak, ll2);
+
+    ///assert
+    ASSERT_IS_TRUE((const void*)weak == (const void*)ll2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_DEC_REF(LL)(ll2);
+    THANDLE_WEAK_ASSIGN(LL)(&weak, NULL);
+}
+
+/* THANDLE_WEAK_UPGRADE */
+
+/*Tests_SRS_THANDLE_02_046: [ If lvalue is NULL then THANDLE_WEAK_UPGRADE shall return. ]*/
+TEST_FUNCTION(THANDLE_WEAK_UPGRADE_with_lvalue_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_WEAK_UPGRADE(LL)(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_047: [ If weak is NULL then THANDLE_WEAK_UPGRADE shall store NULL in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_WEAK_UPGRADE_with_weak_NULL_stores_NULL)
+{
+    ///arrange
+    THANDLE(LL) ll = (LL*)0x42; /*uninitialized memory*/
+
+    ///act
+    THANDLE_WEAK_UPGRADE(LL)(&ll, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(ll);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_048: [ THANDLE_WEAK_UPGRADE shall increment the ref count of weak with interlocked_compare_exchange only if the ref count is not 0, and try again if the ref count changed meanwhile. ]*/
+/*Tests_SRS_THANDLE_02_050: [ THANDLE_WEAK_UPGRADE shall store weak as a THANDLE(T) in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_WEAK_UPGRADE_of_a_live_object_succeeds)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(LL) ll = ll_create(1, "1");
+    THANDLE(LL) upgraded = NULL;
+    THANDLE_WEAK(LL) weak = NULL;
+    ASSERT_IS_NOT_NULL(ll);
+    THANDLE_WEAK_INITIALIZE(LL)(&weak, ll);
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_WEAK_UPGRADE(LL)(&upgraded, weak);
+
+    ///assert
+    ASSERT_IS_TRUE(ll == upgraded);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    THANDLE_DEC_REF(LL)(ll); /*upgraded still keeps the object alive*/
+    ASSERT_ARE_EQUAL(int, 1, ll_get_a(upgraded));
+
+    ///clean
+    THANDLE_DEC_REF(LL)(upgraded);
+    THANDLE_WEAK_ASSIGN(LL)(&weak, NULL);
+}
+
+/*Tests_SRS_THANDLE_02_049: [ If the ref count of weak is 0 then THANDLE_WEAK_UPGRADE shall store NULL in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_WEAK_UPGRADE_of_a_disposed_object_stores_NULL)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(LL) ll = ll_create(1, "1");
+    THANDLE(LL) upgraded = NULL;
+    THANDLE_WEAK(LL) weak = NULL;
+    ASSERT_IS_NOT_NULL(ll);
+    THANDLE_WEAK_INITIALIZE(LL)(&weak, ll);
+    THANDLE_DEC_REF(LL)(ll);
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_WEAK_UPGRADE(LL)(&upgraded, weak);
+
+    ///assert
+    ASSERT_IS_NULL(upgraded);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_WEAK_ASSIGN(LL)(&weak, NULL);
+}
+
+/*Tests_SRS_THANDLE_02_051: [ If t is NULL then THANDLE_LOCAL_INC_REF shall return. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_INC_REF_with_t_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_LOCAL_INC_REF(A_L)(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_053: [ If t is NULL then THANDLE_LOCAL_DEC_REF shall return. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_DEC_REF_with_t_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_LOCAL_DEC_REF(A_L)(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_060: [ If lvalue is NULL then THANDLE_LOCAL_INITIALIZE_MOVE shall return. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_INITIALIZE_MOVE_with_lvalue_NULL_returns)
+{
+    ///arrange
+    A_L a_l = { 1, 2 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(A_L) t = THANDLE_CREATE_FROM_CONTENT(A_L)(&a_l, NULL, NULL);
+    ASSERT_IS_NOT_NULL(t);
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(NULL, &t);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(t);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_DEC_REF(A_L)(t);
+}
+
+/*Tests_SRS_THANDLE_02_061: [ If t is NULL then THANDLE_LOCAL_INITIALIZE_MOVE shall return. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_INITIALIZE_MOVE_with_t_NULL_returns)
+{
+    ///arrange
+    THANDLE_LOCAL(A_L) local = NULL;
+
+    ///act
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(&local, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(local);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_062: [ If *t is NULL then THANDLE_LOCAL_INITIALIZE_MOVE shall store NULL in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_INITIALIZE_MOVE_with_star_t_NULL_stores_NULL)
+{
+    ///arrange
+    THANDLE_LOCAL(A_L) local = (THANDLE_LOCAL(A_L))0x42; /*uninitialized memory*/
+    THANDLE(A_L) t = NULL;
+
+    ///act
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(&local, &t);
+
+    ///assert
+    ASSERT_IS_NULL(local);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_063: [ THANDLE_LOCAL_INITIALIZE_MOVE shall set the local ref count of *t to 1, move the reference of *t under *lvalue and set *t to NULL. ]*/
+/*Tests_SRS_THANDLE_02_066: [ THANDLE_LOCAL_GET_T(T) shall return the T* under t (NULL if t is NULL). ]*/
+TEST_FUNCTION(THANDLE_LOCAL_INITIALIZE_MOVE_succeeds)
+{
+    ///arrange
+    A_L a_l = { 1, 2 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(A_L) t = THANDLE_CREATE_FROM_CONTENT(A_L)(&a_l, NULL, NULL);
+    THANDLE_LOCAL(A_L) local = NULL;
+    ASSERT_IS_NOT_NULL(t);
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(&local, &t);
+
+    ///assert
+    ASSERT_IS_NULL(t);
+    ASSERT_IS_NOT_NULL(local);
+    ASSERT_ARE_EQUAL(int, 1, THANDLE_LOCAL_GET_T(A_L)(local)->a);
+    ASSERT_ARE_EQUAL(int, 2, THANDLE_LOCAL_GET_T(A_L)(local)->b);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_LOCAL_DEC_REF(A_L)(local);
+}
+
+/*Tests_SRS_THANDLE_02_058: [ If lvalue is NULL then THANDLE_LOCAL_INITIALIZE shall return. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_INITIALIZE_with_lvalue_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_LOCAL_INITIALIZE(A_L)(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_059: [ THANDLE_LOCAL_INITIALIZE shall call THANDLE_LOCAL_INC_REF on rvalue (if not NULL) and store rvalue in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_INITIALIZE_with_rvalue_NULL_stores_NULL)
+{
+    ///arrange
+    THANDLE_LOCAL(A_L) local = (THANDLE_LOCAL(A_L))0x42; /*uninitialized memory*/
+
+    ///act
+    THANDLE_LOCAL_INITIALIZE(A_L)(&local, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(local);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_052: [ THANDLE_LOCAL_INC_REF shall increment the local ref count of t without interlocked operations. ]*/
+/*Tests_SRS_THANDLE_02_054: [ THANDLE_LOCAL_DEC_REF shall decrement the local ref count of t without interlocked operations. ]*/
+/*Tests_SRS_THANDLE_02_055: [ If the local ref count of t reaches 0 then THANDLE_LOCAL_DEC_REF shall call THANDLE_DEC_REF. ]*/
+/*Tests_SRS_THANDLE_02_059: [ THANDLE_LOCAL_INITIALIZE shall call THANDLE_LOCAL_INC_REF on rvalue (if not NULL) and store rvalue in *lvalue. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_DEC_REF_frees_the_memory_only_after_the_last_local)
+{
+    ///arrange
+    A_L a_l = { 1, 2 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(A_L) t = THANDLE_CREATE_FROM_CONTENT(A_L)(&a_l, NULL, NULL);
+    THANDLE_LOCAL(A_L) local1 = NULL;
+    THANDLE_LOCAL(A_L) local2 = NULL;
+    ASSERT_IS_NOT_NULL(t);
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(&local1, &t);
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_LOCAL_INITIALIZE(A_L)(&local2, local1);
+    THANDLE_LOCAL_DEC_REF(A_L)(local1);
+
+    ///assert
+    ASSERT_IS_TRUE(local1 == local2);
+    ASSERT_ARE_EQUAL(int, 1, THANDLE_LOCAL_GET_T(A_L)(local2)->a);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///act
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    THANDLE_LOCAL_DEC_REF(A_L)(local2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_056: [ If t1 is NULL then THANDLE_LOCAL_ASSIGN shall return. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_ASSIGN_with_t1_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_LOCAL_ASSIGN(A_L)(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_057: [ THANDLE_LOCAL_ASSIGN shall call THANDLE_LOCAL_INC_REF on t2 (if not NULL), THANDLE_LOCAL_DEC_REF on *t1 (if not NULL) and store t2 in *t1. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_ASSIGN_with_star_t1_not_NULL_and_t2_not_NULL)
+{
+    ///arrange
+    A_L a_l1 = { 1, 2 };
+    A_L a_l2 = { 3, 4 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(A_L) t1 = THANDLE_CREATE_FROM_CONTENT(A_L)(&a_l1, NULL, NULL);
+    THANDLE(A_L) t2 = THANDLE_CREATE_FROM_CONTENT(A_L)(&a_l2, NULL, NULL);
+    THANDLE_LOCAL(A_L) local1 = NULL;
+    THANDLE_LOCAL(A_L) local2 = NULL;
+    ASSERT_IS_NOT_NULL(t1);
+    ASSERT_IS_NOT_NULL(t2);
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(&local1, &t1);
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(&local2, &t2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG)); /*the object of local1 goes away*/
+
+    ///act
+    THANDLE_LOCAL_ASSIGN(A_L)(&local1, local2);
+
+    ///assert
+    ASSERT_IS_TRUE(local1 == local2);
+    ASSERT_ARE_EQUAL(int, 3, THANDLE_LOCAL_GET_T(A_L)(local1)->a);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    THANDLE_LOCAL_ASSIGN(A_L)(&local1, NULL);
+    THANDLE_LOCAL_ASSIGN(A_L)(&local2, NULL);
+}
+
+/*Tests_SRS_THANDLE_02_064: [ If lvalue is NULL then THANDLE_LOCAL_SHARE shall return. ]*/
+TEST_FUNCTION(THANDLE_LOCAL_SHARE_with_lvalue_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    THANDLE_LOCAL_SHARE(A_L)(NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_065: [ THANDLE_LOCAL_SHARE shall call THANDLE_INITIALIZE with lvalue and local as a THANDLE(T). ]*/
+TEST_FUNCTION(THANDLE_LOCAL_SHARE_keeps_the_object_alive_after_the_last_local)
+{
+    ///arrange
+    A_L a_l = { 1, 2 };
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    THANDLE(A_L) t = THANDLE_CREATE_FROM_CONTENT(A_L)(&a_l, NULL, NULL);
+    THANDLE(A_L) shared = NULL;
+    THANDLE_LOCAL(A_L) local = NULL;
+    ASSERT_IS_NOT_NULL(t);
+    THANDLE_LOCAL_INITIALIZE_MOVE(A_L)(&local, &t);
+    umock_c_reset_all_calls();
+
+    ///act
+    THANDLE_LOCAL_SHARE(A_L)(&shared, local);
+    THANDLE_LOCAL_ASSIGN(A_L)(&local, NULL);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(shared);
+    ASSERT_ARE_EQUAL(int, 1, shared->a);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///act
+    STRICT_EXPECTED_CALL(free(IGNORED_ARG));
+    THANDLE_ASSIGN(A_L)(&shared, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_THANDLE_02_066: [ THANDLE_LOCAL_GET_T(T) shall return the T* under t (NULL if t is NULL). ]*/
+TEST_FUNCTION(THANDLE_LOCAL_GET_T_with_t_NULL_returns_NULL)
+{
+    ///arrange
+
+    ///act
+    A_L* result = THANDLE_LOCAL_GET_T(A_L)(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 END_TEST_SUITE(thandle_unittests)
 
@@ -0,0 +1,559 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#include "azure_macro_utils/macro_utils.h"
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#include "azure_c_pal/interlocked.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_pal/gballoc_hl.h"
+#include "azure_c_pal/gballoc_hl_redirect.h"
+#include "azure_c_pal/sync.h"
+#include "azure_c_pal/timer.h"
+#include "azure_c_util/interlocked_hl.h"
+#undef ENABLE_MOCKS
+
+#include "real_interlocked_hl.h"
+#include "real_gballoc_hl.h"
+
+#include "azure_c_util/token_bucket.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    ASSERT_FAIL("umock_c reported error :%" PRI_MU_ENUM "", MU_ENUM_VALUE(UMOCK_C_ERROR_CODE, error_code));
+}
+
+MU_DEFINE_ENUM_STRINGS(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_RESULT_VALUES);
+
+/*the clock only moves when a test (or a wait) moves it*/
+static double g_now_ms;
+
+static double hook_timer_global_get_elapsed_ms(void)
+{
+    return g_now_ms;
+}
+
+/*waiting is simulated by moving the clock. When g_bucket_refilled_during_wait is not NULL, another thread takes a token meanwhile (and so refills the bucket)*/
+static TOKEN_BUCKET_HANDLE g_bucket_refilled_during_wait;
+
+static bool hook_wait_on_address(volatile_atomic int32_t* address, int32_t compare_value, uint32_t timeout_ms)
+{
+    (void)address;
+    (void)compare_value;
+    if (g_bucket_refilled_during_wait != NULL)
+    {
+        TOKEN_BUCKET_HANDLE token_bucket = g_bucket_refilled_during_wait;
+        g_bucket_refilled_during_wait = NULL;
+        g_now_ms += 1;
+        ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(token_bucket, 1));
+        return true;
+    }
+    else
+    {
+        g_now_ms += timeout_ms;
+        return false;
+    }
+}
+
+static uint32_t g_wake_by_address_all_call_count;
+
+static void hook_wake_by_address_all(volatile_atomic int32_t* address)
+{
+    (void)address;
+    g_wake_by_address_all_call_count++;
+}
+
+static TOKEN_BUCKET_HANDLE TEST_token_bucket_create(int64_t capacity, int64_t tokens_per_second)
+{
+    TOKEN_BUCKET_HANDLE result = token_bucket_create(capacity, tokens_per_second);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/*creates a bucket with capacity tokens refilled with 1 token every millisecond and takes all the tokens out*/
+static TOKEN_BUCKET_HANDLE TEST_token_bucket_create_empty(int64_t capacity)
+{
+    TOKEN_BUCKET_HANDLE result = TEST_token_bucket_create(capacity, 1000);
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(result, capacity));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(token_bucket_unittests)
+
+TEST_SUITE_INITIALIZE(setsBufferTempSize)
+{
+    ASSERT_ARE_EQUAL(int, 0, real_gballoc_hl_init(NULL, NULL));
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_stdint_register_types());
+    ASSERT_ARE_EQUAL(int, 0, umocktypes_bool_register_types());
+
+    REGISTER_GBALLOC_HL_GLOBAL_MOCK_HOOK();
+    REGISTER_INTERLOCKED_HL_GLOBAL_MOCK_HOOK();
+
+    REGISTER_GLOBAL_MOCK_HOOK(timer_global_get_elapsed_ms, hook_timer_global_get_elapsed_ms);
+    REGISTER_GLOBAL_MOCK_HOOK(wait_on_address, hook_wait_on_address);
+    REGISTER_GLOBAL_MOCK_HOOK(wake_by_address_all, hook_wake_by_address_all);
+
+    REGISTER_TYPE(INTERLOCKED_HL_RESULT, INTERLOCKED_HL_RESULT);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+
+    real_gballoc_hl_deinit();
+}
+
+TEST_FUNCTION_INITIALIZE(f)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_now_ms = 1000;
+    g_bucket_refilled_during_wait = NULL;
+    g_wake_by_address_all_call_count = 0;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(cleans)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_001: [ If capacity is less than or equal to 0 then token_bucket_create shall fail and return NULL. ]*/
+TEST_FUNCTION(token_bucket_create_with_capacity_0_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket;
+
+    ///act
+    token_bucket = token_bucket_create(0, 10);
+
+    ///assert
+    ASSERT_IS_NULL(token_bucket);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_002: [ If tokens_per_second is less than or equal to 0 then token_bucket_create shall fail and return NULL. ]*/
+TEST_FUNCTION(token_bucket_create_with_tokens_per_second_0_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket;
+
+    ///act
+    token_bucket = token_bucket_create(10, 0);
+
+    ///assert
+    ASSERT_IS_NULL(token_bucket);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_003: [ token_bucket_create shall allocate memory for the bucket. ]*/
+/*Tests_SRS_TOKEN_BUCKET_02_005: [ token_bucket_create shall record the current time from timer_global_get_elapsed_ms, set the bucket to hold capacity tokens, succeed and return a non-NULL value. ]*/
+TEST_FUNCTION(token_bucket_create_succeeds)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+
+    ///act
+    token_bucket = token_bucket_create(10, 10);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(token_bucket);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(token_bucket, 10)); /*the bucket starts full*/
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_004: [ If there are any failures then token_bucket_create shall fail and return NULL. ]*/
+TEST_FUNCTION(when_malloc_fails_token_bucket_create_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket;
+
+    STRICT_EXPECTED_CALL(malloc(IGNORED_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    token_bucket = token_bucket_create(10, 10);
+
+    ///assert
+    ASSERT_IS_NULL(token_bucket);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_006: [ If token_bucket is NULL then token_bucket_destroy shall return. ]*/
+TEST_FUNCTION(token_bucket_destroy_with_token_bucket_NULL_returns)
+{
+    ///arrange
+
+    ///act
+    token_bucket_destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_007: [ token_bucket_destroy shall free all used resources. ]*/
+TEST_FUNCTION(token_bucket_destroy_frees)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+
+    STRICT_EXPECTED_CALL(free(token_bucket));
+
+    ///act
+    token_bucket_destroy(token_bucket);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_008: [ If token_bucket is NULL then token_bucket_try_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+TEST_FUNCTION(token_bucket_try_acquire_with_token_bucket_NULL_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_RESULT result;
+
+    ///act
+    result = token_bucket_try_acquire(NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_009: [ If count is less than or equal to 0 or count is greater than the capacity of the bucket then token_bucket_try_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+TEST_FUNCTION(token_bucket_try_acquire_with_count_0_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    TOKEN_BUCKET_RESULT result;
+
+    ///act
+    result = token_bucket_try_acquire(token_bucket, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_009: [ If count is less than or equal to 0 or count is greater than the capacity of the bucket then token_bucket_try_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+TEST_FUNCTION(token_bucket_try_acquire_with_count_greater_than_capacity_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    TOKEN_BUCKET_RESULT result;
+
+    ///act
+    result = token_bucket_try_acquire(token_bucket, 11);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_010: [ token_bucket_try_acquire shall compute from timer_global_get_elapsed_ms the number of tokens due since the creation of the bucket and give back to the bucket the tokens that were not given back yet, without exceeding capacity. ]*/
+/*Tests_SRS_TOKEN_BUCKET_02_011: [ token_bucket_try_acquire shall take count tokens from the bucket by calling InterlockedHL_Add64WithCeiling with the capacity of the bucket as ceiling. ]*/
+/*Tests_SRS_TOKEN_BUCKET_02_012: [ If InterlockedHL_Add64WithCeiling succeeds then token_bucket_try_acquire shall succeed and return TOKEN_BUCKET_OK. ]*/
+TEST_FUNCTION(token_bucket_try_acquire_succeeds)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    TOKEN_BUCKET_RESULT result;
+
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG));
+
+    ///act
+    result = token_bucket_try_acquire(token_bucket, 4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_013: [ Otherwise token_bucket_try_acquire shall return TOKEN_BUCKET_NOT_ENOUGH_TOKENS. ]*/
+TEST_FUNCTION(token_bucket_try_acquire_with_not_enough_tokens_returns_TOKEN_BUCKET_NOT_ENOUGH_TOKENS)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    TOKEN_BUCKET_RESULT result;
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(token_bucket, 7));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 4, IGNORED_ARG));
+
+    ///act
+    result = token_bucket_try_acquire(token_bucket, 4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_NOT_ENOUGH_TOKENS, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(token_bucket, 3)); /*the failed call did not take anything*/
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_010: [ token_bucket_try_acquire shall compute from timer_global_get_elapsed_ms the number of tokens due since the creation of the bucket and give back to the bucket the tokens that were not given back yet, without exceeding capacity. ]*/
+TEST_FUNCTION(token_bucket_try_acquire_refills_the_bucket_with_the_tokens_due)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10); /*1 token every 100 ms*/
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(token_bucket, 10));
+    g_now_ms += 350;
+
+    ///act
+    TOKEN_BUCKET_RESULT result_3 = token_bucket_try_acquire(token_bucket, 3);
+    TOKEN_BUCKET_RESULT result_1 = token_bucket_try_acquire(token_bucket, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, result_3);
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_NOT_ENOUGH_TOKENS, result_1);
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_010: [ token_bucket_try_acquire shall compute from timer_global_get_elapsed_ms the number of tokens due since the creation of the bucket and give back to the bucket the tokens that were not given back yet, without exceeding capacity. ]*/
+TEST_FUNCTION(token_bucket_try_acquire_does_not_refill_more_than_capacity)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(token_bucket, 5));
+    g_now_ms += 60000;
+
+    ///act
+    TOKEN_BUCKET_RESULT result_10 = token_bucket_try_acquire(token_bucket, 10);
+    TOKEN_BUCKET_RESULT result_1 = token_bucket_try_acquire(token_bucket, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, result_10);
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_NOT_ENOUGH_TOKENS, result_1);
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_014: [ If token_bucket is NULL then token_bucket_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+TEST_FUNCTION(token_bucket_acquire_with_token_bucket_NULL_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_RESULT result;
+
+    ///act
+    result = token_bucket_acquire(NULL, 1, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_015: [ If count is less than or equal to 0 or count is greater than the capacity of the bucket then token_bucket_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+TEST_FUNCTION(token_bucket_acquire_with_count_negative_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    TOKEN_BUCKET_RESULT result;
+
+    ///act
+    result = token_bucket_acquire(token_bucket, -1, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_015: [ If count is less than or equal to 0 or count is greater than the capacity of the bucket then token_bucket_acquire shall fail and return TOKEN_BUCKET_ERROR. ]*/
+TEST_FUNCTION(token_bucket_acquire_with_count_greater_than_capacity_fails)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    TOKEN_BUCKET_RESULT result;
+
+    ///act
+    result = token_bucket_acquire(token_bucket, 11, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_016: [ token_bucket_acquire shall refill the bucket as token_bucket_try_acquire does. ]*/
+/*Tests_SRS_TOKEN_BUCKET_02_017: [ token_bucket_acquire shall take count tokens from the bucket by calling InterlockedHL_Add64WithCeiling with the capacity of the bucket as ceiling. If that succeeds then token_bucket_acquire shall succeed and return TOKEN_BUCKET_OK. ]*/
+TEST_FUNCTION(token_bucket_acquire_with_enough_tokens_succeeds_without_waiting)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create(10, 10);
+    TOKEN_BUCKET_RESULT result;
+
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 10, IGNORED_ARG));
+
+    ///act
+    result = token_bucket_acquire(token_bucket, 10, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_019: [ Otherwise token_bucket_acquire shall wait with wait_on_address for the bucket to be refilled, at most for the time needed to refill the missing tokens and at most until timeout_ms expires, and then try again. ]*/
+TEST_FUNCTION(token_bucket_acquire_waits_for_the_missing_tokens)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create_empty(10);
+    TOKEN_BUCKET_RESULT result;
+
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 5, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, 0, 6)); /*5 tokens at 1 token/ms, rounded up*/
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 5, IGNORED_ARG));
+
+    ///act
+    result = token_bucket_acquire(token_bucket, 5, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_018: [ If timeout_ms is not UINT32_MAX and timeout_ms milliseconds have elapsed since token_bucket_acquire was called then token_bucket_acquire shall return TOKEN_BUCKET_TIMEOUT. ]*/
+/*Tests_SRS_TOKEN_BUCKET_02_019: [ Otherwise token_bucket_acquire shall wait with wait_on_address for the bucket to be refilled, at most for the time needed to refill the missing tokens and at most until timeout_ms expires, and then try again. ]*/
+TEST_FUNCTION(token_bucket_acquire_times_out)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create_empty(10);
+    TOKEN_BUCKET_RESULT result;
+
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 5, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(wait_on_address(IGNORED_ARG, 0, 4)); /*the timeout comes before the tokens*/
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 5, IGNORED_ARG));
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+
+    ///act
+    result = token_bucket_acquire(token_bucket, 5, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_TIMEOUT, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, token_bucket_try_acquire(token_bucket, 4)); /*the tokens refilled meanwhile are still in the bucket*/
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_020: [ When the refill gives back tokens and there are threads waiting in token_bucket_acquire, the waiting threads shall be woken up with wake_by_address_all. ]*/
+TEST_FUNCTION(a_refill_in_another_thread_wakes_up_token_bucket_acquire)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create_empty(10);
+    TOKEN_BUCKET_RESULT result;
+    g_bucket_refilled_during_wait = token_bucket;
+
+    ///act
+    result = token_bucket_acquire(token_bucket, 5, UINT32_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, result);
+    ASSERT_ARE_EQUAL(uint32_t, 1, g_wake_by_address_all_call_count);
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+/*Tests_SRS_TOKEN_BUCKET_02_020: [ When the refill gives back tokens and there are threads waiting in token_bucket_acquire, the waiting threads shall be woken up with wake_by_address_all. ]*/
+TEST_FUNCTION(a_refill_without_waiters_does_not_wake)
+{
+    ///arrange
+    TOKEN_BUCKET_HANDLE token_bucket = TEST_token_bucket_create_empty(10);
+    TOKEN_BUCKET_RESULT result;
+    g_now_ms += 5;
+
+    STRICT_EXPECTED_CALL(timer_global_get_elapsed_ms());
+    STRICT_EXPECTED_CALL(InterlockedHL_Add64WithCeiling(IGNORED_ARG, 10, 5, IGNORED_ARG));
+
+    ///act
+    result = token_bucket_try_acquire(token_bucket, 5);
+
+    ///assert
+    ASSERT_ARE_EQUAL(TOKEN_BUCKET_RESULT, TOKEN_BUCKET_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///clean
+    token_bucket_destroy(token_bucket);
+}
+
+END_TEST_SUITE(token_bucket_unittests)